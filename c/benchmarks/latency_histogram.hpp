@@ -0,0 +1,108 @@
+#ifndef BENCHMARKS_LATENCY_HISTOGRAM_HPP
+#define BENCHMARKS_LATENCY_HISTOGRAM_HPP
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <stdint.h>
+
+#include <chrono>
+#include <vector>
+
+// Latencies in nanoseconds, counted in the manner of an HDR histogram: every
+// power of two range is split into SUB_COUNT/2 linear buckets, so a
+// percentile is reported within 1% of the recorded value whatever its size.
+// Recording is a few instructions and never allocates, merge the histograms
+// of separate threads or connections when the run is over.
+class latency_histogram {
+  public:
+    latency_histogram() : counts_(BUCKETS), total_(0), max_(0) {}
+
+    void record(uint64_t ns) {
+        ++counts_[index(ns)];
+        ++total_;
+        if (ns > max_) max_ = ns;
+    }
+
+    void merge(const latency_histogram &other) {
+        for (size_t i = 0; i < BUCKETS; ++i) counts_[i] += other.counts_[i];
+        total_ += other.total_;
+        if (other.max_ > max_) max_ = other.max_;
+    }
+
+    uint64_t count() const { return total_; }
+
+    // The highest value that can be in the bucket of the p-th percentile
+    uint64_t percentile(double p) const {
+        if (!total_) return 0;
+        uint64_t rank = uint64_t(p / 100.0 * total_ + 0.5);
+        if (rank < 1) rank = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                uint64_t v = highest(i);
+                return v < max_ ? v : max_;
+            }
+        }
+        return max_;
+    }
+
+    // Report p50, p99 and p99.9 in microseconds as benchmark counters
+    void report(benchmark::State &state) const {
+        state.counters["p50_us"] = percentile(50) / 1e3;
+        state.counters["p99_us"] = percentile(99) / 1e3;
+        state.counters["p99.9_us"] = percentile(99.9) / 1e3;
+    }
+
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+  private:
+    static const int SUB_BITS = 8;
+    static const uint64_t SUB_COUNT = 1 << SUB_BITS;
+    static const uint64_t HALF = SUB_COUNT / 2;
+    static const size_t BUCKETS = (64 - SUB_BITS + 2) * HALF;
+
+    // Values below SUB_COUNT have a bucket each, above that the top SUB_BITS
+    // bits of a value choose its bucket within its power of two range.
+    static size_t index(uint64_t v) {
+        if (v < SUB_COUNT) return v;
+        int shift = 63 - __builtin_clzll(v) - (SUB_BITS - 1);
+        return shift * HALF + (v >> shift);
+    }
+
+    static uint64_t highest(size_t i) {
+        if (i < SUB_COUNT) return i;
+        int shift = int(i / HALF) - 1;
+        uint64_t sub = i - shift * HALF;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::vector<uint64_t> counts_;
+    uint64_t total_;
+    uint64_t max_;
+};
+
+#endif // BENCHMARKS_LATENCY_HISTOGRAM_HPP
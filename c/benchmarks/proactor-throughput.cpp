@@ -0,0 +1,339 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "proton/condition.h"
+#include "proton/connection.h"
+#include "proton/delivery.h"
+#include "proton/link.h"
+#include "proton/listener.h"
+#include "proton/netaddr.h"
+#include "proton/proactor.h"
+#include "proton/sasl.h"
+#include "proton/session.h"
+#include "proton/ssl.h"
+#include "proton/transport.h"
+
+#include "latency_histogram.hpp"
+
+// Messages sent through the proactor over loopback: N connections each with
+// M sending links, served by T threads that share one proactor with the
+// receiving ends. Every message carries the time it was sent, so besides
+// msgs/s and bytes/s the receivers report latency percentiles. Use it to
+// check proactor scheduling changes against regressions. Run from c/tests
+// so the test certificates are found.
+
+enum security_t { SEC_NONE, SEC_SASL, SEC_TLS };
+
+static const int CREDIT = 500;
+static const uint64_t MAX_MESSAGES = 50000;
+static const uint64_t MAX_BYTES = 128 * 1024 * 1024;
+static const pn_millis_t TIMEOUT = 60 * 1000;
+
+struct connection_t {
+  bool server;
+  uint64_t sent;               // client: messages sent on all links
+  std::vector<uint64_t> link_sent;  // client: messages sent on each link
+  latency_histogram latency;   // server: latency of messages received
+};
+
+struct bench_t {
+  pn_proactor_t *proactor;
+  security_t security;
+  pn_ssl_domain_t *client_ssl;
+  pn_ssl_domain_t *server_ssl;
+  size_t connections;
+  size_t links;
+  size_t threads;
+  size_t size;
+  uint64_t per_link;
+  uint64_t total;
+  std::vector<connection_t> clients;
+  std::vector<connection_t> servers;
+  size_t accepted;             // only used by listener events
+  std::atomic<uint64_t> received;
+  std::atomic<uint64_t> start;
+  std::atomic<uint64_t> end;
+  std::atomic<bool> done;
+  std::mutex lock;
+  std::string error;
+
+  void fail(const std::string &what) {
+    std::lock_guard<std::mutex> g(lock);
+    if (error.empty()) error = what;
+  }
+};
+
+// Room for a message on each thread, filled with the time stamp and the payload
+static thread_local std::vector<char> buffer;
+
+static bool setup_ssl(bench_t &b) {
+  b.client_ssl = pn_ssl_domain(PN_SSL_MODE_CLIENT);
+  b.server_ssl = pn_ssl_domain(PN_SSL_MODE_SERVER);
+  return b.client_ssl && b.server_ssl &&
+         pn_ssl_domain_set_credentials(b.server_ssl, "ssl-certs/tserver-certificate.pem",
+                                       "ssl-certs/tserver-private-key.pem", "tserverpw") == 0 &&
+         pn_ssl_domain_set_peer_authentication(b.client_ssl, PN_SSL_ANONYMOUS_PEER, NULL) == 0;
+}
+
+static pn_transport_t *make_transport(bench_t &b, bool server) {
+  pn_transport_t *t = pn_transport();
+  if (server) pn_transport_set_server(t);
+  if (b.security == SEC_TLS)
+    pn_ssl_init(pn_ssl(t), server ? b.server_ssl : b.client_ssl, NULL);
+  if (b.security != SEC_NONE)
+    pn_sasl_allowed_mechs(pn_sasl(t), "ANONYMOUS");
+  return t;
+}
+
+static void send_messages(bench_t &b, connection_t &c, pn_link_t *l) {
+  uint64_t *sent = (uint64_t *) pn_link_get_context(l);
+  if (buffer.size() < b.size) buffer.resize(b.size, 'x');
+  while (pn_link_credit(l) > 0 && *sent < b.per_link) {
+    uint64_t now = latency_histogram::now();
+    uint64_t zero = 0;
+    b.start.compare_exchange_strong(zero, now);
+    memcpy(buffer.data(), &now, sizeof(now));
+    uint64_t tag = c.sent++;
+    pn_delivery_t *d = pn_delivery(l, pn_dtag((const char *) &tag, sizeof(tag)));
+    pn_link_send(l, buffer.data(), b.size);
+    pn_link_advance(l);
+    pn_delivery_settle(d);
+    ++*sent;
+  }
+}
+
+// Close everything, the proactor is inactive once the timeout is cancelled too
+static void finish(bench_t &b) {
+  pn_proactor_cancel_timeout(b.proactor);
+  pn_proactor_disconnect(b.proactor, NULL);
+}
+
+static void receive_message(bench_t &b, connection_t &c, pn_delivery_t *d) {
+  pn_link_t *l = pn_delivery_link(d);
+  if (buffer.size() < b.size) buffer.resize(b.size);
+  size_t n = 0;
+  ssize_t r;
+  while ((r = pn_link_recv(l, buffer.data() + n, buffer.size() - n)) > 0)
+    n += r;
+  if (pn_delivery_partial(d)) return;
+  uint64_t now = latency_histogram::now();
+  uint64_t sent;
+  memcpy(&sent, buffer.data(), sizeof(sent));
+  c.latency.record(now - sent);
+  pn_link_advance(l);
+  pn_delivery_settle(d);
+  if (pn_link_credit(l) < CREDIT / 2) pn_link_flow(l, CREDIT - pn_link_credit(l));
+  if (++b.received == b.total) {
+    b.end = now;
+    finish(b);
+  }
+}
+
+static void check_condition(bench_t &b, pn_condition_t *cond) {
+  if (pn_condition_is_set(cond) && b.received < b.total) {
+    b.fail(std::string(pn_condition_get_name(cond)) + ": " + pn_condition_get_description(cond));
+    finish(b);
+  }
+}
+
+static void handle(bench_t &b, pn_event_t *e) {
+  pn_connection_t *pnc = pn_event_connection(e);
+  connection_t *c = pnc ? (connection_t *) pn_connection_get_context(pnc) : NULL;
+
+  switch (pn_event_type(e)) {
+
+  case PN_LISTENER_OPEN: {
+    char host[PN_MAX_ADDR];
+    char port[PN_MAX_ADDR];
+    char addr[PN_MAX_ADDR];
+    pn_netaddr_host_port(pn_listener_addr(pn_event_listener(e)), host, sizeof(host), port, sizeof(port));
+    pn_proactor_addr(addr, sizeof(addr), "127.0.0.1", port);
+    for (connection_t &client : b.clients) {
+      pn_connection_t *conn = pn_connection();
+      pn_connection_set_context(conn, &client);
+      pn_proactor_connect2(b.proactor, conn, make_transport(b, false), addr);
+    }
+    break;
+  }
+
+  case PN_LISTENER_ACCEPT: {
+    pn_connection_t *conn = pn_connection();
+    pn_connection_set_context(conn, &b.servers[b.accepted++ % b.servers.size()]);
+    pn_listener_accept2(pn_event_listener(e), conn, make_transport(b, true));
+    break;
+  }
+
+  case PN_CONNECTION_INIT:
+    if (!c->server) {
+      pn_connection_open(pnc);
+      pn_session_t *ssn = pn_session(pnc);
+      pn_session_open(ssn);
+      for (size_t i = 0; i < b.links; ++i) {
+        pn_link_t *l = pn_sender(ssn, std::to_string(i).c_str());
+        pn_link_set_context(l, &c->link_sent[i]);
+        pn_link_open(l);
+      }
+    }
+    break;
+
+  case PN_CONNECTION_REMOTE_OPEN:
+    if (c->server) pn_connection_open(pnc);
+    break;
+
+  case PN_SESSION_REMOTE_OPEN:
+    if (c->server) pn_session_open(pn_event_session(e));
+    break;
+
+  case PN_LINK_REMOTE_OPEN:
+    if (c->server) {
+      pn_link_t *l = pn_event_link(e);
+      pn_link_open(l);
+      pn_link_flow(l, CREDIT);
+    }
+    break;
+
+  case PN_LINK_FLOW:
+    if (!c->server) send_messages(b, *c, pn_event_link(e));
+    break;
+
+  case PN_DELIVERY:
+    if (c->server) receive_message(b, *c, pn_event_delivery(e));
+    break;
+
+  case PN_TRANSPORT_CLOSED:
+    check_condition(b, pn_transport_condition(pn_event_transport(e)));
+    break;
+
+  case PN_LISTENER_CLOSE:
+    check_condition(b, pn_listener_condition(pn_event_listener(e)));
+    break;
+
+  case PN_PROACTOR_TIMEOUT:
+    b.fail("timed out");
+    finish(b);
+    break;
+
+  case PN_PROACTOR_INACTIVE:
+    b.done = true;
+    pn_proactor_interrupt(b.proactor);
+    break;
+
+  case PN_PROACTOR_INTERRUPT:
+    // Interrupts may be coalesced, pass it on to the next thread
+    pn_proactor_interrupt(b.proactor);
+    break;
+
+  default:
+    break;
+  }
+}
+
+static void run(bench_t *b) {
+  while (!b->done) {
+    pn_event_batch_t *events = pn_proactor_wait(b->proactor);
+    pn_event_t *e;
+    while ((e = pn_event_batch_next(events))) handle(*b, e);
+    pn_proactor_done(b->proactor, events);
+  }
+}
+
+static void BM_ProactorThroughput(benchmark::State &state) {
+  bench_t b;
+  b.connections = state.range(0);
+  b.links = state.range(1);
+  b.threads = state.range(2);
+  b.size = state.range(3);
+  b.security = security_t(state.range(4));
+  b.client_ssl = b.server_ssl = NULL;
+  b.accepted = 0;
+  uint64_t messages = MAX_BYTES / b.size < MAX_MESSAGES ? MAX_BYTES / b.size : MAX_MESSAGES;
+  b.per_link = messages / (b.connections * b.links) + 1;
+  b.total = b.per_link * b.connections * b.links;
+  b.clients.resize(b.connections);
+  b.servers.resize(b.connections);
+  for (connection_t &c : b.clients) c.server = false;
+  for (connection_t &c : b.servers) c.server = true;
+
+  if (b.security == SEC_TLS && !setup_ssl(b)) {
+    state.SkipWithError("SSL not available or certificates not found");
+  }
+
+  for (auto _ : state) {
+    if (state.error_occurred()) break;
+    b.received = b.start = b.end = 0;
+    b.done = false;
+    for (connection_t &c : b.clients) {
+      c.sent = 0;
+      c.link_sent.assign(b.links, 0);
+    }
+    b.proactor = pn_proactor();
+    pn_proactor_set_timeout(b.proactor, TIMEOUT);
+    pn_proactor_listen(b.proactor, pn_listener(), "127.0.0.1:0", 16);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < b.threads; ++i) threads.emplace_back(run, &b);
+    for (std::thread &t : threads) t.join();
+    pn_proactor_free(b.proactor);
+
+    if (!b.error.empty()) {
+      state.SkipWithError(b.error.c_str());
+      break;
+    }
+    state.SetIterationTime((b.end - b.start) / 1e9);
+  }
+
+  latency_histogram latency;
+  for (connection_t &c : b.servers) latency.merge(c.latency);
+  latency.report(state);
+  state.SetItemsProcessed(latency.count());
+  state.SetBytesProcessed(latency.count() * b.size);
+  state.SetLabel(b.security == SEC_TLS ? "tls" : b.security == SEC_SASL ? "sasl" : "plain");
+  if (b.client_ssl) pn_ssl_domain_free(b.client_ssl);
+  if (b.server_ssl) pn_ssl_domain_free(b.server_ssl);
+}
+
+static void proactor_args(benchmark::internal::Benchmark *bm) {
+  bm->ArgNames({"conns", "links", "threads", "size", "sec"});
+  for (int64_t size : {64, 1024, 16 * 1024}) {
+    bm->Args({1, 1, 1, size, SEC_NONE});
+    bm->Args({4, 4, 4, size, SEC_NONE});
+  }
+  bm->Args({16, 1, 4, 1024, SEC_NONE});
+  bm->Args({4, 4, 4, 1024, SEC_SASL});
+  bm->Args({1, 1, 1, 16 * 1024, SEC_TLS});
+  bm->Args({4, 4, 4, 1024, SEC_TLS});
+}
+
+BENCHMARK(BM_ProactorThroughput)
+    ->Apply(proactor_args)
+    ->Iterations(1)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
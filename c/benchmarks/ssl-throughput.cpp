@@ -0,0 +1,232 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "proton/connection_driver.h"
+#include "proton/delivery.h"
+#include "proton/engine.h"
+#include "proton/ssl.h"
+#include "proton/transport.h"
+
+// Message throughput between a sender and a receiver over a socketpair,
+// with and without TLS, to show what encryption costs on top of the AMQP
+// processing. Run from c/tests so the test certificates are found.
+
+static const int CREDIT = 200;
+
+struct peer_t {
+  pn_connection_driver_t driver;
+  int fd;
+  pn_link_t *link;
+};
+
+struct flow_t {
+  size_t size;                  // of a message
+  std::vector<char> payload;
+  std::vector<char> scratch;
+  uint64_t tag;
+  size_t received;
+  size_t received_bytes;
+};
+
+static void handle_sender(flow_t &f, peer_t &p, pn_event_t *event) {
+  switch (pn_event_type(event)) {
+  case PN_LINK_FLOW:
+  case PN_TRANSPORT: {
+    pn_link_t *l = p.link;
+    if (!l || !(pn_link_state(l) & PN_LOCAL_ACTIVE)) break;
+    while (pn_link_credit(l) > 0) {
+      ++f.tag;
+      pn_delivery_t *d = pn_delivery(l, pn_dtag((const char *) &f.tag, sizeof(f.tag)));
+      pn_link_send(l, f.payload.data(), f.payload.size());
+      pn_link_advance(l);
+      pn_delivery_settle(d);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+static void handle_receiver(flow_t &f, peer_t &p, pn_event_t *event) {
+  switch (pn_event_type(event)) {
+  case PN_CONNECTION_REMOTE_OPEN:
+    pn_connection_open(pn_event_connection(event));
+    break;
+  case PN_SESSION_REMOTE_OPEN:
+    pn_session_open(pn_event_session(event));
+    break;
+  case PN_LINK_REMOTE_OPEN:
+    p.link = pn_event_link(event);
+    pn_link_open(p.link);
+    pn_link_flow(p.link, CREDIT);
+    break;
+  case PN_DELIVERY: {
+    pn_delivery_t *d = pn_event_delivery(event);
+    pn_link_t *l = pn_delivery_link(d);
+    ssize_t n;
+    while ((n = pn_link_recv(l, f.scratch.data(), f.scratch.size())) > 0)
+      f.received_bytes += n;
+    if (!pn_delivery_partial(d)) {
+      pn_link_advance(l);
+      pn_delivery_settle(d);
+      ++f.received;
+      if (pn_link_credit(l) < CREDIT / 2) pn_link_flow(l, CREDIT - pn_link_credit(l));
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+// Move what each side can write and read without blocking
+static size_t pump(peer_t &p) {
+  size_t moved = 0;
+  pn_bytes_t out;
+  while ((out = pn_connection_driver_write_buffer(&p.driver)).size) {
+    ssize_t n = write(p.fd, out.start, out.size);
+    if (n <= 0) break;
+    pn_connection_driver_write_done(&p.driver, n);
+    moved += n;
+  }
+  pn_rwbytes_t in;
+  while ((in = pn_connection_driver_read_buffer(&p.driver)).size) {
+    ssize_t n = read(p.fd, in.start, in.size);
+    if (n <= 0) break;
+    pn_connection_driver_read_done(&p.driver, n);
+    moved += n;
+  }
+  return moved;
+}
+
+static void run(flow_t &f, peer_t &sender, peer_t &receiver) {
+  pn_event_t *event;
+  while ((event = pn_connection_driver_next_event(&sender.driver))) handle_sender(f, sender, event);
+  pump(sender);
+  while ((event = pn_connection_driver_next_event(&receiver.driver))) handle_receiver(f, receiver, event);
+  pump(receiver);
+}
+
+static bool setup_ssl(pn_transport_t *client, pn_transport_t *server,
+                      pn_ssl_domain_t *cd, pn_ssl_domain_t *sd) {
+  if (!cd || !sd) return false;
+  if (pn_ssl_domain_set_credentials(sd, "ssl-certs/tserver-certificate.pem",
+                                    "ssl-certs/tserver-private-key.pem", "tserverpw") != 0)
+    return false;
+  if (pn_ssl_domain_set_peer_authentication(cd, PN_SSL_ANONYMOUS_PEER, NULL) != 0)
+    return false;
+  return pn_ssl_init(pn_ssl(client), cd, NULL) == 0 &&
+         pn_ssl_init(pn_ssl(server), sd, NULL) == 0;
+}
+
+static void BM_SocketpairThroughput(benchmark::State &state) {
+  const bool tls = state.range(0);
+  flow_t f;
+  f.size = state.range(1);
+  f.payload.assign(f.size, 'x');
+  f.scratch.resize(64 * 1024);
+  f.tag = 0;
+  f.received = f.received_bytes = 0;
+
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    state.SkipWithError("socketpair failed");
+    return;
+  }
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  fcntl(fds[1], F_SETFL, O_NONBLOCK);
+
+  pn_transport_t *ct = pn_transport();
+  pn_transport_t *st = pn_transport();
+  pn_transport_set_server(st);
+  pn_ssl_domain_t *cd = NULL, *sd = NULL;
+  if (tls) {
+    cd = pn_ssl_domain(PN_SSL_MODE_CLIENT);
+    sd = pn_ssl_domain(PN_SSL_MODE_SERVER);
+    if (!setup_ssl(ct, st, cd, sd)) {
+      state.SkipWithError("SSL not available or certificates not found");
+    }
+  }
+
+  peer_t sender = {}, receiver = {};
+  if (pn_connection_driver_init(&sender.driver, NULL, ct) != 0 ||
+      pn_connection_driver_init(&receiver.driver, NULL, st) != 0) {
+    printf("pn_connection_driver_init failed\n");
+    exit(1);
+  }
+  sender.fd = fds[0];
+  receiver.fd = fds[1];
+
+  if (!state.error_occurred()) {
+    pn_connection_open(sender.driver.connection);
+    pn_session_t *ssn = pn_session(sender.driver.connection);
+    pn_session_open(ssn);
+    sender.link = pn_sender(ssn, "throughput");
+    pn_link_open(sender.link);
+    while (!receiver.link && !pn_connection_driver_finished(&sender.driver))
+      run(f, sender, receiver);
+    if (!receiver.link) state.SkipWithError("connection failed");
+  }
+
+  size_t goal = 0;
+  for (auto _ : state) {
+    if (state.error_occurred()) break;
+    ++goal;
+    while (f.received < goal) {
+      if (pn_connection_driver_finished(&sender.driver)) {
+        state.SkipWithError("connection closed");
+        break;
+      }
+      run(f, sender, receiver);
+    }
+  }
+
+  state.SetLabel(tls ? "tls" : "plain");
+  state.SetItemsProcessed(f.received);
+  state.SetBytesProcessed(f.received_bytes);
+
+  pn_connection_driver_destroy(&sender.driver);
+  pn_connection_driver_destroy(&receiver.driver);
+  if (cd) pn_ssl_domain_free(cd);
+  if (sd) pn_ssl_domain_free(sd);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+BENCHMARK(BM_SocketpairThroughput)
+    ->ArgNames({"tls", "size"})
+    ->Args({0, 1024})
+    ->Args({1, 1024})
+    ->Args({0, 64 * 1024})
+    ->Args({1, 64 * 1024})
+    ->Unit(benchmark::kMicrosecond);
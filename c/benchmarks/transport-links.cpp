@@ -0,0 +1,131 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "proton/connection_driver.h"
+#include "proton/engine.h"
+
+// Cost of one output pass of a connection with many links when only a
+// few of them have changed since the last pass.
+
+static void accept_remote(pn_event_t *event) {
+  switch (pn_event_type(event)) {
+  case PN_CONNECTION_REMOTE_OPEN:
+    pn_connection_open(pn_event_connection(event));
+    break;
+  case PN_SESSION_REMOTE_OPEN:
+    pn_session_open(pn_event_session(event));
+    break;
+  case PN_LINK_REMOTE_OPEN:
+    pn_link_open(pn_event_link(event));
+    break;
+  default:
+    break;
+  }
+}
+
+// Copy pending output of one driver to the input of the other
+static size_t shovel(pn_connection_driver_t &from, pn_connection_driver_t &to) {
+  pn_bytes_t wbuf = pn_connection_driver_write_buffer(&from);
+  pn_rwbytes_t rbuf = pn_connection_driver_read_buffer(&to);
+  size_t n = rbuf.size < wbuf.size ? rbuf.size : wbuf.size;
+  if (n) {
+    memcpy(rbuf.start, wbuf.start, n);
+    pn_connection_driver_read_done(&to, n);
+    pn_connection_driver_write_done(&from, n);
+  }
+  return n;
+}
+
+static void run(pn_connection_driver_t &a, pn_connection_driver_t &b) {
+  size_t moved;
+  do {
+    pn_event_t *event;
+    while ((event = pn_connection_driver_next_event(&a))) accept_remote(event);
+    while ((event = pn_connection_driver_next_event(&b))) accept_remote(event);
+    moved = shovel(a, b) + shovel(b, a);
+  } while (moved);
+}
+
+static void drain_events(pn_connection_driver_t &d) {
+  while (pn_connection_driver_next_event(&d))
+    ;
+}
+
+static void BM_OutputPassLinks(benchmark::State &state) {
+  const int links = state.range(0);
+  const int changed = state.range(1);
+
+  pn_connection_driver_t client, server;
+  if (pn_connection_driver_init(&client, NULL, NULL) != 0 ||
+      pn_connection_driver_init(&server, NULL, NULL) != 0) {
+    printf("pn_connection_driver_init failed\n");
+    exit(1);
+  }
+
+  pn_connection_open(client.connection);
+  pn_session_t *ssn = pn_session(client.connection);
+  pn_session_open(ssn);
+  std::vector<pn_link_t *> receivers;
+  for (int i = 0; i < links; ++i) {
+    pn_link_t *l = pn_receiver(ssn, ("link" + std::to_string(i)).c_str());
+    pn_link_open(l);
+    receivers.push_back(l);
+  }
+  run(client, server);
+
+  int next = 0;
+  size_t bytes = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < changed; ++i) {
+      pn_link_flow(receivers[next], 1);
+      next = (next + 1) % links;
+    }
+    pn_bytes_t out = pn_connection_driver_write_buffer(&client);
+    pn_connection_driver_write_done(&client, out.size);
+    bytes += out.size;
+    drain_events(client);
+  }
+
+  state.SetLabel("output passes");
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(bytes);
+
+  pn_connection_driver_destroy(&client);
+  pn_connection_driver_destroy(&server);
+}
+
+BENCHMARK(BM_OutputPassLinks)
+    ->ArgNames({"links", "changed"})
+    ->Args({10, 1})
+    ->Args({100, 1})
+    ->Args({1000, 1})
+    ->Args({5000, 1})
+    ->Args({5000, 100})
+    ->Unit(benchmark::kMicrosecond);
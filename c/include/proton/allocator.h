@@ -0,0 +1,104 @@
+#ifndef PROTON_ALLOCATOR_H
+#define PROTON_ALLOCATOR_H 1
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+/**
+ * @file
+ * @copybrief allocator
+ * @copydetails allocator
+ *
+ * @defgroup allocator Allocator
+ * @ingroup core
+ */
+
+#include <proton/import_export.h>
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @addtogroup allocator
+ * @{
+ *
+ * **Unsettled API**: Memory allocation for proton objects.
+ *
+ * Every object the library creates - connections, sessions, links,
+ * deliveries, events, buffers, data and strings - and the memory they
+ * own is obtained from the installed allocator. By default that is
+ * the C library malloc(), realloc() and free().
+ *
+ * pn_slab_allocator() provides an alternative that keeps freed blocks
+ * in size classes and hands them out again, using a per-thread cache
+ * so that threads allocating and freeing at the same time do not
+ * contend. Setting the environment variable PN_ALLOCATOR to "slab"
+ * installs it when the library is loaded.
+ */
+
+/**
+ * A set of memory allocation functions, each called with the context
+ * of the allocator.
+ *
+ * They must behave like malloc(), realloc() and free() and may be
+ * called from any thread at any time.
+ */
+typedef struct pn_allocator_t {
+  void *(*allocate)(void *context, size_t size);
+  void *(*reallocate)(void *context, void *block, size_t size);
+  void (*deallocate)(void *context, void *block);
+  void *context;
+} pn_allocator_t;
+
+/**
+ * Install the allocator used for all subsequent allocations.
+ *
+ * The allocator is copied. Passing NULL restores the default.
+ *
+ * A block must be freed by the allocator that allocated it, so this
+ * can only be called while no proton objects exist, normally at the
+ * start of the program before any other proton function.
+ *
+ * Builds with memory debugging (PN_MEMDEBUG) always use the default,
+ * so that the statistics they keep remain exact.
+ */
+PN_EXTERN void pn_set_allocator(const pn_allocator_t *allocator);
+
+/**
+ * The built in allocator that serves small blocks from per-thread
+ * caches of fixed size blocks.
+ *
+ * Freed blocks are kept for reuse rather than returned to the system.
+ */
+PN_EXTERN const pn_allocator_t *pn_slab_allocator(void);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* allocator.h */
@@ -562,6 +562,32 @@ PN_EXTERN ssize_t pn_data_encoded_size(pn_data_t *data);
  */
 PN_EXTERN ssize_t pn_data_decode(pn_data_t *data, const char *bytes, size_t size);
 
+/**
+ * **Unsettled API** - Decode like pn_data_decode() without copying
+ * binary, string and symbol values.
+ *
+ * The decoded values refer to @p bytes, which must stay unchanged
+ * until the data object is cleared or pn_data_intern() is called.
+ * Values borrowed by an earlier call from other bytes are interned
+ * first, so those bytes must still be valid too.
+ *
+ * @param data a pn_data_t object
+ * @param bytes a pointer to an encoded AMQP data stream
+ * @param size the size of the encoded AMQP data stream
+ * @return the number of bytes consumed from the AMQP data stream or an error code
+ */
+PN_EXTERN ssize_t pn_data_decode_borrowed(pn_data_t *data, const char *bytes, size_t size);
+
+/**
+ * **Unsettled API** - Copy any values borrowed by
+ * pn_data_decode_borrowed() into the data object, after which it no
+ * longer refers to the bytes they were decoded from.
+ *
+ * @param data a pn_data_t object
+ * @return zero on success or an error code on failure
+ */
+PN_EXTERN int pn_data_intern(pn_data_t *data);
+
 /**
  * Puts an empty list value into a pn_data_t. Elements may be filled
  * by entering the list node using ::pn_data_enter() and using
@@ -174,7 +174,21 @@ PN_EXTERN bool pn_connection_driver_read_closed(pn_connection_driver_t *);
  PN_EXTERN pn_bytes_t pn_connection_driver_write_buffer(pn_connection_driver_t *);
 
 /**
- * Call when the first n bytes of pn_connection_driver_write_buffer() have been
+ * Get the pending output as a list of buffers, for scatter/gather IO such as writev().
+ *
+ * Fills up to n entries of buffers, in output order. Where the protocol layers
+ * allow, large message payloads are referenced where they are held by the
+ * engine rather than copied into a single write buffer.
+ * Call pn_connection_driver_write_done() with the total number of bytes written.
+ * The buffers are only valid until the next call to a pn_connection_driver_ function.
+ *
+ * @return the number of buffers filled, 0 means there is nothing to write.
+ */
+PN_EXTERN size_t pn_connection_driver_write_buffers(pn_connection_driver_t *, pn_bytes_t *buffers, size_t n);
+
+/**
+ * Call when the first n bytes of pn_connection_driver_write_buffer() or
+ * pn_connection_driver_write_buffers() have been
  * written to IO. Reclaims the buffer space and reset the write buffer.
  */
 PN_EXTERN void pn_connection_driver_write_done(pn_connection_driver_t *, size_t n);
@@ -517,6 +517,28 @@ PN_EXTERN void pn_collector_release(pn_collector_t *collector);
  */
 PN_EXTERN void pn_collector_drain(pn_collector_t *collector);
 
+/**
+ * **Unsettled API** - Keep the events of a collector in a ring of
+ * reusable events.
+ *
+ * A collector in ring mode does not reference count its events: an
+ * event returned by ::pn_collector_next() or ::pn_collector_peek() is
+ * only valid until the next call to ::pn_collector_next() or
+ * ::pn_collector_pop(), and must not be retained with pn_incref().
+ * The context of an event is held until the collector is next empty
+ * rather than until the event itself is done with. The ring starts
+ * with room for @p capacity events and doubles whenever it is full.
+ *
+ * ::pn_connection_driver_init() puts the driver's collector in ring
+ * mode.
+ *
+ * @param[in] collector an empty collector
+ * @param[in] capacity the initial number of events in the ring
+ * @return 0 on success, PN_STATE_ERR if the collector is not empty or
+ *         already in ring mode, PN_ARG_ERR if @p capacity is 0
+ */
+PN_EXTERN int pn_collector_ring(pn_collector_t *collector, size_t capacity);
+
 /**
  * Place a new event on a collector.
  *
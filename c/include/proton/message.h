@@ -737,6 +737,18 @@ PN_EXTERN int pn_message_decode(pn_message_t *msg, const char *bytes, size_t siz
  */
 PN_EXTERN int pn_message_encode(pn_message_t *msg, char *bytes, size_t *size);
 
+/**
+ * **Unsettled API**: Get the number of bytes needed to encode a message.
+ *
+ * Use this to size a buffer for pn_message_encode() up front rather
+ * than retrying on PN_OVERFLOW.
+ *
+ * @param[in] msg A message object.
+ * @return The exact length of the encoded message or an error code (<0).
+ * On error pn_message_error(msg) will provide more information.
+ */
+PN_EXTERN ssize_t pn_message_encoded_size(pn_message_t *msg);
+
 /**
  * **Unsettled API**: Encode a message, allocating space if necessary
  *
@@ -744,6 +756,7 @@ PN_EXTERN int pn_message_encode(pn_message_t *msg, char *bytes, size_t *size);
  * @param[inout] buf Used to encode msg.
  *   If buf->start == NULL memory is allocated with malloc().
  *   If buf->size is not large enough, buffer is expanded with realloc().
+ *   The encoded size is computed first so at most one allocation is made.
  *   On return buf holds the address and size of the final buffer.
  *   buf->size may be larger than the length of the encoded message.
  * @return The length of the encoded message or an error code (<0).
@@ -769,18 +782,179 @@ struct pn_link_t;
  * @param[in] msg A message object.
  * @param[in] sender A sending link.
  * @param[inout] buf See pn_message_encode2. If buf == NULL then
- * any memory needed for encoding will be allocated and freed by pn_message_send().
+ * the message is encoded directly into the delivery's buffer with no
+ * intermediate copy.
  *
  * @return The length of the encoded message or an error code (<0).
  * On error pn_message_error(msg) will provide more information.
  */
 PN_EXTERN ssize_t pn_message_send(pn_message_t *msg, pn_link_t *sender, pn_rwbytes_t *buf);
 
+/**
+ * **Unsettled API**
+ *
+ * Decode the message held by a complete received delivery.
+ *
+ * The message is decoded straight from the delivery's buffered bytes,
+ * like pn_message_decode() but without first reading them out with
+ * pn_link_recv(). The bytes are left unread and the link is not
+ * advanced.
+ *
+ * @param[in] msg A message object.
+ * @param[in] delivery A received delivery.
+ *
+ * @return zero on success, PN_STATE_ERR if the delivery is partial,
+ * PN_ABORTED if it was aborted, PN_UNDERFLOW if it holds no bytes or
+ * another error code if the message is not correctly encoded.
+ * On a decode error pn_message_error(msg) will provide more information.
+ */
+PN_EXTERN int pn_message_recv(pn_message_t *msg, pn_delivery_t *delivery);
+
 /**
  * Save message content into a pn_data_t object data. The data object will first be cleared.
  */
 PN_EXTERN int pn_message_data(pn_message_t *msg, pn_data_t *data);
 
+/**
+ * **Unsettled API**: A read-only view of an encoded message.
+ *
+ * A view indexes the sections of an encoded message in place and
+ * decodes individual fields only when they are asked for. It never
+ * copies the message: the bytes it was decoded from must stay valid
+ * and unchanged for as long as the view is used.
+ *
+ * This is much cheaper than pn_message_decode() when only a few
+ * fields are needed, for example to route a message and then forward
+ * the original bytes with pn_message_view_send().
+ *
+ * Strings and binary values are returned as pn_bytes_t referring to
+ * the encoded message, they are not NUL terminated. Absent fields
+ * return their AMQP default value.
+ */
+typedef struct pn_message_view_t pn_message_view_t;
+
+/**
+ * **Unsettled API**: Construct a new message view.
+ *
+ * Free with pn_message_view_free(). A view can be reused for any
+ * number of messages.
+ */
+PN_EXTERN pn_message_view_t *pn_message_view(void);
+
+/**
+ * **Unsettled API**: Free a message view.
+ */
+PN_EXTERN void pn_message_view_free(pn_message_view_t *view);
+
+/**
+ * **Unsettled API**: Index an encoded message.
+ *
+ * @param[in] view A message view.
+ * @param[in] bytes The encoded message, which is not copied.
+ * @param[in] size The size of the encoded message.
+ * @return zero on success or PN_ARG_ERR if the sections of the message
+ * are not correctly encoded.
+ */
+PN_EXTERN int pn_message_view_decode(pn_message_view_t *view, const char *bytes, size_t size);
+
+/**
+ * **Unsettled API**: Index the message held by a received delivery.
+ *
+ * The view refers directly to the delivery's buffered bytes and is
+ * valid until the delivery is read with pn_link_recv() or settled, or
+ * the link is advanced past the delivery that follows it. Open the
+ * view before advancing the link past the delivery: only the bytes of
+ * a viewed delivery are kept once the link has moved on, and they no
+ * longer count against the session's incoming capacity.
+ *
+ * @return zero on success, PN_STATE_ERR if the delivery is partial,
+ * PN_ABORTED if it was aborted or PN_ARG_ERR if the message is not
+ * correctly encoded.
+ */
+PN_EXTERN int pn_message_view_recv(pn_message_view_t *view, pn_delivery_t *delivery);
+
+/**
+ * **Unsettled API**: The complete encoded message the view refers to.
+ */
+PN_EXTERN pn_bytes_t pn_message_view_bytes(pn_message_view_t *view);
+
+/**
+ * **Unsettled API**: Send the original encoded message unchanged.
+ *
+ * Sends pn_message_view_bytes() on the current delivery of sender and
+ * advances it, like pn_message_send().
+ *
+ * @return The length of the message or an error code (<0).
+ */
+PN_EXTERN ssize_t pn_message_view_send(pn_message_view_t *view, pn_link_t *sender);
+
+/**
+ * **Unsettled API**: Header fields, see the pn_message_t accessors of
+ * the same name.
+ * @{
+ */
+PN_EXTERN bool        pn_message_view_is_durable         (pn_message_view_t *view);
+PN_EXTERN uint8_t     pn_message_view_get_priority       (pn_message_view_t *view);
+PN_EXTERN pn_millis_t pn_message_view_get_ttl            (pn_message_view_t *view);
+PN_EXTERN bool        pn_message_view_is_first_acquirer  (pn_message_view_t *view);
+PN_EXTERN uint32_t    pn_message_view_get_delivery_count (pn_message_view_t *view);
+/** @} */
+
+/**
+ * **Unsettled API**: Properties fields, see the pn_message_t accessors
+ * of the same name.
+ *
+ * Message and correlation ids of a binary or string type refer to the
+ * encoded message.
+ * @{
+ */
+PN_EXTERN pn_atom_t      pn_message_view_get_id                   (pn_message_view_t *view);
+PN_EXTERN pn_bytes_t     pn_message_view_get_user_id              (pn_message_view_t *view);
+PN_EXTERN pn_bytes_t     pn_message_view_get_address              (pn_message_view_t *view);
+PN_EXTERN pn_bytes_t     pn_message_view_get_subject              (pn_message_view_t *view);
+PN_EXTERN pn_bytes_t     pn_message_view_get_reply_to             (pn_message_view_t *view);
+PN_EXTERN pn_atom_t      pn_message_view_get_correlation_id       (pn_message_view_t *view);
+PN_EXTERN pn_bytes_t     pn_message_view_get_content_type         (pn_message_view_t *view);
+PN_EXTERN pn_bytes_t     pn_message_view_get_content_encoding     (pn_message_view_t *view);
+PN_EXTERN pn_timestamp_t pn_message_view_get_expiry_time          (pn_message_view_t *view);
+PN_EXTERN pn_timestamp_t pn_message_view_get_creation_time        (pn_message_view_t *view);
+PN_EXTERN pn_bytes_t     pn_message_view_get_group_id             (pn_message_view_t *view);
+PN_EXTERN pn_sequence_t  pn_message_view_get_group_sequence       (pn_message_view_t *view);
+PN_EXTERN pn_bytes_t     pn_message_view_get_reply_to_group_id    (pn_message_view_t *view);
+/** @} */
+
+/**
+ * **Unsettled API**: Look up an application property by key.
+ *
+ * @param[in] view A message view.
+ * @param[in] key The string key of the property.
+ * @return The encoded AMQP value of the property, which can be decoded
+ * with pn_data_decode(), or an empty pn_bytes_t if there is no such
+ * property.
+ */
+PN_EXTERN pn_bytes_t pn_message_view_property(pn_message_view_t *view, pn_bytes_t key);
+
+/**
+ * **Unsettled API**: The encoded map of delivery annotations, or empty if absent.
+ */
+PN_EXTERN pn_bytes_t pn_message_view_instructions(pn_message_view_t *view);
+
+/**
+ * **Unsettled API**: The encoded map of message annotations, or empty if absent.
+ */
+PN_EXTERN pn_bytes_t pn_message_view_annotations(pn_message_view_t *view);
+
+/**
+ * **Unsettled API**: The encoded map of application properties, or empty if absent.
+ */
+PN_EXTERN pn_bytes_t pn_message_view_properties(pn_message_view_t *view);
+
+/**
+ * **Unsettled API**: The complete encoding of the body sections,
+ * including their descriptors, or empty if there is no body.
+ */
+PN_EXTERN pn_bytes_t pn_message_view_body(pn_message_view_t *view);
+
 /** @}
  */
 
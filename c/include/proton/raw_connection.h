@@ -226,6 +226,111 @@ PNP_EXTERN size_t pn_raw_connection_write_buffers(pn_raw_connection_t *connectio
  */
 PNP_EXTERN size_t pn_raw_connection_take_written_buffers(pn_raw_connection_t *connection, pn_raw_buffer_t *buffers, size_t num);
 
+/**
+ * **Unsettled API**: Send large writes without copying them into the kernel.
+ *
+ * Whenever the buffers queued for writing add up to at least @p threshold bytes
+ * they are sent with MSG_ZEROCOPY where the platform supports it. The kernel
+ * then reads the data from the buffers after the send call has returned, so a
+ * buffer is only returned by @ref pn_raw_connection_take_written_buffers (and
+ * reported by @ref PN_RAW_CONNECTION_WRITTEN) once the kernel has finished with it.
+ *
+ * Zero copy only pays off for large writes, typically of tens of kilobytes or more.
+ *
+ * @param[in] threshold the smallest write to send without copying, 0 (the default) disables zero copy.
+ *
+ * @note This has no effect where zero copy sends are not supported.
+ */
+PNP_EXTERN void pn_raw_connection_set_zerocopy(pn_raw_connection_t *connection, size_t threshold);
+
+/**
+ * **Unsettled API**: Relay everything each of two raw connections reads to the other.
+ *
+ * The proactor then moves the bytes between the two sockets itself. On Linux they are
+ * spliced through a pipe in each direction and never copied into user space.
+ *
+ * Relayed connections don't use buffers. @ref PN_RAW_CONNECTION_NEED_READ_BUFFERS and
+ * @ref PN_RAW_CONNECTION_NEED_WRITE_BUFFERS are not raised and buffers offered are refused.
+ * Read buffers not yet filled are returned empty; write buffers already given are written
+ * before any relayed bytes. @ref PN_RAW_CONNECTION_READ and @ref PN_RAW_CONNECTION_WRITTEN
+ * report that bytes were relayed, there are no buffers to take.
+ *
+ * When one connection reads faster than the other can write, the pipe between them fills
+ * and the reading connection stops reading until there is room again. End of stream on one
+ * connection closes the other for write once everything before it has been written. When a
+ * connection can no longer write, the other is closed for read. Either way the connections
+ * report @ref PN_RAW_CONNECTION_CLOSED_READ, @ref PN_RAW_CONNECTION_CLOSED_WRITE and
+ * @ref PN_RAW_CONNECTION_DISCONNECTED as usual.
+ *
+ * Both connections must have reported @ref PN_RAW_CONNECTION_CONNECTED and must not have
+ * been closed. A connection can only be relayed once.
+ *
+ * @return 0 if the relay is set up, PN_STATE_ERR if either connection is closed or already
+ * relayed, PN_ERR if the pipes can't be created or the proactor can't relay.
+ *
+ * @note Thread-safe
+ */
+PNP_EXTERN int pn_raw_connection_relay(pn_raw_connection_t *connection, pn_raw_connection_t *peer);
+
+/**
+ * **Unsettled API**: Set how many read and write buffers @p connection can hold at once.
+ *
+ * The default is 16 of each. More read slots let a busy connection read more with each
+ * system call, fewer keep the memory of many idle connections down.
+ *
+ * Call this before the connection is given to @ref pn_proactor_raw_connect or
+ * @ref pn_listener_raw_accept.
+ *
+ * @return 0 on success, PN_ARG_ERR if a count is 0 or more than 1024, PN_STATE_ERR if the
+ * connection has already started or holds buffers, PN_OUT_OF_MEMORY.
+ */
+PNP_EXTERN int pn_raw_connection_set_buffer_slots(pn_raw_connection_t *connection, size_t read_slots, size_t write_slots);
+
+/**
+ * **Unsettled API**: Add @p count read buffers of @p size bytes to the raw buffer pool of @p proactor.
+ *
+ * The memory is allocated here, once, and freed by pn_proactor_free(). Buffers of one size
+ * form a size class; call this once for each size wanted.
+ *
+ * @return 0 on success, PN_ARG_ERR if @p size or @p count is 0 or too big,
+ * PN_OUT_OF_MEMORY, PN_ERR if the proactor has no buffer pool.
+ *
+ * @note Thread-safe
+ */
+PNP_EXTERN int pn_proactor_add_raw_buffers(pn_proactor_t *proactor, size_t size, size_t count);
+
+/**
+ * **Unsettled API**: Read into buffers from the proactor's raw buffer pool.
+ *
+ * @p connection then reads into pool buffers of at least @p size bytes, 0 for any size,
+ * and never asks the application for read buffers: @ref PN_RAW_CONNECTION_NEED_READ_BUFFERS
+ * is not raised and @ref pn_raw_connection_give_read_buffers refuses buffers.
+ *
+ * Buffers are only taken from the pool when the socket has bytes to read, and the ones left
+ * empty go straight back, so idle connections hold no buffers. If the pool has no buffer to
+ * spare the connection stops reading until one is released.
+ *
+ * Every read buffer taken from the connection, empty or not, belongs to the pool. Return it
+ * with @ref pn_proactor_release_raw_buffers when done with it.
+ *
+ * Call this before the connection is given to @ref pn_proactor_raw_connect or
+ * @ref pn_listener_raw_accept.
+ *
+ * @note This has no effect where the proactor has no buffer pool.
+ */
+PNP_EXTERN void pn_raw_connection_use_buffer_pool(pn_raw_connection_t *connection, size_t size);
+
+/**
+ * **Unsettled API**: Return buffers to the raw buffer pool of @p proactor.
+ *
+ * Buffers that did not come from the pool are ignored.
+ *
+ * @return the number of buffers returned to the pool.
+ *
+ * @note Thread-safe
+ */
+PNP_EXTERN size_t pn_proactor_release_raw_buffers(pn_proactor_t *proactor, const pn_raw_buffer_t *buffers, size_t num);
+
 /**
  * Is @p connection closed for read?
  *
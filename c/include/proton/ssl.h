@@ -258,6 +258,78 @@ PN_EXTERN int pn_ssl_domain_set_protocols(pn_ssl_domain_t *domain, const char *p
  */
 PN_EXTERN int pn_ssl_domain_set_ciphers(pn_ssl_domain_t *domain, const char *ciphers);
 
+/**
+ * **Unsettled API** - Configure TLS session caching for resumption
+ *
+ * A client domain keeps the sessions of connections initialized with a
+ * session_id (see ::pn_ssl_init), so that a later connection with the
+ * same session_id can resume the session rather than make a full
+ * handshake.  A server domain keeps the sessions it has issued so that
+ * clients may resume them by session id.  The cache belongs to the
+ * domain and is shared safely by connections running in different
+ * threads.
+ *
+ * By default a client domain keeps 64 sessions and a server domain
+ * uses the SSL implementation's defaults.
+ *
+ * @param[in] domain the ssl domain to configure.
+ * @param[in] capacity the most sessions to keep, the least recently
+ * used are discarded first.  0 disables the cache.
+ * @param[in] ttl how long a session may be resumed after it was
+ * established, in milliseconds.  0 for no limit other than the
+ * lifetime the SSL implementation gives the session.
+ * @return 0 on success, an error code if the SSL implementation does
+ * not support it
+ */
+PN_EXTERN int pn_ssl_domain_set_session_cache(pn_ssl_domain_t *domain, size_t capacity, pn_millis_t ttl);
+
+/**
+ * **Unsettled API** - Enable or disable TLS session tickets
+ *
+ * With session tickets (RFC 5077) a server hands the client its
+ * session state, encrypted, so resumption needs no server side cache.
+ * Tickets are enabled by default where the SSL implementation
+ * supports them.
+ *
+ * @param[in] domain the ssl domain to configure.
+ * @param[in] enabled true to issue (server) or accept (client) tickets.
+ * @return 0 on success, an error code if the SSL implementation does
+ * not support it
+ */
+PN_EXTERN int pn_ssl_domain_set_session_tickets(pn_ssl_domain_t *domain, bool enabled);
+
+/**
+ * **Unsettled API** - Let the kernel encrypt output (kernel TLS)
+ *
+ * Once the handshake of a connection is complete its keys are handed to
+ * the operating system, which then encrypts what is written to the
+ * socket. This saves copying output through the SSL library and lets
+ * large writes go out without being encrypted in user space. Input is
+ * still decrypted by the SSL library.
+ *
+ * Only connections run by a proactor that supports it are offloaded, at
+ * present the epoll proactor on Linux with the kernel's "tls" module.
+ * Other connections, and those whose cipher the kernel does not
+ * support, are encrypted as usual.
+ *
+ * The keys are handed over once. The SSL library cannot send any record
+ * of its own after that, so a connection fails with an
+ * amqp:connection:framing-error if it has to: when the peer asks for a
+ * TLS 1.3 key update, or starts a renegotiation. Do not enable this for
+ * peers that update keys during a connection.
+ *
+ * With OpenSSL the keys are taken from an interface internal to
+ * OpenSSL. This is only supported for OpenSSL 3, and only when the
+ * library in use is from the same release series as the one proton was
+ * built against.
+ *
+ * @param[in] domain the ssl domain to configure.
+ * @param[in] enabled true to offload output where possible.
+ * @return 0 on success, an error code if the SSL implementation does
+ * not support it
+ */
+PN_EXTERN int pn_ssl_domain_set_kernel_tls(pn_ssl_domain_t *domain, bool enabled);
+
 /**
  * **Deprecated** - Use ::pn_transport_require_encryption()
  *
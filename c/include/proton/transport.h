@@ -483,6 +483,68 @@ PN_EXTERN void pn_transport_set_idle_timeout(pn_transport_t *transport, pn_milli
  */
 PN_EXTERN pn_millis_t pn_transport_get_remote_idle_timeout(pn_transport_t *transport);
 
+/**
+ * **Unsettled API** - Get how long dispositions may be held back to be
+ * sent together.
+ *
+ * @param[in] transport a transport object
+ * @return the disposition delay in milliseconds, 0 if dispositions are
+ * sent with the output that follows them
+ */
+PN_EXTERN pn_millis_t pn_transport_get_disposition_delay(pn_transport_t *transport);
+
+/**
+ * **Unsettled API** - Set how long dispositions may be held back to be
+ * sent together.
+ *
+ * Dispositions without outcome fields, such as accepting or settling
+ * a delivery, are gathered into ranges of delivery ids with the same
+ * outcome and sent as one DISPOSITION frame per range. By default the
+ * ranges are sent once per pass over the output. With a delay they
+ * are held until pn_transport_tick() finds that the delay has passed,
+ * so that deliveries acknowledged out of order can join up first.
+ * They are also sent when their session or connection is closed.
+ *
+ * A transport with a delay must be ticked, see pn_transport_tick().
+ *
+ * @param[in] transport a transport object
+ * @param[in] delay the disposition delay in milliseconds
+ */
+PN_EXTERN void pn_transport_set_disposition_delay(pn_transport_t *transport, pn_millis_t delay);
+
+/**
+ * **Unsettled API** - Get the number of deliveries whose dispositions
+ * a session holds before sending them.
+ *
+ * @param[in] transport a transport object
+ * @return the limit, 0 if there is none
+ */
+PN_EXTERN size_t pn_transport_get_disposition_batch(pn_transport_t *transport);
+
+/**
+ * **Unsettled API** - Set the number of deliveries whose dispositions
+ * a session holds before sending them.
+ *
+ * When the limit is reached the ranges are sent straight away,
+ * whatever the disposition delay.
+ *
+ * @param[in] transport a transport object
+ * @param[in] deliveries the limit, 0 for none
+ */
+PN_EXTERN void pn_transport_set_disposition_batch(pn_transport_t *transport, size_t deliveries);
+
+/**
+ * **Unsettled API** - Get the number of DISPOSITION frames saved by
+ * sending dispositions as ranges.
+ *
+ * This is the number of deliveries settled or updated by a range,
+ * less the number of frames sent for those ranges.
+ *
+ * @param[in] transport a transport object
+ * @return the number of frames saved
+ */
+PN_EXTERN uint64_t pn_transport_get_disposition_frames_saved(const pn_transport_t *transport);
+
 /**
  * **Deprecated** - Use the @ref connection_driver API.
  */
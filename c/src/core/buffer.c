@@ -33,152 +33,212 @@
 #include "memory.h"
 #include "util.h"
 
-struct pn_buffer_t {
+/*
+ * A buffer is a chain of chunks. Appending past the end of the last chunk adds
+ * a new chunk rather than reallocating and copying what is already there, so
+ * large deliveries received a frame at a time are never moved. Contiguous
+ * access with pn_buffer_bytes()/pn_buffer_memory() joins the chunks into one,
+ * so delivery payloads are sent and decoded a chunk at a time with
+ * pn_buffer_chunk() instead and only callers that need a single range, like
+ * the message view, pay for the join.
+ *
+ * Chunks grow with the buffer up to PNI_BUFFER_CHUNK_MAX, after that each new
+ * chunk is that size unless a single larger append needs more.
+ */
+#define PNI_BUFFER_CHUNK_MIN 16
+#define PNI_BUFFER_CHUNK_MAX (64*1024)
+
+typedef struct pni_buffer_chunk_t pni_buffer_chunk_t;
+
+struct pni_buffer_chunk_t {
+  pni_buffer_chunk_t *next;
   size_t capacity;
-  size_t start;
+  size_t start;   // content is bytes[start, end)
+  size_t end;
+  // followed by capacity bytes
+};
+
+struct pn_buffer_t {
+  pni_buffer_chunk_t *head;
+  pni_buffer_chunk_t *tail;
+  pni_buffer_chunk_t *spare;  // emptied chunk kept for the next append
+  size_t capacity;            // of the chunks in the chain
   size_t size;
-  char *bytes;
 };
 
 PN_STRUCT_CLASSDEF(pn_buffer)
 
-pn_buffer_t *pn_buffer(size_t capacity)
+static inline char *pni_chunk_bytes(pni_buffer_chunk_t *chunk)
 {
-  pn_buffer_t *buf = (pn_buffer_t *) pni_mem_allocate(PN_CLASSCLASS(pn_buffer), sizeof(pn_buffer_t));
-  if (buf != NULL) {
-    buf->capacity = capacity;
-    buf->start = 0;
-    buf->size = 0;
-    if (capacity > 0) {
-        buf->bytes = (char *) pni_mem_suballocate(PN_CLASSCLASS(pn_buffer), buf, capacity);
-        if (buf->bytes == NULL) {
-            pni_mem_deallocate(PN_CLASSCLASS(pn_buffer), buf);
-            buf = NULL;
-        }
-    }
-    else {
-        buf->bytes = NULL;
-    }
-  }
-  return buf;
+  return (char *) (chunk + 1);
 }
 
-void pn_buffer_free(pn_buffer_t *buf)
+static inline size_t pni_chunk_size(pni_buffer_chunk_t *chunk)
 {
-  if (buf) {
-    pni_mem_subdeallocate(PN_CLASSCLASS(pn_buffer), buf, buf->bytes);
-    pni_mem_deallocate(PN_CLASSCLASS(pn_buffer), buf);
-  }
+  return chunk->end - chunk->start;
 }
 
-size_t pn_buffer_size(pn_buffer_t *buf)
+static pni_buffer_chunk_t *pni_chunk(pn_buffer_t *buf, size_t capacity)
 {
-  return buf->size;
+  pni_buffer_chunk_t *chunk = buf->spare;
+  if (chunk && chunk->capacity >= capacity) {
+    buf->spare = NULL;
+  } else {
+    chunk = (pni_buffer_chunk_t *) pni_mem_suballocate(PN_CLASSCLASS(pn_buffer), buf, sizeof(pni_buffer_chunk_t) + capacity);
+    if (!chunk) return NULL;
+    chunk->capacity = capacity;
+  }
+  chunk->next = NULL;
+  chunk->start = 0;
+  chunk->end = 0;
+  return chunk;
 }
 
-size_t pn_buffer_capacity(pn_buffer_t *buf)
+// Keep the larger of an unused chunk and the spare
+static void pni_chunk_release(pn_buffer_t *buf, pni_buffer_chunk_t *chunk)
 {
-  return buf->capacity;
+  if (buf->spare && buf->spare->capacity >= chunk->capacity) {
+    pni_mem_subdeallocate(PN_CLASSCLASS(pn_buffer), buf, chunk);
+  } else {
+    pni_mem_subdeallocate(PN_CLASSCLASS(pn_buffer), buf, buf->spare);
+    buf->spare = chunk;
+  }
 }
 
-size_t pn_buffer_available(pn_buffer_t *buf)
+static void pni_buffer_push(pn_buffer_t *buf, pni_buffer_chunk_t *chunk)
 {
-  return buf->capacity - buf->size;
+  if (buf->tail) {
+    buf->tail->next = chunk;
+  } else {
+    buf->head = chunk;
+  }
+  buf->tail = chunk;
+  buf->capacity += chunk->capacity;
 }
 
-static size_t pni_buffer_head(pn_buffer_t *buf)
+static size_t pni_buffer_next_chunk(pn_buffer_t *buf, size_t size)
 {
-  return buf->start;
+  size_t capacity = pn_min(pn_max(buf->capacity, PNI_BUFFER_CHUNK_MIN), PNI_BUFFER_CHUNK_MAX);
+  return pn_max(capacity, size);
 }
 
-static size_t pni_buffer_tail(pn_buffer_t *buf)
+pn_buffer_t *pn_buffer(size_t capacity)
 {
-  size_t tail = buf->start + buf->size;
-  if (tail >= buf->capacity)
-    tail -= buf->capacity;
-  return tail;
+  pn_buffer_t *buf = (pn_buffer_t *) pni_mem_allocate(PN_CLASSCLASS(pn_buffer), sizeof(pn_buffer_t));
+  if (buf != NULL) {
+    buf->head = NULL;
+    buf->tail = NULL;
+    buf->spare = NULL;
+    buf->capacity = 0;
+    buf->size = 0;
+    if (capacity > 0) {
+      pni_buffer_chunk_t *chunk = pni_chunk(buf, capacity);
+      if (chunk == NULL) {
+        pni_mem_deallocate(PN_CLASSCLASS(pn_buffer), buf);
+        return NULL;
+      }
+      pni_buffer_push(buf, chunk);
+    }
+  }
+  return buf;
 }
 
-static bool pni_buffer_wrapped(pn_buffer_t *buf)
+void pn_buffer_free(pn_buffer_t *buf)
 {
-  return buf->size && pni_buffer_head(buf) >= pni_buffer_tail(buf);
+  if (buf) {
+    pni_buffer_chunk_t *chunk = buf->head;
+    while (chunk) {
+      pni_buffer_chunk_t *next = chunk->next;
+      pni_mem_subdeallocate(PN_CLASSCLASS(pn_buffer), buf, chunk);
+      chunk = next;
+    }
+    pni_mem_subdeallocate(PN_CLASSCLASS(pn_buffer), buf, buf->spare);
+    pni_mem_deallocate(PN_CLASSCLASS(pn_buffer), buf);
+  }
 }
 
-static size_t pni_buffer_tail_space(pn_buffer_t *buf)
+size_t pn_buffer_size(pn_buffer_t *buf)
 {
-  if (pni_buffer_wrapped(buf)) {
-    return pn_buffer_available(buf);
-  } else {
-    return buf->capacity - pni_buffer_tail(buf);
-  }
+  return buf->size;
 }
 
-static size_t pni_buffer_head_space(pn_buffer_t *buf)
+size_t pn_buffer_capacity(pn_buffer_t *buf)
 {
-  if (pni_buffer_wrapped(buf)) {
-    return pn_buffer_available(buf);
-  } else {
-    return pni_buffer_head(buf);
-  }
+  return buf->capacity;
 }
 
-static size_t pni_buffer_head_size(pn_buffer_t *buf)
+// Space that can be appended without adding a chunk, it follows the content
+size_t pn_buffer_available(pn_buffer_t *buf)
 {
-  if (pni_buffer_wrapped(buf)) {
-    return buf->capacity - pni_buffer_head(buf);
-  } else {
-    return pni_buffer_tail(buf) - pni_buffer_head(buf);
-  }
+  return buf->tail ? buf->tail->capacity - buf->tail->end : 0;
 }
 
-static size_t pni_buffer_tail_size(pn_buffer_t *buf)
+// Move the content of a lone chunk to its start
+static void pni_buffer_compact(pn_buffer_t *buf)
 {
-  if (pni_buffer_wrapped(buf)) {
-    return pni_buffer_tail(buf);
-  } else {
-    return 0;
+  pni_buffer_chunk_t *chunk = buf->head;
+  if (chunk && chunk->start) {
+    memmove(pni_chunk_bytes(chunk), pni_chunk_bytes(chunk) + chunk->start, pni_chunk_size(chunk));
+    chunk->end -= chunk->start;
+    chunk->start = 0;
   }
 }
 
 int pn_buffer_ensure(pn_buffer_t *buf, size_t size)
 {
-  size_t old_capacity = buf->capacity;
-  size_t old_head = pni_buffer_head(buf);
-  bool wrapped = pni_buffer_wrapped(buf);
+  if (pn_buffer_available(buf) >= size) return 0;
 
-  while (pn_buffer_available(buf) < size) {
-    buf->capacity = 2*(buf->capacity ? buf->capacity : 16);
+  if (buf->head && buf->head != buf->tail) {
+    // Start a new chunk rather than moving the ones there are
+    pni_buffer_chunk_t *chunk = pni_chunk(buf, pni_buffer_next_chunk(buf, size));
+    if (!chunk) return PN_OUT_OF_MEMORY;
+    pni_buffer_push(buf, chunk);
+    return 0;
   }
 
-  if (buf->capacity != old_capacity) {
-    char* new_bytes = (char *) pni_mem_subreallocate(PN_CLASSCLASS(pn_buffer), buf, buf->bytes, buf->capacity);
-    if (new_bytes) {
-      buf->bytes = new_bytes;
-
-      if (wrapped) {
-          size_t n = old_capacity - old_head;
-          memmove(buf->bytes + buf->capacity - n, buf->bytes + old_head, n);
-          buf->start = buf->capacity - n;
-      }
-    }
+  // A single chunk stays contiguous so that pn_buffer_memory() can be written directly
+  pni_buffer_compact(buf);
+  size_t capacity = buf->capacity;
+  while (capacity - buf->size < size) {
+    capacity = 2*(capacity ? capacity : PNI_BUFFER_CHUNK_MIN);
   }
-
+  if (capacity == buf->capacity) return 0;
+
+  pni_buffer_chunk_t *chunk = (pni_buffer_chunk_t *)
+    pni_mem_subreallocate(PN_CLASSCLASS(pn_buffer), buf, buf->head, sizeof(pni_buffer_chunk_t) + capacity);
+  if (!chunk) return PN_OUT_OF_MEMORY;
+  if (!buf->head) {
+    chunk->next = NULL;
+    chunk->start = 0;
+    chunk->end = 0;
+  }
+  chunk->capacity = capacity;
+  buf->head = buf->tail = chunk;
+  buf->capacity = capacity;
   return 0;
 }
 
 int pn_buffer_append(pn_buffer_t *buf, const char *bytes, size_t size)
 {
   if (!size) return 0;
-  int err = pn_buffer_ensure(buf, size);
-  if (err) return err;
-
-  size_t tail = pni_buffer_tail(buf);
-  size_t tail_space = pni_buffer_tail_space(buf);
-  size_t n = pn_min(tail_space, size);
 
-  memmove(buf->bytes + tail, bytes, n);
-  memmove(buf->bytes, bytes + n, size - n);
+  pni_buffer_chunk_t *tail = buf->tail;
+  size_t n = 0;
+  if (tail) {
+    // An empty buffer's chunk may have been trimmed from the front
+    if (!buf->size) tail->start = tail->end = 0;
+    n = pn_min(tail->capacity - tail->end, size);
+    memmove(pni_chunk_bytes(tail) + tail->end, bytes, n);
+  }
 
+  if (n < size) {
+    pni_buffer_chunk_t *chunk = pni_chunk(buf, pni_buffer_next_chunk(buf, size - n));
+    if (!chunk) return PN_OUT_OF_MEMORY;
+    memmove(pni_chunk_bytes(chunk), bytes + n, size - n);
+    chunk->end = size - n;
+    pni_buffer_push(buf, chunk);
+  }
+  if (tail) tail->end += n;
   buf->size += size;
 
   return 0;
@@ -186,57 +246,50 @@ int pn_buffer_append(pn_buffer_t *buf, const char *bytes, size_t size)
 
 int pn_buffer_prepend(pn_buffer_t *buf, const char *bytes, size_t size)
 {
-  int err = pn_buffer_ensure(buf, size);
-  if (err) return err;
-
-  size_t head = pni_buffer_head(buf);
-  size_t head_space = pni_buffer_head_space(buf);
-  size_t n = pn_min(head_space, size);
-
-  memmove(buf->bytes + head - n, bytes + size - n, n);
-  memmove(buf->bytes + buf->capacity - (size - n), bytes, size - n);
+  if (!size) return 0;
 
-  if (buf->start >= size) {
-    buf->start -= size;
+  pni_buffer_chunk_t *head = buf->head;
+  if (head && !buf->size) head->start = head->end = 0;
+  if (head && head->start >= size) {
+    head->start -= size;
+  } else if (head && !buf->size && head->capacity >= size) {
+    head->end = size;
   } else {
-    buf->start = buf->capacity - (size - buf->start);
+    pni_buffer_chunk_t *chunk = pni_chunk(buf, pni_buffer_next_chunk(buf, size));
+    if (!chunk) return PN_OUT_OF_MEMORY;
+    chunk->start = chunk->end = chunk->capacity;
+    chunk->start -= size;
+    chunk->next = head;
+    buf->head = chunk;
+    if (!buf->tail) buf->tail = chunk;
+    buf->capacity += chunk->capacity;
+    head = chunk;
   }
-
+  memmove(pni_chunk_bytes(head) + head->start, bytes, size);
   buf->size += size;
 
   return 0;
 }
 
-static size_t pni_buffer_index(pn_buffer_t *buf, size_t index)
-{
-  size_t result = buf->start + index;
-  if (result >= buf->capacity) result -= buf->capacity;
-  return result;
-}
-
 size_t pn_buffer_get(pn_buffer_t *buf, size_t offset, size_t size, char *dst)
 {
-  size = pn_min(size, buf->size);
-  size_t start = pni_buffer_index(buf, offset);
-  size_t stop = pni_buffer_index(buf, offset + size);
-
-  if (size == 0) return 0;
-
-  size_t sz1;
-  size_t sz2;
-
-  if (start >= stop) {
-    sz1 = buf->capacity - start;
-    sz2 = stop;
-  } else {
-    sz1 = stop - start;
-    sz2 = 0;
+  if (offset >= buf->size) return 0;
+  size = pn_min(size, buf->size - offset);
+
+  size_t copied = 0;
+  for (pni_buffer_chunk_t *chunk = buf->head; chunk && copied < size; chunk = chunk->next) {
+    size_t csize = pni_chunk_size(chunk);
+    if (offset >= csize) {
+      offset -= csize;
+      continue;
+    }
+    size_t n = pn_min(csize - offset, size - copied);
+    memmove(dst + copied, pni_chunk_bytes(chunk) + chunk->start + offset, n);
+    copied += n;
+    offset = 0;
   }
 
-  memmove(dst, buf->bytes + start, sz1);
-  memmove(dst + sz1, buf->bytes, sz2);
-
-  return sz1 + sz2;
+  return copied;
 }
 
 int pn_buffer_trim(pn_buffer_t *buf, size_t left, size_t right)
@@ -248,52 +301,106 @@ int pn_buffer_trim(pn_buffer_t *buf, size_t left, size_t right)
     pn_buffer_clear(buf);
     return 0;
   }
-  buf->start += left;
-  if (buf->start >= buf->capacity)
-    buf->start -= buf->capacity;
 
   buf->size -= left + right;
 
+  // Drop whole chunks from the front, keeping the last one
+  while (left) {
+    pni_buffer_chunk_t *chunk = buf->head;
+    size_t n = pn_min(left, pni_chunk_size(chunk));
+    chunk->start += n;
+    left -= n;
+    if (chunk->start == chunk->end && chunk != buf->tail) {
+      buf->head = chunk->next;
+      buf->capacity -= chunk->capacity;
+      pni_chunk_release(buf, chunk);
+    }
+  }
+  while (buf->head != buf->tail && buf->head->start == buf->head->end) {
+    pni_buffer_chunk_t *chunk = buf->head;
+    buf->head = chunk->next;
+    buf->capacity -= chunk->capacity;
+    pni_chunk_release(buf, chunk);
+  }
+
+  if (right) {
+    // Find the chunk that now holds the end of the content
+    size_t remaining = buf->size;
+    pni_buffer_chunk_t *chunk = buf->head;
+    while (remaining > pni_chunk_size(chunk)) {
+      remaining -= pni_chunk_size(chunk);
+      chunk = chunk->next;
+    }
+    chunk->end = chunk->start + remaining;
+    pni_buffer_chunk_t *rest = chunk->next;
+    chunk->next = NULL;
+    buf->tail = chunk;
+    while (rest) {
+      pni_buffer_chunk_t *next = rest->next;
+      buf->capacity -= rest->capacity;
+      pni_chunk_release(buf, rest);
+      rest = next;
+    }
+  }
+
   return 0;
 }
 
+// Keep only the largest chunk, so the space available after clearing is no
+// less than a contiguous buffer of the same history would have
 void pn_buffer_clear(pn_buffer_t *buf)
 {
-  buf->start = 0;
-  buf->size = 0;
-}
-
-static void pn_buffer_rotate (pn_buffer_t *buf, size_t sz) {
-  if (sz == 0) return;
-
-  unsigned c = 0, v = 0;
-  for (; c < buf->capacity; v++) {
-    unsigned t = v, tp = v + sz;
-    char tmp = buf->bytes[v];
-    c++;
-    while (tp != v) {
-      buf->bytes[t] = buf->bytes[tp];
-      t = tp;
-      tp += sz;
-      if (tp >= buf->capacity) tp -= buf->capacity;
-      c++;
-    }
-    buf->bytes[t] = tmp;
+  pni_buffer_chunk_t *keep = buf->head;
+  for (pni_buffer_chunk_t *chunk = buf->head; chunk; chunk = chunk->next) {
+    if (chunk->capacity > keep->capacity) keep = chunk;
+  }
+  pni_buffer_chunk_t *chunk = buf->head;
+  while (chunk) {
+    pni_buffer_chunk_t *next = chunk->next;
+    if (chunk != keep) pni_chunk_release(buf, chunk);
+    chunk = next;
   }
+  if (keep) {
+    keep->next = NULL;
+    keep->start = 0;
+    keep->end = 0;
+    buf->capacity = keep->capacity;
+  }
+  buf->head = buf->tail = keep;
+  buf->size = 0;
 }
 
+// Join the content into a single chunk starting at its beginning
 int pn_buffer_defrag(pn_buffer_t *buf)
 {
-  pn_buffer_rotate(buf, buf->start);
-  buf->start = 0;
+  if (buf->head == buf->tail) {
+    pni_buffer_compact(buf);
+    return 0;
+  }
+
+  // Keep the same total capacity so that the space available does not shrink
+  pni_buffer_chunk_t *joined = (pni_buffer_chunk_t *)
+    pni_mem_suballocate(PN_CLASSCLASS(pn_buffer), buf, sizeof(pni_buffer_chunk_t) + buf->capacity);
+  if (!joined) return PN_OUT_OF_MEMORY;
+  joined->next = NULL;
+  joined->capacity = buf->capacity;
+  joined->start = 0;
+  joined->end = pn_buffer_get(buf, 0, buf->size, pni_chunk_bytes(joined));
+
+  pni_buffer_chunk_t *chunk = buf->head;
+  while (chunk) {
+    pni_buffer_chunk_t *next = chunk->next;
+    pni_mem_subdeallocate(PN_CLASSCLASS(pn_buffer), buf, chunk);
+    chunk = next;
+  }
+  buf->head = buf->tail = joined;
   return 0;
 }
 
 pn_bytes_t pn_buffer_bytes(pn_buffer_t *buf)
 {
-  if (buf) {
-    pn_buffer_defrag(buf);
-    return pn_bytes(buf->size, buf->bytes);
+  if (buf && buf->head && !pn_buffer_defrag(buf)) {
+    return pn_bytes(buf->size, pni_chunk_bytes(buf->head));
   } else {
     return pn_bytes(0, NULL);
   }
@@ -301,9 +408,8 @@ pn_bytes_t pn_buffer_bytes(pn_buffer_t *buf)
 
 pn_rwbytes_t pn_buffer_memory(pn_buffer_t *buf)
 {
-  if (buf) {
-    pn_buffer_defrag(buf);
-    pn_rwbytes_t r = {buf->size, buf->bytes};
+  if (buf && buf->head && !pn_buffer_defrag(buf)) {
+    pn_rwbytes_t r = {buf->size, pni_chunk_bytes(buf->head)};
     return r;
   } else {
     pn_rwbytes_t r = {0, NULL};
@@ -311,15 +417,54 @@ pn_rwbytes_t pn_buffer_memory(pn_buffer_t *buf)
   }
 }
 
+// Contiguous free space after the content, at least size bytes of it, to be
+// written in place and then added to the content with pn_buffer_extend()
+pn_rwbytes_t pn_buffer_free_memory(pn_buffer_t *buf, size_t size)
+{
+  if (pn_buffer_ensure(buf, size)) return pn_rwbytes(0, NULL);
+  pni_buffer_chunk_t *tail = buf->tail;
+  if (!tail) return pn_rwbytes(0, NULL);
+  return pn_rwbytes(tail->capacity - tail->end, pni_chunk_bytes(tail) + tail->end);
+}
+
+int pn_buffer_extend(pn_buffer_t *buf, size_t size)
+{
+  if (size > pn_buffer_available(buf)) return PN_OVERFLOW;
+  buf->tail->end += size;
+  buf->size += size;
+  return 0;
+}
+
+// Contiguous bytes starting at offset, up to the end of the chunk holding them
+pn_bytes_t pn_buffer_chunk(pn_buffer_t *buf, size_t offset)
+{
+  if (offset >= buf->size) return pn_bytes(0, NULL);
+  pni_buffer_chunk_t *chunk = buf->head;
+  while (offset >= pni_chunk_size(chunk)) {
+    offset -= pni_chunk_size(chunk);
+    chunk = chunk->next;
+  }
+  return pn_bytes(pni_chunk_size(chunk) - offset, pni_chunk_bytes(chunk) + chunk->start + offset);
+}
+
+// Fill buffers with the chunks of the content, return the number used
+size_t pn_buffer_chunks(pn_buffer_t *buf, pn_bytes_t *buffers, size_t n)
+{
+  size_t count = 0;
+  for (pni_buffer_chunk_t *chunk = buf->head; chunk && count < n; chunk = chunk->next) {
+    if (chunk->end > chunk->start) {
+      buffers[count++] = pn_bytes(pni_chunk_size(chunk), pni_chunk_bytes(chunk) + chunk->start);
+    }
+  }
+  return count;
+}
+
 int pn_buffer_quote(pn_buffer_t *buf, pn_string_t *str, size_t n)
 {
-  size_t hsize = pni_buffer_head_size(buf);
-  size_t tsize = pni_buffer_tail_size(buf);
-  if (hsize >= n) {
-    pn_quote(str, buf->bytes + pni_buffer_head(buf), n);
-    return 0;
+  for (pni_buffer_chunk_t *chunk = buf->head; chunk && n; chunk = chunk->next) {
+    size_t size = pn_min(pni_chunk_size(chunk), n);
+    pn_quote(str, pni_chunk_bytes(chunk) + chunk->start, size);
+    n -= size;
   }
-  pn_quote(str, buf->bytes + pni_buffer_head(buf), hsize);
-  pn_quote(str, buf->bytes, pn_min(tsize, n-hsize));
   return 0;
 }
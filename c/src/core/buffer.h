@@ -46,6 +46,10 @@ void pn_buffer_clear(pn_buffer_t *buf);
 int pn_buffer_defrag(pn_buffer_t *buf);
 pn_bytes_t pn_buffer_bytes(pn_buffer_t *buf);
 pn_rwbytes_t pn_buffer_memory(pn_buffer_t *buf);
+pn_bytes_t pn_buffer_chunk(pn_buffer_t *buf, size_t offset);
+size_t pn_buffer_chunks(pn_buffer_t *buf, pn_bytes_t *buffers, size_t n);
+pn_rwbytes_t pn_buffer_free_memory(pn_buffer_t *buf, size_t size);
+int pn_buffer_extend(pn_buffer_t *buf, size_t size);
 int pn_buffer_quote(pn_buffer_t *buf, pn_string_t *string, size_t n);
 
 #ifdef __cplusplus
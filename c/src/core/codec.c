@@ -74,12 +74,6 @@ const char *pn_type_name(pn_type_t type)
   return "<UNKNOWN>";
 }
 
-static inline void pni_atom_init(pn_atom_t *atom, pn_type_t type)
-{
-  memset(atom, 0, sizeof(pn_atom_t));
-  atom->type = type;
-}
-
 // data
 
 static void pn_data_finalize(void *object)
@@ -93,16 +87,16 @@ static void pn_data_finalize(void *object)
 static const pn_fields_t *pni_node_fields(pn_data_t *data, pni_node_t *node)
 {
   if (!node) return NULL;
-  if (node->atom.type != PN_DESCRIBED) return NULL;
+  if (node->type != PN_DESCRIBED) return NULL;
 
   pni_node_t *descriptor = pn_data_node(data, node->down);
 
-  if (!descriptor || descriptor->atom.type != PN_ULONG) {
+  if (!descriptor || descriptor->type != PN_ULONG) {
     return NULL;
   }
 
-  if (descriptor->atom.u.as_ulong >= FIELD_MIN && descriptor->atom.u.as_ulong <= FIELD_MAX) {
-    const pn_fields_t *f = &FIELDS[descriptor->atom.u.as_ulong-FIELD_MIN];
+  if (descriptor->u.as_ulong >= FIELD_MIN && descriptor->u.as_ulong <= FIELD_MAX) {
+    const pn_fields_t *f = &FIELDS[descriptor->u.as_ulong-FIELD_MIN];
     return (f->name_index!=0) ? f : NULL;
   } else {
     return NULL;
@@ -249,7 +243,8 @@ static int pni_node_lindex(pn_data_t *data, pni_node_t *node)
 int pni_inspect_enter(void *ctx, pn_data_t *data, pni_node_t *node)
 {
   pn_string_t *str = (pn_string_t *) ctx;
-  pn_atom_t *atom = (pn_atom_t *) &node->atom;
+  pn_atom_t value = pni_node_atom(data, node);
+  pn_atom_t *atom = &value;
 
   pni_node_t *parent = pn_data_node(data, node->parent);
   const pn_fields_t *fields = pni_node_fields(data, parent);
@@ -277,7 +272,7 @@ int pni_inspect_enter(void *ctx, pn_data_t *data, pni_node_t *node)
     return pn_string_addf(str, "@");
   case PN_ARRAY:
     // XXX: need to fix for described arrays
-    return pn_string_addf(str, "@%s[", pn_type_name(node->type));
+    return pn_string_addf(str, "@%s[", pn_type_name((pn_type_t) node->array_type));
   case PN_LIST:
     return pn_string_addf(str, "[");
   case PN_MAP:
@@ -301,7 +296,7 @@ pni_node_t *pni_next_nonnull(pn_data_t *data, pni_node_t *node)
 {
   while (node) {
     node = pn_data_node(data, node->next);
-    if (node && node->atom.type != PN_NULL) {
+    if (node && node->type != PN_NULL) {
       return node;
     }
   }
@@ -314,7 +309,7 @@ int pni_inspect_exit(void *ctx, pn_data_t *data, pni_node_t *node)
   pn_string_t *str = (pn_string_t *) ctx;
   int err;
 
-  switch (node->atom.type) {
+  switch (node->type) {
   case PN_ARRAY:
   case PN_LIST:
     err = pn_string_addf(str, "]");
@@ -331,12 +326,12 @@ int pni_inspect_exit(void *ctx, pn_data_t *data, pni_node_t *node)
   pni_node_t *parent = pn_data_node(data, node->parent);
   pni_node_t *grandparent = parent ? pn_data_node(data, parent->parent) : NULL;
   const pn_fields_t *grandfields = pni_node_fields(data, grandparent);
-  if (!grandfields || node->atom.type != PN_NULL) {
+  if (!grandfields || node->type != PN_NULL) {
     if (node->next) {
-      if (parent && parent->atom.type == PN_MAP && (pni_node_lindex(data, node) % 2) == 0) {
+      if (parent && parent->type == PN_MAP && (pni_node_lindex(data, node) % 2) == 0) {
         err = pn_string_addf(str, "=");
         if (err) return err;
-      } else if (parent && parent->atom.type == PN_DESCRIBED && node->prev == 0) {
+      } else if (parent && parent->type == PN_DESCRIBED && node->prev == 0) {
         err = pn_string_addf(str, " ");
         if (err) return err;
       } else {
@@ -378,6 +373,7 @@ pn_data_t *pn_data(size_t capacity)
   data->size = 0;
   data->nodes = capacity ? (pni_node_t *) pni_mem_suballocate(&clazz, data, capacity * sizeof(pni_node_t)) : NULL;
   data->buf = NULL;
+  data->borrowed = NULL;
   data->parent = 0;
   data->current = 0;
   data->base_parent = 0;
@@ -414,6 +410,7 @@ void pn_data_clear(pn_data_t *data)
     data->current = 0;
     data->base_parent = 0;
     data->base_current = 0;
+    data->borrowed = NULL;
     if (data->buf) pn_buffer_clear(data->buf);
   }
 }
@@ -432,65 +429,91 @@ static int pni_data_grow(pn_data_t *data)
   return 0;
 }
 
-static ssize_t pni_data_intern(pn_data_t *data, const char *start, size_t size)
+// Copy a value into the buffer, null terminated, and refer the node to it
+static int pni_data_intern(pn_data_t *data, pni_node_t *node, const char *start, size_t size)
 {
+  if (data->buf == NULL) {
+    // Heuristic to avoid growing small buffers too much
+    // size + 1 to allow for zero termination
+    data->buf = pn_buffer(pn_max(size+1, PNI_INTERN_MINSIZE));
+    if (data->buf == NULL) return PN_OUT_OF_MEMORY;
+  }
   size_t offset = pn_buffer_size(data->buf);
-  int err = pn_buffer_append(data->buf, start, size);
+  if (size >= UINT32_MAX - offset) return PN_OVERFLOW;
+
+  // The value may be one already in the buffer, which moves if it grows
+  pn_rwbytes_t buf = pn_buffer_memory(data->buf);
+  bool own = buf.start && start >= buf.start && start < buf.start + buf.size;
+  size_t from = own ? (size_t) (start - buf.start) : 0;
+  // Grow a single chunk so the buffer stays contiguous
+  int err = pn_buffer_ensure(data->buf, size + 1);
+  if (err) return err;
+  if (own) start = pn_buffer_memory(data->buf).start + from;
+
+  err = pn_buffer_append(data->buf, start, size);
   if (err) return err;
   err = pn_buffer_append(data->buf, "\0", 1);
   if (err) return err;
-  return offset;
-}
-
-static pn_bytes_t *pni_data_bytes(pn_data_t *data, pni_node_t *node)
-{
-  switch (node->atom.type) {
-  case PN_BINARY:
-  case PN_STRING:
-  case PN_SYMBOL:
-    return &node->atom.u.as_bytes;
-  default: return NULL;
-  }
+  node->u.as_bytes.offset = offset;
+  node->u.as_bytes.size = size;
+  return 0;
 }
 
-static void pni_data_rebase(pn_data_t *data, char *base)
+static void pni_node_set_atom(pni_node_t *node, const pn_atom_t *atom)
 {
-  for (unsigned i = 0; i < data->size; i++) {
-    pni_node_t *node = &data->nodes[i];
-    if (node->data) {
-      pn_bytes_t *bytes = pni_data_bytes(data, node);
-      bytes->start = base + node->data_offset;
-    }
+  node->type = atom->type;
+  node->u.as_ulong = 0;
+  switch (atom->type) {
+  case PN_BOOL: node->u.as_bool = atom->u.as_bool; break;
+  case PN_UBYTE: node->u.as_ubyte = atom->u.as_ubyte; break;
+  case PN_BYTE: node->u.as_byte = atom->u.as_byte; break;
+  case PN_USHORT: node->u.as_ushort = atom->u.as_ushort; break;
+  case PN_SHORT: node->u.as_short = atom->u.as_short; break;
+  case PN_UINT: node->u.as_uint = atom->u.as_uint; break;
+  case PN_INT: node->u.as_int = atom->u.as_int; break;
+  case PN_CHAR: node->u.as_char = atom->u.as_char; break;
+  case PN_ULONG: node->u.as_ulong = atom->u.as_ulong; break;
+  case PN_LONG: node->u.as_long = atom->u.as_long; break;
+  case PN_TIMESTAMP: node->u.as_timestamp = atom->u.as_timestamp; break;
+  case PN_FLOAT: node->u.as_float = atom->u.as_float; break;
+  case PN_DOUBLE: node->u.as_double = atom->u.as_double; break;
+  case PN_DECIMAL32: node->u.as_decimal32 = atom->u.as_decimal32; break;
+  case PN_DECIMAL64: node->u.as_decimal64 = atom->u.as_decimal64; break;
+  default: break;
   }
 }
 
-static int pni_data_intern_node(pn_data_t *data, pni_node_t *node)
-{
-  pn_bytes_t *bytes = pni_data_bytes(data, node);
-  if (!bytes) return 0;
-  if (data->buf == NULL) {
-    // Heuristic to avoid growing small buffers too much
-    // size + 1 to allow for zero termination
-    size_t size = pn_max(bytes->size+1, PNI_INTERN_MINSIZE);
-    data->buf = pn_buffer(size);
-  }
-  size_t oldcap = pn_buffer_capacity(data->buf);
-  ssize_t offset = pni_data_intern(data, bytes->start, bytes->size);
-  if (offset < 0) return offset;
-  node->data = true;
-  node->data_offset = offset;
-  node->data_size = bytes->size;
-  pn_rwbytes_t buf = pn_buffer_memory(data->buf);
-  bytes->start = buf.start + offset;
-
-  if (pn_buffer_capacity(data->buf) != oldcap) {
-    pni_data_rebase(data, buf.start);
+pn_atom_t pni_node_atom(pn_data_t *data, pni_node_t *node)
+{
+  pn_atom_t atom;
+  memset(&atom, 0, sizeof(atom));
+  atom.type = (pn_type_t) node->type;
+  switch (atom.type) {
+  case PN_BOOL: atom.u.as_bool = node->u.as_bool; break;
+  case PN_UBYTE: atom.u.as_ubyte = node->u.as_ubyte; break;
+  case PN_BYTE: atom.u.as_byte = node->u.as_byte; break;
+  case PN_USHORT: atom.u.as_ushort = node->u.as_ushort; break;
+  case PN_SHORT: atom.u.as_short = node->u.as_short; break;
+  case PN_UINT: atom.u.as_uint = node->u.as_uint; break;
+  case PN_INT: atom.u.as_int = node->u.as_int; break;
+  case PN_CHAR: atom.u.as_char = node->u.as_char; break;
+  case PN_ULONG: atom.u.as_ulong = node->u.as_ulong; break;
+  case PN_LONG: atom.u.as_long = node->u.as_long; break;
+  case PN_TIMESTAMP: atom.u.as_timestamp = node->u.as_timestamp; break;
+  case PN_FLOAT: atom.u.as_float = node->u.as_float; break;
+  case PN_DOUBLE: atom.u.as_double = node->u.as_double; break;
+  case PN_DECIMAL32: atom.u.as_decimal32 = node->u.as_decimal32; break;
+  case PN_DECIMAL64: atom.u.as_decimal64 = node->u.as_decimal64; break;
+  case PN_DECIMAL128: memcpy(atom.u.as_decimal128.bytes, pni_node_bytes(data, node).start, 16); break;
+  case PN_UUID: memcpy(atom.u.as_uuid.bytes, pni_node_bytes(data, node).start, 16); break;
+  case PN_BINARY:
+  case PN_STRING:
+  case PN_SYMBOL: atom.u.as_bytes = pni_node_bytes(data, node); break;
+  default: break;
   }
-
-  return 0;
+  return atom;
 }
 
-
 /*
    Append src to data after normalizing for "multiple" field encoding.
 
@@ -661,8 +684,8 @@ int pn_data_vfill(pn_data_t *data, const char *fmt, va_list ap)
     case 'T':                   /* Set type of open array */
       {
         pni_node_t *parent = pn_data_node(data, data->parent);
-        if (parent->atom.type == PN_ARRAY) {
-          parent->type = (pn_type_t) va_arg(ap, int);
+        if (parent->type == PN_ARRAY) {
+          parent->array_type = (pn_type_t) va_arg(ap, int);
         } else {
           return pn_error_format(pni_data_error(data), PN_ERR, "naked type");
         }
@@ -760,12 +783,12 @@ int pn_data_vfill(pn_data_t *data, const char *fmt, va_list ap)
     pni_node_t *parent = pn_data_node(data, data->parent);
     pni_node_t *current = pn_data_node(data, data->current);
     while (parent) {
-      if (parent->atom.type == PN_DESCRIBED && parent->children == 2) {
+      if (parent->type == PN_DESCRIBED && parent->children == 2) {
         current->described = true;
         pn_data_exit(data);
         current = pn_data_node(data, data->current);
         parent = pn_data_node(data, data->parent);
-      } else if (parent->atom.type == PN_NULL && parent->children == 1) {
+      } else if (parent->type == PN_NULL && parent->children == 1) {
         pn_data_exit(data);
         current = pn_data_node(data, data->current);
         current->down = 0;
@@ -799,7 +822,7 @@ static bool pn_scan_next(pn_data_t *data, pn_type_t *type, bool suspend)
     return true;
   } else {
     pni_node_t *parent = pn_data_node(data, data->parent);
-    if (parent && parent->atom.type == PN_DESCRIBED) {
+    if (parent && parent->type == PN_DESCRIBED) {
       pn_data_exit(data);
       return pn_scan_next(data, type, suspend);
     } else {
@@ -1151,7 +1174,7 @@ int pn_data_vscan(pn_data_t *data, const char *fmt, va_list ap)
         if (!suspend) {
           size_t old = pn_data_size(dst);
           pni_node_t *next = pni_data_peek(data);
-          if (next && next->atom.type != PN_NULL) {
+          if (next && next->type != PN_NULL) {
             pn_data_narrow(data);
             int err = pn_data_appendn(dst, data, 1);
             pn_data_widen(data);
@@ -1261,7 +1284,7 @@ pn_handle_t pn_data_point(pn_data_t *data)
   if (data->current) {
     return (pn_handle_t)(uintptr_t)data->current;
   } else {
-    return (pn_handle_t)(uintptr_t)-data->parent;
+    return (pn_handle_t)(uintptr_t)-(pn_shandle_t)data->parent;
   }
 }
 
@@ -1376,7 +1399,7 @@ pn_type_t pn_data_type(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
   if (node) {
-    return node->atom.type;
+    return node->type;
   } else {
     return PN_INVALID;
   }
@@ -1386,7 +1409,7 @@ pn_type_t pni_data_parent_type(pn_data_t *data)
 {
   pni_node_t *node = pn_data_node(data, data->parent);
   if (node) {
-    return node->atom.type;
+    return node->type;
   } else {
     return PN_INVALID;
   }
@@ -1459,7 +1482,8 @@ void pn_data_dump(pn_data_t *data)
   {
     pni_node_t *node = &data->nodes[i];
     pn_string_setn(str, "", 0);
-    pni_inspect_atom((pn_atom_t *) &node->atom, str);
+    pn_atom_t atom = pni_node_atom(data, node);
+    pni_inspect_atom(&atom, str);
     printf("Node %i: prev=%" PN_ZI ", next=%" PN_ZI ", parent=%" PN_ZI ", down=%" PN_ZI 
            ", children=%" PN_ZI ", type=%s (%s)\n",
            i + 1, (size_t) node->prev,
@@ -1467,7 +1491,7 @@ void pn_data_dump(pn_data_t *data)
            (size_t) node->parent,
            (size_t) node->down,
            (size_t) node->children,
-           pn_type_name(node->atom.type), pn_string_get(str));
+           pn_type_name(node->type), pn_string_get(str));
   }
   pn_free(str);
 }
@@ -1524,10 +1548,8 @@ static pni_node_t *pni_data_add(pn_data_t *data)
 
   node->down = 0;
   node->children = 0;
-  node->data = false;
   node->described = false;
-  node->data_offset = 0;
-  node->data_size = 0;
+  node->borrowed = false;
   data->current = pni_data_id(data, node);
   return node;
 }
@@ -1559,11 +1581,53 @@ ssize_t pn_data_decode(pn_data_t *data, const char *bytes, size_t size)
   return r;
 }
 
+ssize_t pn_data_decode_borrowed(pn_data_t *data, const char *bytes, size_t size)
+{
+  // Borrowed values are offsets from one base
+  if (data->borrowed != bytes) {
+    int err = pn_data_intern(data);
+    if (err) return err;
+    data->borrowed = bytes;
+  }
+  pn_decoder_t decoder;
+  pn_decoder_initialize(&decoder);
+  decoder.borrow = true;
+  ssize_t r = pn_decoder_decode(&decoder, bytes, size, data);
+  pn_decoder_finalize(&decoder);
+  return r;
+}
+
+int pni_data_put_borrowed(pn_data_t *data, pn_type_t type, pn_bytes_t bytes)
+{
+  pni_node_t *node = pni_data_add(data);
+  if (node == NULL) return PN_OUT_OF_MEMORY;
+  node->type = type;
+  node->borrowed = true;
+  node->u.as_bytes.offset = bytes.start - data->borrowed;
+  node->u.as_bytes.size = bytes.size;
+  return 0;
+}
+
+int pn_data_intern(pn_data_t *data)
+{
+  if (!data->borrowed) return 0;
+  for (pni_nid_t i = 0; i < data->size; i++) {
+    pni_node_t *node = &data->nodes[i];
+    if (node->borrowed) {
+      int err = pni_data_intern(data, node, data->borrowed + node->u.as_bytes.offset, node->u.as_bytes.size);
+      if (err) return err;
+      node->borrowed = false;
+    }
+  }
+  data->borrowed = NULL;
+  return 0;
+}
+
 int pn_data_put_list(pn_data_t *data)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_LIST;
+  node->type = PN_LIST;
   return 0;
 }
 
@@ -1571,7 +1635,7 @@ int pn_data_put_map(pn_data_t *data)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_MAP;
+  node->type = PN_MAP;
   return 0;
 }
 
@@ -1579,23 +1643,23 @@ int pn_data_put_array(pn_data_t *data, bool described, pn_type_t type)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_ARRAY;
+  node->type = PN_ARRAY;
   node->described = described;
-  node->type = type;
+  node->array_type = type;
   return 0;
 }
 
 void pni_data_set_array_type(pn_data_t *data, pn_type_t type)
 {
   pni_node_t *array = pni_data_current(data);
-  if (array) array->type = type;
+  if (array) array->array_type = type;
 }
 
 int pn_data_put_described(pn_data_t *data)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_DESCRIBED;
+  node->type = PN_DESCRIBED;
   return 0;
 }
 
@@ -1603,7 +1667,8 @@ int pn_data_put_null(pn_data_t *data)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  pni_atom_init(&node->atom, PN_NULL);
+  node->type = PN_NULL;
+  node->u.as_ulong = 0;
   return 0;
 }
 
@@ -1611,8 +1676,8 @@ int pn_data_put_bool(pn_data_t *data, bool b)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_BOOL;
-  node->atom.u.as_bool = b;
+  node->type = PN_BOOL;
+  node->u.as_bool = b;
   return 0;
 }
 
@@ -1620,8 +1685,8 @@ int pn_data_put_ubyte(pn_data_t *data, uint8_t ub)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_UBYTE;
-  node->atom.u.as_ubyte = ub;
+  node->type = PN_UBYTE;
+  node->u.as_ubyte = ub;
   return 0;
 }
 
@@ -1629,8 +1694,8 @@ int pn_data_put_byte(pn_data_t *data, int8_t b)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_BYTE;
-  node->atom.u.as_byte = b;
+  node->type = PN_BYTE;
+  node->u.as_byte = b;
   return 0;
 }
 
@@ -1638,8 +1703,8 @@ int pn_data_put_ushort(pn_data_t *data, uint16_t us)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_USHORT;
-  node->atom.u.as_ushort = us;
+  node->type = PN_USHORT;
+  node->u.as_ushort = us;
   return 0;
 }
 
@@ -1647,8 +1712,8 @@ int pn_data_put_short(pn_data_t *data, int16_t s)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_SHORT;
-  node->atom.u.as_short = s;
+  node->type = PN_SHORT;
+  node->u.as_short = s;
   return 0;
 }
 
@@ -1656,8 +1721,8 @@ int pn_data_put_uint(pn_data_t *data, uint32_t ui)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_UINT;
-  node->atom.u.as_uint = ui;
+  node->type = PN_UINT;
+  node->u.as_uint = ui;
   return 0;
 }
 
@@ -1665,8 +1730,8 @@ int pn_data_put_int(pn_data_t *data, int32_t i)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_INT;
-  node->atom.u.as_int = i;
+  node->type = PN_INT;
+  node->u.as_int = i;
   return 0;
 }
 
@@ -1674,8 +1739,8 @@ int pn_data_put_char(pn_data_t *data, pn_char_t c)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_CHAR;
-  node->atom.u.as_char = c;
+  node->type = PN_CHAR;
+  node->u.as_char = c;
   return 0;
 }
 
@@ -1683,8 +1748,8 @@ int pn_data_put_ulong(pn_data_t *data, uint64_t ul)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_ULONG;
-  node->atom.u.as_ulong = ul;
+  node->type = PN_ULONG;
+  node->u.as_ulong = ul;
   return 0;
 }
 
@@ -1692,8 +1757,8 @@ int pn_data_put_long(pn_data_t *data, int64_t l)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_LONG;
-  node->atom.u.as_long = l;
+  node->type = PN_LONG;
+  node->u.as_long = l;
   return 0;
 }
 
@@ -1701,8 +1766,8 @@ int pn_data_put_timestamp(pn_data_t *data, pn_timestamp_t t)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_TIMESTAMP;
-  node->atom.u.as_timestamp = t;
+  node->type = PN_TIMESTAMP;
+  node->u.as_timestamp = t;
   return 0;
 }
 
@@ -1710,8 +1775,8 @@ int pn_data_put_float(pn_data_t *data, float f)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_FLOAT;
-  node->atom.u.as_float = f;
+  node->type = PN_FLOAT;
+  node->u.as_float = f;
   return 0;
 }
 
@@ -1719,8 +1784,8 @@ int pn_data_put_double(pn_data_t *data, double d)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_DOUBLE;
-  node->atom.u.as_double = d;
+  node->type = PN_DOUBLE;
+  node->u.as_double = d;
   return 0;
 }
 
@@ -1728,8 +1793,8 @@ int pn_data_put_decimal32(pn_data_t *data, pn_decimal32_t d)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_DECIMAL32;
-  node->atom.u.as_decimal32 = d;
+  node->type = PN_DECIMAL32;
+  node->u.as_decimal32 = d;
   return 0;
 }
 
@@ -1737,8 +1802,8 @@ int pn_data_put_decimal64(pn_data_t *data, pn_decimal64_t d)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_DECIMAL64;
-  node->atom.u.as_decimal64 = d;
+  node->type = PN_DECIMAL64;
+  node->u.as_decimal64 = d;
   return 0;
 }
 
@@ -1746,59 +1811,68 @@ int pn_data_put_decimal128(pn_data_t *data, pn_decimal128_t d)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_DECIMAL128;
-  memmove(node->atom.u.as_decimal128.bytes, d.bytes, 16);
-  return 0;
+  node->type = PN_DECIMAL128;
+  return pni_data_intern(data, node, d.bytes, 16);
 }
 
 int pn_data_put_uuid(pn_data_t *data, pn_uuid_t u)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_UUID;
-  memmove(node->atom.u.as_uuid.bytes, u.bytes, 16);
-  return 0;
+  node->type = PN_UUID;
+  return pni_data_intern(data, node, u.bytes, 16);
 }
 
 int pn_data_put_binary(pn_data_t *data, pn_bytes_t bytes)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_BINARY;
-  node->atom.u.as_bytes = bytes;
-  return pni_data_intern_node(data, node);
+  node->type = PN_BINARY;
+  return pni_data_intern(data, node, bytes.start, bytes.size);
 }
 
 int pn_data_put_string(pn_data_t *data, pn_bytes_t string)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_STRING;
-  node->atom.u.as_bytes = string;
-  return pni_data_intern_node(data, node);
+  node->type = PN_STRING;
+  return pni_data_intern(data, node, string.start, string.size);
 }
 
 int pn_data_put_symbol(pn_data_t *data, pn_bytes_t symbol)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom.type = PN_SYMBOL;
-  node->atom.u.as_bytes = symbol;
-  return pni_data_intern_node(data, node);
+  node->type = PN_SYMBOL;
+  return pni_data_intern(data, node, symbol.start, symbol.size);
 }
 
 int pn_data_put_atom(pn_data_t *data, pn_atom_t atom)
 {
   pni_node_t *node = pni_data_add(data);
   if (node == NULL) return PN_OUT_OF_MEMORY;
-  node->atom = atom;
-  return pni_data_intern_node(data, node);
+  switch (atom.type) {
+  case PN_DECIMAL128:
+    node->type = atom.type;
+    return pni_data_intern(data, node, atom.u.as_decimal128.bytes, 16);
+  case PN_UUID:
+    node->type = atom.type;
+    return pni_data_intern(data, node, atom.u.as_uuid.bytes, 16);
+  case PN_BINARY:
+  case PN_STRING:
+  case PN_SYMBOL:
+    node->type = atom.type;
+    return pni_data_intern(data, node, atom.u.as_bytes.start, atom.u.as_bytes.size);
+  default:
+    pni_node_set_atom(node, &atom);
+    return 0;
+  }
 }
 
 size_t pn_data_get_list(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_LIST) {
+  if (node && node->type == PN_LIST) {
     return node->children;
   } else {
     return 0;
@@ -1808,7 +1882,7 @@ size_t pn_data_get_list(pn_data_t *data)
 size_t pn_data_get_map(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_MAP) {
+  if (node && node->type == PN_MAP) {
     return node->children;
   } else {
     return 0;
@@ -1818,7 +1892,7 @@ size_t pn_data_get_map(pn_data_t *data)
 size_t pn_data_get_array(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_ARRAY) {
+  if (node && node->type == PN_ARRAY) {
     if (node->described) {
       return node->children - 1;
     } else {
@@ -1832,7 +1906,7 @@ size_t pn_data_get_array(pn_data_t *data)
 bool pn_data_is_array_described(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_ARRAY) {
+  if (node && node->type == PN_ARRAY) {
     return node->described;
   } else {
     return false;
@@ -1842,8 +1916,8 @@ bool pn_data_is_array_described(pn_data_t *data)
 pn_type_t pn_data_get_array_type(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_ARRAY) {
-    return node->type;
+  if (node && node->type == PN_ARRAY) {
+    return (pn_type_t) node->array_type;
   } else {
     return PN_INVALID;
   }
@@ -1852,20 +1926,20 @@ pn_type_t pn_data_get_array_type(pn_data_t *data)
 bool pn_data_is_described(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  return node && node->atom.type == PN_DESCRIBED;
+  return node && node->type == PN_DESCRIBED;
 }
 
 bool pn_data_is_null(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  return node && node->atom.type == PN_NULL;
+  return node && node->type == PN_NULL;
 }
 
 bool pn_data_get_bool(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_BOOL) {
-    return node->atom.u.as_bool;
+  if (node && node->type == PN_BOOL) {
+    return node->u.as_bool;
   } else {
     return false;
   }
@@ -1874,8 +1948,8 @@ bool pn_data_get_bool(pn_data_t *data)
 uint8_t pn_data_get_ubyte(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_UBYTE) {
-    return node->atom.u.as_ubyte;
+  if (node && node->type == PN_UBYTE) {
+    return node->u.as_ubyte;
   } else {
     return 0;
   }
@@ -1884,8 +1958,8 @@ uint8_t pn_data_get_ubyte(pn_data_t *data)
 int8_t pn_data_get_byte(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_BYTE) {
-    return node->atom.u.as_byte;
+  if (node && node->type == PN_BYTE) {
+    return node->u.as_byte;
   } else {
     return 0;
   }
@@ -1894,8 +1968,8 @@ int8_t pn_data_get_byte(pn_data_t *data)
 uint16_t pn_data_get_ushort(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_USHORT) {
-    return node->atom.u.as_ushort;
+  if (node && node->type == PN_USHORT) {
+    return node->u.as_ushort;
   } else {
     return 0;
   }
@@ -1904,8 +1978,8 @@ uint16_t pn_data_get_ushort(pn_data_t *data)
 int16_t pn_data_get_short(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_SHORT) {
-    return node->atom.u.as_short;
+  if (node && node->type == PN_SHORT) {
+    return node->u.as_short;
   } else {
     return 0;
   }
@@ -1914,8 +1988,8 @@ int16_t pn_data_get_short(pn_data_t *data)
 uint32_t pn_data_get_uint(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_UINT) {
-    return node->atom.u.as_uint;
+  if (node && node->type == PN_UINT) {
+    return node->u.as_uint;
   } else {
     return 0;
   }
@@ -1924,8 +1998,8 @@ uint32_t pn_data_get_uint(pn_data_t *data)
 int32_t pn_data_get_int(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_INT) {
-    return node->atom.u.as_int;
+  if (node && node->type == PN_INT) {
+    return node->u.as_int;
   } else {
     return 0;
   }
@@ -1934,8 +2008,8 @@ int32_t pn_data_get_int(pn_data_t *data)
 pn_char_t pn_data_get_char(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_CHAR) {
-    return node->atom.u.as_char;
+  if (node && node->type == PN_CHAR) {
+    return node->u.as_char;
   } else {
     return 0;
   }
@@ -1944,8 +2018,8 @@ pn_char_t pn_data_get_char(pn_data_t *data)
 uint64_t pn_data_get_ulong(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_ULONG) {
-    return node->atom.u.as_ulong;
+  if (node && node->type == PN_ULONG) {
+    return node->u.as_ulong;
   } else {
     return 0;
   }
@@ -1954,8 +2028,8 @@ uint64_t pn_data_get_ulong(pn_data_t *data)
 int64_t pn_data_get_long(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_LONG) {
-    return node->atom.u.as_long;
+  if (node && node->type == PN_LONG) {
+    return node->u.as_long;
   } else {
     return 0;
   }
@@ -1964,8 +2038,8 @@ int64_t pn_data_get_long(pn_data_t *data)
 pn_timestamp_t pn_data_get_timestamp(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_TIMESTAMP) {
-    return node->atom.u.as_timestamp;
+  if (node && node->type == PN_TIMESTAMP) {
+    return node->u.as_timestamp;
   } else {
     return 0;
   }
@@ -1974,8 +2048,8 @@ pn_timestamp_t pn_data_get_timestamp(pn_data_t *data)
 float pn_data_get_float(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_FLOAT) {
-    return node->atom.u.as_float;
+  if (node && node->type == PN_FLOAT) {
+    return node->u.as_float;
   } else {
     return 0;
   }
@@ -1984,8 +2058,8 @@ float pn_data_get_float(pn_data_t *data)
 double pn_data_get_double(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_DOUBLE) {
-    return node->atom.u.as_double;
+  if (node && node->type == PN_DOUBLE) {
+    return node->u.as_double;
   } else {
     return 0;
   }
@@ -1994,8 +2068,8 @@ double pn_data_get_double(pn_data_t *data)
 pn_decimal32_t pn_data_get_decimal32(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_DECIMAL32) {
-    return node->atom.u.as_decimal32;
+  if (node && node->type == PN_DECIMAL32) {
+    return node->u.as_decimal32;
   } else {
     return 0;
   }
@@ -2004,8 +2078,8 @@ pn_decimal32_t pn_data_get_decimal32(pn_data_t *data)
 pn_decimal64_t pn_data_get_decimal64(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_DECIMAL64) {
-    return node->atom.u.as_decimal64;
+  if (node && node->type == PN_DECIMAL64) {
+    return node->u.as_decimal64;
   } else {
     return 0;
   }
@@ -2014,30 +2088,28 @@ pn_decimal64_t pn_data_get_decimal64(pn_data_t *data)
 pn_decimal128_t pn_data_get_decimal128(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_DECIMAL128) {
-    return node->atom.u.as_decimal128;
-  } else {
-    pn_decimal128_t t = {{0}};
-    return t;
+  pn_decimal128_t t = {{0}};
+  if (node && node->type == PN_DECIMAL128) {
+    memcpy(t.bytes, pni_node_bytes(data, node).start, 16);
   }
+  return t;
 }
 
 pn_uuid_t pn_data_get_uuid(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_UUID) {
-    return node->atom.u.as_uuid;
-  } else {
-    pn_uuid_t t = {{0}};
-    return t;
+  pn_uuid_t t = {{0}};
+  if (node && node->type == PN_UUID) {
+    memcpy(t.bytes, pni_node_bytes(data, node).start, 16);
   }
+  return t;
 }
 
 pn_bytes_t pn_data_get_binary(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_BINARY) {
-    return node->atom.u.as_bytes;
+  if (node && node->type == PN_BINARY) {
+    return pni_node_bytes(data, node);
   } else {
     pn_bytes_t t = {0};
     return t;
@@ -2047,8 +2119,8 @@ pn_bytes_t pn_data_get_binary(pn_data_t *data)
 pn_bytes_t pn_data_get_string(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_STRING) {
-    return node->atom.u.as_bytes;
+  if (node && node->type == PN_STRING) {
+    return pni_node_bytes(data, node);
   } else {
     pn_bytes_t t = {0};
     return t;
@@ -2058,8 +2130,8 @@ pn_bytes_t pn_data_get_string(pn_data_t *data)
 pn_bytes_t pn_data_get_symbol(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && node->atom.type == PN_SYMBOL) {
-    return node->atom.u.as_bytes;
+  if (node && node->type == PN_SYMBOL) {
+    return pni_node_bytes(data, node);
   } else {
     pn_bytes_t t = {0};
     return t;
@@ -2069,10 +2141,10 @@ pn_bytes_t pn_data_get_symbol(pn_data_t *data)
 pn_bytes_t pn_data_get_bytes(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
-  if (node && (node->atom.type == PN_BINARY ||
-               node->atom.type == PN_STRING ||
-               node->atom.type == PN_SYMBOL)) {
-    return node->atom.u.as_bytes;
+  if (node && (node->type == PN_BINARY ||
+               node->type == PN_STRING ||
+               node->type == PN_SYMBOL)) {
+    return pni_node_bytes(data, node);
   } else {
     pn_bytes_t t = {0};
     return t;
@@ -2083,7 +2155,7 @@ pn_atom_t pn_data_get_atom(pn_data_t *data)
 {
   pni_node_t *node = pni_data_current(data);
   if (node) {
-    return *((pn_atom_t *) &node->atom);
+    return pni_node_atom(data, node);
   } else {
     pn_atom_t t = {PN_NULL, {0,}};
     return t;
@@ -25,4 +25,12 @@
 # define PN_TRANSPORT_INITIAL_FRAME_SIZE (512) /* bytes */
 #endif
 
+#ifndef PN_TRANSPORT_OUTPUT_BORROW_MIN
+# define PN_TRANSPORT_OUTPUT_BORROW_MIN (1024) /* bytes of delivery payload referenced, not copied, on output */
+#endif
+
+#ifndef PN_TRANSPORT_BATCH_RESERVE
+# define PN_TRANSPORT_BATCH_RESERVE (16*1024) /* bytes of output reserved at a time for a run of small transfers */
+#endif
+
 #endif /*  _PROTON_SRC_CONFIG_H */
@@ -25,6 +25,9 @@
 #include <proton/transport.h>
 #include <string.h>
 
+/* Initial number of events in the ring of the driver's collector */
+#define PNI_DRIVER_EVENT_RING 64
+
 static pn_event_t *batch_next(pn_connection_driver_t *d) {
   if (!d->collector) return NULL;
   pn_event_t *handled = pn_collector_prev(d->collector);
@@ -59,6 +62,11 @@ int pn_connection_driver_init(pn_connection_driver_t* d, pn_connection_t *c, pn_
     pn_connection_driver_destroy(d);
     return PN_OUT_OF_MEMORY;
   }
+  int err = pn_collector_ring(d->collector, PNI_DRIVER_EVENT_RING);
+  if (err) {
+    pn_connection_driver_destroy(d);
+    return err;
+  }
   pn_connection_collect(d->connection, d->collector);
   return 0;
 }
@@ -114,6 +122,10 @@ pn_bytes_t pn_connection_driver_write_buffer(pn_connection_driver_t *d) {
     pn_bytes(pending, pn_transport_head(d->transport)) : pn_bytes_null;
 }
 
+size_t pn_connection_driver_write_buffers(pn_connection_driver_t *d, pn_bytes_t *buffers, size_t n) {
+  return pni_transport_write_buffers(d->transport, buffers, n);
+}
+
 void pn_connection_driver_write_done(pn_connection_driver_t *d, size_t n) {
   pn_transport_pop(d->transport, n);
 }
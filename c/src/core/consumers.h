@@ -0,0 +1,416 @@
+#ifndef PROTON_CONSUMERS_H
+#define PROTON_CONSUMERS_H 1
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "encodings.h"
+
+#include <proton/type_compat.h>
+#include <proton/types.h>
+
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Reads AMQP encoded values straight out of a byte range without building a
+ * pn_data_t. This is what the generated performative decoders in
+ * performatives.h are built on.
+ *
+ * All the readers return false only if the encoding is malformed or
+ * truncated. A well formed value of an unexpected type is skipped and
+ * reported as absent, which is how pn_data_scan() treats a type mismatch.
+ */
+typedef struct {
+  const uint8_t *output_start;
+  size_t size;
+  size_t position;
+} pni_consumer_t;
+
+static inline pni_consumer_t make_consumer_from_bytes(pn_bytes_t bytes)
+{
+  pni_consumer_t consumer;
+  consumer.output_start = (const uint8_t *) bytes.start;
+  consumer.size = bytes.size;
+  consumer.position = 0;
+  return consumer;
+}
+
+static inline size_t pni_consumer_remaining(pni_consumer_t *consumer)
+{
+  return consumer->size - consumer->position;
+}
+
+static inline bool pni_consumer_readf8(pni_consumer_t *consumer, uint8_t *result)
+{
+  if (pni_consumer_remaining(consumer) < 1) return false;
+  *result = consumer->output_start[consumer->position];
+  consumer->position += 1;
+  return true;
+}
+
+static inline bool pni_consumer_readf16(pni_consumer_t *consumer, uint16_t *result)
+{
+  if (pni_consumer_remaining(consumer) < 2) return false;
+  const uint8_t *p = &consumer->output_start[consumer->position];
+  *result = (uint16_t) p[0] << 8 | p[1];
+  consumer->position += 2;
+  return true;
+}
+
+static inline bool pni_consumer_readf32(pni_consumer_t *consumer, uint32_t *result)
+{
+  if (pni_consumer_remaining(consumer) < 4) return false;
+  const uint8_t *p = &consumer->output_start[consumer->position];
+  *result = (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+  consumer->position += 4;
+  return true;
+}
+
+static inline bool pni_consumer_readf64(pni_consumer_t *consumer, uint64_t *result)
+{
+  uint32_t hi, lo;
+  if (pni_consumer_remaining(consumer) < 8) return false;
+  pni_consumer_readf32(consumer, &hi);
+  pni_consumer_readf32(consumer, &lo);
+  *result = (uint64_t) hi << 32 | lo;
+  return true;
+}
+
+static inline bool pni_consumer_skip(pni_consumer_t *consumer, size_t size)
+{
+  if (pni_consumer_remaining(consumer) < size) return false;
+  consumer->position += size;
+  return true;
+}
+
+/* Read the size that follows a variable width or compound constructor */
+static inline bool pni_consumer_read_size(pni_consumer_t *consumer, uint8_t code, size_t *size)
+{
+  if ((code & 0x10) == 0) {
+    uint8_t s;
+    if (!pni_consumer_readf8(consumer, &s)) return false;
+    *size = s;
+  } else {
+    uint32_t s;
+    if (!pni_consumer_readf32(consumer, &s)) return false;
+    *size = s;
+  }
+  return true;
+}
+
+/* Skip the encoded value that follows the (non descriptor) constructor code */
+static inline bool pni_consumer_skip_value_not_described(pni_consumer_t *consumer, uint8_t code)
+{
+  size_t size;
+  switch (code & 0xF0) {
+  case 0x40: return true;
+  case 0x50: return pni_consumer_skip(consumer, 1);
+  case 0x60: return pni_consumer_skip(consumer, 2);
+  case 0x70: return pni_consumer_skip(consumer, 4);
+  case 0x80: return pni_consumer_skip(consumer, 8);
+  case 0x90: return pni_consumer_skip(consumer, 16);
+  case 0xA0: case 0xB0:
+  case 0xC0: case 0xD0:
+  case 0xE0: case 0xF0:
+    return pni_consumer_read_size(consumer, code, &size) && pni_consumer_skip(consumer, size);
+  default:
+    return false;
+  }
+}
+
+/* Read a constructor, following any descriptor, and return the underlying type code */
+static inline bool pni_consumer_read_constructor(pni_consumer_t *consumer, uint8_t *code)
+{
+  if (!pni_consumer_readf8(consumer, code)) return false;
+  if (*code != PNE_DESCRIPTOR) return true;
+  uint8_t dcode;
+  // Don't allow compound or described descriptors, as in the full decoder
+  if (!pni_consumer_readf8(consumer, &dcode)) return false;
+  if (dcode == PNE_DESCRIPTOR || (dcode & 0xF0) >= 0xC0) return false;
+  if (!pni_consumer_skip_value_not_described(consumer, dcode)) return false;
+  return pni_consumer_readf8(consumer, code) && *code != PNE_DESCRIPTOR;
+}
+
+static inline bool pni_consumer_skip_value(pni_consumer_t *consumer)
+{
+  uint8_t code;
+  return pni_consumer_read_constructor(consumer, &code) &&
+         pni_consumer_skip_value_not_described(consumer, code);
+}
+
+/* Read a numeric descriptor: there must be a described value here */
+static inline bool pni_consumer_read_descriptor(pni_consumer_t *consumer, uint64_t *descriptor)
+{
+  uint8_t code;
+  if (!pni_consumer_readf8(consumer, &code) || code != PNE_DESCRIPTOR) return false;
+  if (!pni_consumer_readf8(consumer, &code)) return false;
+  switch (code) {
+  case PNE_SMALLULONG: {
+    uint8_t ul;
+    if (!pni_consumer_readf8(consumer, &ul)) return false;
+    *descriptor = ul;
+    return true;
+  }
+  case PNE_ULONG:
+    return pni_consumer_readf64(consumer, descriptor);
+  case PNE_ULONG0:
+    *descriptor = 0;
+    return true;
+  default:
+    return false;
+  }
+}
+
+/*
+ * Enter a list: on return the sub consumer covers the list's elements and the
+ * consumer is positioned after the list. A null is treated as an empty list.
+ */
+static inline bool pni_consumer_enter_list(pni_consumer_t *consumer, pni_consumer_t *sub, uint32_t *count)
+{
+  uint8_t code;
+  if (!pni_consumer_readf8(consumer, &code)) return false;
+  switch (code) {
+  case PNE_NULL:
+  case PNE_LIST0:
+    sub->output_start = NULL;
+    sub->size = 0;
+    sub->position = 0;
+    *count = 0;
+    return true;
+  case PNE_LIST8: {
+    uint8_t size, c;
+    if (!pni_consumer_readf8(consumer, &size) || size < 1) return false;
+    if (pni_consumer_remaining(consumer) < size) return false;
+    pni_consumer_readf8(consumer, &c);
+    sub->output_start = consumer->output_start + consumer->position;
+    sub->size = size - 1u;
+    sub->position = 0;
+    *count = c;
+    consumer->position += size - 1u;
+    return true;
+  }
+  case PNE_LIST32: {
+    uint32_t size;
+    if (!pni_consumer_readf32(consumer, &size) || size < 4) return false;
+    if (pni_consumer_remaining(consumer) < size) return false;
+    pni_consumer_readf32(consumer, count);
+    sub->output_start = consumer->output_start + consumer->position;
+    sub->size = size - 4u;
+    sub->position = 0;
+    consumer->position += size - 4u;
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+/* Enter a map in the same way as a list, count is the number of keys plus values */
+static inline bool pni_consumer_enter_map(pni_consumer_t *consumer, pni_consumer_t *sub, uint32_t *count)
+{
+  uint8_t code;
+  if (!pni_consumer_readf8(consumer, &code)) return false;
+  switch (code) {
+  case PNE_NULL:
+    sub->output_start = NULL;
+    sub->size = 0;
+    sub->position = 0;
+    *count = 0;
+    return true;
+  case PNE_MAP8: {
+    uint8_t size, c;
+    if (!pni_consumer_readf8(consumer, &size) || size < 1) return false;
+    if (pni_consumer_remaining(consumer) < size) return false;
+    pni_consumer_readf8(consumer, &c);
+    sub->output_start = consumer->output_start + consumer->position;
+    sub->size = size - 1u;
+    sub->position = 0;
+    *count = c;
+    consumer->position += size - 1u;
+    return true;
+  }
+  case PNE_MAP32: {
+    uint32_t size;
+    if (!pni_consumer_readf32(consumer, &size) || size < 4) return false;
+    if (pni_consumer_remaining(consumer) < size) return false;
+    pni_consumer_readf32(consumer, count);
+    sub->output_start = consumer->output_start + consumer->position;
+    sub->size = size - 4u;
+    sub->position = 0;
+    consumer->position += size - 4u;
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+/*
+ * Typed field readers used by the generated performative decoders. Each
+ * reads exactly one value and sets *present if it was of the expected type.
+ */
+static inline bool pni_consumer_read_bool(pni_consumer_t *consumer, bool *value, bool *present)
+{
+  uint8_t code;
+  if (!pni_consumer_read_constructor(consumer, &code)) return false;
+  switch (code) {
+  case PNE_TRUE:
+    *value = true;
+    *present = true;
+    return true;
+  case PNE_FALSE:
+    *value = false;
+    *present = true;
+    return true;
+  case PNE_BOOLEAN: {
+    uint8_t b;
+    if (!pni_consumer_readf8(consumer, &b)) return false;
+    *value = b != 0;
+    *present = true;
+    return true;
+  }
+  default:
+    return pni_consumer_skip_value_not_described(consumer, code);
+  }
+}
+
+static inline bool pni_consumer_read_ubyte(pni_consumer_t *consumer, uint8_t *value, bool *present)
+{
+  uint8_t code;
+  if (!pni_consumer_read_constructor(consumer, &code)) return false;
+  if (code != PNE_UBYTE) return pni_consumer_skip_value_not_described(consumer, code);
+  *present = true;
+  return pni_consumer_readf8(consumer, value);
+}
+
+static inline bool pni_consumer_read_ushort(pni_consumer_t *consumer, uint16_t *value, bool *present)
+{
+  uint8_t code;
+  if (!pni_consumer_read_constructor(consumer, &code)) return false;
+  if (code != PNE_USHORT) return pni_consumer_skip_value_not_described(consumer, code);
+  *present = true;
+  return pni_consumer_readf16(consumer, value);
+}
+
+static inline bool pni_consumer_read_uint(pni_consumer_t *consumer, uint32_t *value, bool *present)
+{
+  uint8_t code;
+  if (!pni_consumer_read_constructor(consumer, &code)) return false;
+  switch (code) {
+  case PNE_UINT0:
+    *value = 0;
+    *present = true;
+    return true;
+  case PNE_SMALLUINT: {
+    uint8_t v;
+    if (!pni_consumer_readf8(consumer, &v)) return false;
+    *value = v;
+    *present = true;
+    return true;
+  }
+  case PNE_UINT:
+    *present = true;
+    return pni_consumer_readf32(consumer, value);
+  default:
+    return pni_consumer_skip_value_not_described(consumer, code);
+  }
+}
+
+static inline bool pni_consumer_read_ulong(pni_consumer_t *consumer, uint64_t *value, bool *present)
+{
+  uint8_t code;
+  if (!pni_consumer_read_constructor(consumer, &code)) return false;
+  switch (code) {
+  case PNE_ULONG0:
+    *value = 0;
+    *present = true;
+    return true;
+  case PNE_SMALLULONG: {
+    uint8_t v;
+    if (!pni_consumer_readf8(consumer, &v)) return false;
+    *value = v;
+    *present = true;
+    return true;
+  }
+  case PNE_ULONG:
+    *present = true;
+    return pni_consumer_readf64(consumer, value);
+  default:
+    return pni_consumer_skip_value_not_described(consumer, code);
+  }
+}
+
+static inline bool pni_consumer_read_timestamp(pni_consumer_t *consumer, int64_t *value, bool *present)
+{
+  uint8_t code;
+  if (!pni_consumer_read_constructor(consumer, &code)) return false;
+  if (code != PNE_MS64) return pni_consumer_skip_value_not_described(consumer, code);
+  uint64_t t;
+  if (!pni_consumer_readf64(consumer, &t)) return false;
+  *value = (int64_t) t;
+  *present = true;
+  return true;
+}
+
+static inline bool pni_consumer_read_variable(pni_consumer_t *consumer, uint8_t expected, pn_bytes_t *value, bool *present)
+{
+  uint8_t code;
+  if (!pni_consumer_read_constructor(consumer, &code)) return false;
+  if ((code & 0x0F) != expected || (code & 0xE0) != 0xA0) return pni_consumer_skip_value_not_described(consumer, code);
+  size_t size;
+  if (!pni_consumer_read_size(consumer, code, &size)) return false;
+  if (pni_consumer_remaining(consumer) < size) return false;
+  value->size = size;
+  value->start = (const char *) consumer->output_start + consumer->position;
+  *present = true;
+  consumer->position += size;
+  return true;
+}
+
+static inline bool pni_consumer_read_binary(pni_consumer_t *consumer, pn_bytes_t *value, bool *present)
+{
+  return pni_consumer_read_variable(consumer, PNE_VBIN8 & 0x0F, value, present);
+}
+
+static inline bool pni_consumer_read_string(pni_consumer_t *consumer, pn_bytes_t *value, bool *present)
+{
+  return pni_consumer_read_variable(consumer, PNE_STR8_UTF8 & 0x0F, value, present);
+}
+
+static inline bool pni_consumer_read_symbol(pni_consumer_t *consumer, pn_bytes_t *value, bool *present)
+{
+  return pni_consumer_read_variable(consumer, PNE_SYM8 & 0x0F, value, present);
+}
+
+/* Capture the complete encoding of any value, a null is absent */
+static inline bool pni_consumer_read_raw(pni_consumer_t *consumer, pn_bytes_t *value, bool *present)
+{
+  size_t start = consumer->position;
+  if (!pni_consumer_skip_value(consumer)) return false;
+  if (consumer->output_start[start] == PNE_NULL) return true;
+  value->size = consumer->position - start;
+  value->start = (const char *) consumer->output_start + start;
+  *present = true;
+  return true;
+}
+
+#endif /* consumers.h */
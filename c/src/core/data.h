@@ -27,31 +27,62 @@
 #include "decoder.h"
 #include "encoder.h"
 
-typedef uint16_t pni_nid_t;
+typedef uint32_t pni_nid_t;
 #define PNI_NID_MAX ((pni_nid_t)-1)
 #define PNI_INTERN_MINSIZE 64
 
+/*
+ * The value of a node, 8 bytes. Binary, string and symbol values and the
+ * 16 byte decimal128 and uuid values are kept in the data's buffer and
+ * referred to by offset, so neither growing the buffer nor growing the nodes
+ * moves anything a node refers to. Values decoded by pn_data_decode_borrowed()
+ * are offsets into the decoded bytes instead. List, map and array nodes have
+ * no value and the encoder uses the space to note where their size is to be
+ * filled in.
+ */
+typedef union {
+  bool as_bool;
+  uint8_t as_ubyte;
+  int8_t as_byte;
+  uint16_t as_ushort;
+  int16_t as_short;
+  uint32_t as_uint;
+  int32_t as_int;
+  pn_char_t as_char;
+  uint64_t as_ulong;
+  int64_t as_long;
+  pn_timestamp_t as_timestamp;
+  float as_float;
+  double as_double;
+  pn_decimal32_t as_decimal32;
+  pn_decimal64_t as_decimal64;
+  struct {
+    uint32_t offset;
+    uint32_t size;
+  } as_bytes;
+  uint32_t start;
+} pni_value_t;
+
 typedef struct {
-  char *start;
-  size_t data_offset;
-  size_t data_size;
-  pn_atom_t atom;
-  pn_type_t type;
+  pni_value_t u;
   pni_nid_t next;
   pni_nid_t prev;
   pni_nid_t down;
   pni_nid_t parent;
   pni_nid_t children;
+  int8_t type;        // pn_type_t of the node
   // for arrays
+  int8_t array_type;  // pn_type_t of the elements
   bool described;
-  bool data;
-  bool small;
+  bool small : 1;
+  bool borrowed : 1;  // value refers to the bytes given to pn_data_decode_borrowed()
 } pni_node_t;
 
 struct pn_data_t {
   pni_node_t *nodes;
   pn_buffer_t *buf;
   pn_error_t *error;
+  const char *borrowed;
   pni_nid_t capacity;
   pni_nid_t size;
   pni_nid_t parent;
@@ -65,6 +96,15 @@ static inline pni_node_t * pn_data_node(pn_data_t *data, pni_nid_t nd)
   return nd ? (data->nodes + nd - 1) : NULL;
 }
 
+// The bytes of a node whose value is kept in the data's buffer or borrowed
+static inline pn_bytes_t pni_node_bytes(pn_data_t *data, pni_node_t *node)
+{
+  const char *base = node->borrowed ? data->borrowed : pn_buffer_memory(data->buf).start;
+  return pn_bytes(node->u.as_bytes.size, base + node->u.as_bytes.offset);
+}
+
+pn_atom_t pni_node_atom(pn_data_t *data, pni_node_t *node);
+
 int pni_data_traverse(pn_data_t *data,
                       int (*enter)(void *ctx, pn_data_t *data, pni_node_t *node),
                       int (*exit)(void *ctx, pn_data_t *data, pni_node_t *node),
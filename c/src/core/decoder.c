@@ -39,6 +39,7 @@ void pn_decoder_initialize(pn_decoder_t *decoder)
   decoder->size = 0;
   decoder->position = NULL;
   decoder->error = NULL;
+  decoder->borrow = false;
 }
 
 void pn_decoder_finalize(pn_decoder_t *decoder)
@@ -181,6 +182,7 @@ static int pni_decoder_decode_type(pn_decoder_t *decoder, pn_data_t *data, uint8
 static int pni_decoder_single_described(pn_decoder_t *decoder, pn_data_t *data);
 static int pni_decoder_single(pn_decoder_t *decoder, pn_data_t *data);
 void pni_data_set_array_type(pn_data_t *data, pn_type_t type);
+int pni_data_put_borrowed(pn_data_t *data, pn_type_t type, pn_bytes_t bytes);
 
 static int pni_decoder_decode_value(pn_decoder_t *decoder, pn_data_t *data, uint8_t code)
 {
@@ -323,20 +325,26 @@ static int pni_decoder_decode_value(pn_decoder_t *decoder, pn_data_t *data, uint
     {
       char *start = (char *) decoder->position;
       pn_bytes_t bytes = {size, start};
+      pn_type_t type;
       switch (code & 0x0F)
       {
       case 0x0:
-        err = pn_data_put_binary(data, bytes);
+        type = PN_BINARY;
         break;
       case 0x1:
-        err = pn_data_put_string(data, bytes);
+        type = PN_STRING;
         break;
       case 0x3:
-        err = pn_data_put_symbol(data, bytes);
+        type = PN_SYMBOL;
         break;
       default:
         return PN_ARG_ERR;
       }
+      if (decoder->borrow) {
+        err = pni_data_put_borrowed(data, type, bytes);
+      } else {
+        err = pn_data_put_atom(data, (pn_atom_t) {.type = type, .u.as_bytes = bytes});
+      }
     }
 
     decoder->position += size;
@@ -27,6 +27,7 @@ typedef struct pn_decoder_t {
   size_t size;
   const char *position;
   pn_error_t *error;
+  bool borrow;  // leave binary, string and symbol values in the input
 } pn_decoder_t;
 
 void pn_decoder_initialize(pn_decoder_t *decoder);
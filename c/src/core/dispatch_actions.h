@@ -23,6 +23,7 @@
  */
 
 #include "dispatcher.h"
+#include "performatives.h"
 
 #define AMQP_FRAME_TYPE (0)
 #define SASL_FRAME_TYPE (1)
@@ -32,13 +33,15 @@
 int pn_do_open(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload);
 int pn_do_begin(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload);
 int pn_do_attach(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload);
-int pn_do_transfer(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload);
-int pn_do_flow(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload);
-int pn_do_disposition(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload);
 int pn_do_detach(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload);
 int pn_do_end(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload);
 int pn_do_close(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload);
 
+/* AMQP actions decoded directly from the frame, see performatives.h */
+int pn_do_flow(pn_transport_t *transport, uint16_t channel, const pni_amqp_flow_t *flow);
+int pn_do_transfer(pn_transport_t *transport, uint16_t channel, const pni_amqp_transfer_t *transfer, const pn_bytes_t *payload);
+int pn_do_disposition(pn_transport_t *transport, uint16_t channel, const pni_amqp_disposition_t *disposition);
+
 /* SASL actions */
 int pn_do_init(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload);
 int pn_do_mechanisms(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload);
@@ -50,9 +50,6 @@ static inline int pni_dispatch_action(pn_transport_t* transport, uint64_t lcode,
     case OPEN:            action = pn_do_open; break;
     case BEGIN:           action = pn_do_begin; break;
     case ATTACH:          action = pn_do_attach; break;
-    case FLOW:            action = pn_do_flow; break;
-    case TRANSFER:        action = pn_do_transfer; break;
-    case DISPOSITION:     action = pn_do_disposition; break;
     case DETACH:          action = pn_do_detach; break;
     case END:             action = pn_do_end; break;
     case CLOSE:           action = pn_do_close; break;
@@ -75,6 +72,48 @@ static inline int pni_dispatch_action(pn_transport_t* transport, uint64_t lcode,
   return action(transport, frame_type, channel, args, payload);
 }
 
+// The performatives that carry message traffic are decoded straight from the
+// frame into the structs generated in performatives.h rather than through args
+static int pni_dispatch_direct(pn_transport_t *transport, pn_data_t *args, pn_frame_t frame, uint64_t lcode, pni_consumer_t *consumer)
+{
+  union {
+    pni_amqp_flow_t flow;
+    pni_amqp_transfer_t transfer;
+    pni_amqp_disposition_t disposition;
+  } performative;
+  bool decoded;
+  switch (lcode) {
+  case FLOW:        decoded = pni_amqp_decode_flow(consumer, &performative.flow); break;
+  case TRANSFER:    decoded = pni_amqp_decode_transfer(consumer, &performative.transfer); break;
+  case DISPOSITION: decoded = pni_amqp_decode_disposition(consumer, &performative.disposition); break;
+  default:          decoded = false; break;
+  }
+  if (!decoded) {
+    pn_string_format(transport->scratch, "Error decoding frame: %s\n", pn_code(PN_ARG_ERR));
+    pn_quote(transport->scratch, frame.payload, frame.size);
+    PN_LOG(&transport->logger, PN_SUBSYSTEM_AMQP, PN_LEVEL_ERROR, pn_string_get(transport->scratch));
+    return PN_ARG_ERR;
+  }
+
+  size_t dsize = consumer->position;
+  size_t payload_size = frame.size - dsize;
+  const char *payload_mem = payload_size ? frame.payload + dsize : NULL;
+  pn_bytes_t payload = {payload_size, payload_mem};
+
+  // Only build the generic form of the performative if it is going to be logged
+  if (PN_SHOULD_LOG(&transport->logger, PN_SUBSYSTEM_AMQP, PN_LEVEL_FRAME)) {
+    pn_data_decode_borrowed(args, frame.payload, dsize);
+    pn_do_trace(transport, frame.channel, IN, args, payload_mem, payload_size);
+    pn_data_clear(args);
+  }
+
+  switch (lcode) {
+  case FLOW:        return pn_do_flow(transport, frame.channel, &performative.flow);
+  case TRANSFER:    return pn_do_transfer(transport, frame.channel, &performative.transfer, &payload);
+  default:          return pn_do_disposition(transport, frame.channel, &performative.disposition);
+  }
+}
+
 static int pni_dispatch_frame(pn_transport_t * transport, pn_data_t *args, pn_frame_t frame)
 {
   if (frame.size == 0) { // ignore null frames
@@ -82,13 +121,29 @@ static int pni_dispatch_frame(pn_transport_t * transport, pn_data_t *args, pn_fr
     return 0;
   }
 
-  ssize_t dsize = pn_data_decode(args, frame.payload, frame.size);
+  if (frame.type == AMQP_FRAME_TYPE) {
+    pni_consumer_t consumer = make_consumer_from_bytes((pn_bytes_t){frame.size, frame.payload});
+    uint64_t lcode;
+    if (pni_consumer_read_descriptor(&consumer, &lcode)) {
+      switch (lcode) {
+      case FLOW:
+      case TRANSFER:
+      case DISPOSITION:
+        return pni_dispatch_direct(transport, args, frame, lcode, &consumer);
+      }
+    }
+  }
+
+  // The strings and binaries in args point into the frame, so args must be
+  // cleared before returning
+  ssize_t dsize = pn_data_decode_borrowed(args, frame.payload, frame.size);
   if (dsize < 0) {
     pn_string_format(transport->scratch,
                      "Error decoding frame: %s %s\n", pn_code(dsize),
                      pn_error_text(pn_data_error(args)));
     pn_quote(transport->scratch, frame.payload, frame.size);
     PN_LOG(&transport->logger, PN_SUBSYSTEM_AMQP, PN_LEVEL_ERROR, pn_string_get(transport->scratch));
+    pn_data_clear(args);
     return dsize;
   }
 
@@ -101,10 +156,12 @@ static int pni_dispatch_frame(pn_transport_t * transport, pn_data_t *args, pn_fr
   int e = pn_data_scan(args, "D?L.", &scanned, &lcode);
   if (e) {
     PN_LOG(&transport->logger, PN_SUBSYSTEM_AMQP, PN_LEVEL_ERROR, "Scan error");
+    pn_data_clear(args);
     return e;
   }
   if (!scanned) {
     PN_LOG(&transport->logger, PN_SUBSYSTEM_AMQP, PN_LEVEL_ERROR, "Error dispatching frame");
+    pn_data_clear(args);
     return PN_ERR;
   }
   size_t payload_size = frame.size - dsize;
@@ -149,8 +206,5 @@ ssize_t pn_dispatcher_input(pn_transport_t *transport, const char *bytes, size_t
 
 ssize_t pn_dispatcher_output(pn_transport_t *transport, char *bytes, size_t size)
 {
-    int n = pn_buffer_get(transport->output_buffer, 0, size, bytes);
-    pn_buffer_trim(transport->output_buffer, n, 0);
-    // XXX: need to check for errors
-    return n;
+    return pni_output_queue_read(&transport->output_queue, bytes, size);
 }
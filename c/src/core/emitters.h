@@ -0,0 +1,203 @@
+#ifndef PROTON_EMITTERS_H
+#define PROTON_EMITTERS_H 1
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "encodings.h"
+
+#include <proton/type_compat.h>
+#include <proton/types.h>
+
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Writes AMQP encoded values straight into a byte range without building a
+ * pn_data_t. This is what the generated performative encoders in
+ * performatives.h are built on.
+ *
+ * The encodings chosen are the ones pn_data_encode() would choose for the
+ * same values, so frames are the same whichever way they were built. The
+ * pni_emitter_size_*() functions give the encoded size of a value so the
+ * space needed can be worked out before anything is written: the writers
+ * themselves do no bounds checking.
+ */
+typedef struct {
+  char *output_start;
+  size_t size;
+  size_t position;
+} pni_emitter_t;
+
+static inline pni_emitter_t make_emitter_from_bytes(pn_rwbytes_t bytes)
+{
+  pni_emitter_t emitter;
+  emitter.output_start = bytes.start;
+  emitter.size = bytes.size;
+  emitter.position = 0;
+  return emitter;
+}
+
+static inline void pni_emitter_writef8(pni_emitter_t *emitter, uint8_t value)
+{
+  emitter->output_start[emitter->position++] = value;
+}
+
+static inline void pni_emitter_writef16(pni_emitter_t *emitter, uint16_t value)
+{
+  char *p = &emitter->output_start[emitter->position];
+  p[0] = 0xFF & (value >> 8);
+  p[1] = 0xFF & (value     );
+  emitter->position += 2;
+}
+
+static inline void pni_emitter_writef32(pni_emitter_t *emitter, uint32_t value)
+{
+  char *p = &emitter->output_start[emitter->position];
+  p[0] = 0xFF & (value >> 24);
+  p[1] = 0xFF & (value >> 16);
+  p[2] = 0xFF & (value >>  8);
+  p[3] = 0xFF & (value      );
+  emitter->position += 4;
+}
+
+static inline void pni_emitter_writef64(pni_emitter_t *emitter, uint64_t value)
+{
+  pni_emitter_writef32(emitter, value >> 32);
+  pni_emitter_writef32(emitter, value);
+}
+
+static inline void pni_emitter_write_bytes(pni_emitter_t *emitter, pn_bytes_t bytes)
+{
+  if (bytes.size) memcpy(&emitter->output_start[emitter->position], bytes.start, bytes.size);
+  emitter->position += bytes.size;
+}
+
+/* Sizes of encoded values */
+static inline size_t pni_emitter_size_null(void) { return 1; }
+static inline size_t pni_emitter_size_bool(bool value) { return 1; }
+static inline size_t pni_emitter_size_ubyte(uint8_t value) { return 2; }
+static inline size_t pni_emitter_size_ushort(uint16_t value) { return 3; }
+static inline size_t pni_emitter_size_uint(uint32_t value) { return value < 256 ? 2 : 5; }
+static inline size_t pni_emitter_size_ulong(uint64_t value) { return value < 256 ? 2 : 9; }
+static inline size_t pni_emitter_size_binary(pn_bytes_t value) { return (value.size < 256 ? 2 : 5) + value.size; }
+static inline size_t pni_emitter_size_string(pn_bytes_t value) { return pni_emitter_size_binary(value); }
+static inline size_t pni_emitter_size_symbol(pn_bytes_t value) { return pni_emitter_size_binary(value); }
+static inline size_t pni_emitter_size_raw(pn_bytes_t value) { return value.size; }
+
+/* A list is always written with a 32 bit size and count, unless empty */
+static inline size_t pni_emitter_size_described_list(uint64_t descriptor, size_t fields_size, uint32_t count)
+{
+  return 1 + pni_emitter_size_ulong(descriptor) + (count ? 9 + fields_size : 1);
+}
+
+static inline void pni_emitter_write_null(pni_emitter_t *emitter)
+{
+  pni_emitter_writef8(emitter, PNE_NULL);
+}
+
+static inline void pni_emitter_write_bool(pni_emitter_t *emitter, bool value)
+{
+  pni_emitter_writef8(emitter, value ? PNE_TRUE : PNE_FALSE);
+}
+
+static inline void pni_emitter_write_ubyte(pni_emitter_t *emitter, uint8_t value)
+{
+  pni_emitter_writef8(emitter, PNE_UBYTE);
+  pni_emitter_writef8(emitter, value);
+}
+
+static inline void pni_emitter_write_ushort(pni_emitter_t *emitter, uint16_t value)
+{
+  pni_emitter_writef8(emitter, PNE_USHORT);
+  pni_emitter_writef16(emitter, value);
+}
+
+static inline void pni_emitter_write_uint(pni_emitter_t *emitter, uint32_t value)
+{
+  if (value < 256) {
+    pni_emitter_writef8(emitter, PNE_SMALLUINT);
+    pni_emitter_writef8(emitter, value);
+  } else {
+    pni_emitter_writef8(emitter, PNE_UINT);
+    pni_emitter_writef32(emitter, value);
+  }
+}
+
+static inline void pni_emitter_write_ulong(pni_emitter_t *emitter, uint64_t value)
+{
+  if (value < 256) {
+    pni_emitter_writef8(emitter, PNE_SMALLULONG);
+    pni_emitter_writef8(emitter, value);
+  } else {
+    pni_emitter_writef8(emitter, PNE_ULONG);
+    pni_emitter_writef64(emitter, value);
+  }
+}
+
+static inline void pni_emitter_write_variable(pni_emitter_t *emitter, uint8_t code8, uint8_t code32, pn_bytes_t value)
+{
+  if (value.size < 256) {
+    pni_emitter_writef8(emitter, code8);
+    pni_emitter_writef8(emitter, value.size);
+  } else {
+    pni_emitter_writef8(emitter, code32);
+    pni_emitter_writef32(emitter, value.size);
+  }
+  pni_emitter_write_bytes(emitter, value);
+}
+
+static inline void pni_emitter_write_binary(pni_emitter_t *emitter, pn_bytes_t value)
+{
+  pni_emitter_write_variable(emitter, PNE_VBIN8, PNE_VBIN32, value);
+}
+
+static inline void pni_emitter_write_string(pni_emitter_t *emitter, pn_bytes_t value)
+{
+  pni_emitter_write_variable(emitter, PNE_STR8_UTF8, PNE_STR32_UTF8, value);
+}
+
+static inline void pni_emitter_write_symbol(pni_emitter_t *emitter, pn_bytes_t value)
+{
+  pni_emitter_write_variable(emitter, PNE_SYM8, PNE_SYM32, value);
+}
+
+/* Copy a value that is already encoded */
+static inline void pni_emitter_write_raw(pni_emitter_t *emitter, pn_bytes_t value)
+{
+  pni_emitter_write_bytes(emitter, value);
+}
+
+/* Write a descriptor and the header of the list it describes, fields_size is the size of the elements */
+static inline void pni_emitter_write_described_list(pni_emitter_t *emitter, uint64_t descriptor, size_t fields_size, uint32_t count)
+{
+  pni_emitter_writef8(emitter, PNE_DESCRIPTOR);
+  pni_emitter_write_ulong(emitter, descriptor);
+  if (count) {
+    pni_emitter_writef8(emitter, PNE_LIST32);
+    pni_emitter_writef32(emitter, 4 + fields_size);
+    pni_emitter_writef32(emitter, count);
+  } else {
+    pni_emitter_writef8(emitter, PNE_LIST0);
+  }
+}
+
+#endif /* emitters.h */
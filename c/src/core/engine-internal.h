@@ -28,6 +28,7 @@
 
 #include "buffer.h"
 #include "dispatcher.h"
+#include "output_queue.h"
 #include "logger_private.h"
 #include "util.h"
 
@@ -39,6 +40,16 @@ typedef enum pn_endpoint_type_t {CONNECTION, SESSION, SENDER, RECEIVER} pn_endpo
 
 typedef struct pn_endpoint_t pn_endpoint_t;
 
+// Endpoints modified since the transport last processed them are kept
+// on a separate list for each kind, so that every phase of output
+// processing only visits the endpoints it can act on.
+typedef enum {PNI_DIRTY_CONNECTION, PNI_DIRTY_SESSION, PNI_DIRTY_LINK, PNI_DIRTY_KINDS} pni_dirty_kind_t;
+
+typedef struct pni_dirty_list_t {
+  pn_endpoint_t *transport_head;  // reference counted
+  pn_endpoint_t *transport_tail;
+} pni_dirty_list_t;
+
 struct pn_condition_t {
   pn_string_t *name;
   pn_string_t *description;
@@ -65,13 +76,46 @@ typedef struct {
   bool sending;
   bool sent;
   bool init;
+  bool disp_pending;  // covered by a range not yet sent
 } pn_delivery_state_t;
 
+// Deliveries in flight by delivery-id. Ids are allocated in sequence, so
+// they are kept in a ring indexed by the low bits of the id that holds
+// every id from base up to next. The ring has a bounded size; when it is
+// full the oldest deliveries move to a hash so that a few long unsettled
+// deliveries cannot make the ring grow with the id span.
 typedef struct {
+  const pn_class_t *clazz;  // class and object the ring is allocated for
+  void *object;
+  pn_delivery_t **ring;
+  pn_hash_t *spilled;       // deliveries with ids before base, may be NULL
+  uint32_t capacity;        // zero or a power of two
+  uint32_t size;            // deliveries in the ring
+  pn_sequence_t base;       // no smaller id is in the ring
   pn_sequence_t next;
-  pn_hash_t *deliveries;
 } pn_delivery_map_t;
 
+// A run of delivery ids with the same outcome and no outcome fields
+typedef struct {
+  uint64_t code;
+  pn_sequence_t first;
+  pn_sequence_t last;
+  bool settled;
+  bool role;
+} pni_disp_range_t;
+
+// Dispositions waiting to be sent as ranges, sorted by outcome and then
+// by id. Ranges never overlap and adjacent ranges of one outcome merge.
+typedef struct {
+  const pn_class_t *clazz;  // class and object the ranges are allocated for
+  void *object;
+  pni_disp_range_t *ranges;
+  size_t count;
+  size_t capacity;
+  size_t deliveries;        // deliveries covered by the ranges
+  pn_timestamp_t deadline;  // set by the first tick while ranges are held
+} pni_disp_set_t;
+
 typedef struct {
   // XXX: stop using negative numbers
   uint32_t local_handle;
@@ -85,21 +129,16 @@ typedef struct {
   pn_delivery_map_t outgoing;
   pn_hash_t *local_handles;
   pn_hash_t *remote_handles;
-  uint64_t disp_code;
+  pni_disp_set_t disp;
   pn_sequence_t incoming_transfer_count;
   pn_sequence_t incoming_window;
   pn_sequence_t remote_incoming_window;
   pn_sequence_t outgoing_transfer_count;
   pn_sequence_t outgoing_window;
-  pn_sequence_t disp_first;
-  pn_sequence_t disp_last;
   // XXX: stop using negative numbers
   uint16_t local_channel;
   uint16_t remote_channel;
   bool incoming_init;
-  bool disp;
-  bool disp_settled;
-  bool disp_type;
 } pn_session_state_t;
 
 typedef struct pn_io_layer_t {
@@ -169,15 +208,21 @@ struct pn_transport_t {
   pn_data_t *args;
   pn_data_t *output_args;
   pn_buffer_t *frame;  // frame under construction
+  pn_buffer_t *encoded_state;  // delivery-state for the performative under construction
 
-  // Temporary - ??
-  pn_buffer_t *output_buffer;
+  /* frames posted but not yet passed to the io layers */
+  pni_output_queue_t output_queue;
 
   /* statistics */
   uint64_t bytes_input;
   uint64_t bytes_output;
   uint64_t output_frames_ct;
   uint64_t input_frames_ct;
+  uint64_t disp_frames_saved;
+
+  /* disposition coalescing */
+  pn_millis_t disp_delay;
+  size_t disp_batch;
 
   /* output buffered for send */
   #define PN_TRANSPORT_INITIAL_BUFFER_SIZE (8*1024)
@@ -231,8 +276,7 @@ struct pn_connection_t {
   pn_endpoint_t endpoint;
   pn_endpoint_t *endpoint_head;
   pn_endpoint_t *endpoint_tail;
-  pn_endpoint_t *transport_head;  // reference counted
-  pn_endpoint_t *transport_tail;
+  pni_dirty_list_t dirty[PNI_DIRTY_KINDS];
   pn_list_t *sessions;
   pn_list_t *freed;
   pn_transport_t *transport;
@@ -296,6 +340,7 @@ struct pn_link_t {
   pn_delivery_t *unsettled_head;
   pn_delivery_t *unsettled_tail;
   pn_delivery_t *current;
+  pn_delivery_t *advanced; // receiver only, kept bytes of the delivery last advanced past
   pn_record_t *context;
   pn_data_t *properties;
   pn_data_t *remote_properties;
@@ -350,6 +395,7 @@ struct pn_delivery_t {
   bool done;
   bool referenced;
   bool aborted;
+  bool keep; // receiver only, keep the bytes when the link advances past it
 };
 
 #define PN_SET_LOCAL(OLD, NEW)                                          \
@@ -378,7 +424,11 @@ void pn_session_unbound(pn_session_t* ssn);
 void pn_link_unbound(pn_link_t* link);
 void pn_ep_incref(pn_endpoint_t *endpoint);
 void pn_ep_decref(pn_endpoint_t *endpoint);
+pn_rwbytes_t pni_link_send_space(pn_link_t *sender, size_t size);
+ssize_t pni_link_send_written(pn_link_t *sender, size_t n);
 
+size_t pni_transport_write_buffers(pn_transport_t *transport, pn_bytes_t *buffers, size_t n);
+PN_EXTERN size_t pni_transport_produced_buffers(pn_transport_t *transport, pn_bytes_t *buffers, size_t n);
 int pn_post_frame(pn_transport_t *transport, uint8_t type, uint16_t ch, const char *fmt, ...);
 
 typedef enum {IN, OUT} pn_dir_t;
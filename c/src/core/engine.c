@@ -26,6 +26,7 @@
 
 #include "framing.h"
 #include "memory.h"
+#include "message-internal.h"
 #include "platform/platform.h"
 #include "platform/platform_fmt.h"
 #include "protocol.h"
@@ -171,8 +172,10 @@ void pn_connection_unbound(pn_connection_t *connection)
     // connection has been freed prior to unbinding, thus it
     // cannot be re-assigned to a new transport.  Clear the
     // transport work lists to allow the connection to be freed.
-    while (connection->transport_head) {
-        pn_clear_modified(connection, connection->transport_head);
+    for (int kind = 0; kind < PNI_DIRTY_KINDS; kind++) {
+      while (connection->dirty[kind].transport_head) {
+        pn_clear_modified(connection, connection->dirty[kind].transport_head);
+      }
     }
     while (connection->tpwork_head) {
       pn_clear_tpwork(connection->tpwork_head);
@@ -522,8 +525,10 @@ pn_connection_t *pn_connection()
   conn->endpoint_head = NULL;
   conn->endpoint_tail = NULL;
   pn_endpoint_init(&conn->endpoint, CONNECTION, conn);
-  conn->transport_head = NULL;
-  conn->transport_tail = NULL;
+  for (int kind = 0; kind < PNI_DIRTY_KINDS; kind++) {
+    conn->dirty[kind].transport_head = NULL;
+    conn->dirty[kind].transport_tail = NULL;
+  }
   conn->sessions = pn_list(PN_WEAKREF, 0);
   conn->freed = pn_list(PN_WEAKREF, 0);
   conn->transport = NULL;
@@ -762,21 +767,33 @@ void pn_clear_tpwork(pn_delivery_t *delivery)
 
 void pn_dump(pn_connection_t *conn)
 {
-  pn_endpoint_t *endpoint = conn->transport_head;
-  while (endpoint)
-  {
-    printf("%p", (void *) endpoint);
-    endpoint = endpoint->transport_next;
-    if (endpoint)
-      printf(" -> ");
+  for (int kind = 0; kind < PNI_DIRTY_KINDS; kind++) {
+    pn_endpoint_t *endpoint = conn->dirty[kind].transport_head;
+    while (endpoint)
+    {
+      printf("%p", (void *) endpoint);
+      endpoint = endpoint->transport_next;
+      if (endpoint)
+        printf(" -> ");
+    }
+    printf("\n");
+  }
+}
+
+static inline pni_dirty_list_t *pni_dirty_list(pn_connection_t *connection, pn_endpoint_t *endpoint)
+{
+  switch (endpoint->type) {
+  case CONNECTION: return &connection->dirty[PNI_DIRTY_CONNECTION];
+  case SESSION: return &connection->dirty[PNI_DIRTY_SESSION];
+  default: return &connection->dirty[PNI_DIRTY_LINK];
   }
-  printf("\n");
 }
 
 void pn_modified(pn_connection_t *connection, pn_endpoint_t *endpoint, bool emit)
 {
   if (!endpoint->modified) {
-    LL_ADD(connection, transport, endpoint);
+    pni_dirty_list_t *dirty = pni_dirty_list(connection, endpoint);
+    LL_ADD(dirty, transport, endpoint);
     endpoint->modified = true;
   }
 
@@ -789,7 +806,8 @@ void pn_modified(pn_connection_t *connection, pn_endpoint_t *endpoint, bool emit
 void pn_clear_modified(pn_connection_t *connection, pn_endpoint_t *endpoint)
 {
   if (endpoint->modified) {
-    LL_REMOVE(connection, transport, endpoint);
+    pni_dirty_list_t *dirty = pni_dirty_list(connection, endpoint);
+    LL_REMOVE(dirty, transport, endpoint);
     endpoint->transport_next = NULL;
     endpoint->transport_prev = NULL;
     endpoint->modified = false;
@@ -942,7 +960,8 @@ static bool pni_preserve_child(pn_endpoint_t *endpoint)
     pn_decref(parent);
     return true;
   } else {
-    LL_REMOVE(conn, transport, endpoint);
+    pni_dirty_list_t *dirty = pni_dirty_list(conn, endpoint);
+    LL_REMOVE(dirty, transport, endpoint);
     return false;
   }
 }
@@ -961,6 +980,7 @@ static void pn_session_finalize(void *object)
   pni_endpoint_tini(endpoint);
   pn_delivery_map_free(&session->state.incoming);
   pn_delivery_map_free(&session->state.outgoing);
+  pni_disp_set_free(&session->state.disp);
   pn_free(session->state.local_handles);
   pn_free(session->state.remote_handles);
   pni_remove_session(session->connection, session);
@@ -1010,8 +1030,9 @@ pn_session_t *pn_session(pn_connection_t *conn)
   memset(&ssn->state, 0, sizeof(ssn->state));
   ssn->state.local_channel = (uint16_t)-1;
   ssn->state.remote_channel = (uint16_t)-1;
-  pn_delivery_map_init(&ssn->state.incoming, 0);
-  pn_delivery_map_init(&ssn->state.outgoing, 0);
+  pn_delivery_map_init(&ssn->state.incoming, &clazz, ssn, 0);
+  pn_delivery_map_init(&ssn->state.outgoing, &clazz, ssn, 0);
+  pni_disp_set_init(&ssn->state.disp, &clazz, ssn);
   ssn->state.local_handles = pn_hash(PN_WEAKREF, 0, 0.75);
   ssn->state.remote_handles = pn_hash(PN_WEAKREF, 0, 0.75);
   // end transport state
@@ -1171,6 +1192,7 @@ pn_link_t *pn_link_new(int type, pn_session_t *session, const char *name)
   pni_terminus_init(&link->remote_source, PN_UNSPECIFIED);
   pni_terminus_init(&link->remote_target, PN_UNSPECIFIED);
   link->unsettled_head = link->unsettled_tail = link->current = NULL;
+  link->advanced = NULL;
   link->unsettled_count = 0;
   link->max_message_size = 0;
   link->remote_max_message_size = 0;
@@ -1436,6 +1458,18 @@ static bool pni_preserve_delivery(pn_delivery_t *delivery)
   return !delivery->local.settled || (conn->transport && (delivery->state.init || delivery->tpwork));
 }
 
+// Drop the bytes a receiver kept of the delivery it last advanced past, they
+// stopped counting against the session's incoming capacity at the advance
+static void pni_release_advanced(pn_link_t *link)
+{
+  pn_delivery_t *advanced = link->advanced;
+  if (advanced) {
+    pn_buffer_clear(advanced->bytes);
+    advanced->keep = false;
+    link->advanced = NULL;
+  }
+}
+
 static void pn_delivery_finalize(void *object)
 {
   pn_delivery_t *delivery = (pn_delivery_t *) object;
@@ -1455,6 +1489,7 @@ static void pn_delivery_finalize(void *object)
 
     pn_clear_tpwork(delivery);
     LL_REMOVE(link, unsettled, delivery);
+    if (link->advanced == delivery) pni_release_advanced(link);
     pn_delivery_map_del(pn_link_is_sender(link)
                         ? &link->session->state.outgoing
                         : &link->session->state.incoming,
@@ -1570,6 +1605,7 @@ pn_delivery_t *pn_delivery(pn_link_t *link, pn_delivery_tag_t tag)
   pn_buffer_clear(delivery->bytes);
   delivery->done = false;
   delivery->aborted = false;
+  delivery->keep = false;
   pn_record_clear(delivery->context);
 
   // begin delivery state
@@ -1780,7 +1816,14 @@ static void pni_advance_receiver(pn_link_t *link)
 
   pn_delivery_t *current = link->current;
   link->session->incoming_bytes -= pn_buffer_size(current->bytes);
-  pn_buffer_clear(current->bytes);
+  pni_release_advanced(link);
+  // A delivery with a message view open keeps its bytes until the next
+  // advance so that the view stays valid, see pn_message_view_recv()
+  if (current->keep) {
+    link->advanced = current;
+  } else {
+    pn_buffer_clear(current->bytes);
+  }
 
   if (!link->session->state.incoming_window) {
     pni_add_tpwork(current);
@@ -1876,6 +1919,7 @@ void pn_delivery_settle(pn_delivery_t *delivery)
     if (pn_delivery_current(delivery)) {
       pn_link_advance(link);
     }
+    if (link->advanced == delivery) pni_release_advanced(link);
 
     link->unsettled_count--;
     delivery->local.settled = true;
@@ -1902,6 +1946,27 @@ ssize_t pn_link_send(pn_link_t *sender, const char *bytes, size_t n)
   return n;
 }
 
+// Space at the end of the current delivery for the caller to write up to
+// size bytes into in place, followed by pni_link_send_written()
+pn_rwbytes_t pni_link_send_space(pn_link_t *sender, size_t size)
+{
+  pn_delivery_t *current = pn_link_current(sender);
+  if (!current) return pn_rwbytes(0, NULL);
+  return pn_buffer_free_memory(current->bytes, size);
+}
+
+ssize_t pni_link_send_written(pn_link_t *sender, size_t n)
+{
+  pn_delivery_t *current = pn_link_current(sender);
+  if (!current) return PN_EOS;
+  if (!n) return 0;
+  int err = pn_buffer_extend(current->bytes, n);
+  if (err) return err;
+  sender->session->outgoing_bytes += n;
+  pni_add_tpwork(current);
+  return n;
+}
+
 int pn_link_drained(pn_link_t *link)
 {
   assert(link);
@@ -2087,9 +2152,21 @@ size_t pn_delivery_pending(pn_delivery_t *delivery)
      the PN_ABORTED error return code.
   */
   if (delivery->aborted) return 1;
+  if (delivery->link && delivery->link->advanced == delivery) return 0;
   return pn_buffer_size(delivery->bytes);
 }
 
+void pni_delivery_keep_bytes(pn_delivery_t *delivery)
+{
+  delivery->keep = true;
+}
+
+void pni_delivery_drop_bytes(pn_delivery_t *delivery)
+{
+  pn_link_t *link = delivery->link;
+  if (link && link->advanced == delivery) pni_release_advanced(link);
+}
+
 bool pn_delivery_partial(pn_delivery_t *delivery)
 {
   return !delivery->done;
@@ -55,7 +55,7 @@ pn_error_t *pn_error()
 void pn_error_free(pn_error_t *error)
 {
   if (error) {
-    pni_mem_subdeallocate(PN_CLASSCLASS(pn_error), error, error->text);
+    free(error->text);
     pni_mem_deallocate(PN_CLASSCLASS(pn_error), error);
   }
 }
@@ -64,7 +64,7 @@ void pn_error_clear(pn_error_t *error)
 {
   if (error) {
     error->code = 0;
-    pni_mem_subdeallocate(PN_CLASSCLASS(pn_error), error, error->text);
+    free(error->text);
     error->text = NULL;
   }
 }
@@ -18,17 +18,43 @@
  * under the License.
  *
  */
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <proton/error.h>
 #include <proton/object.h>
 #include <proton/event.h>
 #include <proton/reactor.h>
 #include <assert.h>
 
+#include "memory.h"
+
+extern const pn_class_t PN_CLASSCLASS(pn_collector)[];
+
+/* Contexts pinned since the collector was last empty, remembered in a small
+   direct mapped cache so a context is normally pinned once per batch. */
+#define PNI_PIN_CACHE 32
+
+typedef struct {
+  const pn_class_t *clazz;
+  void *context;
+} pni_pin_t;
+
 struct pn_collector_t {
   pn_list_t *pool;
   pn_event_t *head;
   pn_event_t *tail;
   pn_event_t *prev;         /* event returned by previous call to pn_collector_next() */
+  /* Ring mode, see pn_collector_ring(): events are reused in place without
+     being reference counted, ring[first] is the oldest event still in use. */
+  pn_event_t **ring;
+  size_t capacity;
+  size_t first;
+  size_t used;
+  pni_pin_t *pins;
+  size_t pin_count;
+  size_t pin_capacity;
+  void *pinned[PNI_PIN_CACHE];
   bool freed;
 };
 
@@ -47,6 +73,14 @@ static void pn_collector_initialize(pn_collector_t *collector)
   collector->head = NULL;
   collector->tail = NULL;
   collector->prev = NULL;
+  collector->ring = NULL;
+  collector->capacity = 0;
+  collector->first = 0;
+  collector->used = 0;
+  collector->pins = NULL;
+  collector->pin_count = 0;
+  collector->pin_capacity = 0;
+  memset(collector->pinned, 0, sizeof(collector->pinned));
   collector->freed = false;
 }
 
@@ -59,15 +93,40 @@ void pn_collector_drain(pn_collector_t *collector)
   assert(!collector->tail);
 }
 
+static void pni_ring_free(pn_collector_t *collector)
+{
+  for (size_t i = 0; i < collector->capacity; i++) {
+    pn_event_t *event = collector->ring[i];
+    if (event) {
+      /* The context was pinned by the batch, not by the event */
+      event->clazz = NULL;
+      event->context = NULL;
+      pn_decref(event);
+    }
+  }
+  pni_mem_subdeallocate(PN_CLASSCLASS(pn_collector), collector, collector->ring);
+  pni_mem_subdeallocate(PN_CLASSCLASS(pn_collector), collector, collector->pins);
+  collector->ring = NULL;
+  collector->pins = NULL;
+  collector->capacity = 0;
+  collector->pin_capacity = 0;
+}
+
 static void pn_collector_shrink(pn_collector_t *collector)
 {
   assert(collector);
   pn_list_clear(collector->pool);
+  if (collector->ring) {
+    pni_ring_free(collector);
+  }
 }
 
 static void pn_collector_finalize(pn_collector_t *collector)
 {
   pn_collector_drain(collector);
+  if (collector->ring) {
+    pni_ring_free(collector);
+  }
   pn_decref(collector->pool);
 }
 
@@ -121,6 +180,114 @@ void pn_collector_release(pn_collector_t *collector)
 
 pn_event_t *pn_event(void);
 
+int pn_collector_ring(pn_collector_t *collector, size_t capacity)
+{
+  assert(collector);
+  if (collector->ring || collector->head || collector->prev || collector->freed) {
+    return PN_STATE_ERR;
+  }
+  if (capacity == 0) {
+    return PN_ARG_ERR;
+  }
+  collector->ring = (pn_event_t **) pni_mem_suballocate(PN_CLASSCLASS(pn_collector), collector, capacity * sizeof(pn_event_t *));
+  collector->pins = (pni_pin_t *) pni_mem_suballocate(PN_CLASSCLASS(pn_collector), collector, capacity * sizeof(pni_pin_t));
+  if (!collector->ring || !collector->pins) {
+    pni_mem_subdeallocate(PN_CLASSCLASS(pn_collector), collector, collector->ring);
+    pni_mem_subdeallocate(PN_CLASSCLASS(pn_collector), collector, collector->pins);
+    collector->ring = NULL;
+    collector->pins = NULL;
+    return PN_OUT_OF_MEMORY;
+  }
+  memset(collector->ring, 0, capacity * sizeof(pn_event_t *));
+  collector->capacity = capacity;
+  collector->pin_capacity = capacity;
+  collector->first = 0;
+  collector->used = 0;
+  return 0;
+}
+
+// Double the ring when every slot is in use, keeping the events in order.
+static bool pni_ring_grow(pn_collector_t *collector)
+{
+  size_t capacity = 2 * collector->capacity;
+  pn_event_t **ring = (pn_event_t **) pni_mem_suballocate(PN_CLASSCLASS(pn_collector), collector, capacity * sizeof(pn_event_t *));
+  if (!ring) return false;
+  for (size_t i = 0; i < collector->capacity; i++) {
+    ring[i] = collector->ring[(collector->first + i) % collector->capacity];
+  }
+  memset(ring + collector->capacity, 0, collector->capacity * sizeof(pn_event_t *));
+  pni_mem_subdeallocate(PN_CLASSCLASS(pn_collector), collector, collector->ring);
+  collector->ring = ring;
+  collector->capacity = capacity;
+  collector->first = 0;
+  return true;
+}
+
+static pn_event_t *pni_ring_take(pn_collector_t *collector)
+{
+  if (collector->used == collector->capacity && !pni_ring_grow(collector)) {
+    return NULL;
+  }
+  size_t slot = (collector->first + collector->used) % collector->capacity;
+  pn_event_t *event = collector->ring[slot];
+  if (!event) {
+    event = pn_event();
+    if (!event) return NULL;
+    collector->ring[slot] = event;
+  }
+  collector->used++;
+  return event;
+}
+
+// Pin the context for the rest of the batch unless it already is.
+static bool pni_pin(pn_collector_t *collector, const pn_class_t *clazz, void *context)
+{
+  void **cached = &collector->pinned[((uintptr_t) context >> 4) % PNI_PIN_CACHE];
+  if (*cached == context) {
+    return true;
+  }
+  if (collector->pin_count == collector->pin_capacity) {
+    size_t capacity = 2 * collector->pin_capacity;
+    pni_pin_t *pins = (pni_pin_t *) pni_mem_subreallocate(PN_CLASSCLASS(pn_collector), collector, collector->pins, capacity * sizeof(pni_pin_t));
+    if (!pins) return false;
+    collector->pins = pins;
+    collector->pin_capacity = capacity;
+  }
+  pni_pin_t *pin = &collector->pins[collector->pin_count++];
+  pin->clazz = clazz;
+  pin->context = context;
+  pn_class_incref(clazz, context);
+  *cached = context;
+  return true;
+}
+
+// The batch is over once no event is in use: release the pinned contexts.
+// Releasing a context may queue more events, which pin theirs afresh.
+static void pni_unpin(pn_collector_t *collector)
+{
+  size_t count = collector->pin_count;
+  memset(collector->pinned, 0, sizeof(collector->pinned));
+  for (size_t i = 0; i < count; i++) {
+    pni_pin_t pin = collector->pins[i];
+    pn_class_decref(pin.clazz, pin.context);
+  }
+  collector->pin_count -= count;
+  memmove(collector->pins, collector->pins + count, collector->pin_count * sizeof(pni_pin_t));
+}
+
+// Return the oldest event in use to the ring.
+static void pni_ring_release(pn_collector_t *collector, pn_event_t *event)
+{
+  assert(collector->used && collector->ring[collector->first] == event);
+  if (event->attachments) {
+    pn_record_clear(event->attachments);
+  }
+  collector->first = (collector->first + 1) % collector->capacity;
+  if (--collector->used == 0) {
+    pni_unpin(collector);
+  }
+}
+
 pn_event_t *pn_collector_put(pn_collector_t *collector,
                              const pn_class_t *clazz, void *context,
                              pn_event_type_t type)
@@ -142,15 +309,28 @@ pn_event_t *pn_collector_put(pn_collector_t *collector,
 
   clazz = clazz->reify(context);
 
-  pn_event_t *event = (pn_event_t *) pn_list_pop(collector->pool);
+  pn_event_t *event;
+  if (collector->ring) {
+    if (!pni_pin(collector, clazz, context)) {
+      return NULL;
+    }
+    event = pni_ring_take(collector);
+    if (!event) {
+      return NULL;
+    }
+  } else {
+    event = (pn_event_t *) pn_list_pop(collector->pool);
+
+    if (!event) {
+      event = pn_event();
+    }
 
-  if (!event) {
-    event = pn_event();
+    event->pool = collector->pool;
+    pn_incref(event->pool);
+    pn_class_incref(clazz, context);
   }
 
-  event->pool = collector->pool;
-  pn_incref(event->pool);
-
+  event->next = NULL;
   if (tail) {
     tail->next = event;
     collector->tail = event;
@@ -162,7 +342,6 @@ pn_event_t *pn_collector_put(pn_collector_t *collector,
   event->clazz = clazz;
   event->context = context;
   event->type = type;
-  pn_class_incref(clazz, event->context);
 
   return event;
 }
@@ -185,16 +364,32 @@ static pn_event_t *pop_internal(pn_collector_t *collector) {
 }
 
 bool pn_collector_pop(pn_collector_t *collector) {
+  if (collector->ring && collector->prev) {
+    // Events are returned to the ring in order, so prev must go first
+    pn_event_t *prev = collector->prev;
+    collector->prev = NULL;
+    pni_ring_release(collector, prev);
+  }
   pn_event_t *event = pop_internal(collector);
   if (event) {
-    pn_decref(event);
+    if (collector->ring) {
+      pni_ring_release(collector, event);
+    } else {
+      pn_decref(event);
+    }
   }
   return event;
 }
 
 pn_event_t *pn_collector_next(pn_collector_t *collector) {
-  if (collector->prev) {
-    pn_decref(collector->prev);
+  pn_event_t *prev = collector->prev;
+  if (prev) {
+    if (collector->ring) {
+      collector->prev = NULL;
+      pni_ring_release(collector, prev);
+    } else {
+      pn_decref(prev);
+    }
   }
   collector->prev = pop_internal(collector);
   return collector->prev;
@@ -217,7 +412,7 @@ static void pn_event_initialize(pn_event_t *event)
   event->clazz = NULL;
   event->context = NULL;
   event->next = NULL;
-  event->attachments = pn_record();
+  event->attachments = NULL;
 }
 
 static void pn_event_finalize(pn_event_t *event) {
@@ -234,7 +429,9 @@ static void pn_event_finalize(pn_event_t *event) {
     event->clazz = NULL;
     event->context = NULL;
     event->next = NULL;
-    pn_record_clear(event->attachments);
+    if (event->attachments) {
+      pn_record_clear(event->attachments);
+    }
     pn_list_add(pool, event);
   } else {
     pn_decref(event->attachments);
@@ -295,6 +492,9 @@ void *pn_event_context(pn_event_t *event)
 pn_record_t *pn_event_attachments(pn_event_t *event)
 {
   assert(event);
+  if (!event->attachments) {
+    event->attachments = pn_record();
+  }
   return event->attachments;
 }
 
@@ -23,6 +23,7 @@
 #include <string.h>
 
 #include "framing.h"
+#include "util.h"
 
 // TODO: These are near duplicates of code in codec.c - they should be
 // deduplicated.
@@ -83,26 +84,36 @@ ssize_t pn_read_frame(pn_frame_t *frame, const char *bytes, size_t available, ui
   return size;
 }
 
-size_t pn_write_frame(pn_buffer_t* buffer, pn_frame_t frame)
+// The frame body (if any) follows the payload and is queued by reference, not copied
+void pn_write_frame_header(char *bytes, const pn_frame_t *frame, size_t size)
 {
-  size_t size = AMQP_HEADER_SIZE + frame.ex_size + frame.size;
-  if (size <= pn_buffer_available(buffer))
-  {
-    // Prepare header
-    char bytes[8];
-    pn_i_write32(&bytes[0], size);
-    int doff = (frame.ex_size + AMQP_HEADER_SIZE - 1)/4 + 1;
-    bytes[4] = doff;
-    bytes[5] = frame.type;
-    pn_i_write16(&bytes[6], frame.channel);
+  pn_i_write32(&bytes[0], size);
+  int doff = (frame->ex_size + AMQP_HEADER_SIZE - 1)/4 + 1;
+  bytes[4] = doff;
+  bytes[5] = frame->type;
+  pn_i_write16(&bytes[6], frame->channel);
+}
+
+size_t pn_write_frame(pni_output_queue_t* output, pn_frame_t frame, pn_buffer_t *body, size_t offset, size_t size)
+{
+  size_t frame_size = AMQP_HEADER_SIZE + frame.ex_size + frame.size + size;
 
-    // Write header then rest of frame
-    pn_buffer_append(buffer, bytes, 8);
-    if (frame.extended)
-        pn_buffer_append(buffer, frame.extended, frame.ex_size);
-    pn_buffer_append(buffer, frame.payload, frame.size);
-    return size;
-  } else {
+  // Prepare header
+  char bytes[8];
+  pn_write_frame_header(bytes, &frame, frame_size);
+
+  // Write header then rest of frame
+  if (pni_output_queue_append(output, bytes, 8) ||
+      (frame.extended && pni_output_queue_append(output, frame.extended, frame.ex_size)) ||
+      pni_output_queue_append(output, frame.payload, frame.size)) {
     return 0;
   }
+  size_t end = offset + size;
+  while (offset < end) {
+    pn_bytes_t chunk = pn_buffer_chunk(body, offset);
+    chunk.size = pn_min(chunk.size, end - offset);
+    if (pni_output_queue_append_ref(output, chunk.start, chunk.size)) return 0;
+    offset += chunk.size;
+  }
+  return frame_size;
 }
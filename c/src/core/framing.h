@@ -22,7 +22,7 @@
  *
  */
 
-#include "buffer.h"
+#include "output_queue.h"
 
 #include <proton/import_export.h>
 #include <proton/type_compat.h>
@@ -42,6 +42,9 @@ typedef struct {
 } pn_frame_t;
 
 ssize_t pn_read_frame(pn_frame_t *frame, const char *bytes, size_t available, uint32_t max);
-size_t pn_write_frame(pn_buffer_t* buffer, pn_frame_t frame);
+/* Queue a frame followed by size bytes of body from offset, referenced in place in its chunks */
+size_t pn_write_frame(pni_output_queue_t* output, pn_frame_t frame, pn_buffer_t *body, size_t offset, size_t size);
+/* Write the AMQP_HEADER_SIZE bytes that start a frame of size bytes in total */
+void pn_write_frame_header(char *bytes, const pn_frame_t *frame, size_t size);
 
 #endif /* framing.h */
@@ -22,8 +22,8 @@
 
 void pn_init(void)
 {
-  pni_init_default_logger();
   pni_init_memory();
+  pni_init_default_logger();
 }
 
 void pn_fini(void)
@@ -21,14 +21,40 @@
 
 #include "core/memory.h"
 
+#include <proton/allocator.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static void *pni_default_allocate(void *context, size_t size) { return malloc(size); }
+static void *pni_default_reallocate(void *context, void *block, size_t size) { return realloc(block, size); }
+static void pni_default_deallocate(void *context, void *block) { free(block); }
+
+static const pn_allocator_t pni_default_allocator = {
+  pni_default_allocate,
+  pni_default_reallocate,
+  pni_default_deallocate,
+  NULL
+};
+
+static pn_allocator_t pni_allocator = {
+  pni_default_allocate,
+  pni_default_reallocate,
+  pni_default_deallocate,
+  NULL
+};
+
+void pn_set_allocator(const pn_allocator_t *allocator)
+{
+  pni_allocator = allocator ? *allocator : pni_default_allocator;
+}
+
 #ifdef PN_MEMDEBUG
 #include "logger_private.h"
 
 #include "proton/object.h"
 #include "proton/cid.h"
 
-#include <stdlib.h>
-
 #include <signal.h>
 
 // Non portable actual size of allocated block
@@ -260,19 +286,49 @@ void pni_mem_subdeallocate(const pn_class_t *clazz, void *object, void *buffer)
 
 // Versions with no memory debugging - so we can compile with no performance penalty
 
-#include <stdlib.h>
+void pni_init_memory(void)
+{
+  const char *allocator = getenv("PN_ALLOCATOR");
+  if (allocator && !strcmp(allocator, "slab")) {
+    pn_set_allocator(pn_slab_allocator());
+  }
+}
 
-void pni_init_memory(void) {}
 void pni_fini_memory(void) {}
 
 void pni_mem_setup_logging(void) {}
 
-void *pni_mem_allocate(const pn_class_t *clazz, size_t size) { return malloc(size); }
-void *pni_mem_zallocate(const pn_class_t *clazz, size_t size) { return calloc(1, size); }
-void pni_mem_deallocate(const pn_class_t *clazz, void *object) { free(object); }
+void *pni_mem_allocate(const pn_class_t *clazz, size_t size)
+{
+  return pni_allocator.allocate(pni_allocator.context, size);
+}
 
-void *pni_mem_suballocate(const pn_class_t *clazz, void *object, size_t size) { return malloc(size); }
-void *pni_mem_subreallocate(const pn_class_t *clazz, void *object, void *buffer, size_t size) { return realloc(buffer, size); }
-void pni_mem_subdeallocate(const pn_class_t *clazz, void *object, void *buffer) { free(buffer); }
+void *pni_mem_zallocate(const pn_class_t *clazz, size_t size)
+{
+  if (pni_allocator.allocate == pni_default_allocate) return calloc(1, size);
+  void *o = pni_allocator.allocate(pni_allocator.context, size);
+  if (o) memset(o, 0, size);
+  return o;
+}
+
+void pni_mem_deallocate(const pn_class_t *clazz, void *object)
+{
+  pni_allocator.deallocate(pni_allocator.context, object);
+}
+
+void *pni_mem_suballocate(const pn_class_t *clazz, void *object, size_t size)
+{
+  return pni_allocator.allocate(pni_allocator.context, size);
+}
+
+void *pni_mem_subreallocate(const pn_class_t *clazz, void *object, void *buffer, size_t size)
+{
+  return pni_allocator.reallocate(pni_allocator.context, buffer, size);
+}
+
+void pni_mem_subdeallocate(const pn_class_t *clazz, void *object, void *buffer)
+{
+  pni_allocator.deallocate(pni_allocator.context, buffer);
+}
 
 #endif
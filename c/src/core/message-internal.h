@@ -34,6 +34,18 @@ PN_EXTERN pn_message_t * pni_message_with_extra(size_t extra);
 /** Pointer to extra space allocated by pn_message_with_extra(). */
 PN_EXTERN void* pni_message_get_extra(pn_message_t *msg);
 
+/** Build the data to encode msg from and return its encoded size, see pni_message_encode_prepared(). */
+PN_EXTERN ssize_t pni_message_prepare(pn_message_t *msg);
+
+/** Encode the data built by pni_message_prepare() into size bytes known to be enough. */
+PN_EXTERN ssize_t pni_message_encode_prepared(pn_message_t *msg, char *bytes, size_t size);
+
+/** Keep the bytes of a received delivery for a message view when the link advances past it. */
+PN_EXTERN void pni_delivery_keep_bytes(pn_delivery_t *delivery);
+
+/** Drop the bytes kept by pni_delivery_keep_bytes() once the link has advanced past the delivery. */
+PN_EXTERN void pni_delivery_drop_bytes(pn_delivery_t *delivery);
+
 /** @endcond */
 
 #ifdef __cplusplus
@@ -21,6 +21,7 @@
 
 #include "platform/platform_fmt.h"
 
+#include "engine-internal.h"
 #include "max_align.h"
 #include "message-internal.h"
 #include "protocol.h"
@@ -644,20 +645,23 @@ int pn_message_set_reply_to_group_id(pn_message_t *msg, const char *reply_to_gro
   return pn_string_set(msg->reply_to_group_id, reply_to_group_id);
 }
 
-int pn_message_decode(pn_message_t *msg, const char *bytes, size_t size)
+// Each section is decoded into msg->data borrowing from bytes and anything kept
+// is copied out of it, so msg->data must be cleared once this returns. With more
+// set the message continues past size and decoding stops at a section that does
+// not fit, *decoded counts the bytes of the whole sections decoded.
+static int pni_message_decode(pn_message_t *msg, const char *bytes, size_t size, bool more, size_t *decoded)
 {
-  assert(msg && bytes && size);
-
-  pn_message_clear(msg);
-
+  *decoded = 0;
   while (size) {
     pn_data_clear(msg->data);
-    ssize_t used = pn_data_decode(msg->data, bytes, size);
+    ssize_t used = pn_data_decode_borrowed(msg->data, bytes, size);
+    if (used == PN_UNDERFLOW && more) break;
     if (used < 0)
         return pn_error_format(msg->error, used, "data error: %s",
                                pn_error_text(pn_data_error(msg->data)));
     size -= used;
     bytes += used;
+    *decoded += used;
     bool scanned;
     uint64_t desc;
     int err = pn_data_scan(msg->data, "D?L.", &scanned, &desc);
@@ -757,10 +761,91 @@ int pn_message_decode(pn_message_t *msg, const char *bytes, size_t size)
     }
   }
 
-  pn_data_clear(msg->data);
   return 0;
 }
 
+int pn_message_decode(pn_message_t *msg, const char *bytes, size_t size)
+{
+  assert(msg && bytes && size);
+
+  pn_message_clear(msg);
+  size_t decoded;
+  int err = pni_message_decode(msg, bytes, size, false, &decoded);
+  pn_data_clear(msg->data);
+  return err;
+}
+
+// Sections are decoded from the buffer chunk holding them. Only a section that
+// runs on into the next chunk is copied, into a window doubled until it fits.
+static int pni_message_decode_buffer(pn_message_t *msg, pn_buffer_t *buf)
+{
+  size_t size = pn_buffer_size(buf);
+  size_t offset = 0;
+  char *scratch = NULL;
+  int err = 0;
+  while (offset < size && !err) {
+    pn_bytes_t chunk = pn_buffer_chunk(buf, offset);
+    size_t decoded;
+    err = pni_message_decode(msg, chunk.start, chunk.size, offset + chunk.size < size, &decoded);
+    size_t copied = 0;
+    size_t window = chunk.size;
+    while (!err && !decoded) {
+      window = pn_min(2*window, size - offset);
+      char *grown = (char *) realloc(scratch, window);
+      if (!grown) {
+        err = PN_OUT_OF_MEMORY;
+        break;
+      }
+      scratch = grown;
+      copied += pn_buffer_get(buf, offset + copied, window - copied, scratch + copied);
+      err = pni_message_decode(msg, scratch, window, offset + window < size, &decoded);
+    }
+    offset += decoded;
+  }
+  free(scratch);
+  return err;
+}
+
+int pn_message_recv(pn_message_t *msg, pn_delivery_t *delivery)
+{
+  if (!msg || !delivery) return PN_ARG_ERR;
+  if (delivery->aborted) return PN_ABORTED;
+  if (!delivery->done) return PN_STATE_ERR;
+  if (!pn_buffer_size(delivery->bytes)) return PN_UNDERFLOW;
+
+  pn_message_clear(msg);
+  int err = pni_message_decode_buffer(msg, delivery->bytes);
+  pn_data_clear(msg->data);
+  return err;
+}
+
+// Build msg->data from the message and return its encoded size
+ssize_t pni_message_prepare(pn_message_t *msg)
+{
+  pn_data_clear(msg->data);
+  int err = pn_message_data(msg, msg->data);
+  if (err) return err;
+  ssize_t size = pn_data_encoded_size(msg->data);
+  if (size < 0) {
+    size = pn_error_format(msg->error, size, "data error: %s",
+                           pn_error_text(pn_data_error(msg->data)));
+    pn_data_clear(msg->data);
+  }
+  return size;
+}
+
+// Encode the msg->data built by pni_message_prepare() into space known to be big enough
+ssize_t pni_message_encode_prepared(pn_message_t *msg, char *bytes, size_t size)
+{
+  ssize_t encoded = pn_data_encode(msg->data, bytes, size);
+  if (encoded < 0) {
+    encoded = pn_error_format(msg->error, encoded, "data error: %s",
+                              pn_error_text(pn_data_error(msg->data)));
+  }
+  pn_data_clear(msg->data);
+  return encoded;
+}
+
 int pn_message_encode(pn_message_t *msg, char *bytes, size_t *size)
 {
   if (!msg || !bytes || !size || !*size) return PN_ARG_ERR;
@@ -783,6 +868,14 @@ int pn_message_encode(pn_message_t *msg, char *bytes, size_t *size)
   return 0;
 }
 
+ssize_t pn_message_encoded_size(pn_message_t *msg)
+{
+  if (!msg) return PN_ARG_ERR;
+  ssize_t size = pni_message_prepare(msg);
+  pn_data_clear(msg->data);
+  return size;
+}
+
 int pn_message_data(pn_message_t *msg, pn_data_t *data)
 {
   pn_data_clear(data);
@@ -904,34 +997,49 @@ pn_data_t *pn_message_body(pn_message_t *msg)
 }
 
 ssize_t pn_message_encode2(pn_message_t *msg, pn_rwbytes_t *buffer) {
-  static const size_t initial_size = 256;
-  int err = 0;
-  size_t size = 0;
-
-  if (buffer->start == NULL) {
-    buffer->start = (char*)malloc(initial_size);
-    buffer->size = initial_size;
-  }
-  if (buffer->start == NULL) return PN_OUT_OF_MEMORY;
-  size = buffer->size;
-  while ((err = pn_message_encode(msg, buffer->start, &size)) == PN_OVERFLOW) {
-    buffer->size *= 2;
-    buffer->start = (char*)realloc(buffer->start, buffer->size);
-    if (buffer->start == NULL) return PN_OUT_OF_MEMORY;
-    size = buffer->size;
+  ssize_t size = pni_message_prepare(msg);
+  if (size < 0) return size;
+
+  if (buffer->start == NULL || buffer->size < (size_t)size) {
+    // Never allocate less than we used to so that small buffers can be reused
+    size_t capacity = size > 256 ? (size_t)size : 256;
+    char *start = (char*)realloc(buffer->start, capacity);
+    if (start == NULL) {
+      pn_data_clear(msg->data);
+      return PN_OUT_OF_MEMORY;
+    }
+    buffer->start = start;
+    buffer->size = capacity;
   }
-  return err == 0 ? (ssize_t)size : err;
+  return pni_message_encode_prepared(msg, buffer->start, size);
 }
 
 ssize_t pn_message_send(pn_message_t *msg, pn_link_t *sender, pn_rwbytes_t *buffer) {
-  pn_rwbytes_t local_buf = { 0 };
-  if (!buffer) buffer = &local_buf;
-  ssize_t ret = pn_message_encode2(msg, buffer);
+  if (buffer) {
+    ssize_t ret = pn_message_encode2(msg, buffer);
+    if (ret >= 0) {
+      ret = pn_link_send(sender, buffer->start, ret);
+      if (ret >= 0) ret = pn_link_advance(sender);
+      if (ret < 0) pn_error_copy(pn_message_error(msg), pn_link_error(sender));
+    }
+    return ret;
+  }
+  // Encode straight into the delivery
+  ssize_t ret = pni_message_prepare(msg);
   if (ret >= 0) {
-    ret = pn_link_send(sender, buffer->start, ret);
-    if (ret >= 0) ret = pn_link_advance(sender);
-    if (ret < 0) pn_error_copy(pn_message_error(msg), pn_link_error(sender));
+    pn_rwbytes_t space = pni_link_send_space(sender, ret);
+    if (!space.start) {
+      pn_data_clear(msg->data);
+      return pn_link_current(sender) ?
+        pn_error_set(msg->error, PN_OUT_OF_MEMORY, "no space for message") :
+        pn_error_set(msg->error, PN_EOS, "no current delivery");
+    }
+    ret = pni_message_encode_prepared(msg, space.start, ret);
+    if (ret >= 0) {
+      ret = pni_link_send_written(sender, ret);
+      if (ret >= 0) ret = pn_link_advance(sender);
+      if (ret < 0) pn_error_copy(pn_message_error(msg), pn_link_error(sender));
+    }
   }
-  if (local_buf.start) free(local_buf.start);
   return ret;
 }
@@ -0,0 +1,366 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "consumers.h"
+#include "engine-internal.h"
+#include "memory.h"
+#include "protocol.h"
+
+#include <proton/link.h>
+#include <proton/message.h>
+
+#include <string.h>
+
+struct pn_message_view_t {
+  pn_bytes_t bytes;
+  // Encoded values of the sections, not including their descriptors
+  pn_bytes_t header;
+  pn_bytes_t instructions;
+  pn_bytes_t annotations;
+  pn_bytes_t properties;
+  pn_bytes_t application_properties;
+  // Complete encoding of the body sections
+  pn_bytes_t body;
+};
+
+pn_message_view_t *pn_message_view(void)
+{
+  return (pn_message_view_t *) pni_mem_zallocate(PN_VOID, sizeof(pn_message_view_t));
+}
+
+void pn_message_view_free(pn_message_view_t *view)
+{
+  if (view) pni_mem_deallocate(PN_VOID, view);
+}
+
+int pn_message_view_decode(pn_message_view_t *view, const char *bytes, size_t size)
+{
+  if (!view) return PN_ARG_ERR;
+  memset(view, 0, sizeof(*view));
+  if (!bytes || !size) return PN_ARG_ERR;
+
+  view->bytes = pn_bytes(size, bytes);
+  pni_consumer_t consumer = make_consumer_from_bytes(view->bytes);
+  size_t body_start = 0;
+  size_t body_end = 0;
+  while (pni_consumer_remaining(&consumer)) {
+    size_t start = consumer.position;
+    uint64_t descriptor;
+    // As in pn_message_decode() anything without a numeric descriptor is body
+    if (!pni_consumer_read_descriptor(&consumer, &descriptor)) {
+      consumer.position = start;
+      descriptor = 0;
+    }
+    size_t value_start = consumer.position;
+    if (!pni_consumer_skip_value(&consumer)) {
+      memset(view, 0, sizeof(*view));
+      return PN_ARG_ERR;
+    }
+    pn_bytes_t value = pn_bytes(consumer.position - value_start, bytes + value_start);
+    switch (descriptor) {
+    case HEADER:
+      view->header = value;
+      break;
+    case DELIVERY_ANNOTATIONS:
+      view->instructions = value;
+      break;
+    case MESSAGE_ANNOTATIONS:
+      view->annotations = value;
+      break;
+    case PROPERTIES:
+      view->properties = value;
+      break;
+    case APPLICATION_PROPERTIES:
+      view->application_properties = value;
+      break;
+    case FOOTER:
+      break;
+    default:
+      if (!body_end) body_start = start;
+      body_end = consumer.position;
+      break;
+    }
+  }
+  if (body_end) view->body = pn_bytes(body_end - body_start, bytes + body_start);
+  return 0;
+}
+
+int pn_message_view_recv(pn_message_view_t *view, pn_delivery_t *delivery)
+{
+  if (!view || !delivery) return PN_ARG_ERR;
+  if (delivery->aborted) return PN_ABORTED;
+  if (!delivery->done) return PN_STATE_ERR;
+  delivery->keep = true;
+  pn_rwbytes_t memory = pn_buffer_memory(delivery->bytes);
+  return pn_message_view_decode(view, memory.start, memory.size);
+}
+
+pn_bytes_t pn_message_view_bytes(pn_message_view_t *view)
+{
+  return view->bytes;
+}
+
+ssize_t pn_message_view_send(pn_message_view_t *view, pn_link_t *sender)
+{
+  ssize_t ret = pn_link_send(sender, view->bytes.start, view->bytes.size);
+  if (ret >= 0) pn_link_advance(sender);
+  return ret;
+}
+
+// Position a consumer at field index of an encoded list, false if it is absent
+static bool pni_view_field(pn_bytes_t section, int index, pni_consumer_t *field)
+{
+  if (!section.size) return false;
+  pni_consumer_t consumer = make_consumer_from_bytes(section);
+  uint32_t count;
+  if (!pni_consumer_enter_list(&consumer, field, &count) || (uint32_t)index >= count) return false;
+  for (int i = 0; i < index; i++) {
+    if (!pni_consumer_skip_value(field)) return false;
+  }
+  return true;
+}
+
+static bool pni_view_bool(pn_bytes_t section, int index)
+{
+  pni_consumer_t field;
+  bool value = false;
+  bool present = false;
+  if (pni_view_field(section, index, &field)) pni_consumer_read_bool(&field, &value, &present);
+  return present && value;
+}
+
+static uint32_t pni_view_uint(pn_bytes_t section, int index, uint32_t dflt)
+{
+  pni_consumer_t field;
+  uint32_t value = 0;
+  bool present = false;
+  if (pni_view_field(section, index, &field)) pni_consumer_read_uint(&field, &value, &present);
+  return present ? value : dflt;
+}
+
+static pn_timestamp_t pni_view_timestamp(pn_bytes_t section, int index)
+{
+  pni_consumer_t field;
+  int64_t value = 0;
+  bool present = false;
+  if (pni_view_field(section, index, &field)) pni_consumer_read_timestamp(&field, &value, &present);
+  return present ? value : 0;
+}
+
+static pn_bytes_t pni_view_string(pn_bytes_t section, int index)
+{
+  pni_consumer_t field;
+  pn_bytes_t value = {0, NULL};
+  bool present = false;
+  if (pni_view_field(section, index, &field)) pni_consumer_read_string(&field, &value, &present);
+  return value;
+}
+
+static pn_bytes_t pni_view_symbol(pn_bytes_t section, int index)
+{
+  pni_consumer_t field;
+  pn_bytes_t value = {0, NULL};
+  bool present = false;
+  if (pni_view_field(section, index, &field)) pni_consumer_read_symbol(&field, &value, &present);
+  return value;
+}
+
+static pn_bytes_t pni_view_binary(pn_bytes_t section, int index)
+{
+  pni_consumer_t field;
+  pn_bytes_t value = {0, NULL};
+  bool present = false;
+  if (pni_view_field(section, index, &field)) pni_consumer_read_binary(&field, &value, &present);
+  return value;
+}
+
+// Message ids are one of ulong, uuid, binary or string
+static pn_atom_t pni_view_msgid(pn_bytes_t section, int index)
+{
+  pn_atom_t atom;
+  atom.type = PN_NULL;
+  pni_consumer_t field;
+  uint8_t code;
+  if (!pni_view_field(section, index, &field)) return atom;
+  pni_consumer_t value = field;
+  if (!pni_consumer_read_constructor(&value, &code)) return atom;
+  bool present = false;
+  switch (code) {
+  case PNE_ULONG0:
+  case PNE_SMALLULONG:
+  case PNE_ULONG:
+    if (pni_consumer_read_ulong(&field, &atom.u.as_ulong, &present) && present) atom.type = PN_ULONG;
+    break;
+  case PNE_UUID:
+    if (pni_consumer_remaining(&value) >= 16) {
+      memcpy(atom.u.as_uuid.bytes, value.output_start + value.position, 16);
+      atom.type = PN_UUID;
+    }
+    break;
+  case PNE_VBIN8:
+  case PNE_VBIN32:
+    if (pni_consumer_read_binary(&field, &atom.u.as_bytes, &present) && present) atom.type = PN_BINARY;
+    break;
+  case PNE_STR8_UTF8:
+  case PNE_STR32_UTF8:
+    if (pni_consumer_read_string(&field, &atom.u.as_bytes, &present) && present) atom.type = PN_STRING;
+    break;
+  }
+  return atom;
+}
+
+bool pn_message_view_is_durable(pn_message_view_t *view)
+{
+  return pni_view_bool(view->header, HEADER_DURABLE);
+}
+
+uint8_t pn_message_view_get_priority(pn_message_view_t *view)
+{
+  pni_consumer_t field;
+  uint8_t value = HEADER_PRIORITY_DEFAULT;
+  bool present = false;
+  if (pni_view_field(view->header, HEADER_PRIORITY, &field)) pni_consumer_read_ubyte(&field, &value, &present);
+  return present ? value : HEADER_PRIORITY_DEFAULT;
+}
+
+pn_millis_t pn_message_view_get_ttl(pn_message_view_t *view)
+{
+  return pni_view_uint(view->header, HEADER_TTL, 0);
+}
+
+bool pn_message_view_is_first_acquirer(pn_message_view_t *view)
+{
+  return pni_view_bool(view->header, HEADER_FIRST_ACQUIRER);
+}
+
+uint32_t pn_message_view_get_delivery_count(pn_message_view_t *view)
+{
+  return pni_view_uint(view->header, HEADER_DELIVERY_COUNT, HEADER_DELIVERY_COUNT_DEFAULT);
+}
+
+pn_atom_t pn_message_view_get_id(pn_message_view_t *view)
+{
+  return pni_view_msgid(view->properties, PROPERTIES_MESSAGE_ID);
+}
+
+pn_bytes_t pn_message_view_get_user_id(pn_message_view_t *view)
+{
+  return pni_view_binary(view->properties, PROPERTIES_USER_ID);
+}
+
+pn_bytes_t pn_message_view_get_address(pn_message_view_t *view)
+{
+  return pni_view_string(view->properties, PROPERTIES_TO);
+}
+
+pn_bytes_t pn_message_view_get_subject(pn_message_view_t *view)
+{
+  return pni_view_string(view->properties, PROPERTIES_SUBJECT);
+}
+
+pn_bytes_t pn_message_view_get_reply_to(pn_message_view_t *view)
+{
+  return pni_view_string(view->properties, PROPERTIES_REPLY_TO);
+}
+
+pn_atom_t pn_message_view_get_correlation_id(pn_message_view_t *view)
+{
+  return pni_view_msgid(view->properties, PROPERTIES_CORRELATION_ID);
+}
+
+pn_bytes_t pn_message_view_get_content_type(pn_message_view_t *view)
+{
+  return pni_view_symbol(view->properties, PROPERTIES_CONTENT_TYPE);
+}
+
+pn_bytes_t pn_message_view_get_content_encoding(pn_message_view_t *view)
+{
+  return pni_view_symbol(view->properties, PROPERTIES_CONTENT_ENCODING);
+}
+
+pn_timestamp_t pn_message_view_get_expiry_time(pn_message_view_t *view)
+{
+  return pni_view_timestamp(view->properties, PROPERTIES_ABSOLUTE_EXPIRY_TIME);
+}
+
+pn_timestamp_t pn_message_view_get_creation_time(pn_message_view_t *view)
+{
+  return pni_view_timestamp(view->properties, PROPERTIES_CREATION_TIME);
+}
+
+pn_bytes_t pn_message_view_get_group_id(pn_message_view_t *view)
+{
+  return pni_view_string(view->properties, PROPERTIES_GROUP_ID);
+}
+
+pn_sequence_t pn_message_view_get_group_sequence(pn_message_view_t *view)
+{
+  return pni_view_uint(view->properties, PROPERTIES_GROUP_SEQUENCE, 0);
+}
+
+pn_bytes_t pn_message_view_get_reply_to_group_id(pn_message_view_t *view)
+{
+  return pni_view_string(view->properties, PROPERTIES_REPLY_TO_GROUP_ID);
+}
+
+pn_bytes_t pn_message_view_property(pn_message_view_t *view, pn_bytes_t key)
+{
+  pn_bytes_t result = {0, NULL};
+  if (!view->application_properties.size) return result;
+  pni_consumer_t consumer = make_consumer_from_bytes(view->application_properties);
+  pni_consumer_t map;
+  uint32_t count;
+  if (!pni_consumer_enter_map(&consumer, &map, &count)) return result;
+  for (uint32_t i = 0; i + 1 < count; i += 2) {
+    pn_bytes_t k = {0, NULL};
+    bool present = false;
+    if (!pni_consumer_read_string(&map, &k, &present)) return result;
+    bool match = present && k.size == key.size && (key.size == 0 || memcmp(k.start, key.start, key.size) == 0);
+    size_t start = map.position;
+    if (!pni_consumer_skip_value(&map)) return result;
+    if (match) {
+      result.size = map.position - start;
+      result.start = (const char *) map.output_start + start;
+      return result;
+    }
+  }
+  return result;
+}
+
+pn_bytes_t pn_message_view_instructions(pn_message_view_t *view)
+{
+  return view->instructions;
+}
+
+pn_bytes_t pn_message_view_annotations(pn_message_view_t *view)
+{
+  return view->annotations;
+}
+
+pn_bytes_t pn_message_view_properties(pn_message_view_t *view)
+{
+  return view->application_properties;
+}
+
+pn_bytes_t pn_message_view_body(pn_message_view_t *view)
+{
+  return view->body;
+}
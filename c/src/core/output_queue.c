@@ -0,0 +1,235 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "output_queue.h"
+#include "memory.h"
+#include "util.h"
+
+#include <proton/error.h>
+
+#include <string.h>
+
+int pni_output_queue_init(pni_output_queue_t *queue, const pn_class_t *clazz, void *object, size_t capacity)
+{
+  memset(queue, 0, sizeof(*queue));
+  queue->clazz = clazz;
+  queue->object = object;
+  queue->bytes = pn_buffer(capacity);
+  return queue->bytes ? 0 : PN_OUT_OF_MEMORY;
+}
+
+static pni_output_seg_t *pni_output_seg(pni_output_queue_t *queue, size_t i)
+{
+  return &queue->segs[(queue->seg_head + i) % queue->seg_capacity];
+}
+
+void pni_output_queue_fini(pni_output_queue_t *queue)
+{
+  for (size_t i = 0; i < queue->seg_count; ++i) {
+    pn_buffer_free(pni_output_seg(queue, i)->owner);
+  }
+  pni_mem_subdeallocate(queue->clazz, queue->object, queue->segs);
+  pn_buffer_free(queue->bytes);
+  pn_buffer_free(queue->spare);
+  memset(queue, 0, sizeof(*queue));
+}
+
+static pni_output_seg_t *pni_output_queue_tail(pni_output_queue_t *queue)
+{
+  return queue->seg_count ? pni_output_seg(queue, queue->seg_count - 1) : NULL;
+}
+
+static pni_output_seg_t *pni_output_queue_push(pni_output_queue_t *queue)
+{
+  if (queue->seg_count == queue->seg_capacity) {
+    size_t capacity = queue->seg_capacity ? 2*queue->seg_capacity : 8;
+    pni_output_seg_t *segs = (pni_output_seg_t *)
+      pni_mem_suballocate(queue->clazz, queue->object, capacity * sizeof(pni_output_seg_t));
+    if (!segs) return NULL;
+    for (size_t i = 0; i < queue->seg_count; ++i) {
+      segs[i] = *pni_output_seg(queue, i);
+    }
+    pni_mem_subdeallocate(queue->clazz, queue->object, queue->segs);
+    queue->segs = segs;
+    queue->seg_capacity = capacity;
+    queue->seg_head = 0;
+  }
+  pni_output_seg_t *seg = pni_output_seg(queue, queue->seg_count++);
+  seg->start = NULL;
+  seg->size = 0;
+  seg->owner = NULL;
+  return seg;
+}
+
+int pni_output_queue_append(pni_output_queue_t *queue, const char *bytes, size_t size)
+{
+  if (!size) return 0;
+  int err = pn_buffer_append(queue->bytes, bytes, size);
+  if (err) return err;
+  pni_output_seg_t *seg = pni_output_queue_tail(queue);
+  if (!seg || seg->start || seg->owner) {
+    seg = pni_output_queue_push(queue);
+    if (!seg) {
+      pn_buffer_trim(queue->bytes, 0, size);
+      return PN_OUT_OF_MEMORY;
+    }
+  }
+  seg->size += size;
+  queue->size += size;
+  return 0;
+}
+
+// Contiguous space after the queued bytes to be written in place and added with pni_output_queue_commit()
+pn_rwbytes_t pni_output_queue_reserve(pni_output_queue_t *queue, size_t size)
+{
+  return pn_buffer_free_memory(queue->bytes, size);
+}
+
+int pni_output_queue_commit(pni_output_queue_t *queue, size_t size)
+{
+  if (!size) return 0;
+  int err = pn_buffer_extend(queue->bytes, size);
+  if (err) return err;
+  pni_output_seg_t *seg = pni_output_queue_tail(queue);
+  if (!seg || seg->start || seg->owner) {
+    seg = pni_output_queue_push(queue);
+    if (!seg) {
+      pn_buffer_trim(queue->bytes, 0, size);
+      return PN_OUT_OF_MEMORY;
+    }
+  }
+  seg->size += size;
+  queue->size += size;
+  return 0;
+}
+
+int pni_output_queue_append_ref(pni_output_queue_t *queue, const char *bytes, size_t size)
+{
+  if (!size) return 0;
+  pni_output_seg_t *seg = pni_output_queue_push(queue);
+  if (!seg) return PN_OUT_OF_MEMORY;
+  seg->start = bytes;
+  seg->size = size;
+  queue->size += size;
+  return 0;
+}
+
+static void pni_output_queue_recycle(pni_output_queue_t *queue, pn_buffer_t *payload)
+{
+  // Keep the larger of the two buffers, it is the one most likely to avoid a regrow
+  if (queue->spare && pn_buffer_capacity(queue->spare) >= pn_buffer_capacity(payload)) {
+    pn_buffer_free(payload);
+  } else {
+    pn_buffer_free(queue->spare);
+    pn_buffer_clear(payload);
+    queue->spare = payload;
+  }
+}
+
+// Take ownership of a buffer referenced by queued output
+int pni_output_queue_release(pni_output_queue_t *queue, pn_buffer_t *payload)
+{
+  pni_output_seg_t *seg = pni_output_queue_tail(queue);
+  if (!seg) {
+    pni_output_queue_recycle(queue, payload);
+    return 0;
+  }
+  if (seg->owner) {
+    seg = pni_output_queue_push(queue);
+    if (!seg) return PN_OUT_OF_MEMORY;
+  }
+  seg->owner = payload;
+  return 0;
+}
+
+// An empty buffer to replace one handed over by pni_output_queue_release()
+pn_buffer_t *pni_output_queue_spare(pni_output_queue_t *queue)
+{
+  pn_buffer_t *spare = queue->spare;
+  if (spare) {
+    queue->spare = NULL;
+    return spare;
+  }
+  return pn_buffer(64);
+}
+
+size_t pni_output_queue_read(pni_output_queue_t *queue, char *dst, size_t size)
+{
+  size_t read = 0;
+  size_t offset = 0;
+  for (size_t i = 0; i < queue->seg_count && read < size; ++i) {
+    pni_output_seg_t *seg = pni_output_seg(queue, i);
+    size_t n = pn_min(seg->size, size - read);
+    if (seg->start) {
+      memcpy(dst + read, seg->start, n);
+    } else {
+      pn_buffer_get(queue->bytes, offset, n, dst + read);
+      offset += n;
+    }
+    read += n;
+  }
+  pni_output_queue_consume(queue, read);
+  return read;
+}
+
+size_t pni_output_queue_buffers(pni_output_queue_t *queue, pn_bytes_t *buffers, size_t n)
+{
+  size_t count = 0;
+  size_t offset = 0;
+  for (size_t i = 0; i < queue->seg_count && count < n; ++i) {
+    pni_output_seg_t *seg = pni_output_seg(queue, i);
+    if (seg->start) {
+      buffers[count++] = pn_bytes(seg->size, seg->start);
+    } else {
+      // Bytes in the ring buffer may wrap around its end
+      size_t end = offset + seg->size;
+      while (offset < end && count < n) {
+        pn_bytes_t chunk = pn_buffer_chunk(queue->bytes, offset);
+        chunk.size = pn_min(chunk.size, end - offset);
+        buffers[count++] = chunk;
+        offset += chunk.size;
+      }
+    }
+  }
+  return count;
+}
+
+void pni_output_queue_consume(pni_output_queue_t *queue, size_t size)
+{
+  size_t inline_size = 0;
+  while (queue->seg_count) {
+    pni_output_seg_t *seg = pni_output_seg(queue, 0);
+    size_t n = pn_min(seg->size, size);
+    if (seg->start) {
+      seg->start += n;
+    } else {
+      inline_size += n;
+    }
+    seg->size -= n;
+    size -= n;
+    queue->size -= n;
+    if (seg->size) break;
+    if (seg->owner) pni_output_queue_recycle(queue, seg->owner);
+    queue->seg_head = (queue->seg_head + 1) % queue->seg_capacity;
+    queue->seg_count--;
+  }
+  pn_buffer_trim(queue->bytes, inline_size, 0);
+}
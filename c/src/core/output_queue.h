@@ -0,0 +1,82 @@
+#ifndef PROTON_OUTPUT_QUEUE_H
+#define PROTON_OUTPUT_QUEUE_H 1
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "buffer.h"
+
+#include <proton/object.h>
+#include <proton/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Pending transport output.
+ *
+ * Frame headers, performatives and small payloads are copied into a single
+ * byte buffer. Large payloads are queued by reference so that they can be
+ * written straight from the memory they were sent from. A payload buffer
+ * handed to the queue with pni_output_queue_release() is kept until all the
+ * output that precedes it has been consumed.
+ */
+typedef struct {
+  const char *start;   /* NULL: the next size bytes of the queue's byte buffer */
+  size_t size;
+  pn_buffer_t *owner;  /* payload buffer to release once this segment is consumed */
+} pni_output_seg_t;
+
+typedef struct {
+  const pn_class_t *clazz;  /* class and object the segment list is allocated for */
+  void *object;
+  pn_buffer_t *bytes;
+  pni_output_seg_t *segs;
+  size_t seg_capacity;
+  size_t seg_head;
+  size_t seg_count;
+  size_t size;
+  pn_buffer_t *spare;  /* released payload buffer kept for reuse */
+} pni_output_queue_t;
+
+int pni_output_queue_init(pni_output_queue_t *queue, const pn_class_t *clazz, void *object, size_t capacity);
+void pni_output_queue_fini(pni_output_queue_t *queue);
+int pni_output_queue_append(pni_output_queue_t *queue, const char *bytes, size_t size);
+int pni_output_queue_append_ref(pni_output_queue_t *queue, const char *bytes, size_t size);
+pn_rwbytes_t pni_output_queue_reserve(pni_output_queue_t *queue, size_t size);
+int pni_output_queue_commit(pni_output_queue_t *queue, size_t size);
+int pni_output_queue_release(pni_output_queue_t *queue, pn_buffer_t *payload);
+pn_buffer_t *pni_output_queue_spare(pni_output_queue_t *queue);
+size_t pni_output_queue_read(pni_output_queue_t *queue, char *dst, size_t size);
+size_t pni_output_queue_buffers(pni_output_queue_t *queue, pn_bytes_t *buffers, size_t n);
+void pni_output_queue_consume(pni_output_queue_t *queue, size_t size);
+
+static inline size_t pni_output_queue_size(pni_output_queue_t *queue)
+{
+  return queue->size;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* output_queue.h */
@@ -0,0 +1,273 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <proton/allocator.h>
+
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+/*
+ * Slab allocator
+ *
+ * Blocks of up to PNI_SLAB_MAX bytes are carved out of PNI_SLAB_SIZE slabs
+ * in a fixed set of size classes. Each thread keeps a free list per class, so
+ * allocating and freeing usually involve no synchronisation at all. When a
+ * thread's list grows past a limit half of it goes back to a shared pool, and
+ * an empty list is refilled from the pool before a new slab is allocated.
+ *
+ * Every block starts with a header that records its class so that it can be
+ * freed without knowing its size. Larger blocks come straight from malloc()
+ * with the same header.
+ *
+ * Slabs are never returned to the system. The blocks left in the cache of a
+ * thread that exits stay there, they are bounded by the cache limit.
+ */
+
+#if defined(_MSC_VER)
+#include <windows.h>
+#define PNI_THREAD_LOCAL __declspec(thread)
+typedef volatile LONG pni_spinlock_t;
+static inline bool pni_spin_trylock(pni_spinlock_t *lock) { return InterlockedExchange(lock, 1) == 0; }
+static inline void pni_spin_unlock(pni_spinlock_t *lock) { InterlockedExchange(lock, 0); }
+#else
+#define PNI_THREAD_LOCAL __thread
+typedef volatile int pni_spinlock_t;
+static inline bool pni_spin_trylock(pni_spinlock_t *lock) { return __sync_lock_test_and_set(lock, 1) == 0; }
+static inline void pni_spin_unlock(pni_spinlock_t *lock) { __sync_lock_release(lock); }
+#endif
+
+// Only held to move a batch of blocks or record a slab
+static inline void pni_spin_lock(pni_spinlock_t *lock)
+{
+  while (!pni_spin_trylock(lock)) {
+    while (*lock);
+  }
+}
+
+typedef union pni_slab_header_t {
+  struct {
+    size_t cls;   // size class, or PNI_SLAB_LARGE
+    size_t size;  // usable size
+  } block;
+  long double align;
+  void *align_ptr;
+} pni_slab_header_t;
+
+typedef struct pni_slab_free_t {
+  struct pni_slab_free_t *next;
+} pni_slab_free_t;
+
+typedef union pni_slab_t {
+  union pni_slab_t *next;
+  pni_slab_header_t align;
+} pni_slab_t;
+
+typedef struct pni_slab_list_t {
+  pni_slab_free_t *head;
+  size_t count;
+} pni_slab_list_t;
+
+// Block sizes including the header
+static const size_t pni_slab_sizes[] = {
+  32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512,
+  640, 768, 896, 1024, 1280, 1536, 1792, 2048, 2560, 3072, 3584, 4096
+};
+
+#define PNI_SLAB_CLASSES (sizeof(pni_slab_sizes)/sizeof(pni_slab_sizes[0]))
+#define PNI_SLAB_MAX 4096
+#define PNI_SLAB_SIZE (64*1024)
+#define PNI_SLAB_LARGE ((size_t) -1)
+
+static PNI_THREAD_LOCAL pni_slab_list_t pni_slab_cache[PNI_SLAB_CLASSES];
+
+static pni_spinlock_t pni_slab_lock;
+static pni_slab_list_t pni_slab_pool[PNI_SLAB_CLASSES];
+static pni_slab_t *pni_slabs;   // every slab, so pooled blocks remain reachable
+
+// The smallest class holding size bytes
+static inline size_t pni_slab_class(size_t size)
+{
+  size_t lo = 0;
+  size_t hi = PNI_SLAB_CLASSES;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (pni_slab_sizes[mid] < size) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+static inline size_t pni_slab_blocks(size_t cls)
+{
+  return (PNI_SLAB_SIZE - sizeof(pni_slab_t)) / pni_slab_sizes[cls];
+}
+
+// Detach up to n blocks from the front of list
+static pni_slab_free_t *pni_slab_take(pni_slab_list_t *list, size_t n, pni_slab_free_t **last, size_t *taken)
+{
+  pni_slab_free_t *first = list->head;
+  pni_slab_free_t *end = first;
+  size_t count = 1;
+  while (count < n && end->next) {
+    end = end->next;
+    count++;
+  }
+  list->head = end->next;
+  list->count -= count;
+  end->next = NULL;
+  *last = end;
+  *taken = count;
+  return first;
+}
+
+static inline void pni_slab_give(pni_slab_list_t *list, pni_slab_free_t *first, pni_slab_free_t *last, size_t count)
+{
+  last->next = list->head;
+  list->head = first;
+  list->count += count;
+}
+
+static bool pni_slab_refill(pni_slab_list_t *cache, size_t cls)
+{
+  pni_slab_free_t *first = NULL;
+  pni_slab_free_t *last = NULL;
+  size_t count = 0;
+
+  pni_spin_lock(&pni_slab_lock);
+  pni_slab_list_t *pool = &pni_slab_pool[cls];
+  if (pool->head) {
+    first = pni_slab_take(pool, pni_slab_blocks(cls), &last, &count);
+  }
+  pni_spin_unlock(&pni_slab_lock);
+
+  if (!first) {
+    pni_slab_t *slab = (pni_slab_t *) malloc(PNI_SLAB_SIZE);
+    if (!slab) return false;
+    size_t size = pni_slab_sizes[cls];
+    char *block = (char *) (slab + 1);
+    count = pni_slab_blocks(cls);
+    for (size_t i = 0; i < count; i++, block += size) {
+      pni_slab_free_t *f = (pni_slab_free_t *) block;
+      f->next = first;
+      if (!first) last = f;
+      first = f;
+    }
+    pni_spin_lock(&pni_slab_lock);
+    slab->next = pni_slabs;
+    pni_slabs = slab;
+    pni_spin_unlock(&pni_slab_lock);
+  }
+
+  pni_slab_give(cache, first, last, count);
+  return true;
+}
+
+// Return half of an overgrown cache to the pool
+static void pni_slab_drain(pni_slab_list_t *cache, size_t cls)
+{
+  pni_slab_free_t *last;
+  size_t count;
+  pni_slab_free_t *first = pni_slab_take(cache, cache->count / 2, &last, &count);
+
+  pni_spin_lock(&pni_slab_lock);
+  pni_slab_give(&pni_slab_pool[cls], first, last, count);
+  pni_spin_unlock(&pni_slab_lock);
+}
+
+static void *pni_slab_allocate(void *context, size_t size)
+{
+  pni_slab_header_t *header;
+  if (size <= PNI_SLAB_MAX - sizeof(pni_slab_header_t)) {
+    size_t cls = pni_slab_class(size + sizeof(pni_slab_header_t));
+    pni_slab_list_t *cache = &pni_slab_cache[cls];
+    if (!cache->head && !pni_slab_refill(cache, cls)) return NULL;
+    header = (pni_slab_header_t *) cache->head;
+    cache->head = cache->head->next;
+    cache->count--;
+    header->block.cls = cls;
+    header->block.size = pni_slab_sizes[cls] - sizeof(pni_slab_header_t);
+  } else {
+    if (size > SIZE_MAX - sizeof(pni_slab_header_t)) return NULL;
+    header = (pni_slab_header_t *) malloc(sizeof(pni_slab_header_t) + size);
+    if (!header) return NULL;
+    header->block.cls = PNI_SLAB_LARGE;
+    header->block.size = size;
+  }
+  return header + 1;
+}
+
+static void pni_slab_deallocate(void *context, void *object)
+{
+  if (!object) return;
+  pni_slab_header_t *header = (pni_slab_header_t *) object - 1;
+  size_t cls = header->block.cls;
+  if (cls == PNI_SLAB_LARGE) {
+    free(header);
+    return;
+  }
+  pni_slab_list_t *cache = &pni_slab_cache[cls];
+  pni_slab_free_t *f = (pni_slab_free_t *) header;
+  f->next = cache->head;
+  cache->head = f;
+  if (++cache->count > 2 * pni_slab_blocks(cls)) {
+    pni_slab_drain(cache, cls);
+  }
+}
+
+static void *pni_slab_reallocate(void *context, void *object, size_t size)
+{
+  if (!object) return pni_slab_allocate(context, size);
+  pni_slab_header_t *header = (pni_slab_header_t *) object - 1;
+  if (header->block.cls == PNI_SLAB_LARGE) {
+    if (size > PNI_SLAB_MAX - sizeof(pni_slab_header_t)) {
+      if (size > SIZE_MAX - sizeof(pni_slab_header_t)) return NULL;
+      header = (pni_slab_header_t *) realloc(header, sizeof(pni_slab_header_t) + size);
+      if (!header) return NULL;
+      header->block.size = size;
+      return header + 1;
+    }
+  } else if (size <= header->block.size) {
+    return object;
+  }
+  void *moved = pni_slab_allocate(context, size);
+  if (!moved) return NULL;
+  memcpy(moved, object, pn_min(size, header->block.size));
+  pni_slab_deallocate(context, object);
+  return moved;
+}
+
+static const pn_allocator_t pni_slab_allocator = {
+  pni_slab_allocate,
+  pni_slab_reallocate,
+  pni_slab_deallocate,
+  NULL
+};
+
+const pn_allocator_t *pn_slab_allocator(void)
+{
+  return &pni_slab_allocator;
+}
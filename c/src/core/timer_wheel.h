@@ -0,0 +1,237 @@
+#ifndef PROTON_TIMER_WHEEL_H
+#define PROTON_TIMER_WHEEL_H 1
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <proton/type_compat.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Hierarchical timer wheel
+ *
+ * Timers are intrusive entries with a deadline in whatever unit the user
+ * keeps time in, normally milliseconds. Level l of the wheel has 64 slots
+ * each spanning 64^l units; an entry sits at the level of the highest 6 bit
+ * group in which its deadline differs from the wheel's current time, in the
+ * slot given by that group of the deadline. Adding and removing an entry are
+ * constant time.
+ *
+ * pni_timer_wheel_advance() moves the current time forward. Entries in a slot
+ * of a higher level are redistributed to the lower levels once time reaches
+ * the start of the slot, and entries that are due are moved to an expired
+ * list in deadline order, from which pni_timer_wheel_pop() takes them. Time
+ * jumps straight from one occupied slot to the next, so advancing over an
+ * idle period costs nothing.
+ *
+ * pni_timer_wheel_next() is the earliest time the wheel needs advancing: the
+ * exact deadline for entries due within the current 64 units, or the start of
+ * the slot holding later ones.
+ *
+ * This is header only so that it can be shared by the proactor and the C++
+ * container. It does no locking.
+ */
+
+#define PNI_WHEEL_BITS 6
+#define PNI_WHEEL_SLOTS (1 << PNI_WHEEL_BITS)
+#define PNI_WHEEL_LEVELS ((64 + PNI_WHEEL_BITS - 1) / PNI_WHEEL_BITS)
+#define PNI_WHEEL_EXPIRED (PNI_WHEEL_LEVELS * PNI_WHEEL_SLOTS + 1)
+
+typedef struct pni_timer_entry_t {
+  struct pni_timer_entry_t *next;
+  struct pni_timer_entry_t **pprev;
+  uint64_t deadline;
+  uint16_t where;   // slot index + 1, PNI_WHEEL_EXPIRED or 0 if not on the wheel
+} pni_timer_entry_t;
+
+typedef struct pni_timer_wheel_t {
+  uint64_t now;
+  uint64_t occupied[PNI_WHEEL_LEVELS];  // bitmap of non-empty slots per level
+  pni_timer_entry_t *slots[PNI_WHEEL_LEVELS * PNI_WHEEL_SLOTS];
+  pni_timer_entry_t *expired;
+  pni_timer_entry_t **expired_end;
+  size_t count;
+} pni_timer_wheel_t;
+
+static inline int pni_wheel_lowest_bit(uint64_t x)
+{
+#if defined(__GNUC__)
+  return __builtin_ctzll(x);
+#else
+  int n = 0;
+  while (!(x & 1)) { x >>= 1; n++; }
+  return n;
+#endif
+}
+
+static inline int pni_wheel_highest_bit(uint64_t x)
+{
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll(x);
+#else
+  int n = 0;
+  while (x >>= 1) n++;
+  return n;
+#endif
+}
+
+static inline void pni_timer_entry_init(pni_timer_entry_t *e)
+{
+  e->next = NULL;
+  e->pprev = NULL;
+  e->deadline = 0;
+  e->where = 0;
+}
+
+static inline bool pni_timer_entry_scheduled(const pni_timer_entry_t *e)
+{
+  return e->where != 0;
+}
+
+static inline void pni_timer_wheel_init(pni_timer_wheel_t *w, uint64_t now)
+{
+  w->now = now;
+  for (int l = 0; l < PNI_WHEEL_LEVELS; l++) w->occupied[l] = 0;
+  for (int s = 0; s < PNI_WHEEL_LEVELS * PNI_WHEEL_SLOTS; s++) w->slots[s] = NULL;
+  w->expired = NULL;
+  w->expired_end = &w->expired;
+  w->count = 0;
+}
+
+static inline bool pni_timer_wheel_empty(const pni_timer_wheel_t *w)
+{
+  return w->count == 0;
+}
+
+static inline void pni_wheel_link(pni_timer_entry_t **pprev, pni_timer_entry_t *e)
+{
+  e->next = *pprev;
+  if (e->next) e->next->pprev = &e->next;
+  e->pprev = pprev;
+  *pprev = e;
+}
+
+static inline void pni_wheel_expire(pni_timer_wheel_t *w, pni_timer_entry_t *e)
+{
+  pni_wheel_link(w->expired_end, e);
+  w->expired_end = &e->next;
+  e->where = PNI_WHEEL_EXPIRED;
+}
+
+// Place an entry relative to the current time, e is not linked anywhere
+static inline void pni_wheel_place(pni_timer_wheel_t *w, pni_timer_entry_t *e)
+{
+  if (e->deadline <= w->now) {
+    pni_wheel_expire(w, e);
+    return;
+  }
+  int level = pni_wheel_highest_bit(e->deadline ^ w->now) / PNI_WHEEL_BITS;
+  int slot = (e->deadline >> (level * PNI_WHEEL_BITS)) & (PNI_WHEEL_SLOTS - 1);
+  int index = level * PNI_WHEEL_SLOTS + slot;
+  pni_wheel_link(&w->slots[index], e);
+  w->occupied[level] |= (uint64_t) 1 << slot;
+  e->where = index + 1;
+}
+
+// Add e, which must not already be on the wheel
+static inline void pni_timer_wheel_add(pni_timer_wheel_t *w, pni_timer_entry_t *e, uint64_t deadline)
+{
+  e->deadline = deadline;
+  pni_wheel_place(w, e);
+  w->count++;
+}
+
+// Take e off the wheel if it is on it
+static inline void pni_timer_wheel_remove(pni_timer_wheel_t *w, pni_timer_entry_t *e)
+{
+  if (!e->where) return;
+  if (e->where == PNI_WHEEL_EXPIRED) {
+    if (w->expired_end == &e->next) w->expired_end = e->pprev;
+  } else if (!e->next && e->pprev == &w->slots[e->where - 1]) {
+    int index = e->where - 1;
+    w->occupied[index / PNI_WHEEL_SLOTS] &= ~((uint64_t) 1 << (index % PNI_WHEEL_SLOTS));
+  }
+  *e->pprev = e->next;
+  if (e->next) e->next->pprev = e->pprev;
+  e->next = NULL;
+  e->pprev = NULL;
+  e->where = 0;
+  w->count--;
+}
+
+// Start of the earliest occupied slot, 0 if there are none
+static inline uint64_t pni_wheel_next_slot(const pni_timer_wheel_t *w)
+{
+  for (int l = 0; l < PNI_WHEEL_LEVELS; l++) {
+    if (w->occupied[l]) {
+      int shift = (l + 1) * PNI_WHEEL_BITS;
+      uint64_t base = shift < 64 ? (w->now >> shift) << shift : 0;
+      return base | ((uint64_t) pni_wheel_lowest_bit(w->occupied[l]) << (l * PNI_WHEEL_BITS));
+    }
+  }
+  return 0;
+}
+
+// Earliest time the wheel needs advancing, 0 if it is empty
+static inline uint64_t pni_timer_wheel_next(const pni_timer_wheel_t *w)
+{
+  return w->expired ? w->now : pni_wheel_next_slot(w);
+}
+
+// Move time forward to now, moving every entry that is due to the expired list
+static inline void pni_timer_wheel_advance(pni_timer_wheel_t *w, uint64_t now)
+{
+  while (w->now < now) {
+    uint64_t t = pni_wheel_next_slot(w);
+    if (!t || t > now) {
+      w->now = now;
+      return;
+    }
+    w->now = t;
+    // Cascade from the top so entries reaching level 0 at t expire together
+    for (int l = PNI_WHEEL_LEVELS - 1; l >= 0; l--) {
+      int shift = l * PNI_WHEEL_BITS;
+      if (l && (t & (((uint64_t) 1 << shift) - 1))) continue;
+      int slot = (t >> shift) & (PNI_WHEEL_SLOTS - 1);
+      if (!(w->occupied[l] & ((uint64_t) 1 << slot))) continue;
+      w->occupied[l] &= ~((uint64_t) 1 << slot);
+      pni_timer_entry_t *e = w->slots[l * PNI_WHEEL_SLOTS + slot];
+      w->slots[l * PNI_WHEEL_SLOTS + slot] = NULL;
+      while (e) {
+        pni_timer_entry_t *next = e->next;
+        pni_wheel_place(w, e);
+        e = next;
+      }
+    }
+  }
+}
+
+// Take the next expired entry off the wheel, NULL if there are none
+static inline pni_timer_entry_t *pni_timer_wheel_pop(pni_timer_wheel_t *w)
+{
+  pni_timer_entry_t *e = w->expired;
+  if (e) pni_timer_wheel_remove(w, e);
+  return e;
+}
+
+#endif /* timer_wheel.h */
@@ -36,6 +36,7 @@
 #include "proton/event.h"
 
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <stdarg.h>
@@ -72,26 +73,50 @@ static void pni_calculate_channel_max(pn_transport_t *transport) {
   }
 }
 
-void pn_delivery_map_init(pn_delivery_map_t *db, pn_sequence_t next)
+void pn_delivery_map_init(pn_delivery_map_t *db, const pn_class_t *clazz, void *object, pn_sequence_t next)
 {
-  db->deliveries = pn_hash(PN_WEAKREF, 0, 0.75);
+  db->clazz = clazz;
+  db->object = object;
+  db->ring = NULL;
+  db->spilled = NULL;
+  db->capacity = 0;
+  db->size = 0;
+  db->base = next;
   db->next = next;
 }
 
 void pn_delivery_map_free(pn_delivery_map_t *db)
 {
-  pn_free(db->deliveries);
+  pni_mem_subdeallocate(db->clazz, db->object, db->ring);
+  pn_free(db->spilled);
+  db->ring = NULL;
+  db->spilled = NULL;
+  db->capacity = 0;
 }
 
+// Largest ring, deliveries older than this many ids go to the hash
+#define PNI_DELIVERY_RING_MAX (16*1024)
+
 static inline uintptr_t pni_sequence_make_hash ( pn_sequence_t i )
 {
   return i & 0x00000000FFFFFFFFUL;
 }
 
+static inline pn_delivery_t **pni_delivery_map_slot(pn_delivery_map_t *db, pn_sequence_t id)
+{
+  return &db->ring[id & (db->capacity - 1)];
+}
+
+static inline bool pni_delivery_map_in_ring(pn_delivery_map_t *db, pn_sequence_t id)
+{
+  return db->size && id - db->base < db->next - db->base;
+}
 
 static pn_delivery_t *pni_delivery_map_get(pn_delivery_map_t *db, pn_sequence_t id)
 {
-  return (pn_delivery_t *) pn_hash_get(db->deliveries, pni_sequence_make_hash(id) );
+  if (pni_delivery_map_in_ring(db, id)) return *pni_delivery_map_slot(db, id);
+  if (!db->spilled || !pn_hash_size(db->spilled)) return NULL;
+  return (pn_delivery_t *) pn_hash_get(db->spilled, pni_sequence_make_hash(id));
 }
 
 static void pn_delivery_state_init(pn_delivery_state_t *ds, pn_delivery_t *delivery, pn_sequence_t id)
@@ -100,13 +125,66 @@ static void pn_delivery_state_init(pn_delivery_state_t *ds, pn_delivery_t *deliv
   ds->sending = false;
   ds->sent = false;
   ds->init = true;
+  ds->disp_pending = false;
+}
+
+// Move the deliveries to a ring twice the size
+static bool pni_delivery_map_grow(pn_delivery_map_t *db)
+{
+  uint32_t capacity = db->capacity ? 2*db->capacity : 16;
+  pn_delivery_t **ring = (pn_delivery_t **) pni_mem_suballocate(db->clazz, db->object, capacity * sizeof(pn_delivery_t *));
+  if (!ring) return false;
+  memset(ring, 0, capacity * sizeof(pn_delivery_t *));
+  if (db->size) {
+    for (pn_sequence_t id = db->base; id != db->next; ++id) {
+      ring[id & (capacity - 1)] = *pni_delivery_map_slot(db, id);
+    }
+  }
+  pni_mem_subdeallocate(db->clazz, db->object, db->ring);
+  db->ring = ring;
+  db->capacity = capacity;
+  return true;
+}
+
+// Advance base past the slots that are empty
+static void pni_delivery_map_trim(pn_delivery_map_t *db)
+{
+  while (db->base != db->next && !*pni_delivery_map_slot(db, db->base)) {
+    db->base++;
+  }
+}
+
+// Move the oldest delivery in the ring to the hash
+static bool pni_delivery_map_spill(pn_delivery_map_t *db)
+{
+  if (!db->spilled) {
+    db->spilled = pn_hash(PN_WEAKREF, 0, 0.75);
+    if (!db->spilled) return false;
+  }
+  pn_delivery_t **slot = pni_delivery_map_slot(db, db->base);
+  if (pn_hash_put(db->spilled, pni_sequence_make_hash(db->base), *slot)) return false;
+  *slot = NULL;
+  db->size--;
+  db->base++;
+  pni_delivery_map_trim(db);
+  return true;
 }
 
 static pn_delivery_state_t *pni_delivery_map_push(pn_delivery_map_t *db, pn_delivery_t *delivery)
 {
+  // next may have been reset while the ring was empty
+  if (!db->size) db->base = db->next;
+  if (db->next - db->base == db->capacity) {
+    if (db->capacity < PNI_DELIVERY_RING_MAX) {
+      if (!pni_delivery_map_grow(db)) return NULL;
+    } else {
+      if (!pni_delivery_map_spill(db)) return NULL;
+    }
+  }
   pn_delivery_state_t *ds = &delivery->state;
   pn_delivery_state_init(ds, delivery, db->next++);
-  pn_hash_put(db->deliveries, pni_sequence_make_hash(ds->id), delivery);
+  *pni_delivery_map_slot(db, ds->id) = delivery;
+  db->size++;
   return ds;
 }
 
@@ -116,23 +194,117 @@ void pn_delivery_map_del(pn_delivery_map_t *db, pn_delivery_t *delivery)
     delivery->state.init = false;
     delivery->state.sending = false;
     delivery->state.sent = false;
-    pn_hash_del(db->deliveries, pni_sequence_make_hash(delivery->state.id) );
+    delivery->state.disp_pending = false;
+    pn_sequence_t id = delivery->state.id;
+    if (pni_delivery_map_in_ring(db, id)) {
+      pn_delivery_t **slot = pni_delivery_map_slot(db, id);
+      assert(*slot == delivery);
+      *slot = NULL;
+      db->size--;
+      pni_delivery_map_trim(db);
+    } else {
+      assert(db->spilled);
+      pn_hash_del(db->spilled, pni_sequence_make_hash(id));
+    }
   }
 }
 
 static void pni_delivery_map_clear(pn_delivery_map_t *dm)
 {
-  pn_hash_t *hash = dm->deliveries;
-  for (pn_handle_t entry = pn_hash_head(hash);
-       entry;
-       entry = pn_hash_next(hash, entry))
-  {
-    pn_delivery_t *dlv = (pn_delivery_t *) pn_hash_value(hash, entry);
-    pn_delivery_map_del(dm, dlv);
+  while (dm->size) {
+    pn_delivery_map_del(dm, *pni_delivery_map_slot(dm, dm->base));
+  }
+  while (dm->spilled && pn_hash_size(dm->spilled)) {
+    pn_delivery_map_del(dm, (pn_delivery_t *) pn_hash_value(dm->spilled, pn_hash_head(dm->spilled)));
   }
+  dm->base = 0;
   dm->next = 0;
 }
 
+void pni_disp_set_init(pni_disp_set_t *set, const pn_class_t *clazz, void *object)
+{
+  set->clazz = clazz;
+  set->object = object;
+  set->ranges = NULL;
+  set->count = 0;
+  set->capacity = 0;
+  set->deliveries = 0;
+  set->deadline = 0;
+}
+
+void pni_disp_set_free(pni_disp_set_t *set)
+{
+  pni_mem_subdeallocate(set->clazz, set->object, set->ranges);
+  set->ranges = NULL;
+  set->capacity = 0;
+}
+
+static void pni_disp_set_clear(pni_disp_set_t *set)
+{
+  set->count = 0;
+  set->deliveries = 0;
+  set->deadline = 0;
+}
+
+// Order of ranges: by outcome, then by id
+static int pni_disp_range_cmp(const pni_disp_range_t *range, bool role, bool settled, uint64_t code, pn_sequence_t id)
+{
+  if (range->role != role) return range->role ? 1 : -1;
+  if (range->settled != settled) return range->settled ? 1 : -1;
+  if (range->code != code) return range->code > code ? 1 : -1;
+  return (int32_t) (range->first - id) > 0 ? 1 : -1;
+}
+
+static inline bool pni_disp_range_same(const pni_disp_range_t *range, bool role, bool settled, uint64_t code)
+{
+  return range->role == role && range->settled == settled && range->code == code;
+}
+
+// Add the disposition of one delivery, which must not already be in the set
+static int pni_disp_set_add(pni_disp_set_t *set, bool role, bool settled, uint64_t code, pn_sequence_t id)
+{
+  // First range that comes after id
+  size_t lo = 0;
+  size_t hi = set->count;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (pni_disp_range_cmp(&set->ranges[mid], role, settled, code, id) < 0) lo = mid + 1;
+    else hi = mid;
+  }
+
+  pni_disp_range_t *prev = lo > 0 && pni_disp_range_same(&set->ranges[lo-1], role, settled, code) ? &set->ranges[lo-1] : NULL;
+  pni_disp_range_t *next = lo < set->count && pni_disp_range_same(&set->ranges[lo], role, settled, code) ? &set->ranges[lo] : NULL;
+  if (prev && prev->last + 1 == id) {
+    prev->last = id;
+    if (next && next->first == id + 1) {
+      prev->last = next->last;
+      memmove(next, next + 1, (set->count - lo - 1) * sizeof(pni_disp_range_t));
+      set->count--;
+    }
+  } else if (next && next->first == id + 1) {
+    next->first = id;
+  } else {
+    if (set->count == set->capacity) {
+      size_t capacity = set->capacity ? 2*set->capacity : 8;
+      pni_disp_range_t *ranges = (pni_disp_range_t *)
+        pni_mem_subreallocate(set->clazz, set->object, set->ranges, capacity * sizeof(pni_disp_range_t));
+      if (!ranges) return PN_OUT_OF_MEMORY;
+      set->ranges = ranges;
+      set->capacity = capacity;
+    }
+    pni_disp_range_t *range = &set->ranges[lo];
+    memmove(range + 1, range, (set->count - lo) * sizeof(pni_disp_range_t));
+    set->count++;
+    range->role = role;
+    range->settled = settled;
+    range->code = code;
+    range->first = id;
+    range->last = id;
+  }
+  set->deliveries++;
+  return 0;
+}
+
 static ssize_t pn_io_layer_input_passthru(pn_transport_t *, unsigned int, const char *, size_t );
 static ssize_t pn_io_layer_output_passthru(pn_transport_t *, unsigned int, char *, size_t );
 
@@ -399,6 +571,7 @@ static void pn_transport_initialize(void *object)
   pn_transport_t *transport = (pn_transport_t *)object;
   transport->freed = false;
   transport->output_buf = NULL;
+  memset(&transport->output_queue, 0, sizeof(transport->output_queue));
   transport->output_size = PN_TRANSPORT_INITIAL_BUFFER_SIZE;
   transport->input_buf = NULL;
   transport->input_size =  PN_TRANSPORT_INITIAL_BUFFER_SIZE;
@@ -411,8 +584,12 @@ static void pn_transport_initialize(void *object)
   transport->args = pn_data(16);
   transport->output_args = pn_data(16);
   transport->frame = pn_buffer(PN_TRANSPORT_INITIAL_FRAME_SIZE);
+  transport->encoded_state = pn_buffer(64);
   transport->input_frames_ct = 0;
   transport->output_frames_ct = 0;
+  transport->disp_frames_saved = 0;
+  transport->disp_delay = 0;
+  transport->disp_batch = 0;
 
   transport->connection = NULL;
   transport->context = pn_record();
@@ -566,8 +743,7 @@ pn_transport_t *pn_transport(void)
     return NULL;
   }
 
-  transport->output_buffer = pn_buffer(4*1024);
-  if (!transport->output_buffer) {
+  if (pni_output_queue_init(&transport->output_queue, &clazz, transport, 4*1024)) {
     pn_transport_free(transport);
     return NULL;
   }
@@ -650,8 +826,8 @@ static void pn_transport_finalize(void *object)
 
   pn_ssl_free(transport);
   pn_sasl_free(transport);
-  pni_mem_deallocate(PN_CLASSCLASS(pn_strdup), transport->remote_container);
-  pni_mem_deallocate(PN_CLASSCLASS(pn_strdup), transport->remote_hostname);
+  free(transport->remote_container);
+  free(transport->remote_hostname);
   pn_free(transport->remote_offered_capabilities);
   pn_free(transport->remote_desired_capabilities);
   pn_free(transport->remote_properties);
@@ -667,8 +843,9 @@ static void pn_transport_finalize(void *object)
   pn_data_free(transport->args);
   pn_data_free(transport->output_args);
   pn_buffer_free(transport->frame);
+  pn_buffer_free(transport->encoded_state);
   pn_free(transport->context);
-  pn_buffer_free(transport->output_buffer);
+  pni_output_queue_fini(&transport->output_queue);
   pni_logger_fini(&transport->logger);
 }
 
@@ -774,6 +951,7 @@ int pn_transport_unbind(pn_transport_t *transport)
   while (ssn) {
     pni_delivery_map_clear(&ssn->state.incoming);
     pni_delivery_map_clear(&ssn->state.outgoing);
+    pni_disp_set_clear(&ssn->state.disp);
     ssn = pn_session_next(ssn, 0);
   }
 
@@ -845,6 +1023,7 @@ static pn_link_t *pni_handle_state(pn_session_t *ssn, uint32_t handle)
 bool pni_disposition_batchable(pn_disposition_t *disposition)
 {
   switch (disposition->type) {
+  case 0:           // settled with no outcome
   case PN_ACCEPTED:
     return true;
   case PN_RELEASED:
@@ -906,6 +1085,65 @@ void pn_do_trace(pn_transport_t *transport, uint16_t ch, pn_dir_t dir,
   }
 }
 
+// The direct encoders don't build a pn_data_t, so make one for the frame log
+static void pni_trace_performative(pn_transport_t *transport, uint16_t ch, pn_bytes_t performative,
+                                   const char *payload, size_t size)
+{
+  if (PN_SHOULD_LOG(&transport->logger, PN_SUBSYSTEM_AMQP, PN_LEVEL_FRAME)) {
+    pn_data_clear(transport->output_args);
+    pn_data_decode_borrowed(transport->output_args, performative.start, performative.size);
+    pn_do_trace(transport, ch, OUT, transport->output_args, payload, size);
+    pn_data_clear(transport->output_args);
+  }
+}
+
+static int pni_post_encoded_frame(pn_transport_t *transport, uint8_t type, uint16_t ch, pn_bytes_t performative)
+{
+  pn_frame_t frame = {AMQP_FRAME_TYPE};
+  frame.type = type;
+  frame.channel = ch;
+  frame.payload = performative.start;
+  frame.size = performative.size;
+  if (!pn_write_frame(&transport->output_queue, frame, NULL, 0, 0)) {
+    return PN_OUT_OF_MEMORY;
+  }
+  transport->output_frames_ct += 1;
+  if (PN_SHOULD_LOG(&transport->logger, PN_SUBSYSTEM_IO, PN_LEVEL_RAW)) {
+    pn_string_set(transport->scratch, "RAW: \"");
+    pn_buffer_quote(transport->output_queue.bytes, transport->scratch, AMQP_HEADER_SIZE+frame.ex_size+frame.size);
+    pn_string_addf(transport->scratch, "\"");
+    pni_logger_log(&transport->logger, PN_SUBSYSTEM_IO, PN_LEVEL_RAW, pn_string_get(transport->scratch));
+  }
+
+  return 0;
+}
+
+/*
+ * Encode a delivery-state for the state field of a performative. The
+ * encoding is kept in transport->encoded_state until the next call.
+ */
+static int pni_encode_delivery_state(pn_transport_t *transport, uint64_t code, pn_data_t *fields, pn_bytes_t *encoded)
+{
+  pn_data_clear(transport->output_args);
+  int err = pn_data_fill(transport->output_args, "DLC", code, fields);
+  if (err) {
+    pn_logger_logf(&transport->logger, PN_SUBSYSTEM_AMQP, PN_LEVEL_ERROR,
+                      "error encoding delivery state: %s: %s", pn_code(err),
+                      pn_error_text(pn_data_error(transport->output_args)));
+    return PN_ERR;
+  }
+  pn_buffer_t *buf = transport->encoded_state;
+  ssize_t size = pn_data_encoded_size(transport->output_args);
+  if (size < 0) return (int) size;
+  pn_buffer_clear(buf);
+  pn_buffer_ensure(buf, size);
+  pn_rwbytes_t mem = pn_buffer_memory(buf);
+  ssize_t wr = pn_data_encode(transport->output_args, mem.start, pn_buffer_available(buf));
+  if (wr < 0) return (int) wr;
+  *encoded = pn_bytes(wr, mem.start);
+  return 0;
+}
+
 int pn_post_frame(pn_transport_t *transport, uint8_t type, uint16_t ch, const char *fmt, ...)
 {
   pn_buffer_t *frame_buf = transport->frame;
@@ -939,28 +1177,57 @@ int pn_post_frame(pn_transport_t *transport, uint8_t type, uint16_t ch, const ch
     return PN_ERR;
   }
 
-  pn_frame_t frame = {AMQP_FRAME_TYPE};
-  frame.type = type;
-  frame.channel = ch;
-  frame.payload = buf.start;
-  frame.size = wr;
-  pn_buffer_ensure(transport->output_buffer, AMQP_HEADER_SIZE+frame.ex_size+frame.size);
-  pn_write_frame(transport->output_buffer, frame);
-  transport->output_frames_ct += 1;
-  if (PN_SHOULD_LOG(&transport->logger, PN_SUBSYSTEM_IO, PN_LEVEL_RAW)) {
-    pn_string_set(transport->scratch, "RAW: \"");
-    pn_buffer_quote(transport->output_buffer, transport->scratch, AMQP_HEADER_SIZE+frame.ex_size+frame.size);
-    pn_string_addf(transport->scratch, "\"");
-    pni_logger_log(&transport->logger, PN_SUBSYSTEM_IO, PN_LEVEL_RAW, pn_string_get(transport->scratch));
+  return pni_post_encoded_frame(transport, type, ch, pn_bytes(wr, buf.start));
+}
+
+/*
+ * Post a performative encoded by one of the direct encoders in
+ * performatives.h. Like pn_post_frame() but pn_data_t is only used if the
+ * frame is going to be logged.
+ */
+static int pni_post_performative(pn_transport_t *transport, uint16_t ch, pn_bytes_t performative)
+{
+  pni_trace_performative(transport, ch, performative, NULL, 0);
+  return pni_post_encoded_frame(transport, AMQP_FRAME_TYPE, ch, performative);
+}
+
+static int pni_post_flow_frame(pn_transport_t *transport, uint16_t ch, const pni_amqp_flow_t *flow)
+{
+  pn_buffer_t *frame_buf = transport->frame;
+
+ encode_performative:
+  pn_buffer_clear(frame_buf);
+  pn_rwbytes_t buf = pn_buffer_memory(frame_buf);
+  buf.size = pn_buffer_available(frame_buf);
+  size_t size = pni_amqp_encode_flow(buf, flow);
+  if (size > buf.size) {
+    pn_buffer_ensure(frame_buf, size);
+    goto encode_performative;
   }
+  return pni_post_performative(transport, ch, pn_bytes(size, buf.start));
+}
 
-  return 0;
+static int pni_post_disposition_frame(pn_transport_t *transport, uint16_t ch, const pni_amqp_disposition_t *disposition)
+{
+  pn_buffer_t *frame_buf = transport->frame;
+
+ encode_performative:
+  pn_buffer_clear(frame_buf);
+  pn_rwbytes_t buf = pn_buffer_memory(frame_buf);
+  buf.size = pn_buffer_available(frame_buf);
+  size_t size = pni_amqp_encode_disposition(buf, disposition);
+  if (size > buf.size) {
+    pn_buffer_ensure(frame_buf, size);
+    goto encode_performative;
+  }
+  return pni_post_performative(transport, ch, pn_bytes(size, buf.start));
 }
 
 static int pni_post_amqp_transfer_frame(pn_transport_t *transport, uint16_t ch,
                                         uint32_t handle,
                                         pn_sequence_t id,
-                                        pn_bytes_t *payload,
+                                        pn_buffer_t *payload,
+                                        size_t *sent,
                                         const pn_bytes_t *tag,
                                         uint32_t message_format,
                                         bool settled,
@@ -970,33 +1237,37 @@ static int pni_post_amqp_transfer_frame(pn_transport_t *transport, uint16_t ch,
                                         pn_data_t* state,
                                         bool resume,
                                         bool aborted,
-                                        bool batchable)
+                                        bool batchable,
+                                        bool borrow)
 {
   bool more_flag = more;
   unsigned framecount = 0;
   pn_buffer_t *frame = transport->frame;
 
+  pni_amqp_transfer_t transfer;
+  memset(&transfer, 0, sizeof(transfer));
+  transfer.handle = handle;
+  transfer.handle_present = true;
+  transfer.delivery_id = id;
+  transfer.delivery_id_present = true;
+  transfer.delivery_tag = *tag;
+  transfer.delivery_tag_present = tag->start != NULL;
+  transfer.message_format = message_format;
+  transfer.message_format_present = true;
+  transfer.settled = transfer.settled_present = settled;
+  transfer.resume = transfer.resume_present = resume;
+  transfer.aborted = transfer.aborted_present = aborted;
+  transfer.batchable = transfer.batchable_present = batchable;
+  if (code) {
+    int err = pni_encode_delivery_state(transport, code, state, &transfer.state);
+    if (err) return err;
+    transfer.state_present = true;
+  }
+
   // create performatives, assuming 'more' flag need not change
 
  compute_performatives:
-  pn_data_clear(transport->output_args);
-  int err = pn_data_fill(transport->output_args, "DL[IIzI?o?on?DLC?o?o?o]", TRANSFER,
-                         handle,
-                         id,
-                         tag->size, tag->start,
-                         message_format,
-                         settled, settled,
-                         more_flag, more_flag,
-                         (bool)code, code, state,
-                         resume, resume,
-                         aborted, aborted,
-                         batchable, batchable);
-  if (err) {
-    pn_logger_logf(&transport->logger, PN_SUBSYSTEM_AMQP, PN_LEVEL_ERROR,
-                      "error posting transfer frame: %s: %s", pn_code(err),
-                      pn_error_text(pn_data_error(transport->output_args)));
-    return PN_ERR;
-  }
+  transfer.more = transfer.more_present = more_flag;
 
   do { // send as many frames as possible without changing the 'more' flag...
 
@@ -1005,19 +1276,15 @@ static int pni_post_amqp_transfer_frame(pn_transport_t *transport, uint16_t ch,
     pn_rwbytes_t buf = pn_buffer_memory( frame );
     buf.size = pn_buffer_available( frame );
 
-    ssize_t wr = pn_data_encode(transport->output_args, buf.start, buf.size);
-    if (wr < 0) {
-      if (wr == PN_OVERFLOW) {
-        pn_buffer_ensure( frame, pn_buffer_available( frame ) * 2 );
-        goto encode_performatives;
-      }
-      pn_logger_logf(&transport->logger, PN_SUBSYSTEM_AMQP, PN_LEVEL_ERROR, "error posting frame: %s", pn_code(wr));
-      return PN_ERR;
+    size_t wr = pni_amqp_encode_transfer(buf, &transfer);
+    if (wr > buf.size) {
+      pn_buffer_ensure( frame, wr );
+      goto encode_performatives;
     }
     buf.size = wr;
 
     // check if we need to break up the outbound frame
-    size_t available = payload->size;
+    size_t available = pn_buffer_size(payload) - *sent;
     if (transport->remote_max_frame) {
       if ((available + buf.size) > transport->remote_max_frame - 8) {
         available = transport->remote_max_frame - 8 - buf.size;
@@ -1032,35 +1299,40 @@ static int pni_post_amqp_transfer_frame(pn_transport_t *transport, uint16_t ch,
       }
     }
 
-    if (pn_buffer_available( frame ) < (available + buf.size)) {
+    if (!borrow && pn_buffer_available( frame ) < (available + buf.size)) {
       // not enough room for payload - try again...
       pn_buffer_ensure( frame, available + buf.size );
       goto encode_performatives;
     }
 
-    pn_do_trace(transport, ch, OUT, transport->output_args, payload->start, available);
+    if (PN_SHOULD_LOG(&transport->logger, PN_SUBSYSTEM_AMQP, PN_LEVEL_FRAME)) {
+      pn_bytes_t first = pn_buffer_chunk(payload, *sent);
+      pni_trace_performative(transport, ch, pn_bytes(buf.size, buf.start), first.start, pn_min(first.size, available));
+    }
 
-    memmove( buf.start + buf.size, payload->start, available);
-    payload->start += available;
-    payload->size -= available;
-    buf.size += available;
+    // A borrowed payload is written from the chunks it is held in, the caller keeps it alive
+    if (!borrow) {
+      buf.size += pn_buffer_get(payload, *sent, available, buf.start + buf.size);
+    }
 
     pn_frame_t frame = {AMQP_FRAME_TYPE};
     frame.channel = ch;
     frame.payload = buf.start;
     frame.size = buf.size;
 
-    pn_buffer_ensure(transport->output_buffer, AMQP_HEADER_SIZE+frame.ex_size+frame.size);
-    pn_write_frame(transport->output_buffer, frame);
+    if (!pn_write_frame(&transport->output_queue, frame, borrow ? payload : NULL, *sent, borrow ? available : 0)) {
+      return PN_OUT_OF_MEMORY;
+    }
+    *sent += available;
     transport->output_frames_ct += 1;
     framecount++;
     if (PN_SHOULD_LOG(&transport->logger, PN_SUBSYSTEM_IO, PN_LEVEL_RAW)) {
       pn_string_set(transport->scratch, "RAW: \"");
-      pn_buffer_quote(transport->output_buffer, transport->scratch, AMQP_HEADER_SIZE+frame.ex_size+frame.size);
+      pn_buffer_quote(transport->output_queue.bytes, transport->scratch, AMQP_HEADER_SIZE+frame.ex_size+frame.size);
       pn_string_addf(transport->scratch, "\"");
       pni_logger_log(&transport->logger, PN_SUBSYSTEM_IO, PN_LEVEL_RAW, pn_string_get(transport->scratch));
     }
-  } while (payload->size > 0 && framecount < frame_limit);
+  } while (*sent < pn_buffer_size(payload) && framecount < frame_limit);
 
   return framecount;
 }
@@ -1199,9 +1471,9 @@ int pn_do_open(pn_transport_t *transport, uint8_t frame_type, uint16_t channel,
       transport->remote_max_frame = AMQP_MIN_MAX_FRAME_SIZE;
     }
   }
-  pni_mem_deallocate(PN_CLASSCLASS(pn_strdup), transport->remote_container);
+  free(transport->remote_container);
   transport->remote_container = container_q ? pn_bytes_strdup(remote_container) : NULL;
-  pni_mem_deallocate(PN_CLASSCLASS(pn_strdup), transport->remote_hostname);
+  free(transport->remote_hostname);
   transport->remote_hostname = hostname_q ? pn_bytes_strdup(remote_hostname) : NULL;
 
   if (conn) {
@@ -1489,22 +1761,56 @@ static void pn_full_settle(pn_delivery_map_t *db, pn_delivery_t *delivery)
   pn_decref(delivery);
 }
 
-int pn_do_transfer(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload)
+/*
+ * The direct decoder leaves a delivery-state in its encoded form. Pick out
+ * its descriptor and decode its field list into disp_data, leaving them as
+ * pn_data_scan("D?LC") would have. Unless always is set the fields are only
+ * decoded when there are some, as most outcomes have none.
+ */
+static int pni_decode_delivery_state(pn_transport_t *transport, pn_bytes_t state, bool always,
+                                     bool *type_init, uint64_t *type, bool *remote_data)
+{
+  pn_data_clear(transport->disp_data);
+  *type_init = false;
+  *type = 0;
+  *remote_data = false;
+  if (!state.size) return 0;
+
+  pni_consumer_t consumer = make_consumer_from_bytes(state);
+  pni_consumer_t descriptor = consumer;
+  *type_init = pni_consumer_read_descriptor(&descriptor, type);
+
+  uint8_t code;
+  if (!pni_consumer_readf8(&consumer, &code) || code != PNE_DESCRIPTOR || !pni_consumer_skip_value(&consumer)) {
+    *type_init = false;
+    return 0;
+  }
+
+  pni_consumer_t fields = consumer;
+  pni_consumer_t list;
+  uint32_t count;
+  *remote_data = pni_consumer_enter_list(&fields, &list, &count) && count > 0;
+  if (always || *remote_data) {
+    ssize_t dsize = pn_data_decode(transport->disp_data, state.start + consumer.position, state.size - consumer.position);
+    if (dsize < 0) return (int) dsize;
+  }
+  return 0;
+}
+
+int pn_do_transfer(pn_transport_t *transport, uint16_t channel, const pni_amqp_transfer_t *transfer, const pn_bytes_t *payload)
 {
   // XXX: multi transfer
-  uint32_t handle;
-  pn_bytes_t tag;
-  bool id_present;
-  pn_sequence_t id;
-  bool settled;
-  bool more;
-  bool has_type, settled_set;
-  bool resume, aborted, batchable;
+  uint32_t handle = transfer->handle;
+  pn_bytes_t tag = transfer->delivery_tag;
+  bool id_present = transfer->delivery_id_present;
+  pn_sequence_t id = transfer->delivery_id;
+  bool settled = transfer->settled;
+  bool settled_set = transfer->settled_present;
+  bool more = transfer->more;
+  bool aborted = transfer->aborted;
+  bool has_type, has_fields;
   uint64_t type;
-  pn_data_clear(transport->disp_data);
-  int err = pn_data_scan(args, "D.[I?Iz.?oo.D?LCooo]", &handle, &id_present, &id, &tag,
-                         &settled_set, &settled, &more, &has_type, &type, transport->disp_data,
-                         &resume, &aborted, &batchable);
+  int err = pni_decode_delivery_state(transport, transfer->state, true, &has_type, &type, &has_fields);
   if (err) return err;
   pn_session_t *ssn = pni_channel_state(transport, channel);
   if (!ssn) {
@@ -1559,6 +1865,7 @@ int pn_do_transfer(pn_transport_t *transport, uint8_t frame_type, uint16_t chann
 
     delivery = pn_delivery(link, pn_dtag(tag.start, tag.size));
     pn_delivery_state_t *state = pni_delivery_map_push(incoming, delivery);
+    if (!state) return PN_OUT_OF_MEMORY;
     if (id_present && id != state->id) {
       return pn_do_error(transport, "amqp:session:invalid-field",
                          "sequencing error, expected delivery-id %u, got %u",
@@ -1617,16 +1924,17 @@ int pn_do_transfer(pn_transport_t *transport, uint8_t frame_type, uint16_t chann
   return 0;
 }
 
-int pn_do_flow(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload)
+int pn_do_flow(pn_transport_t *transport, uint16_t channel, const pni_amqp_flow_t *flow)
 {
-  pn_sequence_t onext, inext, delivery_count;
-  uint32_t iwin, owin, link_credit;
-  uint32_t handle;
-  bool inext_init, handle_init, dcount_init, drain;
-  int err = pn_data_scan(args, "D.[?IIII?I?II.o]", &inext_init, &inext, &iwin,
-                         &onext, &owin, &handle_init, &handle, &dcount_init,
-                         &delivery_count, &link_credit, &drain);
-  if (err) return err;
+  pn_sequence_t inext = flow->next_incoming_id;
+  pn_sequence_t delivery_count = flow->delivery_count;
+  uint32_t iwin = flow->incoming_window;
+  uint32_t link_credit = flow->link_credit;
+  uint32_t handle = flow->handle;
+  bool inext_init = flow->next_incoming_id_present;
+  bool handle_init = flow->handle_present;
+  bool dcount_init = flow->delivery_count_present;
+  bool drain = flow->drain;
 
   pn_session_t *ssn = pni_channel_state(transport, channel);
   if (!ssn) {
@@ -1764,18 +2072,16 @@ static int pni_do_delivery_disposition(pn_transport_t * transport, pn_delivery_t
   return 0;
 }
 
-int pn_do_disposition(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload)
+int pn_do_disposition(pn_transport_t *transport, uint16_t channel, const pni_amqp_disposition_t *disposition)
 {
-  bool role;
-  pn_sequence_t first, last;
-  uint64_t type = 0;
-  bool last_init, settled, type_init;
-  pn_data_clear(transport->disp_data);
-  int err = pn_data_scan(args, "D.[oI?IoD?LC]", &role, &first, &last_init,
-                         &last, &settled, &type_init, &type,
-                         transport->disp_data);
+  bool role = disposition->role;
+  pn_sequence_t first = disposition->first;
+  pn_sequence_t last = disposition->last_present ? disposition->last : first;
+  bool settled = disposition->settled;
+  uint64_t type;
+  bool type_init, remote_data;
+  int err = pni_decode_delivery_state(transport, disposition->state, false, &type_init, &type, &remote_data);
   if (err) return err;
-  if (!last_init) last = first;
 
   pn_session_t *ssn = pni_channel_state(transport, channel);
   if (!ssn) {
@@ -1793,34 +2099,32 @@ int pn_do_disposition(pn_transport_t *transport, uint8_t frame_type, uint16_t ch
     deliveries = &ssn->state.incoming;
   }
 
-  pn_data_rewind(transport->disp_data);
-  bool remote_data = (pn_data_next(transport->disp_data) &&
-                      pn_data_get_list(transport->disp_data) > 0);
-
   // Do some validation of received first and last values
   // TODO: We should really also clamp the first value here, but we're not keeping track of the earliest
   // unsettled delivery sequence no
   last = sequence_lte(last, deliveries->next) ? last : deliveries->next;
 
-  // If there are fewer deliveries in the session than the range then look at every delivery in the session
-  // otherwise look at every delivery_id in the disposition performative
-  pn_hash_t *dh = deliveries->deliveries;
-  if (last-first+1 >= pn_hash_size(dh)) {
-    for (pn_handle_t entry = pn_hash_head(dh); entry!=0 ; entry = pn_hash_next(dh, entry)) {
-      pn_sequence_t key = pn_hash_key(dh, entry);
+  // Deliveries that fell out of the ring, which this does not remove
+  pn_hash_t *spilled = deliveries->spilled;
+  if (spilled && pn_hash_size(spilled)) {
+    for (pn_handle_t entry = pn_hash_head(spilled); entry; entry = pn_hash_next(spilled, entry)) {
+      pn_sequence_t key = pn_hash_key(spilled, entry);
       if (sequence_lte(first, key) && sequence_lte(key, last)) {
-        pn_delivery_t *delivery = (pn_delivery_t*) pn_hash_value(dh, entry);
+        pn_delivery_t *delivery = (pn_delivery_t *) pn_hash_value(spilled, entry);
         err = pni_do_delivery_disposition(transport, delivery, settled, remote_data, type_init, type);
         if (err) return err;
       }
     }
-  } else {
-    for (pn_sequence_t id = first; sequence_lte(id, last); ++id) {
-      pn_delivery_t *delivery = pni_delivery_map_get(deliveries, id);
-      if (delivery) {
-        err = pni_do_delivery_disposition(transport, delivery, settled, remote_data, type_init, type);
-        if (err) return err;
-      }
+  }
+
+  // Only ids from the oldest delivery in the ring on can match
+  if (!deliveries->size) return 0;
+  first = sequence_lte(deliveries->base, first) ? first : deliveries->base;
+  for (pn_sequence_t id = first; sequence_lte(id, last); ++id) {
+    pn_delivery_t *delivery = pni_delivery_map_get(deliveries, id);
+    if (delivery) {
+      err = pni_do_delivery_disposition(transport, delivery, settled, remote_data, type_init, type);
+      if (err) return err;
     }
   }
 
@@ -2176,16 +2480,25 @@ static int pni_post_flow(pn_transport_t *transport, pn_session_t *ssn, pn_link_t
   ssn->state.incoming_window = pni_session_incoming_window(ssn);
   ssn->state.outgoing_window = pni_session_outgoing_window(ssn);
   bool linkq = (bool) link;
-  pn_link_state_t *state = &link->state;
-  return pn_post_frame(transport, AMQP_FRAME_TYPE, ssn->state.local_channel, "DL[?IIII?I?I?In?o]", FLOW,
-                       (int16_t) ssn->state.remote_channel >= 0, ssn->state.incoming_transfer_count,
-                       ssn->state.incoming_window,
-                       ssn->state.outgoing_transfer_count,
-                       ssn->state.outgoing_window,
-                       linkq, linkq ? state->local_handle : 0,
-                       linkq, linkq ? state->delivery_count : 0,
-                       linkq, linkq ? state->link_credit : 0,
-                       linkq, linkq ? link->drain : false);
+  pni_amqp_flow_t flow;
+  memset(&flow, 0, sizeof(flow));
+  flow.next_incoming_id = ssn->state.incoming_transfer_count;
+  flow.next_incoming_id_present = (int16_t) ssn->state.remote_channel >= 0;
+  flow.incoming_window = ssn->state.incoming_window;
+  flow.incoming_window_present = true;
+  flow.next_outgoing_id = ssn->state.outgoing_transfer_count;
+  flow.next_outgoing_id_present = true;
+  flow.outgoing_window = ssn->state.outgoing_window;
+  flow.outgoing_window_present = true;
+  if (linkq) {
+    pn_link_state_t *state = &link->state;
+    flow.handle = state->local_handle;
+    flow.delivery_count = state->delivery_count;
+    flow.link_credit = state->link_credit;
+    flow.drain = link->drain;
+    flow.handle_present = flow.delivery_count_present = flow.link_credit_present = flow.drain_present = true;
+  }
+  return pni_post_flow_frame(transport, ssn->state.local_channel, &flow);
 }
 
 static int pni_process_flow_receiver(pn_transport_t *transport, pn_endpoint_t *endpoint)
@@ -2206,26 +2519,53 @@ static int pni_process_flow_receiver(pn_transport_t *transport, pn_endpoint_t *e
   return 0;
 }
 
+// Send the pending dispositions of a session, one frame per range
 static int pni_flush_disp(pn_transport_t *transport, pn_session_t *ssn)
 {
-  uint64_t code = ssn->state.disp_code;
-  bool settled = ssn->state.disp_settled;
-  if (ssn->state.disp) {
-    int err = pn_post_frame(transport, AMQP_FRAME_TYPE, ssn->state.local_channel, "DL[oI?I?o?DL[]]", DISPOSITION,
-                            ssn->state.disp_type,
-                            ssn->state.disp_first,
-                            ssn->state.disp_last!=ssn->state.disp_first, ssn->state.disp_last,
-                            settled, settled,
-                            (bool)code, code);
-    if (err) return err;
-    ssn->state.disp_type = 0;
-    ssn->state.disp_code = 0;
-    ssn->state.disp_settled = 0;
-    ssn->state.disp_first = 0;
-    ssn->state.disp_last = 0;
-    ssn->state.disp = false;
-  }
-  return 0;
+  pni_disp_set_t *set = &ssn->state.disp;
+  if (!set->count) return 0;
+
+  int err = 0;
+  size_t sent = 0;
+  for (; sent < set->count; sent++) {
+    pni_disp_range_t *range = &set->ranges[sent];
+    pni_amqp_disposition_t disposition;
+    memset(&disposition, 0, sizeof(disposition));
+    disposition.role = range->role;
+    disposition.role_present = true;
+    disposition.first = range->first;
+    disposition.first_present = true;
+    disposition.last = range->last;
+    disposition.last_present = range->last != range->first;
+    disposition.settled = disposition.settled_present = range->settled;
+    // Batched outcomes have no fields
+    char state[16];
+    if (range->code) {
+      pni_emitter_t emitter = make_emitter_from_bytes(pn_rwbytes(sizeof(state), state));
+      pni_emitter_write_described_list(&emitter, range->code, 0, 0);
+      disposition.state = pn_bytes(emitter.position, state);
+      disposition.state_present = true;
+    }
+    err = pni_post_disposition_frame(transport, ssn->state.local_channel, &disposition);
+    if (err) break;
+
+    pn_delivery_map_t *dm = range->role ? &ssn->state.incoming : &ssn->state.outgoing;
+    for (pn_sequence_t id = range->first; sequence_lte(id, range->last); ++id) {
+      pn_delivery_t *delivery = pni_delivery_map_get(dm, id);
+      if (delivery) delivery->state.disp_pending = false;
+    }
+    set->deliveries -= range->last - range->first + 1;
+    transport->disp_frames_saved += range->last - range->first;
+  }
+
+  // Keep the ranges that were not sent
+  if (sent == set->count) {
+    pni_disp_set_clear(set);
+  } else if (sent) {
+    memmove(set->ranges, set->ranges + sent, (set->count - sent) * sizeof(pni_disp_range_t));
+    set->count -= sent;
+  }
+  return err;
 }
 
 static int pni_post_disp(pn_transport_t *transport, pn_delivery_t *delivery)
@@ -2243,40 +2583,35 @@ static int pni_post_disp(pn_transport_t *transport, pn_delivery_t *delivery)
     return 0;
   }
 
-  if (!pni_disposition_batchable(&delivery->local)) {
-    pn_data_clear(transport->disp_data);
-    PN_RETURN_IF_ERROR(pni_disposition_encode(&delivery->local, transport->disp_data));
-    return pn_post_frame(transport, AMQP_FRAME_TYPE, ssn->state.local_channel,
-      "DL[oIn?o?DLC]", DISPOSITION,
-      role, state->id,
-      delivery->local.settled, delivery->local.settled,
-      (bool)code, code, transport->disp_data);
+  // An earlier disposition of this delivery is still waiting and must go first
+  if (state->disp_pending) {
+    int err = pni_flush_disp(transport, ssn);
+    if (err) return err;
   }
 
-  if (ssn_state->disp && code == ssn_state->disp_code &&
-      delivery->local.settled == ssn_state->disp_settled &&
-      ssn_state->disp_type == role) {
-    if (state->id == ssn_state->disp_first - 1) {
-      ssn_state->disp_first = state->id;
-      return 0;
-    } else if (state->id == ssn_state->disp_last + 1) {
-      ssn_state->disp_last = state->id;
-      return 0;
+  if (!pni_disposition_batchable(&delivery->local)) {
+    pni_amqp_disposition_t disposition;
+    memset(&disposition, 0, sizeof(disposition));
+    disposition.role = role;
+    disposition.role_present = true;
+    disposition.first = state->id;
+    disposition.first_present = true;
+    disposition.settled = disposition.settled_present = delivery->local.settled;
+    if (code) {
+      pn_data_clear(transport->disp_data);
+      PN_RETURN_IF_ERROR(pni_disposition_encode(&delivery->local, transport->disp_data));
+      PN_RETURN_IF_ERROR(pni_encode_delivery_state(transport, code, transport->disp_data, &disposition.state));
+      disposition.state_present = true;
     }
+    return pni_post_disposition_frame(transport, ssn->state.local_channel, &disposition);
   }
 
-  if (ssn_state->disp) {
-    int err = pni_flush_disp(transport, ssn);
-    if (err) return err;
+  int err = pni_disp_set_add(&ssn_state->disp, role, delivery->local.settled, code, state->id);
+  if (err) return err;
+  state->disp_pending = true;
+  if (transport->disp_batch && ssn_state->disp.deliveries >= transport->disp_batch) {
+    return pni_flush_disp(transport, ssn);
   }
-
-  ssn_state->disp_type = role;
-  ssn_state->disp_code = code;
-  ssn_state->disp_settled = delivery->local.settled;
-  ssn_state->disp_first = state->id;
-  ssn_state->disp_last = state->id;
-  ssn_state->disp = true;
-
   return 0;
 }
 
@@ -2300,17 +2635,24 @@ static int pni_process_tpwork_sender(pn_transport_t *transport, pn_delivery_t *d
         ssn_state->remote_incoming_window > 0 && link_state->link_credit > 0) {
       if (!state->init) {
         state = pni_delivery_map_push(&ssn_state->outgoing, delivery);
+        if (!state) return PN_OUT_OF_MEMORY;
       }
 
-      pn_bytes_t bytes = pn_buffer_bytes(delivery->bytes);
-      size_t full_size = bytes.size;
+      size_t full_size = pn_buffer_size(delivery->bytes);
+      size_t sent = 0;
       pn_bytes_t tag = pn_buffer_bytes(delivery->tag);
+      // Large payloads are referenced by the output rather than copied into it:
+      // the delivery's buffer is handed to the output queue and replaced.
+      pn_buffer_t *replacement = NULL;
+      if (full_size >= PN_TRANSPORT_OUTPUT_BORROW_MIN) {
+        replacement = pni_output_queue_spare(&transport->output_queue);
+      }
       pn_data_clear(transport->disp_data);
       PN_RETURN_IF_ERROR(pni_disposition_encode(&delivery->local, transport->disp_data));
       int count = pni_post_amqp_transfer_frame(transport,
                                                ssn_state->local_channel,
                                                link_state->local_handle,
-                                               state->id, &bytes, &tag,
+                                               state->id, delivery->bytes, &sent, &tag,
                                                0, // message-format
                                                delivery->local.settled,
                                                !delivery->done,
@@ -2319,16 +2661,28 @@ static int pni_process_tpwork_sender(pn_transport_t *transport, pn_delivery_t *d
                                                transport->disp_data,
                                                false, /* Resume */
                                                delivery->aborted,
-                                               false /* Batchable */
+                                               false, /* Batchable */
+                                               replacement != NULL
       );
+      if (replacement) {
+        // Keep any unsent remainder with the delivery
+        for (size_t offset = sent; offset < full_size;) {
+          pn_bytes_t chunk = pn_buffer_chunk(delivery->bytes, offset);
+          pn_buffer_append(replacement, chunk.start, chunk.size);
+          offset += chunk.size;
+        }
+        pn_buffer_t *borrowed = delivery->bytes;
+        delivery->bytes = replacement;
+        int err = pni_output_queue_release(&transport->output_queue, borrowed);
+        if (err) return err;
+      }
       if (count < 0) return count;
       state->sending = true;
       xfr_posted = true;
       ssn_state->outgoing_transfer_count += count;
       ssn_state->remote_incoming_window -= count;
 
-      int sent = full_size - bytes.size;
-      pn_buffer_trim(delivery->bytes, sent, 0);
+      if (!replacement) pn_buffer_trim(delivery->bytes, sent, 0);
       link->session->outgoing_bytes -= sent;
       if (!pn_buffer_size(delivery->bytes) && delivery->done) {
         state->sent = true;
@@ -2353,6 +2707,118 @@ static int pni_process_tpwork_sender(pn_transport_t *transport, pn_delivery_t *d
   return 0;
 }
 
+// Upper bound of the encoded size of a batched transfer performative, less its delivery tag
+#define PNI_BATCHED_TRANSFER_MAX 32
+
+/*
+ * Small, complete deliveries with no delivery state, each going out as a
+ * single frame, are written straight into the output without going through
+ * transport->frame.
+ */
+static bool pni_transfer_batchable(pn_transport_t *transport, pn_delivery_t *delivery)
+{
+  pn_link_t *link = delivery->link;
+  pn_session_state_t *ssn_state = &link->session->state;
+  pn_link_state_t *link_state = &link->state;
+  if (!pn_link_is_sender(link) || delivery->state.sent || !delivery->done || delivery->aborted ||
+      delivery->local.type || (int16_t) ssn_state->local_channel < 0 || (int32_t) link_state->local_handle < 0 ||
+      ssn_state->remote_incoming_window == 0 || link_state->link_credit <= 0) {
+    return false;
+  }
+  size_t size = pn_buffer_size(delivery->bytes);
+  if (size >= PN_TRANSPORT_OUTPUT_BORROW_MIN) return false;
+  size_t max_frame = transport->remote_max_frame;
+  return !max_frame ||
+    AMQP_HEADER_SIZE + PNI_BATCHED_TRANSFER_MAX + pn_buffer_size(delivery->tag) + size <= max_frame;
+}
+
+/*
+ * Post the run of batchable deliveries on the link of delivery, starting with
+ * it. Output space is reserved for many frames at once and each frame is
+ * encoded in place. On return *next is the delivery following the run on the
+ * work list; the deliveries of the run may have been settled.
+ */
+static int pni_post_transfer_batch(pn_transport_t *transport, pn_delivery_t *delivery, pn_delivery_t **next)
+{
+  pn_link_t *link = delivery->link;
+  pn_session_t *ssn = link->session;
+  pn_session_state_t *ssn_state = &ssn->state;
+  pn_link_state_t *link_state = &link->state;
+  pni_output_queue_t *output = &transport->output_queue;
+
+  pn_frame_t frame = {AMQP_FRAME_TYPE};
+  frame.channel = ssn_state->local_channel;
+
+  pni_amqp_transfer_t transfer;
+  memset(&transfer, 0, sizeof(transfer));
+  transfer.handle = link_state->local_handle;
+  transfer.handle_present = true;
+  transfer.delivery_id_present = true;
+  transfer.message_format_present = true;
+  transfer.settled_present = true;
+  transfer.more_present = true;
+
+  pn_rwbytes_t space = pn_rwbytes(0, NULL);
+  size_t used = 0;
+  int err = 0;
+  while (delivery && delivery->link == link && pni_transfer_batchable(transport, delivery)) {
+    pn_delivery_t *tp_next = delivery->tpwork_next;
+    pn_delivery_state_t *state = &delivery->state;
+    if (!state->init) {
+      state = pni_delivery_map_push(&ssn_state->outgoing, delivery);
+      if (!state) {
+        err = PN_OUT_OF_MEMORY;
+        break;
+      }
+    }
+    size_t payload_size = pn_buffer_size(delivery->bytes);
+    transfer.delivery_id = state->id;
+    transfer.delivery_tag = pn_buffer_bytes(delivery->tag);
+    transfer.delivery_tag_present = transfer.delivery_tag.start != NULL;
+    transfer.settled = delivery->local.settled;
+
+    size_t size = AMQP_HEADER_SIZE + PNI_BATCHED_TRANSFER_MAX + transfer.delivery_tag.size + payload_size;
+    if (space.size - used < size) {
+      if ((err = pni_output_queue_commit(output, used))) return err;
+      space = pni_output_queue_reserve(output, pn_max(size, PN_TRANSPORT_BATCH_RESERVE));
+      if (!space.start) return PN_OUT_OF_MEMORY;
+      used = 0;
+    }
+    char *bytes = space.start + used;
+    size_t wr = pni_amqp_encode_transfer(pn_rwbytes(size - AMQP_HEADER_SIZE, bytes + AMQP_HEADER_SIZE), &transfer);
+    assert(wr <= PNI_BATCHED_TRANSFER_MAX + transfer.delivery_tag.size);
+    pn_buffer_get(delivery->bytes, 0, payload_size, bytes + AMQP_HEADER_SIZE + wr);
+    size = AMQP_HEADER_SIZE + wr + payload_size;
+    pn_write_frame_header(bytes, &frame, size);
+    used += size;
+    transport->output_frames_ct += 1;
+
+    state->sending = true;
+    state->sent = true;
+    ssn_state->outgoing_transfer_count++;
+    ssn_state->remote_incoming_window--;
+    ssn->outgoing_bytes -= payload_size;
+    pn_buffer_clear(delivery->bytes);
+    link_state->delivery_count++;
+    link_state->link_credit--;
+    link->queued--;
+    ssn->outgoing_deliveries--;
+
+    if (delivery->local.settled) {
+      pn_full_settle(&ssn_state->outgoing, delivery);
+    } else if (!pn_delivery_buffered(delivery)) {
+      pn_clear_tpwork(delivery);
+    }
+    delivery = tp_next;
+  }
+  *next = delivery;
+  int cerr = pni_output_queue_commit(output, used);
+  if (err) return err;
+  if (cerr) return cerr;
+  pn_collector_put(transport->connection->collector, PN_OBJECT, link, PN_LINK_FLOW);
+  return 0;
+}
+
 static int pni_process_tpwork_receiver(pn_transport_t *transport, pn_delivery_t *delivery, bool *settle)
 {
   *settle = false;
@@ -2380,8 +2846,16 @@ static int pni_process_tpwork(pn_transport_t *transport, pn_endpoint_t *endpoint
   {
     pn_connection_t *conn = (pn_connection_t *) endpoint;
     pn_delivery_t *delivery = conn->tpwork_head;
+    // Frames that are logged go through the usual path
+    bool batching = !PN_SHOULD_LOG(&transport->logger, PN_SUBSYSTEM_AMQP, PN_LEVEL_FRAME) &&
+                    !PN_SHOULD_LOG(&transport->logger, PN_SUBSYSTEM_IO, PN_LEVEL_RAW);
     while (delivery)
     {
+      if (batching && pni_transfer_batchable(transport, delivery)) {
+        int err = pni_post_transfer_batch(transport, delivery, &delivery);
+        if (err) return err;
+        continue;
+      }
       pn_delivery_t *tp_next = delivery->tpwork_next;
       bool settle = false;
 
@@ -2410,12 +2884,34 @@ static int pni_process_tpwork(pn_transport_t *transport, pn_endpoint_t *endpoint
   return 0;
 }
 
+// Dispositions may wait for a tick after the delay unless the session or connection is closing
+static bool pni_disp_held(pn_transport_t *transport, pn_session_t *session)
+{
+  return transport->disp_delay &&
+    !(session->endpoint.state & PN_LOCAL_CLOSED) &&
+    !(transport->connection->endpoint.state & PN_LOCAL_CLOSED);
+}
+
+static int pni_flush_all_disp(pn_transport_t *transport)
+{
+  pn_session_t *ssn = pn_session_head(transport->connection, 0);
+  while (ssn) {
+    if ((int16_t) ssn->state.local_channel >= 0) {
+      int err = pni_flush_disp(transport, ssn);
+      if (err) return err;
+    }
+    ssn = pn_session_next(ssn, 0);
+  }
+  return 0;
+}
+
 static int pni_process_flush_disp(pn_transport_t *transport, pn_endpoint_t *endpoint)
 {
   if (endpoint->type == SESSION) {
     pn_session_t *session = (pn_session_t *) endpoint;
     pn_session_state_t *state = &session->state;
-    if ((int16_t) state->local_channel >= 0 && !transport->close_sent)
+    if ((int16_t) state->local_channel >= 0 && !transport->close_sent &&
+        !pni_disp_held(transport, session))
     {
       int err = pni_flush_disp(transport, session);
       if (err) return err;
@@ -2577,7 +3073,9 @@ static int pni_process_conn_teardown(pn_transport_t *transport, pn_endpoint_t *e
   {
     if (endpoint->state & PN_LOCAL_CLOSED && !transport->close_sent) {
       if (pni_pointful_buffering(transport, NULL)) return 0;
-      int err = pni_post_close(transport, NULL);
+      int err = transport->disp_delay ? pni_flush_all_disp(transport) : 0;
+      if (err) return err;
+      err = pni_post_close(transport, NULL);
       if (err) return err;
       transport->close_sent = true;
     }
@@ -2587,10 +3085,10 @@ static int pni_process_conn_teardown(pn_transport_t *transport, pn_endpoint_t *e
   return 0;
 }
 
-static int pni_phase(pn_transport_t *transport, int (*phase)(pn_transport_t *, pn_endpoint_t *))
+static int pni_phase(pn_transport_t *transport, pni_dirty_kind_t kind, int (*phase)(pn_transport_t *, pn_endpoint_t *))
 {
   pn_connection_t *conn = transport->connection;
-  pn_endpoint_t *endpoint = conn->transport_head;
+  pn_endpoint_t *endpoint = conn->dirty[kind].transport_head;
   while (endpoint)
   {
     pn_endpoint_t *next = endpoint->transport_next;
@@ -2604,23 +3102,23 @@ static int pni_phase(pn_transport_t *transport, int (*phase)(pn_transport_t *, p
 static int pni_process(pn_transport_t *transport)
 {
   int err;
-  if ((err = pni_phase(transport, pni_process_conn_setup))) return err;
-  if ((err = pni_phase(transport, pni_process_ssn_setup))) return err;
-  if ((err = pni_phase(transport, pni_process_link_setup))) return err;
-  if ((err = pni_phase(transport, pni_process_flow_receiver))) return err;
+  if ((err = pni_phase(transport, PNI_DIRTY_CONNECTION, pni_process_conn_setup))) return err;
+  if ((err = pni_phase(transport, PNI_DIRTY_SESSION, pni_process_ssn_setup))) return err;
+  if ((err = pni_phase(transport, PNI_DIRTY_LINK, pni_process_link_setup))) return err;
+  if ((err = pni_phase(transport, PNI_DIRTY_LINK, pni_process_flow_receiver))) return err;
 
   // XXX: this has to happen two times because we might settle stuff
   // on the first pass and create space for more work to be done on the
   // second pass
-  if ((err = pni_phase(transport, pni_process_tpwork))) return err;
-  if ((err = pni_phase(transport, pni_process_tpwork))) return err;
+  if ((err = pni_phase(transport, PNI_DIRTY_CONNECTION, pni_process_tpwork))) return err;
+  if ((err = pni_phase(transport, PNI_DIRTY_CONNECTION, pni_process_tpwork))) return err;
 
-  if ((err = pni_phase(transport, pni_process_flush_disp))) return err;
+  if ((err = pni_phase(transport, PNI_DIRTY_SESSION, pni_process_flush_disp))) return err;
 
-  if ((err = pni_phase(transport, pni_process_flow_sender))) return err;
-  if ((err = pni_phase(transport, pni_process_link_teardown))) return err;
-  if ((err = pni_phase(transport, pni_process_ssn_teardown))) return err;
-  if ((err = pni_phase(transport, pni_process_conn_teardown))) return err;
+  if ((err = pni_phase(transport, PNI_DIRTY_LINK, pni_process_flow_sender))) return err;
+  if ((err = pni_phase(transport, PNI_DIRTY_LINK, pni_process_link_teardown))) return err;
+  if ((err = pni_phase(transport, PNI_DIRTY_SESSION, pni_process_ssn_teardown))) return err;
+  if ((err = pni_phase(transport, PNI_DIRTY_CONNECTION, pni_process_conn_teardown))) return err;
 
   if (transport->connection->tpwork_head) {
     pn_modified(transport->connection, &transport->connection->endpoint, false);
@@ -2730,15 +3228,36 @@ static int64_t pn_tick_amqp(pn_transport_t* transport, unsigned int layer, int64
       transport->last_bytes_output = transport->bytes_output;
     } else if (transport->keepalive_deadline <= now) {
       transport->keepalive_deadline = now + (pn_timestamp_t)(transport->remote_idle_timeout/2.0);
-      if (pn_buffer_size(transport->output_buffer) == 0) {    // no outbound data pending
+      if (pni_output_queue_size(&transport->output_queue) == 0) {    // no outbound data pending
         // so send empty frame (and account for it!)
         pn_post_frame(transport, AMQP_FRAME_TYPE, 0, "");
-        transport->last_bytes_output += pn_buffer_size(transport->output_buffer);
+        transport->last_bytes_output += pni_output_queue_size(&transport->output_queue);
       }
     }
     timeout = pn_timestamp_min( timeout, transport->keepalive_deadline );
   }
 
+  // Send held dispositions once they have waited for the delay
+  if (transport->disp_delay && transport->connection && !transport->close_sent) {
+    pn_session_t *ssn = pn_session_head(transport->connection, 0);
+    while (ssn) {
+      pni_disp_set_t *set = &ssn->state.disp;
+      if (set->count) {
+        if (!set->deadline) {
+          set->deadline = now + transport->disp_delay;
+        } else if (set->deadline <= now) {
+          int err = pni_flush_disp(transport, ssn);
+          if (err) {
+            pn_do_error(transport, "amqp:internal-error", "error sending dispositions: %s", pn_code(err));
+            break;
+          }
+        }
+        if (set->count) timeout = pn_timestamp_min(timeout, set->deadline);
+      }
+      ssn = pn_session_next(ssn, 0);
+    }
+  }
+
   return timeout;
 }
 
@@ -2774,7 +3293,7 @@ static ssize_t pn_output_write_amqp(pn_transport_t* transport, unsigned int laye
   // write out any buffered data _before_ returning PN_EOS, else we
   // could truncate an outgoing Close frame containing a useful error
   // status
-  if (!pn_buffer_size(transport->output_buffer) && transport->close_sent) {
+  if (!pni_output_queue_size(&transport->output_queue) && transport->close_sent) {
     return PN_EOS;
   }
 
@@ -2838,6 +3357,67 @@ static ssize_t transport_produce(pn_transport_t *transport)
   return transport->output_pending;
 }
 
+// True if AMQP frames pass through the io layers unmodified: the output queue
+// can then be written directly rather than copied into the output buffer.
+static bool pni_output_direct(pn_transport_t *transport, unsigned int *amqp_layer)
+{
+  for (unsigned int layer = 0; layer < PN_IO_LAYER_CT && transport->io_layers[layer]; ++layer) {
+    const pn_io_layer_t *io_layer = transport->io_layers[layer];
+    if (io_layer->process_output == pn_output_write_amqp) {
+      *amqp_layer = layer;
+      return true;
+    }
+    if (io_layer != &pni_passthru_layer) return false;
+  }
+  return false;
+}
+
+// generate outbound frames into the output queue, return amount of pending output else error
+static ssize_t transport_produce_direct(pn_transport_t *transport, unsigned int layer)
+{
+  if (transport->head_closed) return PN_EOS;
+
+  ssize_t n = transport->io_layers[layer]->process_output(transport, layer, NULL, 0);
+  size_t pending = transport->output_pending + pni_output_queue_size(&transport->output_queue);
+  if (n < 0 && !pending) {
+    PN_LOG(&transport->logger, PN_SUBSYSTEM_AMQP | PN_SUBSYSTEM_IO, PN_LEVEL_FRAME | PN_LEVEL_RAW, "  -> EOS");
+    pni_close_head(transport);
+    return n;
+  }
+  return pending;
+}
+
+size_t pni_transport_write_buffers(pn_transport_t *transport, pn_bytes_t *buffers, size_t n)
+{
+  unsigned int layer;
+  if (!n) return 0;
+  if (!pni_output_direct(transport, &layer)) {
+    ssize_t pending = transport_produce(transport);
+    if (pending <= 0) return 0;
+    buffers[0] = pn_bytes(pending, transport->output_buf);
+    return 1;
+  }
+
+  if (transport_produce_direct(transport, layer) <= 0) return 0;
+  return pni_transport_produced_buffers(transport, buffers, n);
+}
+
+// Like pni_transport_write_buffers() but only returns output that has already been generated
+size_t pni_transport_produced_buffers(pn_transport_t *transport, pn_bytes_t *buffers, size_t n)
+{
+  unsigned int layer;
+  if (!n) return 0;
+  // Anything already in the output buffer was produced first
+  size_t count = 0;
+  if (transport->output_pending) {
+    buffers[count++] = pn_bytes(transport->output_pending, transport->output_buf);
+  }
+  if (pni_output_direct(transport, &layer)) {
+    count += pni_output_queue_buffers(&transport->output_queue, buffers + count, n - count);
+  }
+  return count;
+}
+
 // deprecated
 ssize_t pn_transport_output(pn_transport_t *transport, char *bytes, size_t size)
 {
@@ -3019,6 +3599,33 @@ uint64_t pn_transport_get_frames_input(const pn_transport_t *transport)
   return 0;
 }
 
+pn_millis_t pn_transport_get_disposition_delay(pn_transport_t *transport)
+{
+  return transport->disp_delay;
+}
+
+void pn_transport_set_disposition_delay(pn_transport_t *transport, pn_millis_t delay)
+{
+  transport->disp_delay = delay;
+}
+
+size_t pn_transport_get_disposition_batch(pn_transport_t *transport)
+{
+  return transport->disp_batch;
+}
+
+void pn_transport_set_disposition_batch(pn_transport_t *transport, size_t deliveries)
+{
+  transport->disp_batch = deliveries;
+}
+
+uint64_t pn_transport_get_disposition_frames_saved(const pn_transport_t *transport)
+{
+  if (transport)
+    return transport->disp_frames_saved;
+  return 0;
+}
+
 // input
 ssize_t pn_transport_capacity(pn_transport_t *transport)  /* <0 == done */
 {
@@ -3141,15 +3748,23 @@ ssize_t pn_transport_peek(pn_transport_t *transport, char *dst, size_t size)
 void pn_transport_pop(pn_transport_t *transport, size_t size)
 {
   if (transport) {
-    assert( transport->output_pending >= size );
+    // Output beyond the output buffer was taken from the output queue by pni_transport_write_buffers()
+    size_t queued = size > transport->output_pending ? size - transport->output_pending : 0;
+    assert( pni_output_queue_size(&transport->output_queue) >= queued );
+    size -= queued;
     transport->output_pending -= size;
-    transport->bytes_output += size;
+    transport->bytes_output += size + queued;
     if (transport->output_pending) {
       memmove( transport->output_buf,  &transport->output_buf[size],
                transport->output_pending );
     }
+    pni_output_queue_consume(&transport->output_queue, queued);
 
-    if (transport->output_pending==0 && pn_transport_pending(transport) < 0) {
+    // Refill the output, without copying the queue if it can be written directly
+    unsigned int layer;
+    if (transport->output_pending==0 &&
+        (pni_output_direct(transport, &layer) ?
+         transport_produce_direct(transport, layer) : pn_transport_pending(transport)) < 0) {
       // TODO: It looks to me that this is a NOP as iff we ever get here
       // TODO: pni_close_head() will always have been already called before leaving pn_transport_pending()
       pni_close_head(transport);
@@ -22,9 +22,11 @@
  *
  */
 
-void pn_delivery_map_init(pn_delivery_map_t *db, pn_sequence_t next);
+void pn_delivery_map_init(pn_delivery_map_t *db, const pn_class_t *clazz, void *object, pn_sequence_t next);
 void pn_delivery_map_del(pn_delivery_map_t *db, pn_delivery_t *delivery);
 void pn_delivery_map_free(pn_delivery_map_t *db);
+void pni_disp_set_init(pni_disp_set_t *set, const pn_class_t *clazz, void *object);
+void pni_disp_set_free(pni_disp_set_t *set);
 void pn_unmap_handle(pn_session_t *ssn, pn_link_t *link);
 void pn_unmap_channel(pn_transport_t *transport, pn_session_t *ssn);
 
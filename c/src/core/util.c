@@ -31,6 +31,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
 
@@ -114,12 +115,11 @@ bool pn_env_bool(const char *name)
                !pn_strcasecmp(v, "yes")  || !pn_strcasecmp(v, "on"));
 }
 
-PN_STRUCT_CLASSDEF(pn_strdup)
-
+// Strings from pn_strdup()/pn_strndup() are freed with free(), like strdup()
 char *pn_strdup(const char *src)
 {
   if (!src) return NULL;
-  char *dest = (char *) pni_mem_allocate(PN_CLASSCLASS(pn_strdup), strlen(src)+1);
+  char *dest = (char *) malloc(strlen(src)+1);
   if (!dest) return NULL;
   return strcpy(dest, src);
 }
@@ -132,7 +132,7 @@ char *pn_strndup(const char *src, size_t n)
       size++;
     }
 
-    char *dest = (char *) pni_mem_allocate(PN_CLASSCLASS(pn_strdup), size + 1);
+    char *dest = (char *) malloc(size + 1);
     if (!dest) return NULL;
     strncpy(dest, src, pn_min(n, size));
     dest[size] = '\0';
@@ -43,7 +43,6 @@ int pn_quote(pn_string_t *dst, const char *src, size_t size);
 bool pn_env_bool(const char *name);
 pn_timestamp_t pn_timestamp_min(pn_timestamp_t a, pn_timestamp_t b);
 
-extern const pn_class_t PN_CLASSCLASS(pn_strdup)[];
 char *pn_strdup(const char *src);
 char *pn_strndup(const char *src, size_t n);
 
@@ -0,0 +1,115 @@
+#!/usr/bin/python
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+
+# Generates typed structs with direct decoders and encoders for the
+# performatives that are on the message hot path, so that they can be
+# dispatched and posted without going through pn_data_t.
+
+from __future__ import print_function
+from protocol import *
+
+PERFORMATIVES = ["flow", "transfer", "disposition"]
+
+# AMQP type -> (C type, consumer reader and emitter writer suffix)
+READERS = {
+    "boolean": ("bool", "bool"),
+    "ubyte": ("uint8_t", "ubyte"),
+    "ushort": ("uint16_t", "ushort"),
+    "uint": ("uint32_t", "uint"),
+    "ulong": ("uint64_t", "ulong"),
+    "binary": ("pn_bytes_t", "binary"),
+    "string": ("pn_bytes_t", "string"),
+    "symbol": ("pn_bytes_t", "symbol"),
+}
+# Anything else is left as its raw encoding
+RAW = ("pn_bytes_t", "raw")
+
+
+def reader(field):
+    return READERS.get(ftype(field), RAW)
+
+
+print("/* generated */")
+print("#ifndef _PROTON_PERFORMATIVES_H")
+print("#define _PROTON_PERFORMATIVES_H 1")
+print()
+print("#include \"core/consumers.h\"")
+print("#include \"core/emitters.h\"")
+print("#include \"protocol.h\"")
+
+for type in TYPES:
+    if type["@name"] not in PERFORMATIVES:
+        continue
+    name = tname(type)
+    fields = type.query["field"]
+    print()
+    print("typedef struct {")
+    for f in fields:
+        print("  %s %s;" % (reader(f)[0], fname(f)))
+    for f in fields:
+        print("  bool %s_present;" % fname(f))
+    print("} pni_amqp_%s_t;" % name)
+    print()
+    print("/* Decode the field list of a %s whose descriptor has already been read */" % type["@name"])
+    print("static inline bool pni_amqp_decode_%s(pni_consumer_t *consumer, pni_amqp_%s_t *%s)" % (name, name, name))
+    print("{")
+    print("  pni_consumer_t fields;")
+    print("  uint32_t count;")
+    print("  memset(%s, 0, sizeof(*%s));" % (name, name))
+    print("  if (!pni_consumer_enter_list(consumer, &fields, &count)) return false;")
+    for i, f in enumerate(fields):
+        print("  if (count > %d && !pni_consumer_read_%s(&fields, &%s->%s, &%s->%s_present)) return false;" %
+              (i, reader(f)[1], name, fname(f), name, fname(f)))
+    print("  return true;")
+    print("}")
+    print()
+    print("/*")
+    print(" * Encode a %s, returning the encoded size. Nothing is written unless" % type["@name"])
+    print(" * it fits in the buffer. Absent trailing fields are omitted.")
+    print(" */")
+    print("static inline size_t pni_amqp_encode_%s(pn_rwbytes_t buffer, const pni_amqp_%s_t *%s)" % (name, name, name))
+    print("{")
+    print("  size_t fields = 0;")
+    print("  size_t nulls = 0;")
+    print("  uint32_t count = 0;")
+    for i, f in enumerate(fields):
+        print("  if (%s->%s_present) {" % (name, fname(f)))
+        print("    fields += nulls + pni_emitter_size_%s(%s->%s);" % (reader(f)[1], name, fname(f)))
+        print("    nulls = 0;")
+        print("    count = %d;" % (i + 1))
+        print("  } else {")
+        print("    nulls++;")
+        print("  }")
+    print("  size_t size = pni_emitter_size_described_list(%s, fields, count);" % name.upper())
+    print("  if (size > buffer.size) return size;")
+    print()
+    print("  pni_emitter_t emitter = make_emitter_from_bytes(buffer);")
+    print("  pni_emitter_write_described_list(&emitter, %s, fields, count);" % name.upper())
+    for i, f in enumerate(fields):
+        print("  if (count > %d) {" % i)
+        print("    if (%s->%s_present) pni_emitter_write_%s(&emitter, %s->%s);" %
+              (name, fname(f), reader(f)[1], name, fname(f)))
+        print("    else pni_emitter_write_null(&emitter);")
+        print("  }")
+    print("  return size;")
+    print("}")
+
+print()
+print("#endif /* performatives.h */")
@@ -39,6 +39,7 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 
 #include <proton/connection_driver.h>
@@ -46,6 +47,7 @@
 
 #include "netaddr-internal.h"
 #include "proactor-internal.h"
+#include "core/timer_wheel.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -55,6 +57,7 @@ typedef struct acceptor_t acceptor_t;
 typedef struct tslot_t tslot_t;
 typedef pthread_mutex_t pmutex;
 typedef struct pni_timer_t pni_timer_t;
+typedef struct pni_uring_t pni_uring_t;
 
 typedef enum {
   EVENT_FD,   /* schedule() or pn_proactor_interrupt() */
@@ -70,6 +73,7 @@ typedef struct epoll_extended_t {
   epoll_type_t type;   // io/timer/eventfd
   uint32_t wanted;     // events to poll for
   bool polling;
+  uint32_t slot;       // io_uring registration
   pmutex barrier_mutex;
 } epoll_extended_t;
 
@@ -136,11 +140,28 @@ typedef struct pni_timer_manager_t {
   epoll_extended_t epoll_timer;
   pmutex deletion_mutex;
   pni_timer_t *proactor_timer;
-  pn_list_t *timers_heap;
+  pni_timer_wheel_t timers_wheel;      // Connection timers
   uint64_t timerfd_deadline;
   bool sched_timeout;
 } pni_timer_manager_t;
 
+/* Read buffers of one size, from one pn_proactor_add_raw_buffers() */
+typedef struct pni_raw_buffer_class_t {
+  char *memory;                      /* count buffers of size bytes */
+  char **free;                       /* Stack of the free buffers */
+  size_t count;
+  size_t free_count;
+  uint32_t size;
+} pni_raw_buffer_class_t;
+
+/* Read buffers shared by the pooled raw connections of a proactor */
+typedef struct pni_raw_buffer_pool_t {
+  pmutex mutex;
+  pni_raw_buffer_class_t *classes;   /* In increasing size */
+  size_t class_count;
+  struct praw_connection_t *waiting; /* Connections that found no free buffer */
+} pni_raw_buffer_pool_t;
+
 struct pn_proactor_t {
   task_t task;
   pni_timer_manager_t timer_manager;
@@ -166,6 +187,7 @@ struct pn_proactor_t {
   task_t *ready_list_last;
   // Interrupts have a dedicated eventfd because they must be async-signal safe.
   int interruptfd;
+  pni_raw_buffer_pool_t raw_buffers;
   // If the process runs out of file descriptors, disarm listening sockets temporarily and save them here.
   acceptor_t *overflow;
   pmutex overflow_mutex;
@@ -202,7 +224,8 @@ struct pn_proactor_t {
   tslot_t **resume_list;
   pn_hash_t *tslot_map;
   struct epoll_event *kevents;
-  int epollfd;
+  int epollfd;           /* epoll or io_uring fd */
+  pni_uring_t *uring;    /* io_uring poller only */
   int thread_count;
   int thread_capacity;
   int runnables_capacity;
@@ -238,7 +261,11 @@ typedef struct pconnection_t {
   pn_event_batch_t batch;
   pn_connection_driver_t driver;
   bool output_drained;
-  const char *wbuf_current;
+  bool ktls_tx;               /* the kernel encrypts output */
+#define PCONNECTION_WBUF_MAX 16
+  struct iovec wbuf[PCONNECTION_WBUF_MAX]; /* pending output, gathered into one sendmsg() */
+  struct iovec *wbuf_current;
+  int wbuf_count;
   size_t wbuf_remaining;
   size_t wbuf_completed;
   pn_event_type_t current_event_type;/* Sole use for debugging, i.e. crash analysis of optimized code. */
@@ -351,7 +378,7 @@ bool proactor_remove(task_t *tsk);
 bool unassign_thread(tslot_t *ts, tslot_state new_state);
 
 void task_init(task_t *tsk, task_type_t t, pn_proactor_t *p);
-static void task_finalize(task_t* tsk) {
+static inline void task_finalize(task_t* tsk) {
   pmutex_finalize(&tsk->mutex);
 }
 
@@ -360,9 +387,29 @@ void notify_poller(pn_proactor_t *p);
 void schedule_done(task_t *tsk);
 
 void psocket_init(psocket_t* ps, epoll_type_t type);
-bool start_polling(epoll_extended_t *ee, int epollfd);
-void stop_polling(epoll_extended_t *ee, int epollfd);
-void rearm_polling(epoll_extended_t *ee, int epollfd);
+/*
+ * Kernel event notification, implemented with epoll (epoll_poller.c) or
+ * io_uring (uring_poller.c).  Each polled fd is armed one shot: after it is
+ * reported it must be rearmed before it will be reported again.
+ */
+bool pni_poller_init(pn_proactor_t *p);
+void pni_poller_finalize(pn_proactor_t *p);
+/* Like epoll_wait() into p->kevents, timeout is 0 or -1 */
+int pni_poller_wait(pn_proactor_t *p, int timeout);
+bool start_polling(epoll_extended_t *ee, pn_proactor_t *p);
+void stop_polling(epoll_extended_t *ee, pn_proactor_t *p);
+void rearm_polling(epoll_extended_t *ee, pn_proactor_t *p);
+
+/* The kernel calls do not form a memory barrier, so cached memory
+   writes to struct epoll_extended_t in the arming thread might not be
+   visible to the polling thread. This function creates a memory barrier,
+   called before arming.
+*/
+static inline void memory_barrier(epoll_extended_t *ee) {
+  // Mutex lock/unlock has the side-effect of being a memory barrier.
+  lock(&ee->barrier_mutex);
+  unlock(&ee->barrier_mutex);
+}
 
 int pgetaddrinfo(const char *host, const char *port, int flags, struct addrinfo **res);
 void configure_socket(int sock);
@@ -376,6 +423,7 @@ typedef struct praw_connection_t praw_connection_t;
 task_t *pni_raw_connection_task(praw_connection_t *rc);
 praw_connection_t *pni_batch_raw_connection(pn_event_batch_t* batch);
 void pni_raw_connection_done(praw_connection_t *rc);
+void pni_raw_buffer_pool_finalize(pni_raw_buffer_pool_t *pool);
 
 pni_timer_t *pni_timer(pni_timer_manager_t *tm, pconnection_t *c);
 void pni_timer_free(pni_timer_t *timer);
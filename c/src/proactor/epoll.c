@@ -42,6 +42,9 @@
  by the poller to make the task runnable.  A task may aslso be scheduled to run by placing it
  on a ready queue which is monitored by the poller via two eventfds.
 
+ The kernel calls that arm fds and wait for them are in epoll_poller.c, or in
+ uring_poller.c when built with PROACTOR=io_uring.
+
  Lock ordering - never add locks right to left:
     task -> sched -> ready
     non-proactor-task -> proactor-task
@@ -65,6 +68,7 @@
 #include "core/engine-internal.h"
 #include "core/logger_private.h"
 #include "core/util.h"
+#include "ssl/ssl-internal.h"
 
 #include <proton/condition.h>
 #include <proton/connection_driver.h>
@@ -93,6 +97,10 @@
 #include <limits.h>
 #include <time.h>
 #include <alloca.h>
+#include <linux/version.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,13,0)
+#include <linux/tls.h>
+#endif
 
 #include "./netaddr-internal.h" /* Include after socket/inet headers */
 
@@ -113,17 +121,6 @@ void pstrerror(int err, strerrorbuf msg) {
   if (e) snprintf(msg, sizeof(strerrorbuf), "unknown error %d", err);
 }
 
-/* epoll_ctl()/epoll_wait() do not form a memory barrier, so cached memory
-   writes to struct epoll_extended_t in the EPOLL_ADD thread might not be
-   visible to epoll_wait() thread. This function creates a memory barrier,
-   called before epoll_ctl() and after epoll_wait()
-*/
-static void memory_barrier(epoll_extended_t *ee) {
-  // Mutex lock/unlock has the side-effect of being a memory barrier.
-  lock(&ee->barrier_mutex);
-  unlock(&ee->barrier_mutex);
-}
-
 /* Read from an event FD */
 static uint64_t read_uint64(int fd) {
   uint64_t result = 0;
@@ -153,43 +150,8 @@ const char *AMQP_PORT_NAME = "amqp";
 PN_STRUCT_CLASSDEF(pn_proactor)
 PN_STRUCT_CLASSDEF(pn_listener)
 
-bool start_polling(epoll_extended_t *ee, int epollfd) {
-  if (ee->polling)
-    return false;
-  ee->polling = true;
-  struct epoll_event ev = {0};
-  ev.data.ptr = ee;
-  ev.events = ee->wanted | EPOLLONESHOT;
-  memory_barrier(ee);
-  return (epoll_ctl(epollfd, EPOLL_CTL_ADD, ee->fd, &ev) == 0);
-}
-
-void stop_polling(epoll_extended_t *ee, int epollfd) {
-  // TODO: check for error, return bool or just log?
-  // TODO: is EPOLL_CTL_DEL ever needed beyond auto de-register when ee->fd is closed?
-  if (ee->fd == -1 || !ee->polling || epollfd == -1)
-    return;
-  struct epoll_event ev = {0};
-  ev.data.ptr = ee;
-  ev.events = 0;
-  memory_barrier(ee);
-  if (epoll_ctl(epollfd, EPOLL_CTL_DEL, ee->fd, &ev) == -1)
-    EPOLL_FATAL("EPOLL_CTL_DEL", errno);
-  ee->fd = -1;
-  ee->polling = false;
-}
-
-void rearm_polling(epoll_extended_t *ee, int epollfd) {
-  struct epoll_event ev = {0};
-  ev.data.ptr = ee;
-  ev.events = ee->wanted | EPOLLONESHOT;
-  memory_barrier(ee);
-  if (epoll_ctl(epollfd, EPOLL_CTL_MOD, ee->fd, &ev) == -1)
-    EPOLL_FATAL("arming polled file descriptor", errno);
-}
-
 static void rearm(pn_proactor_t *p, epoll_extended_t *ee) {
-  rearm_polling(ee, p->epollfd);
+  rearm_polling(ee, p);
 }
 
 /*
@@ -753,15 +715,20 @@ static const char *pconnection_setup(pconnection_t *pc, pn_proactor_t *p, pn_con
   pc->write_blocked = true;
   pc->disconnected = false;
   pc->output_drained = false;
+  pc->ktls_tx = false;
   pc->wbuf_completed = 0;
   pc->wbuf_remaining = 0;
-  pc->wbuf_current = NULL;
+  pc->wbuf_current = pc->wbuf;
+  pc->wbuf_count = 0;
   pc->hog_count = 0;
   pc->batch.next_event = pconnection_batch_next;
 
   if (server) {
     pn_transport_set_server(pc->driver.transport);
   }
+#ifdef TLS_TX
+  pni_ssl_ktls_offer(pc->driver.transport);
+#endif
 
   pmutex_init(&pc->rearm_mutex);
 
@@ -803,7 +770,7 @@ static void pconnection_final_free(pconnection_t *pc) {
 static void pconnection_cleanup(pconnection_t *pc) {
   assert(pconnection_is_final(pc));
   int fd = pc->psocket.epoll_io.fd;
-  stop_polling(&pc->psocket.epoll_io, pc->task.proactor->epollfd);
+  stop_polling(&pc->psocket.epoll_io, pc->task.proactor);
   if (fd != -1)
     pclosefd(pc->task.proactor, fd);
 
@@ -815,18 +782,74 @@ static void pconnection_cleanup(pconnection_t *pc) {
   // else proactor_disconnect logic owns psocket and its final free
 }
 
-static void set_wbuf(pconnection_t *pc, const char *start, size_t sz) {
+static void set_wbuf(pconnection_t *pc, const pn_bytes_t *buffers, size_t n) {
   pc->wbuf_completed = 0;
-  pc->wbuf_current = start;
-  pc->wbuf_remaining = sz;
+  pc->wbuf_current = pc->wbuf;
+  pc->wbuf_count = n;
+  pc->wbuf_remaining = 0;
+  for (size_t i = 0; i < n; ++i) {
+    pc->wbuf[i].iov_base = (void *) buffers[i].start;
+    pc->wbuf[i].iov_len = buffers[i].size;
+    pc->wbuf_remaining += buffers[i].size;
+  }
 }
 
+#ifdef TLS_TX
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+// Hand output encryption to the kernel once the SSL layer is ready, true if
+// the SSL layer has been told the outcome and may have more output for us.
+// Call only when all output so far has been written.
+static bool pconnection_ktls_tx(pconnection_t *pc) {
+  size_t size;
+  const void *info = pni_ssl_ktls_tx(pc->driver.transport, &size);
+  if (!info) return false;
+  int fd = pc->psocket.epoll_io.fd;
+  pc->ktls_tx =
+    setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) == 0 &&
+    setsockopt(fd, SOL_TLS, TLS_TX, info, size) == 0;
+  pni_ssl_ktls_tx_done(pc->driver.transport, pc->ktls_tx);
+  return true;
+}
+
+// The SSL layer leaves close_notify to us once the kernel has the keys
+static void pconnection_ktls_close_notify(pconnection_t *pc) {
+  static const unsigned char alert[2] = {1, 0};   // warning, close_notify
+  char control[CMSG_SPACE(sizeof(unsigned char))];
+  struct iovec iov = {(void *) alert, sizeof(alert)};
+  struct msghdr msg = {0};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_TLS;
+  cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+  *CMSG_DATA(cmsg) = 21;    // alert
+  (void) sendmsg(pc->psocket.epoll_io.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+#else
+static inline bool pconnection_ktls_tx(pconnection_t *pc) { return false; }
+static inline void pconnection_ktls_close_notify(pconnection_t *pc) {}
+#endif
+
 // Never call with any locks held.
 static void ensure_wbuf(pconnection_t *pc) {
   // next connection_driver call is the expensive output generator
-  pn_bytes_t bytes = pn_connection_driver_write_buffer(&pc->driver);
-  set_wbuf(pc, bytes.start, bytes.size);
-  if (bytes.size == 0)
+  pn_bytes_t buffers[PCONNECTION_WBUF_MAX];
+  size_t n = pn_connection_driver_write_buffers(&pc->driver, buffers, PCONNECTION_WBUF_MAX);
+  set_wbuf(pc, buffers, n);
+  if (pc->wbuf_remaining == 0 && pconnection_ktls_tx(pc)) {
+    n = pn_connection_driver_write_buffers(&pc->driver, buffers, PCONNECTION_WBUF_MAX);
+    set_wbuf(pc, buffers, n);
+  }
+  if (pc->wbuf_remaining == 0)
     pc->output_drained = true;
 }
 
@@ -1038,25 +1061,34 @@ static void pconnection_done(pconnection_t *pc) {
 
 // Return true unless error
 static bool pconnection_write(pconnection_t *pc) {
-  size_t wbuf_size = pc->wbuf_remaining;
-  ssize_t n = send(pc->psocket.epoll_io.fd, pc->wbuf_current, wbuf_size, MSG_NOSIGNAL);
+  struct msghdr msg = {0};
+  msg.msg_iov = pc->wbuf_current;
+  msg.msg_iovlen = pc->wbuf_count;
+  ssize_t n = sendmsg(pc->psocket.epoll_io.fd, &msg, MSG_NOSIGNAL);
   if (n > 0) {
     pc->wbuf_completed += n;
     pc->wbuf_remaining -= n;
     pc->io_doublecheck = false;
     if (pc->wbuf_remaining) {
       pc->write_blocked = true;
-      pc->wbuf_current += n;
+      // Skip what was written
+      size_t written = n;
+      while (written >= pc->wbuf_current->iov_len) {
+        written -= pc->wbuf_current->iov_len;
+        pc->wbuf_current++;
+        pc->wbuf_count--;
+      }
+      pc->wbuf_current->iov_base = (char *) pc->wbuf_current->iov_base + written;
+      pc->wbuf_current->iov_len -= written;
     }
     else {
-      // write_done also calls pn_transport_pending(), so the transport knows all current output
+      // write_done also generates more output, so the transport knows all current output
       pn_connection_driver_write_done(&pc->driver, pc->wbuf_completed);
-      pc->wbuf_completed = 0;
-      pn_transport_t *t = pc->driver.transport;
-      set_wbuf(pc, t->output_buf, t->output_pending);
-      if (t->output_pending == 0)
+      pn_bytes_t buffers[PCONNECTION_WBUF_MAX];
+      size_t count = pni_transport_produced_buffers(pc->driver.transport, buffers, PCONNECTION_WBUF_MAX);
+      set_wbuf(pc, buffers, count);
+      if (pc->wbuf_remaining == 0 && !pconnection_ktls_tx(pc))
         pc->output_drained = true;
-      // TODO: revise transport API to allow similar efficient access to transport output
     }
   } else if (errno == EWOULDBLOCK) {
     pc->write_blocked = true;
@@ -1095,6 +1127,7 @@ static void write_flush(pconnection_t *pc) {
     }
     else {
       if (pn_connection_driver_write_closed(&pc->driver)) {
+        if (pc->ktls_tx) pconnection_ktls_close_notify(pc);
         shutdown(pc->psocket.epoll_io.fd, SHUT_WR);
         pc->write_blocked = true;
       }
@@ -1245,6 +1278,8 @@ static pn_event_batch_t *pconnection_process(pconnection_t *pc, uint32_t events,
   }
 
   write_flush(pc);
+  if (pn_transport_get_disposition_delay(pc->driver.transport))
+    pconnection_tick(pc);         /* dispositions held by the output need a deadline */
 
   lock(&pc->task.mutex);
   if (pc->task.closing && pconnection_is_final(pc)) {
@@ -1314,7 +1349,7 @@ void pconnection_connected_lh(pconnection_t *pc) {
 
 /* multi-address connections may call pconnection_start multiple times with diffferent FDs  */
 static void pconnection_start(pconnection_t *pc, int fd) {
-  int efd = pc->task.proactor->epollfd;
+  pn_proactor_t *p = pc->task.proactor;
   /* Get the local socket name now, get the peer name in pconnection_connected */
   socklen_t len = sizeof(pc->local.ss);
   (void)getsockname(fd, (struct sockaddr*)&pc->local.ss, &len);
@@ -1322,12 +1357,12 @@ static void pconnection_start(pconnection_t *pc, int fd) {
   epoll_extended_t *ee = &pc->psocket.epoll_io;
   if (ee->polling) {     /* This is not the first attempt, stop polling and close the old FD */
     int fd = ee->fd;     /* Save fd, it will be set to -1 by stop_polling */
-    stop_polling(ee, efd);
-    pclosefd(pc->task.proactor, fd);
+    stop_polling(ee, p);
+    pclosefd(p, fd);
   }
   ee->fd = fd;
   pc->current_arm = ee->wanted = EPOLLIN | EPOLLOUT;
-  start_polling(ee, efd);  // TODO: check for error
+  start_polling(ee, p);  // TODO: check for error
 }
 
 /* Called on initial connect, and if connection fails to try another address */
@@ -1423,7 +1458,8 @@ void pn_proactor_connect2(pn_proactor_t *p, pn_connection_t *c, pn_transport_t *
 
 static void pconnection_tick(pconnection_t *pc) {
   pn_transport_t *t = pc->driver.transport;
-  if (pn_transport_get_idle_timeout(t) || pn_transport_get_remote_idle_timeout(t)) {
+  if (pn_transport_get_idle_timeout(t) || pn_transport_get_remote_idle_timeout(t) ||
+      pn_transport_get_disposition_delay(t)) {
     uint64_t now = pn_proactor_now_64();
     uint64_t next = pn_transport_tick(t, now);
     if (next) {
@@ -1542,7 +1578,7 @@ void pn_proactor_listen(pn_proactor_t *p, pn_listener_t *l, const char *addr, in
           ps->epoll_io.fd = fd;
           ps->epoll_io.wanted = EPOLLIN;
           ps->epoll_io.polling = false;
-          start_polling(&ps->epoll_io, l->task.proactor->epollfd);  // TODO: check for error
+          start_polling(&ps->epoll_io, l->task.proactor);  // TODO: check for error
           l->active_count++;
           acceptor->armed = true;
         } else {
@@ -1621,7 +1657,7 @@ static void listener_begin_close(pn_listener_t* l) {
           shutdown(ps->epoll_io.fd, SHUT_RD);  // Force epoll event and callback
         } else {
           int fd = ps->epoll_io.fd;
-          stop_polling(&ps->epoll_io, l->task.proactor->epollfd);
+          stop_polling(&ps->epoll_io, l->task.proactor);
           close(fd);
           l->active_count--;
         }
@@ -1706,7 +1742,7 @@ static pn_event_batch_t *listener_process(pn_listener_t *l, int n_events, bool t
         if (l->task.closing) {
           l->acceptors[i].armed = false;
           int fd = ps->epoll_io.fd;
-          stop_polling(&ps->epoll_io, l->task.proactor->epollfd);
+          stop_polling(&ps->epoll_io, l->task.proactor);
           close(fd);
           l->active_count--;
         } else {
@@ -1915,7 +1951,7 @@ static void grow_poller_bufs(pn_proactor_t* p) {
 }
 
 /* Set up an epoll_extended_t to be used for ready list schedule() or interrupts */
- static void epoll_eventfd_init(epoll_extended_t *ee, int eventfd, int epollfd, bool always_set) {
+ static void epoll_eventfd_init(epoll_extended_t *ee, int eventfd, pn_proactor_t *p, bool always_set) {
   ee->fd = eventfd;
   ee->type = EVENT_FD;
   if (always_set) {
@@ -1928,7 +1964,7 @@ static void grow_poller_bufs(pn_proactor_t* p) {
     ee->wanted = EPOLLIN;
   }
   ee->polling = false;
-  start_polling(ee, epollfd);  // TODO: check for error
+  start_polling(ee, p);  // TODO: check for error
   if (always_set)
     ee->wanted = EPOLLIN;      // for all subsequent rearms
 }
@@ -1944,16 +1980,17 @@ pn_proactor_t *pn_proactor() {
   pmutex_init(&p->eventfd_mutex);
   pmutex_init(&p->sched_mutex);
   pmutex_init(&p->tslot_mutex);
+  pmutex_init(&p->raw_buffers.mutex);
 
-  if ((p->epollfd = epoll_create(1)) >= 0) {
+  if (pni_poller_init(p)) {
     if ((p->eventfd = eventfd(0, EFD_NONBLOCK)) >= 0) {
       if ((p->interruptfd = eventfd(0, EFD_NONBLOCK)) >= 0) {
         if (pni_timer_manager_init(&p->timer_manager))
           if ((p->collector = pn_collector()) != NULL) {
             p->batch.next_event = &proactor_batch_next;
-            start_polling(&p->timer_manager.epoll_timer, p->epollfd);  // TODO: check for error
-            epoll_eventfd_init(&p->epoll_schedule, p->eventfd, p->epollfd, true);
-            epoll_eventfd_init(&p->epoll_interrupt, p->interruptfd, p->epollfd, false);
+            start_polling(&p->timer_manager.epoll_timer, p);  // TODO: check for error
+            epoll_eventfd_init(&p->epoll_schedule, p->eventfd, p, true);
+            epoll_eventfd_init(&p->epoll_interrupt, p->interruptfd, p, false);
             p->tslot_map = pn_hash(PN_VOID, 0, 0.75);
             grow_poller_bufs(p);
             return p;
@@ -1961,10 +1998,11 @@ pn_proactor_t *pn_proactor() {
       }
     }
   }
-  if (p->epollfd >= 0) close(p->epollfd);
+  pni_poller_finalize(p);
   if (p->eventfd >= 0) close(p->eventfd);
   if (p->interruptfd >= 0) close(p->interruptfd);
   pni_timer_manager_finalize(&p->timer_manager);
+  pmutex_finalize(&p->raw_buffers.mutex);
   pmutex_finalize(&p->tslot_mutex);
   pmutex_finalize(&p->sched_mutex);
   pmutex_finalize(&p->eventfd_mutex);
@@ -1977,8 +2015,7 @@ pn_proactor_t *pn_proactor() {
 void pn_proactor_free(pn_proactor_t *p) {
   //  No competing threads, not even a pending timer
   p->shutting_down = true;
-  close(p->epollfd);
-  p->epollfd = -1;
+  pni_poller_finalize(p);
   close(p->eventfd);
   p->eventfd = -1;
   close(p->interruptfd);
@@ -1999,6 +2036,7 @@ void pn_proactor_free(pn_proactor_t *p) {
   }
 
   pni_timer_manager_finalize(&p->timer_manager);
+  pni_raw_buffer_pool_finalize(&p->raw_buffers);
   pn_collector_free(p->collector);
   pmutex_finalize(&p->tslot_mutex);
   pmutex_finalize(&p->sched_mutex);
@@ -2493,7 +2531,7 @@ static bool poller_do_epoll(struct pn_proactor_t* p, tslot_t *ts, bool can_block
     p->poller_suspended = (timeout == -1);
     unlock(&p->sched_mutex);
 
-    n_events = epoll_wait(p->epollfd, p->kevents, p->kevents_capacity, timeout);
+    n_events = pni_poller_wait(p, timeout);
 
     lock(&p->sched_mutex);
     p->poller_suspended = false;
@@ -0,0 +1,76 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+
+#include "epoll-internal.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+bool pni_poller_init(pn_proactor_t *p) {
+  p->epollfd = epoll_create(1);
+  return p->epollfd >= 0;
+}
+
+void pni_poller_finalize(pn_proactor_t *p) {
+  if (p->epollfd >= 0) close(p->epollfd);
+  p->epollfd = -1;
+}
+
+int pni_poller_wait(pn_proactor_t *p, int timeout) {
+  return epoll_wait(p->epollfd, p->kevents, p->kevents_capacity, timeout);
+}
+
+bool start_polling(epoll_extended_t *ee, pn_proactor_t *p) {
+  if (ee->polling)
+    return false;
+  ee->polling = true;
+  struct epoll_event ev = {0};
+  ev.data.ptr = ee;
+  ev.events = ee->wanted | EPOLLONESHOT;
+  memory_barrier(ee);
+  return (epoll_ctl(p->epollfd, EPOLL_CTL_ADD, ee->fd, &ev) == 0);
+}
+
+void stop_polling(epoll_extended_t *ee, pn_proactor_t *p) {
+  // TODO: check for error, return bool or just log?
+  // TODO: is EPOLL_CTL_DEL ever needed beyond auto de-register when ee->fd is closed?
+  if (ee->fd == -1 || !ee->polling || p->epollfd == -1)
+    return;
+  struct epoll_event ev = {0};
+  ev.data.ptr = ee;
+  ev.events = 0;
+  memory_barrier(ee);
+  if (epoll_ctl(p->epollfd, EPOLL_CTL_DEL, ee->fd, &ev) == -1)
+    EPOLL_FATAL("EPOLL_CTL_DEL", errno);
+  ee->fd = -1;
+  ee->polling = false;
+}
+
+void rearm_polling(epoll_extended_t *ee, pn_proactor_t *p) {
+  struct epoll_event ev = {0};
+  ev.data.ptr = ee;
+  ev.events = ee->wanted | EPOLLONESHOT;
+  memory_barrier(ee);
+  if (epoll_ctl(p->epollfd, EPOLL_CTL_MOD, ee->fd, &ev) == -1)
+    EPOLL_FATAL("arming polled file descriptor", errno);
+}
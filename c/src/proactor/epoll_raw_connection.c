@@ -21,10 +21,16 @@
 
 /* This is currently epoll implementation specific - and will need changing for the other proactors */
 
+/* For splice(), pipe2() and the pipe size fcntls, set before epoll-internal.h includes any system header.
+   This file makes no strerror_r() calls so the GNU variant does no harm here. */
+#define _GNU_SOURCE
+#include <fcntl.h>
+
 #include "epoll-internal.h"
 #include "proactor-internal.h"
 #include "raw_connection-internal.h"
 
+#include <proton/error.h>
 #include <proton/proactor.h>
 #include <proton/listener.h>
 #include <proton/netaddr.h>
@@ -33,10 +39,36 @@
 #include <alloca.h>
 #include <assert.h>
 #include <errno.h>
+#include <poll.h>
+#include <signal.h>
 #include <string.h>
 #include <unistd.h>
 
 #include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+#include <linux/errqueue.h>
+#define PNI_ZEROCOPY 1
+#endif
+
+/* Pipes are enlarged to this if the system allows, bigger pipes mean fewer splices */
+#define PNI_RELAY_PIPE_SIZE (1024*1024)
+
+/* One direction of a relay: bytes read by one connection wait in a pipe to be written by the other */
+typedef struct praw_relay_pipe_t {
+  int fds[2];
+  size_t queued;                     /* Bytes in the pipe */
+  bool eof;                          /* The reading connection will put no more bytes in the pipe */
+  bool broken;                       /* The writing connection will take no more bytes from the pipe */
+  bool blocked;                      /* The reading connection stopped on a full pipe */
+} praw_relay_pipe_t;
+
+typedef struct praw_relay_t {
+  pmutex mutex;                      /* protects everything except the pipe fds */
+  praw_connection_t *conns[2];       /* NULL once the connection has finished */
+  praw_relay_pipe_t pipes[2];        /* pipes[i] carries the bytes read by conns[i] */
+} praw_relay_t;
 
 /* epoll specific raw connection struct */
 struct praw_connection_t {
@@ -48,6 +80,14 @@ struct praw_connection_t {
   pn_event_batch_t batch;
   struct addrinfo *addrinfo;         /* Resolved address list */
   struct addrinfo *ai;               /* Current connect address */
+  uint32_t zerocopy_threshold;       /* Requested by the application */
+  praw_relay_t *relay;               /* Set under the task mutex, only cleared by the connection itself */
+  int relay_side;                    /* Index of this connection in relay->conns */
+  bool io_waking;                    /* The relay or buffer pool needs attention, protected by the task mutex */
+  uint32_t pool_size;                /* Smallest pooled read buffer wanted */
+  praw_connection_t *pool_next;      /* Buffer pool waiting list, protected by the pool mutex */
+  bool pool_waiting;                 /* On the waiting list, protected by the pool mutex */
+  bool zerocopy;                     /* Enabled on the socket */
   bool connected;
   bool disconnected;
 };
@@ -84,7 +124,7 @@ static void praw_connection_connected_lh(praw_connection_t *prc) {
 
 /* multi-address connections may call pconnection_start multiple times with diffferent FDs  */
 static void praw_connection_start(praw_connection_t *prc, int fd) {
-  int efd = prc->task.proactor->epollfd;
+  pn_proactor_t *p = prc->task.proactor;
 
   /* Get the local socket name now, get the peer name in pconnection_connected */
   socklen_t len = sizeof(prc->local.ss);
@@ -93,12 +133,12 @@ static void praw_connection_start(praw_connection_t *prc, int fd) {
   epoll_extended_t *ee = &prc->psocket.epoll_io;
   if (ee->polling) {     /* This is not the first attempt, stop polling and close the old FD */
     int fd = ee->fd;     /* Save fd, it will be set to -1 by stop_polling */
-    stop_polling(ee, efd);
-    pclosefd(prc->task.proactor, fd);
+    stop_polling(ee, p);
+    pclosefd(p, fd);
   }
   ee->fd = fd;
   ee->wanted = EPOLLIN | EPOLLOUT;
-  start_polling(ee, efd);  // TODO: check for error
+  start_polling(ee, p);  // TODO: check for error
 }
 
 /* Called on initial connect, and if connection fails to try another address */
@@ -150,7 +190,7 @@ static void praw_connection_init(praw_connection_t *prc, pn_proactor_t *p, pn_ra
 
 static void praw_connection_cleanup(praw_connection_t *prc) {
   int fd = prc->psocket.epoll_io.fd;
-  stop_polling(&prc->psocket.epoll_io, prc->task.proactor->epollfd);
+  stop_polling(&prc->psocket.epoll_io, prc->task.proactor);
   if (fd != -1)
     pclosefd(prc->task.proactor, fd);
 
@@ -168,7 +208,10 @@ pn_raw_connection_t *pn_raw_connection(void) {
   praw_connection_t *conn = (praw_connection_t*) calloc(1, sizeof(praw_connection_t));
   if (!conn) return NULL;
 
-  pni_raw_initialize(&conn->raw_connection);
+  if (!pni_raw_initialize(&conn->raw_connection)) {
+    free(conn);
+    return NULL;
+  }
 
   return &conn->raw_connection;
 }
@@ -272,6 +315,414 @@ void pn_raw_connection_wake(pn_raw_connection_t *rc) {
   if (notify) notify_poller(prc->task.proactor);
 }
 
+void pn_raw_connection_set_zerocopy(pn_raw_connection_t *rc, size_t threshold) {
+  praw_connection_t *prc = containerof(rc, praw_connection_t, raw_connection);
+  prc->zerocopy_threshold = threshold > UINT32_MAX ? UINT32_MAX : threshold;
+}
+
+/* Apply the requested zero copy threshold, zero copy stays off if the socket can't do it */
+static void praw_connection_zerocopy_update(praw_connection_t *prc, int fd) {
+#ifdef PNI_ZEROCOPY
+  if (prc->zerocopy_threshold && !prc->zerocopy) {
+    int one = 1;
+    prc->zerocopy = !setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+    if (!prc->zerocopy) prc->zerocopy_threshold = 0;
+  }
+#endif
+  prc->raw_connection.zerocopy_threshold = prc->zerocopy ? prc->zerocopy_threshold : 0;
+}
+
+/* Collect zero copy send completions from the socket error queue */
+static void praw_connection_zerocopy_completions(praw_connection_t *prc, int fd) {
+#ifdef PNI_ZEROCOPY
+  char control[128];
+  while (true) {
+    struct msghdr msg = {0};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) return;
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+      if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+          (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+        struct sock_extended_err *ee = (struct sock_extended_err *) CMSG_DATA(cm);
+        if (ee->ee_errno == 0 && ee->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+          pni_raw_zerocopy_done(&prc->raw_connection, ee->ee_info, ee->ee_data);
+        }
+      }
+    }
+  }
+#endif
+}
+
+//
+// Relays
+//
+
+/* Call with the relay mutex held, returns true if the poller needs notifying */
+static bool praw_relay_wake_lh(praw_relay_t *relay, int side) {
+  praw_connection_t *prc = relay->conns[side];
+  if (!prc) return false;
+  bool notify = false;
+  lock(&prc->task.mutex);
+  if (!prc->task.closing) {
+    prc->io_waking = true;
+    notify = schedule(&prc->task);
+  }
+  unlock(&prc->task.mutex);
+  return notify;
+}
+
+static void praw_relay_free(praw_relay_t *relay) {
+  for (int i = 0; i < 2; i++) {
+    close(relay->pipes[i].fds[0]);
+    close(relay->pipes[i].fds[1]);
+  }
+  pmutex_finalize(&relay->mutex);
+  free(relay);
+}
+
+/* Called by a finished connection, which neither reads nor writes any more */
+static void praw_relay_detach(praw_connection_t *prc, praw_relay_t *relay) {
+  int side = prc->relay_side;
+  lock(&relay->mutex);
+  relay->conns[side] = NULL;
+  relay->pipes[side].eof = true;
+  relay->pipes[1-side].broken = true;
+  bool notify = praw_relay_wake_lh(relay, 1-side);
+  bool last = !relay->conns[1-side];
+  pn_proactor_t *p = prc->task.proactor;
+  unlock(&relay->mutex);
+  if (last) praw_relay_free(relay);
+  if (notify) notify_poller(p);
+}
+
+int pn_raw_connection_relay(pn_raw_connection_t *rc, pn_raw_connection_t *peer) {
+  if (!rc || !peer || rc == peer) return PN_ARG_ERR;
+  praw_relay_t *relay = (praw_relay_t*) calloc(1, sizeof(praw_relay_t));
+  if (!relay) return PN_OUT_OF_MEMORY;
+  for (int i = 0; i < 2; i++) {
+    if (pipe2(relay->pipes[i].fds, O_NONBLOCK | O_CLOEXEC)) {
+      if (i) {
+        close(relay->pipes[0].fds[0]);
+        close(relay->pipes[0].fds[1]);
+      }
+      free(relay);
+      return PN_ERR;
+    }
+    (void)fcntl(relay->pipes[i].fds[1], F_SETPIPE_SZ, PNI_RELAY_PIPE_SIZE);
+  }
+  pmutex_init(&relay->mutex);
+
+  praw_connection_t *prcs[2] = {
+    containerof(rc, praw_connection_t, raw_connection),
+    containerof(peer, praw_connection_t, raw_connection)
+  };
+  /* Always lock the two tasks in the same order */
+  praw_connection_t *first = prcs[0] < prcs[1] ? prcs[0] : prcs[1];
+  praw_connection_t *second = prcs[0] < prcs[1] ? prcs[1] : prcs[0];
+  lock(&first->task.mutex);
+  lock(&second->task.mutex);
+  bool ok = true;
+  for (int i = 0; i < 2; i++) {
+    ok = ok && !prcs[i]->relay && !prcs[i]->task.closing;
+  }
+  bool notify = false;
+  if (ok) {
+    for (int i = 0; i < 2; i++) {
+      relay->conns[i] = prcs[i];
+      prcs[i]->relay = relay;
+      prcs[i]->relay_side = i;
+      prcs[i]->io_waking = true;
+      notify |= schedule(&prcs[i]->task);
+    }
+  }
+  unlock(&second->task.mutex);
+  unlock(&first->task.mutex);
+
+  if (!ok) {
+    praw_relay_free(relay);
+    return PN_STATE_ERR;
+  }
+  if (notify) notify_poller(prcs[0]->task.proactor);
+  return 0;
+}
+
+/* Splice from the socket into the pipe to the peer */
+static long relay_in(pn_raw_connection_t *rc, int fd) {
+  praw_connection_t *prc = containerof(rc, praw_connection_t, raw_connection);
+  praw_relay_t *relay = prc->relay;
+  int side = prc->relay_side;
+  praw_relay_pipe_t *pipe = &relay->pipes[side];
+  long r = splice(fd, NULL, pipe->fds[1], NULL, PNI_RELAY_PIPE_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+  if (r > 0) {
+    lock(&relay->mutex);
+    bool was_empty = pipe->queued == 0;
+    pipe->queued += r;
+    bool notify = was_empty && praw_relay_wake_lh(relay, 1-side);
+    unlock(&relay->mutex);
+    if (notify) notify_poller(prc->task.proactor);
+  } else if (r < 0 && errno == EAGAIN) {
+    /* Either the socket is empty or the pipe is full. The peer clears blocked
+       under the mutex after it empties some of the pipe, so it can't be missed. */
+    lock(&relay->mutex);
+    struct pollfd pfd = {pipe->fds[1], POLLOUT, 0};
+    if (poll(&pfd, 1, 0) == 0) pipe->blocked = true;
+    unlock(&relay->mutex);
+    errno = EWOULDBLOCK;
+  }
+  return r;
+}
+
+/* Splice to a socket without raising SIGPIPE, splice() has no MSG_NOSIGNAL */
+static long splice_nosigpipe(int from, int to, size_t size) {
+  sigset_t pending, old, block;
+  sigemptyset(&block);
+  sigaddset(&block, SIGPIPE);
+  sigpending(&pending);
+  bool was_pending = sigismember(&pending, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &block, &old);
+  long r = splice(from, NULL, to, NULL, size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+  int err = errno;
+  if (r < 0 && err == EPIPE && !was_pending) {
+    struct timespec zero = {0, 0};
+    while (sigtimedwait(&block, NULL, &zero) < 0 && errno == EINTR)
+      ;
+  }
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  errno = err;
+  return r;
+}
+
+/* Splice from the pipe from the peer to the socket */
+static long relay_out(pn_raw_connection_t *rc, int fd) {
+  praw_connection_t *prc = containerof(rc, praw_connection_t, raw_connection);
+  praw_relay_t *relay = prc->relay;
+  int side = prc->relay_side;
+  praw_relay_pipe_t *pipe = &relay->pipes[1-side];
+  lock(&relay->mutex);
+  size_t queued = pipe->queued;
+  unlock(&relay->mutex);
+  if (!queued) return 0;
+  long r = splice_nosigpipe(pipe->fds[0], fd, queued);
+  if (r > 0) {
+    lock(&relay->mutex);
+    pipe->queued -= r;
+    bool notify = false;
+    if (pipe->blocked) {
+      pipe->blocked = false;
+      notify = praw_relay_wake_lh(relay, 1-side);
+    }
+    unlock(&relay->mutex);
+    if (notify) notify_poller(prc->task.proactor);
+  }
+  return r;
+}
+
+/* Carry end of stream and errors across the relay */
+static void praw_relay_update(praw_connection_t *prc) {
+  pn_raw_connection_t *rc = &prc->raw_connection;
+  praw_relay_t *relay = prc->relay;
+  int side = prc->relay_side;
+  praw_relay_pipe_t *out = &relay->pipes[side];
+  praw_relay_pipe_t *in = &relay->pipes[1-side];
+
+  lock(&relay->mutex);
+  bool close_read = out->broken;
+  bool close_write = in->eof && in->queued == 0;
+  unlock(&relay->mutex);
+  /* Nothing read could be written, and nothing more will arrive to write */
+  if (close_read && !pn_raw_connection_is_read_closed(rc)) pn_raw_connection_read_close(rc);
+  if (close_write && !pn_raw_connection_is_write_closed(rc)) pn_raw_connection_write_close(rc);
+
+  bool rclosed = pn_raw_connection_is_read_closed(rc);
+  bool wclosed = pn_raw_connection_is_write_closed(rc);
+  bool notify = false;
+  lock(&relay->mutex);
+  if ((rclosed && !out->eof) || (wclosed && !in->broken)) {
+    out->eof |= rclosed;
+    in->broken |= wclosed;
+    notify = praw_relay_wake_lh(relay, 1-side);
+  }
+  unlock(&relay->mutex);
+  if (notify) notify_poller(prc->task.proactor);
+}
+
+static int praw_relay_wanted(praw_connection_t *prc) {
+  pn_raw_connection_t *rc = &prc->raw_connection;
+  praw_relay_t *relay = prc->relay;
+  int side = prc->relay_side;
+  lock(&relay->mutex);
+  int wanted =
+    (pni_raw_can_relay_read(rc) && !relay->pipes[side].blocked ? EPOLLIN : 0) |
+    (pni_raw_can_relay_write(rc) && relay->pipes[1-side].queued ? EPOLLOUT : 0);
+  unlock(&relay->mutex);
+  return wanted;
+}
+
+//
+// Buffer pool
+//
+
+/* Call with the pool mutex held, returns true if the poller needs notifying */
+static bool praw_buffer_pool_wake_lh(pni_raw_buffer_pool_t *pool) {
+  bool notify = false;
+  while (pool->waiting) {
+    praw_connection_t *prc = pool->waiting;
+    pool->waiting = prc->pool_next;
+    prc->pool_next = NULL;
+    prc->pool_waiting = false;
+    lock(&prc->task.mutex);
+    if (!prc->task.closing) {
+      prc->io_waking = true;
+      notify |= schedule(&prc->task);
+    }
+    unlock(&prc->task.mutex);
+  }
+  return notify;
+}
+
+int pn_proactor_add_raw_buffers(pn_proactor_t *p, size_t size, size_t count) {
+  if (!size || size > UINT32_MAX || !count || count > SIZE_MAX/size) return PN_ARG_ERR;
+  pni_raw_buffer_class_t c = {0};
+  c.memory = (char*) malloc(size*count);
+  c.free = (char**) malloc(count*sizeof(char*));
+  if (!c.memory || !c.free) {
+    free(c.memory);
+    free(c.free);
+    return PN_OUT_OF_MEMORY;
+  }
+  /* Hand out the lowest addresses first */
+  for (size_t i = 0; i < count; i++) {
+    c.free[i] = c.memory + (count-1-i)*size;
+  }
+  c.count = c.free_count = count;
+  c.size = size;
+
+  pni_raw_buffer_pool_t *pool = &p->raw_buffers;
+  lock(&pool->mutex);
+  pni_raw_buffer_class_t *classes = (pni_raw_buffer_class_t*)
+    realloc(pool->classes, (pool->class_count+1)*sizeof(pni_raw_buffer_class_t));
+  if (!classes) {
+    unlock(&pool->mutex);
+    free(c.memory);
+    free(c.free);
+    return PN_OUT_OF_MEMORY;
+  }
+  size_t i = pool->class_count;
+  for (; i > 0 && classes[i-1].size > c.size; i--) {
+    classes[i] = classes[i-1];
+  }
+  classes[i] = c;
+  pool->classes = classes;
+  pool->class_count++;
+  bool notify = praw_buffer_pool_wake_lh(pool);
+  unlock(&pool->mutex);
+  if (notify) notify_poller(p);
+  return 0;
+}
+
+size_t pn_proactor_release_raw_buffers(pn_proactor_t *p, const pn_raw_buffer_t *buffers, size_t num) {
+  pni_raw_buffer_pool_t *pool = &p->raw_buffers;
+  size_t released = 0;
+  lock(&pool->mutex);
+  for (size_t i = 0; i < num; i++) {
+    char *bytes = buffers[i].bytes;
+    for (size_t j = 0; j < pool->class_count; j++) {
+      pni_raw_buffer_class_t *c = &pool->classes[j];
+      if (bytes >= c->memory && bytes < c->memory + c->size*c->count) {
+        assert((size_t)(bytes - c->memory) % c->size == 0);
+        assert(c->free_count < c->count);
+        c->free[c->free_count++] = bytes;
+        released++;
+        break;
+      }
+    }
+  }
+  bool notify = released && praw_buffer_pool_wake_lh(pool);
+  unlock(&pool->mutex);
+  if (notify) notify_poller(p);
+  return released;
+}
+
+/* Take free buffers of at least size bytes, or join the waiting list if there are none */
+static size_t praw_buffer_pool_take(praw_connection_t *prc, pn_raw_buffer_t *buffers, size_t num) {
+  pni_raw_buffer_pool_t *pool = &prc->task.proactor->raw_buffers;
+  size_t count = 0;
+  lock(&pool->mutex);
+  for (size_t j = 0; j < pool->class_count; j++) {
+    pni_raw_buffer_class_t *c = &pool->classes[j];
+    if (c->size < prc->pool_size || !c->free_count) continue;
+    for (; count < num && c->free_count; count++) {
+      pn_raw_buffer_t b = {0};
+      b.bytes = c->free[--c->free_count];
+      b.capacity = c->size;
+      buffers[count] = b;
+    }
+    break;
+  }
+  if (!count && !prc->pool_waiting) {
+    prc->pool_waiting = true;
+    prc->pool_next = pool->waiting;
+    pool->waiting = prc;
+  }
+  unlock(&pool->mutex);
+  return count;
+}
+
+static bool praw_buffer_pool_waiting(praw_connection_t *prc) {
+  if (!prc->raw_connection.rpooled) return false;
+  pni_raw_buffer_pool_t *pool = &prc->task.proactor->raw_buffers;
+  lock(&pool->mutex);
+  bool waiting = prc->pool_waiting;
+  unlock(&pool->mutex);
+  return waiting;
+}
+
+static void praw_buffer_pool_leave(praw_connection_t *prc) {
+  pni_raw_buffer_pool_t *pool = &prc->task.proactor->raw_buffers;
+  lock(&pool->mutex);
+  if (prc->pool_waiting) {
+    praw_connection_t **pp = &pool->waiting;
+    while (*pp != prc) pp = &(*pp)->pool_next;
+    *pp = prc->pool_next;
+    prc->pool_next = NULL;
+    prc->pool_waiting = false;
+  }
+  unlock(&pool->mutex);
+}
+
+void pni_raw_buffer_pool_finalize(pni_raw_buffer_pool_t *pool) {
+  for (size_t j = 0; j < pool->class_count; j++) {
+    free(pool->classes[j].memory);
+    free(pool->classes[j].free);
+  }
+  free(pool->classes);
+  pmutex_finalize(&pool->mutex);
+}
+
+void pn_raw_connection_use_buffer_pool(pn_raw_connection_t *rc, size_t size) {
+  praw_connection_t *prc = containerof(rc, praw_connection_t, raw_connection);
+  prc->pool_size = size > UINT32_MAX ? UINT32_MAX : size;
+  rc->rpooled = true;
+}
+
+/*
+ * Leave the relay and the buffer pool before the connection is freed.
+ * False if the task was scheduled again meanwhile and has to finish later.
+ */
+static bool praw_connection_finish(praw_connection_t *prc) {
+  lock(&prc->task.mutex);
+  prc->task.closing = true;          /* No new relay and no more relay or pool wakes */
+  bool ready = prc->task.ready;
+  praw_relay_t *relay = prc->relay;
+  prc->relay = NULL;
+  unlock(&prc->task.mutex);
+
+  if (relay) praw_relay_detach(prc, relay);
+  if (prc->raw_connection.rpooled) praw_buffer_pool_leave(prc);
+  return !ready;
+}
+
 static inline void set_closed(pn_raw_connection_t *rc)
 {
   praw_connection_t *prc = containerof(rc, praw_connection_t, raw_connection);
@@ -329,12 +780,36 @@ task_t *pni_raw_connection_task(praw_connection_t *rc) {
   return &rc->task;
 }
 
-static long snd(int fd, const void* b, size_t s) {
-  return send(fd, b, s, MSG_NOSIGNAL | MSG_DONTWAIT);
+static long sndv(int fd, const pn_bytes_t *buffers, size_t count, bool *zerocopy) {
+  struct iovec iov[raw_iov_count];
+  for (size_t i = 0; i < count; i++) {
+    iov[i].iov_base = (void *) buffers[i].start;
+    iov[i].iov_len = buffers[i].size;
+  }
+  struct msghdr msg = {0};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = count;
+#ifdef PNI_ZEROCOPY
+  if (*zerocopy) {
+    long r = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT | MSG_ZEROCOPY);
+    if (r >= 0 || errno != ENOBUFS) return r;
+    /* Out of memory to pin the pages, copy instead */
+  }
+#endif
+  *zerocopy = false;
+  return sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
 }
 
-static long rcv(int fd, void* b, size_t s) {
-  return recv(fd, b, s, MSG_DONTWAIT);
+static long rcvv(int fd, const pn_rwbytes_t *buffers, size_t count) {
+  struct iovec iov[raw_iov_count];
+  for (size_t i = 0; i < count; i++) {
+    iov[i].iov_base = buffers[i].start;
+    iov[i].iov_len = buffers[i].size;
+  }
+  struct msghdr msg = {0};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = count;
+  return recvmsg(fd, &msg, MSG_DONTWAIT);
 }
 
 static int shutr(int fd) {
@@ -349,6 +824,23 @@ static void  set_error(pn_raw_connection_t *conn, const char *msg, int err) {
   psocket_error(containerof(conn, praw_connection_t, raw_connection), err, msg);
 }
 
+/*
+ * Nothing is kept from the pool while there is nothing to read: buffers are taken just
+ * before reading and the ones left unfilled go straight back.
+ */
+static void praw_connection_pool_read(praw_connection_t *prc, int fd) {
+  pn_raw_connection_t *raw = &prc->raw_connection;
+  pn_raw_buffer_t buffers[raw_iov_count];
+  size_t n = pn_raw_connection_read_buffers_capacity(raw);
+  if (n > raw_iov_count) n = raw_iov_count;
+  if (n) n = praw_buffer_pool_take(prc, buffers, n);
+  if (!n) return;
+  pni_raw_give_read_buffers(raw, buffers, n);
+  pni_raw_readv(raw, fd, rcvv, set_error);
+  n = pni_raw_take_unused_read_buffers(raw, buffers, raw_iov_count);
+  if (n) pn_proactor_release_raw_buffers(prc->task.proactor, buffers, n);
+}
+
 pn_event_batch_t *pni_raw_connection_process(task_t *t, bool sched_ready) {
   praw_connection_t *rc = containerof(t, praw_connection_t, task);
   lock(&rc->task.mutex);
@@ -381,11 +873,28 @@ pn_event_batch_t *pni_raw_connection_process(task_t *t, bool sched_ready) {
       pni_task_wake_done(&rc->task);
     }
   }
+  rc->io_waking = false;
+  praw_relay_t *relay = rc->relay;
   unlock(&t->mutex);
 
-  if (wake) pni_raw_wake(&rc->raw_connection);
-  if (events & EPOLLIN) pni_raw_read(&rc->raw_connection, fd, rcv, set_error);
-  if (events & EPOLLOUT) pni_raw_write(&rc->raw_connection, fd, snd, set_error);
+  pn_raw_connection_t *raw = &rc->raw_connection;
+  if (wake) pni_raw_wake(raw);
+  if (relay && !raw->relayed) pni_raw_relay_start(raw);
+  if (rc->zerocopy_threshold != raw->zerocopy_threshold) praw_connection_zerocopy_update(rc, fd);
+  if ((events & EPOLLERR) && pni_raw_zerocopy_pending(raw)) praw_connection_zerocopy_completions(rc, fd);
+  if (relay && raw->relayed) {
+    /* Buffers written before the relay started go first */
+    if (events & EPOLLOUT) pni_raw_writev(raw, fd, sndv, set_error);
+    pni_raw_relay_write(raw, fd, relay_out, set_error);
+    if (events & EPOLLIN) pni_raw_relay_read(raw, fd, relay_in, set_error);
+    praw_relay_update(rc);
+    return &rc->batch;
+  }
+  if (events & EPOLLIN) {
+    if (raw->rpooled) praw_connection_pool_read(rc, fd);
+    else pni_raw_readv(raw, fd, rcvv, set_error);
+  }
+  if (events & EPOLLOUT) pni_raw_writev(raw, fd, sndv, set_error);
   return &rc->batch;
 }
 
@@ -396,7 +905,7 @@ void pni_raw_connection_done(praw_connection_t *rc) {
   pn_proactor_t *p = rc->task.proactor;
   tslot_t *ts = rc->task.runner;
   rc->task.working = false;
-  notify = pni_task_wake_pending(&rc->task) && schedule(&rc->task);
+  notify = (pni_task_wake_pending(&rc->task) || rc->io_waking) && schedule(&rc->task);
   // The task may be in the ready state even if we've got no raw connection
   // wakes outstanding because we dealt with it already in pni_raw_batch_next()
   ready = rc->task.ready;
@@ -406,14 +915,16 @@ void pni_raw_connection_done(praw_connection_t *rc) {
   int fd = rc->psocket.epoll_io.fd;
   pni_raw_process_shutdown(raw, fd, shutr, shutw);
   int wanted =
-    (pni_raw_can_read(raw)  ? EPOLLIN : 0) |
-    (pni_raw_can_write(raw) ? EPOLLOUT : 0);
+    (pni_raw_can_read(raw) && !praw_buffer_pool_waiting(rc) ? EPOLLIN : 0) |
+    (pni_raw_can_write(raw) ? EPOLLOUT : 0) |
+    (pni_raw_zerocopy_pending(raw) ? EPOLLERR : 0);
+  if (raw->relayed && rc->relay) wanted |= praw_relay_wanted(rc);
   if (wanted) {
     rc->psocket.epoll_io.wanted = wanted;
-    rearm_polling(&rc->psocket.epoll_io, p->epollfd);  // TODO: check for error
+    rearm_polling(&rc->psocket.epoll_io, p);  // TODO: check for error
   } else {
     bool finished_disconnect = raw->state==conn_fini && !ready && !raw->disconnectpending;
-    if (finished_disconnect) {
+    if (finished_disconnect && praw_connection_finish(rc)) {
       // If we're closed and we've sent the disconnect then close
       pni_raw_finalize(raw);
       praw_connection_cleanup(rc);
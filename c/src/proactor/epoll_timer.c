@@ -32,23 +32,15 @@
  * Epoll proactor subsystem for timers.
  *
  * Two types of timers: (1) connection timers, one per connection, active if at least one of the peers has set a heartbeat,
- * timers move forward in time (but see replace_timer_deadline() note below), latency not critical; (2) a single proactor
- * timer, can move forwards or backwards, can be canceled.
+ * latency not critical; (2) a single proactor timer, can move forwards or backwards, can be canceled.
  *
- * A single timerfd is shared by all the timers.  Connection timers are tracked on a heap ordered list.  The proactor timer is
- * tracked separately.  The next timerfd_deadline is the earliest of all the timers, in this case the earliest of the first
- * connection timer and the poactor timer.
+ * A single timerfd is shared by all the timers.  Connection timers are kept on a hierarchical timer wheel (see
+ * core/timer_wheel.h) so setting, moving and cancelling one is constant time however many connections there are.  The
+ * proactor timer is tracked separately.  The next timerfd_deadline is the earliest of the wheel's next deadline and the
+ * proactor timer.
  *
- * If a connection timer is changed to a later time, it is not moved.  It is kept in place but marked with the new deadline.  On
- * expiry, depending on whether the deadline was extended, the decision is made to either generate a timeout or replace the
- * timer on the ordered list.
- *
- * When a timerfd read event is generated, the proactor invokes pni_timer_manager_process() to generate timeouts for each
- * expired timer and to do housekeeping on the rest.
- *
- * replace_timer_deadline(): a connection timer can go backwards in time at most once if: both peers have heartbeats and the
- * second AMQP open frame results in a shorter periodic transport timer than the first open frame.  In this case, the
- * existing timer_deadline is immediately orphaned and a new one created for the rest of the connection's life.
+ * When a timerfd read event is generated, the proactor invokes pni_timer_manager_process() to advance the wheel and
+ * generate a timeout for each expired timer.
  *
  * Lock ordering: tm->task_mutex --> tm->deletion_mutex.
  */
@@ -71,110 +63,46 @@ static void timerfd_drain(int fd) {
   }
 }
 
-// Struct to manage the ordering of timers on the heap ordered list and manage the lifecycle if
-// the parent timer is self-deleting.
-typedef struct timer_deadline_t {
-  uint64_t list_deadline;      // Heap ordering deadline.  Must not change while on list.
-  pni_timer_t *timer;          // Parent timer.  NULL means orphaned and to be deleted.
-  bool resequenced;            // An out-of-order connection timeout caught and handled.
-} timer_deadline_t;
-
-static void timer_deadline_initialize(void *object) {
-  timer_deadline_t *td = (timer_deadline_t *) object;
-  memset(td, 0 , sizeof(*td));
-}
-
-static void timer_deadline_finalize(void *object) {
-  assert(((timer_deadline_t *) object)->list_deadline == 0);
-}
-
-static intptr_t timer_deadline_compare(void *oa, void *ob) {
-  timer_deadline_t *a = (timer_deadline_t *) oa;
-  timer_deadline_t *b = (timer_deadline_t *) ob;
-  return a->list_deadline - b->list_deadline;
-}
-
-#define timer_deadline_inspect NULL
-#define timer_deadline_hashcode NULL
-#define CID_timer_deadline CID_pn_void
-
-static timer_deadline_t* pni_timer_deadline(void) {
-  static const pn_class_t timer_deadline_clazz = PN_CLASS(timer_deadline);
-  return (timer_deadline_t *) pn_class_new(&timer_deadline_clazz, sizeof(timer_deadline_t));
-}
-
-
 struct pni_timer_t {
   uint64_t deadline;
-  timer_deadline_t *timer_deadline;
+  pni_timer_entry_t entry;     // On tm->timers_wheel while a connection timer is set
   pni_timer_manager_t *manager;
   pconnection_t *connection;
 };
 
 pni_timer_t *pni_timer(pni_timer_manager_t *tm, pconnection_t *c) {
-  timer_deadline_t *td = NULL;
-  pni_timer_t *timer = NULL;
   assert(c || !tm->task.proactor->timer);  // Proactor timer.  Can only be one.
-  timer = (pni_timer_t *) malloc(sizeof(pni_timer_t));
+  pni_timer_t *timer = (pni_timer_t *) malloc(sizeof(pni_timer_t));
   if (!timer) return NULL;
-  if (c) {
-    // Connections are tracked on the timer_heap.  Allocate the tracking struct.
-    td = pni_timer_deadline();
-    if (!td) {
-      free(timer);
-      return NULL;
-    }
-  }
-
-  lock(&tm->task.mutex);
   timer->connection = c;
   timer->manager = tm;
-  timer->timer_deadline = td;
   timer->deadline = 0;
-  if (c)
-    td->timer = timer;
-  unlock(&tm->task.mutex);
+  pni_timer_entry_init(&timer->entry);
   return timer;
 }
 
 // Call with no locks.
 void pni_timer_free(pni_timer_t *timer) {
-  timer_deadline_t *td = timer->timer_deadline;
-  bool can_free_td = false;
-  if (td) pni_timer_set(timer, 0);
   pni_timer_manager_t *tm = timer->manager;
   lock(&tm->task.mutex);
+  // Wait out any timeout in progress for the connection.
   lock(&tm->deletion_mutex);
-  if (td) {
-    if (td->list_deadline)
-      td->timer = NULL;  // Orphan.  timer_manager does eventual pn_free() in process().
-    else
-      can_free_td = true;
-  }
+  pni_timer_wheel_remove(&tm->timers_wheel, &timer->entry);
   unlock(&tm->deletion_mutex);
   unlock(&tm->task.mutex);
-  if (can_free_td) {
-    pn_free(td);
-  }
   free(timer);
 }
 
-static timer_deadline_t *replace_timer_deadline(pni_timer_manager_t *tm, pni_timer_t *timer);
-
 // Return true if initialization succeeds.  Called once at proactor creation.
 bool pni_timer_manager_init(pni_timer_manager_t *tm) {
   tm->epoll_timer.fd = -1;
   tm->timerfd_deadline = 0;
-  tm->timers_heap = NULL;
   tm->proactor_timer = NULL;
   pn_proactor_t *p = containerof(tm, pn_proactor_t, timer_manager);
   task_init(&tm->task, TIMER_MANAGER, p);
   pmutex_init(&tm->deletion_mutex);
+  pni_timer_wheel_init(&tm->timers_wheel, pn_proactor_now_64());
 
-  // PN_VOID turns off ref counting for the elements in the list.
-  tm->timers_heap = pn_list(PN_VOID, 0);
-  if (!tm->timers_heap)
-    return false;
   tm->proactor_timer = pni_timer(tm, NULL);
   if (!tm->proactor_timer)
     return false;
@@ -193,17 +121,8 @@ void pni_timer_manager_finalize(pni_timer_manager_t *tm) {
   lock(&tm->task.mutex);
   unlock(&tm->task.mutex);  // Memory barrier
   if (tm->epoll_timer.fd >= 0) close(tm->epoll_timer.fd);
-  pni_timer_free(tm->proactor_timer);
-  if (tm->timers_heap) {
-    size_t sz = pn_list_size(tm->timers_heap);
-    // On teardown there is no need to preserve the heap.  Traverse the list ignoring minpop().
-    for (size_t idx = 0; idx < sz; idx++) {
-      timer_deadline_t *td = (timer_deadline_t *) pn_list_get(tm->timers_heap, idx);
-      td->list_deadline = 0;
-      pn_free(td);
-    }
-    pn_free(tm->timers_heap);
-  }
+  if (tm->proactor_timer) pni_timer_free(tm->proactor_timer);
+  // Connection timers belong to their connections, which are gone by now.
   pmutex_finalize(&tm->deletion_mutex);
   task_finalize(&tm->task);
 }
@@ -215,12 +134,9 @@ static bool adjust_deadline(pni_timer_manager_t *tm) {
     return false;  // timer_manager task will adjust the timer when it stops working
   bool notify = false;
   uint64_t new_deadline = tm->proactor_timer->deadline;
-  if (pn_list_size(tm->timers_heap)) {
-    // First element of timers_heap has earliest deadline on the heap.
-    timer_deadline_t *heap0 = (timer_deadline_t *) pn_list_get(tm->timers_heap, 0);
-    assert(heap0->list_deadline != 0);
-    new_deadline = new_deadline ? pn_min(new_deadline, heap0->list_deadline) : heap0->list_deadline;
-  }
+  uint64_t wheel_deadline = pni_timer_wheel_next(&tm->timers_wheel);
+  if (wheel_deadline)
+    new_deadline = new_deadline ? pn_min(new_deadline, wheel_deadline) : wheel_deadline;
   // Only change target deadline if new_deadline is in future but earlier than old timerfd_deadline.
   if (new_deadline) {
     if (tm->timerfd_deadline == 0 || new_deadline < tm->timerfd_deadline) {
@@ -253,28 +169,12 @@ void pni_timer_set(pni_timer_t *timer, uint64_t deadline) {
 
   if (timer == tm->proactor_timer) {
     assert(!timer->connection);
-    timer->deadline = deadline;
   } else {
-    // Connection
-    timer_deadline_t *td = timer->timer_deadline;
-    // A connection timer can go backwards at most once.  Check here.
-    if (deadline && td->list_deadline && deadline < td->list_deadline) {
-      if (td->resequenced)
-        EPOLL_FATAL("idle timeout sequencing error", 0);  //
-      else {
-        // replace drops the lock for malloc.  Safe because there can be no competing call to
-        // the timer set function by the same pconnection from another thread.
-        td = replace_timer_deadline(tm, timer);
-      }
-    }
-
-    timer->deadline = deadline;
-    // Put on list if not already there.
-    if (deadline && !td->list_deadline) {
-      td->list_deadline = deadline;
-      pn_list_minpush(tm->timers_heap, td);
-    }
+    pni_timer_wheel_remove(&tm->timers_wheel, &timer->entry);
+    if (deadline)
+      pni_timer_wheel_add(&tm->timers_wheel, &timer->entry, deadline);
   }
+  timer->deadline = deadline;
 
   // Skip a cancelled timer (deadline == 0) since it doesn't change the timerfd deadline.
   if (deadline)
@@ -305,48 +205,24 @@ pn_event_batch_t *pni_timer_manager_process(pni_timer_manager_t *tm, bool timeou
     // here with the event batch, and schedule the timer manager task to process the connection timers.
   }
 
-  // Next, find all expired connection timers at front of the ordered heap.
-  while (pn_list_size(tm->timers_heap)) {
-    timer_deadline_t *td = (timer_deadline_t *) pn_list_get(tm->timers_heap, 0);
-    if (td->list_deadline > now)
-      break;
-
-    // Expired. Remove from list.
-    timer_deadline_t *min = (timer_deadline_t *) pn_list_minpop(tm->timers_heap);
-    assert (min == td);
-    min->list_deadline = 0;
-
-    // Three possibilities to act on:
-    //   timer expired -> pni_connection_timeout()
-    //   timer deadline extended -> minpush back on list to new spot
-    //   timer freed -> free the associated timer_deadline popped off the list
-    if (!td->timer) {
-      unlock(&tm->task.mutex);
-      pn_free(td);
-      lock(&tm->task.mutex);
-    } else {
-      uint64_t deadline = td->timer->deadline;
-      if (deadline) {
-        if (deadline <= now) {
-          td->timer->deadline = 0;
-          pconnection_t *pc = td->timer->connection;
-          lock(&tm->deletion_mutex);     // Prevent connection from deleting itself when tm->task.mutex dropped.
-          unlock(&tm->task.mutex);
-          pni_pconnection_timeout(pc);
-          unlock(&tm->deletion_mutex);
-          lock(&tm->task.mutex);
-        } else {
-          td->list_deadline = deadline;
-          pn_list_minpush(tm->timers_heap, td);
-        }
-      }
-    }
+  // Next, expire every connection timer that is due in one pass of the wheel.
+  pni_timer_wheel_advance(&tm->timers_wheel, now);
+  pni_timer_entry_t *e;
+  while ((e = pni_timer_wheel_pop(&tm->timers_wheel))) {
+    pni_timer_t *timer = containerof(e, pni_timer_t, entry);
+    timer->deadline = 0;
+    pconnection_t *pc = timer->connection;
+    lock(&tm->deletion_mutex);     // Prevent connection from deleting itself when tm->task.mutex dropped.
+    unlock(&tm->task.mutex);
+    pni_pconnection_timeout(pc);
+    unlock(&tm->deletion_mutex);
+    lock(&tm->task.mutex);
   }
 
   if (timeout) {
     // TODO: query whether perf gain by doing these system calls outside the lock, perhaps with additional set_reset_mutex.
     timerfd_drain(tm->epoll_timer.fd);
-    rearm_polling(&tm->epoll_timer, tm->task.proactor->epollfd);
+    rearm_polling(&tm->epoll_timer, tm->task.proactor);
   }
   tm->task.working = false;  // must be false for adjust_deadline to do adjustment
   bool notify = adjust_deadline(tm);
@@ -358,26 +234,3 @@ pn_event_batch_t *pni_timer_manager_process(pni_timer_manager_t *tm, bool timeou
   return NULL;
   // TODO: perhaps become task of one of the timed out timers (if otherwise idle) and process() that task.
 }
-
-// Call with timer_manager lock held.
-// There can be no competing call to this and timer_set() from the same connection.
-static timer_deadline_t *replace_timer_deadline(pni_timer_manager_t *tm, pni_timer_t *timer) {
-  assert(timer->connection);
-  timer_deadline_t *old_td = timer->timer_deadline;
-  assert(old_td);
-  // Mark old struct for deletion.  No parent timer.
-  old_td->timer = NULL;
-
-  unlock(&tm->task.mutex);
-  // Create replacement timer for life of connection.
-  timer_deadline_t *new_td = pni_timer_deadline();
-  if (!new_td)
-    EPOLL_FATAL("replacement timer deadline allocation", errno);
-  lock(&tm->task.mutex);
-
-  new_td->list_deadline = 0;
-  new_td->timer = timer;
-  new_td->resequenced = true;
-  timer->timer_deadline = new_td;
-  return new_td;
-}
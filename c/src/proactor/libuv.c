@@ -1369,5 +1369,10 @@ void pn_raw_connection_wake(pn_raw_connection_t *conn) {}
 void pn_raw_connection_close(pn_raw_connection_t *conn) {}
 void pn_raw_connection_read_close(pn_raw_connection_t *conn) {}
 void pn_raw_connection_write_close(pn_raw_connection_t *conn) {}
+void pn_raw_connection_set_zerocopy(pn_raw_connection_t *conn, size_t threshold) {}
+int pn_raw_connection_relay(pn_raw_connection_t *conn, pn_raw_connection_t *peer) { return PN_ERR; }
+int pn_proactor_add_raw_buffers(pn_proactor_t *p, size_t size, size_t count) { return PN_ERR; }
+size_t pn_proactor_release_raw_buffers(pn_proactor_t *p, const pn_raw_buffer_t *buffers, size_t num) { return 0; }
+void pn_raw_connection_use_buffer_pool(pn_raw_connection_t *conn, size_t size) {}
 const struct pn_netaddr_t *pn_raw_connection_local_addr(pn_raw_connection_t *connection) { return NULL; }
 const struct pn_netaddr_t *pn_raw_connection_remote_addr(pn_raw_connection_t *connection) { return NULL; }
@@ -21,13 +21,17 @@
  *
  */
 
+#include "proton/raw_connection.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 enum {
-  read_buffer_count = 16,
-  write_buffer_count = 16
+  read_buffer_count = 16,     // Default slots for read buffers
+  write_buffer_count = 16,    // Default slots for write buffers
+  raw_buffer_slots_max = 1024,
+  raw_iov_count = 64          // Most buffers read or written by one vectored call
 };
 
 typedef enum {
@@ -78,13 +82,19 @@ typedef struct pbuffer_t {
   uint32_t capacity;
   uint32_t size;
   uint32_t offset;
+  uint32_t zerocopy_id; // Last zero copy send that used the buffer, 0 if none
   buff_ptr next;
   uint8_t type; // For debugging
 } pbuffer_t;
 
+// Zero copy sends that can be awaiting completion at once
+#define PNI_RAW_ZEROCOPY_MAX 64
+
 struct pn_raw_connection_t {
-  pbuffer_t rbuffers[read_buffer_count];
-  pbuffer_t wbuffers[write_buffer_count];
+  pbuffer_t *rbuffers; // rbuffer_slots of them, followed by the write buffers
+  pbuffer_t *wbuffers;
+  uint16_t rbuffer_slots;
+  uint16_t wbuffer_slots;
   pn_condition_t *condition;
   pn_collector_t *collector;
   pn_record_t *attachments;
@@ -104,9 +114,17 @@ struct pn_raw_connection_t {
   buff_ptr wbuffer_first_written;
   buff_ptr wbuffer_last_written;
 
+  // Zero copy sends are numbered from 1, sends up to zerocopy_done have completed
+  uint32_t zerocopy_threshold; // 0 if not in use
+  uint32_t zerocopy_sent;
+  uint32_t zerocopy_done;
+  uint64_t zerocopy_completed; // Completed sends after zerocopy_done, lowest bit first
+
   uint8_t state; // really raw_conn_state
   uint8_t disconnect_state; // really raw_disconnect_state
 
+  bool relayed; // Bytes are spliced to or from a peer connection instead of using buffers
+  bool rpooled; // Read buffers come from the proactor, not the application
   bool rrequestedbuffers;
   bool wrequestedbuffers;
 
@@ -130,11 +148,35 @@ void pni_raw_read_close(pn_raw_connection_t *conn);
 void pni_raw_write_close(pn_raw_connection_t *conn);
 void pni_raw_read(pn_raw_connection_t *conn, int sock, long (*recv)(int, void*, size_t), void (*set_error)(pn_raw_connection_t *, const char *, int));
 void pni_raw_write(pn_raw_connection_t *conn, int sock, long (*send)(int, const void*, size_t), void (*set_error)(pn_raw_connection_t *, const char *, int));
+/*
+ * Vectored versions that read into or write from all the available buffers with
+ * a single call. sendv may clear *zerocopy if it did not send with zero copy.
+ */
+void pni_raw_readv(pn_raw_connection_t *conn, int sock, long (*recvv)(int, const pn_rwbytes_t*, size_t), void (*set_error)(pn_raw_connection_t *, const char *, int));
+void pni_raw_writev(pn_raw_connection_t *conn, int sock, long (*sendv)(int, const pn_bytes_t*, size_t, bool*), void (*set_error)(pn_raw_connection_t *, const char *, int));
+// Zero copy sends first to last (numbered from 0 as the kernel does) have completed
+void pni_raw_zerocopy_done(pn_raw_connection_t *conn, uint32_t first, uint32_t last);
+bool pni_raw_zerocopy_pending(pn_raw_connection_t *conn);
+/*
+ * A relayed connection moves bytes with relay() instead of through buffers. relay() returns the bytes it
+ * moved; when reading 0 means end of stream and when writing it means there is nothing left to write.
+ */
+void pni_raw_relay_start(pn_raw_connection_t *conn);
+void pni_raw_relay_read(pn_raw_connection_t *conn, int sock, long (*relay)(pn_raw_connection_t *, int), void (*set_error)(pn_raw_connection_t *, const char *, int));
+void pni_raw_relay_write(pn_raw_connection_t *conn, int sock, long (*relay)(pn_raw_connection_t *, int), void (*set_error)(pn_raw_connection_t *, const char *, int));
+bool pni_raw_can_relay_read(pn_raw_connection_t *conn);
+bool pni_raw_can_relay_write(pn_raw_connection_t *conn);
 void pni_raw_process_shutdown(pn_raw_connection_t *conn, int sock, int (*shutdown_rd)(int), int (*shutdown_wr)(int));
+/*
+ * Pooled connections are given read buffers by the proactor just before reading and the buffers still
+ * unused afterwards are taken back.
+ */
+size_t pni_raw_give_read_buffers(pn_raw_connection_t *conn, pn_raw_buffer_t const *buffers, size_t num);
+size_t pni_raw_take_unused_read_buffers(pn_raw_connection_t *conn, pn_raw_buffer_t *buffers, size_t num);
 bool pni_raw_can_read(pn_raw_connection_t *conn);
 bool pni_raw_can_write(pn_raw_connection_t *conn);
 pn_event_t *pni_raw_event_next(pn_raw_connection_t *conn);
-void pni_raw_initialize(pn_raw_connection_t *conn);
+bool pni_raw_initialize(pn_raw_connection_t *conn);
 void pni_raw_finalize(pn_raw_connection_t *conn);
 
 #ifdef __cplusplus
@@ -28,6 +28,7 @@
 
 #include "proton/raw_connection.h"
 
+#include "proton/error.h"
 #include "proton/event.h"
 #include "proton/listener.h"
 #include "proton/object.h"
@@ -47,23 +48,39 @@
 
 PN_STRUCT_CLASSDEF(pn_raw_connection)
 
-void pni_raw_initialize(pn_raw_connection_t *conn) {
+// Read and write slots share one allocation, read slots first
+static bool pni_raw_allocate_slots(pn_raw_connection_t *conn, uint16_t rslots, uint16_t wslots) {
+  pbuffer_t *slots = (pbuffer_t*) calloc(rslots+wslots, sizeof(pbuffer_t));
+  if (!slots) return false;
+  free(conn->rbuffers);
+  conn->rbuffers = slots;
+  conn->wbuffers = slots+rslots;
+  conn->rbuffer_slots = rslots;
+  conn->wbuffer_slots = wslots;
+
   // Link together free lists
-  for (buff_ptr i = 1; i<=read_buffer_count; i++) {
-    conn->rbuffers[i-1].next = i==read_buffer_count ? 0 : i+1;
+  for (buff_ptr i = 1; i<=rslots; i++) {
+    conn->rbuffers[i-1].next = i==rslots ? 0 : i+1;
     conn->rbuffers[i-1].type = buff_rempty;
-    conn->wbuffers[i-1].next = i==read_buffer_count ? 0 : i+1;
+  }
+  for (buff_ptr i = 1; i<=wslots; i++) {
+    conn->wbuffers[i-1].next = i==wslots ? 0 : i+1;
     conn->wbuffers[i-1].type = buff_wempty;
   }
+  conn->rbuffer_first_empty = 1;
+  conn->wbuffer_first_empty = 1;
+  return true;
+}
+
+bool pni_raw_initialize(pn_raw_connection_t *conn) {
+  if (!pni_raw_allocate_slots(conn, read_buffer_count, write_buffer_count)) return false;
 
   conn->condition = pn_condition();
   conn->collector = pn_collector();
   conn->attachments = pn_record();
 
-  conn->rbuffer_first_empty = 1;
-  conn->wbuffer_first_empty = 1;
-
   conn->state = conn_init;
+  return true;
 }
 
 typedef enum {
@@ -225,7 +242,7 @@ bool pni_raw_validate(pn_raw_connection_t *conn) {
     if (conn->rbuffers[i-1].type != buff_read) return false;
     rread_count++;
   }
-  if (rempty_count+runused_count+rread_count != read_buffer_count) return false;
+  if (rempty_count+runused_count+rread_count != conn->rbuffer_slots) return false;
   if (!conn->rbuffer_first_unused && conn->rbuffer_last_unused) return false;
   if (conn->rbuffer_last_unused &&
     (conn->rbuffers[conn->rbuffer_last_unused-1].type != buff_unread || conn->rbuffers[conn->rbuffer_last_unused-1].next != 0)) return false;
@@ -248,7 +265,7 @@ bool pni_raw_validate(pn_raw_connection_t *conn) {
     if (conn->wbuffers[i-1].type != buff_written) return false;
     wwritten_count++;
   }
-  if (wempty_count+wunwritten_count+wwritten_count != write_buffer_count) return false;
+  if (wempty_count+wunwritten_count+wwritten_count != conn->wbuffer_slots) return false;
   if (!conn->wbuffer_first_towrite && conn->wbuffer_last_towrite) return false;
   if (conn->wbuffer_last_towrite &&
     (conn->wbuffers[conn->wbuffer_last_towrite-1].type != buff_unwritten || conn->wbuffers[conn->wbuffer_last_towrite-1].next != 0)) return false;
@@ -262,22 +279,37 @@ void pni_raw_finalize(pn_raw_connection_t *conn) {
   pn_condition_free(conn->condition);
   pn_collector_free(conn->collector);
   pn_free(conn->attachments);
+  free(conn->rbuffers);
+}
+
+int pn_raw_connection_set_buffer_slots(pn_raw_connection_t *conn, size_t read_slots, size_t write_slots) {
+  assert(conn);
+  if (read_slots == 0 || write_slots == 0 || read_slots > raw_buffer_slots_max || write_slots > raw_buffer_slots_max) {
+    return PN_ARG_ERR;
+  }
+  if (conn->state != conn_init || conn->rbuffer_count || conn->wbuffer_count) return PN_STATE_ERR;
+  return pni_raw_allocate_slots(conn, read_slots, write_slots) ? 0 : PN_OUT_OF_MEMORY;
 }
 
 size_t pn_raw_connection_read_buffers_capacity(pn_raw_connection_t *conn) {
   assert(conn);
   bool rclosed = pni_raw_rclosed(conn);
-  return rclosed ? 0 : (read_buffer_count - conn->rbuffer_count);
+  return (rclosed || conn->relayed) ? 0 : (conn->rbuffer_slots - conn->rbuffer_count);
 }
 
 size_t pn_raw_connection_write_buffers_capacity(pn_raw_connection_t *conn) {
   assert(conn);
   bool wclosed = pni_raw_wclosed(conn);
-  return wclosed ? 0 : (write_buffer_count-conn->wbuffer_count);
+  return (wclosed || conn->relayed) ? 0 : (conn->wbuffer_slots-conn->wbuffer_count);
 }
 
 size_t pn_raw_connection_give_read_buffers(pn_raw_connection_t *conn, pn_raw_buffer_t const *buffers, size_t num) {
   assert(conn);
+  // The proactor supplies the read buffers of a pooled connection
+  return conn->rpooled ? 0 : pni_raw_give_read_buffers(conn, buffers, num);
+}
+
+size_t pni_raw_give_read_buffers(pn_raw_connection_t *conn, pn_raw_buffer_t const *buffers, size_t num) {
   size_t can_take = pn_min(num, pn_raw_connection_read_buffers_capacity(conn));
   if ( can_take==0 ) return 0;
 
@@ -344,6 +376,29 @@ size_t pn_raw_connection_take_read_buffers(pn_raw_connection_t *conn, pn_raw_buf
   return count;
 }
 
+size_t pni_raw_take_unused_read_buffers(pn_raw_connection_t *conn, pn_raw_buffer_t *buffers, size_t num) {
+  size_t count = 0;
+  for (; conn->rbuffer_first_unused && count < num; count++) {
+    buff_ptr p = conn->rbuffer_first_unused;
+    assert(conn->rbuffers[p-1].type == buff_unread);
+    buffers[count].context = conn->rbuffers[p-1].context;
+    buffers[count].bytes = conn->rbuffers[p-1].bytes;
+    buffers[count].capacity = conn->rbuffers[p-1].capacity;
+    buffers[count].size = 0;
+    buffers[count].offset = conn->rbuffers[p-1].offset;
+    conn->rbuffers[p-1].type = buff_rempty;
+
+    conn->rbuffer_first_unused = conn->rbuffers[p-1].next;
+    conn->rbuffers[p-1].next = conn->rbuffer_first_empty;
+    conn->rbuffer_first_empty = p;
+  }
+  if (!conn->rbuffer_first_unused) {
+    conn->rbuffer_last_unused = 0;
+  }
+  conn->rbuffer_count -= count;
+  return count;
+}
+
 size_t pn_raw_connection_write_buffers(pn_raw_connection_t *conn, pn_raw_buffer_t const *buffers, size_t num) {
   assert(conn);
   size_t can_take = pn_min(num, pn_raw_connection_write_buffers_capacity(conn));
@@ -361,6 +416,7 @@ size_t pn_raw_connection_write_buffers(pn_raw_connection_t *conn, pn_raw_buffer_
     conn->wbuffers[current-1].capacity = buffers[i].capacity;
     conn->wbuffers[current-1].size = buffers[i].size;
     conn->wbuffers[current-1].offset = buffers[i].offset;
+    conn->wbuffers[current-1].zerocopy_id = 0;
     conn->wbuffers[current-1].type = buff_unwritten;
 
     previous = current;
@@ -383,6 +439,16 @@ size_t pn_raw_connection_write_buffers(pn_raw_connection_t *conn, pn_raw_buffer_
   return can_take;
 }
 
+// The kernel may still be sending from a buffer used by a zero copy send that has not completed
+static inline bool pni_raw_wbuffer_done(pn_raw_connection_t *conn, buff_ptr p) {
+  uint32_t id = conn->wbuffers[p-1].zerocopy_id;
+  return id == 0 || (int32_t)(id - conn->zerocopy_done) <= 0;
+}
+
+static inline bool pni_raw_written_ready(pn_raw_connection_t *conn) {
+  return conn->wbuffer_first_written && pni_raw_wbuffer_done(conn, conn->wbuffer_first_written);
+}
+
 size_t pn_raw_connection_take_written_buffers(pn_raw_connection_t *conn, pn_raw_buffer_t *buffers, size_t num) {
   assert(conn);
   size_t count = 0;
@@ -391,7 +457,7 @@ size_t pn_raw_connection_take_written_buffers(pn_raw_connection_t *conn, pn_raw_
   if (!current) return 0;
 
   buff_ptr previous;
-  for (; current && count < num; count++) {
+  for (; current && count < num && pni_raw_wbuffer_done(conn, current); count++) {
     assert(conn->wbuffers[current-1].type == buff_written);
     buffers[count].context = conn->wbuffers[current-1].context;
     buffers[count].bytes = conn->wbuffers[current-1].bytes;
@@ -420,7 +486,7 @@ static inline void pni_raw_put_event(pn_raw_connection_t *conn, pn_event_type_t
   pn_collector_put(conn->collector, PN_CLASSCLASS(pn_raw_connection), (void*)conn, type);
 }
 
-static inline void pni_raw_release_buffers(pn_raw_connection_t *conn) {
+static inline void pni_raw_release_rbuffers(pn_raw_connection_t *conn) {
   for(;conn->rbuffer_first_unused;) {
     buff_ptr p = conn->rbuffer_first_unused;
     assert(conn->rbuffers[p-1].type == buff_unread);
@@ -438,6 +504,10 @@ static inline void pni_raw_release_buffers(pn_raw_connection_t *conn) {
     conn->rbuffers[p-1].type = buff_read;
   }
   conn->rbuffer_last_unused = 0;
+}
+
+static inline void pni_raw_release_buffers(pn_raw_connection_t *conn) {
+  pni_raw_release_rbuffers(conn);
   for(;conn->wbuffer_first_towrite;) {
     buff_ptr p = conn->wbuffer_first_towrite;
     assert(conn->wbuffers[p-1].type == buff_unwritten);
@@ -458,6 +528,9 @@ static inline void pni_raw_release_buffers(pn_raw_connection_t *conn) {
 
 static inline void pni_raw_disconnect(pn_raw_connection_t *conn) {
   pni_raw_release_buffers(conn);
+  // Completions still outstanding are not waited for, all buffers go back now
+  conn->zerocopy_done = conn->zerocopy_sent;
+  conn->zerocopy_completed = 0;
   conn->disconnectpending = true;
   conn->disconnect_state  = disc_init;
   conn->state = pni_raw_new_state(conn, int_disconnect);
@@ -478,18 +551,26 @@ void pni_raw_wake(pn_raw_connection_t *conn) {
   conn->wakepending = true;
 }
 
-void pni_raw_read(pn_raw_connection_t *conn, int sock, long (*recv)(int, void*, size_t), void(*set_error)(pn_raw_connection_t *, const char *, int)) {
+// Read with recv into the first buffer or with recvv into all of them
+static void pni_raw_do_read(pn_raw_connection_t *conn, int sock,
+                            long (*recv)(int, void*, size_t), long (*recvv)(int, const pn_rwbytes_t*, size_t),
+                            void(*set_error)(pn_raw_connection_t *, const char *, int)) {
   assert(conn);
 
   if (!pni_raw_ropen(conn)) return;
 
   bool closed = false;
   for(;conn->rbuffer_first_unused;) {
-    buff_ptr p = conn->rbuffer_first_unused;
-    assert(conn->rbuffers[p-1].type == buff_unread);
-    char *bytes = conn->rbuffers[p-1].bytes+conn->rbuffers[p-1].offset;
-    size_t s = conn->rbuffers[p-1].capacity-conn->rbuffers[p-1].offset;
-    int r = recv(sock, bytes, s);
+    pn_rwbytes_t iov[raw_iov_count];
+    size_t n = 0;
+    size_t total = 0;
+    for (buff_ptr p = conn->rbuffer_first_unused; p && n < raw_iov_count && (recvv || n == 0); p = conn->rbuffers[p-1].next) {
+      assert(conn->rbuffers[p-1].type == buff_unread);
+      iov[n].start = conn->rbuffers[p-1].bytes+conn->rbuffers[p-1].offset;
+      iov[n].size = conn->rbuffers[p-1].capacity-conn->rbuffers[p-1].offset;
+      total += iov[n++].size;
+    }
+    long r = recvv ? recvv(sock, iov, n) : recv(sock, iov[0].start, iov[0].size);
     if (r < 0) {
       switch (errno) {
         // Interrupted system call try again
@@ -505,26 +586,36 @@ void pni_raw_read(pn_raw_connection_t *conn, int sock, long (*recv)(int, void*,
           return;
       }
     }
-    conn->rbuffers[p-1].size += r;
-    conn->rbuffers[p-1].offset += r;
 
-    if (!conn->rbuffer_first_read) {
-      conn->rbuffer_first_read = p;
-    }
-    if (conn->rbuffer_last_read) {
-      conn->rbuffers[conn->rbuffer_last_read-1].next = p;
-    }
-    conn->rbuffer_last_read = p;
-    conn->rbuffer_first_unused = conn->rbuffers[p-1].next;
+    // Move each buffer with bytes read (or the first one at end of stream) to the read list
+    size_t left = r;
+    do {
+      buff_ptr p = conn->rbuffer_first_unused;
+      size_t c = pn_min(left, conn->rbuffers[p-1].capacity-conn->rbuffers[p-1].offset);
+      conn->rbuffers[p-1].size += c;
+      conn->rbuffers[p-1].offset += c;
+      left -= c;
+
+      if (!conn->rbuffer_first_read) {
+        conn->rbuffer_first_read = p;
+      }
+      if (conn->rbuffer_last_read) {
+        conn->rbuffers[conn->rbuffer_last_read-1].next = p;
+      }
+      conn->rbuffer_last_read = p;
+      conn->rbuffer_first_unused = conn->rbuffers[p-1].next;
 
-    conn->rbuffers[p-1].next = 0;
-    conn->rbuffers[p-1].type = buff_read;
+      conn->rbuffers[p-1].next = 0;
+      conn->rbuffers[p-1].type = buff_read;
+    } while (left > 0);
 
     // Checking for end of stream here ensures that there is a buffer at the end with nothing in it
     if (r == 0) {
       closed = true;
       break;
     }
+    // A short vectored read took everything there was
+    if (recvv && (size_t)r < total) break;
   }
 finished_reading:
   if (!conn->rbuffer_first_unused) {
@@ -551,7 +642,18 @@ finished_reading:
   return;
 }
 
-void pni_raw_write(pn_raw_connection_t *conn, int sock, long (*send)(int, const void*, size_t), void(*set_error)(pn_raw_connection_t *, const char *, int)) {
+void pni_raw_read(pn_raw_connection_t *conn, int sock, long (*recv)(int, void*, size_t), void(*set_error)(pn_raw_connection_t *, const char *, int)) {
+  pni_raw_do_read(conn, sock, recv, NULL, set_error);
+}
+
+void pni_raw_readv(pn_raw_connection_t *conn, int sock, long (*recvv)(int, const pn_rwbytes_t*, size_t), void(*set_error)(pn_raw_connection_t *, const char *, int)) {
+  pni_raw_do_read(conn, sock, NULL, recvv, set_error);
+}
+
+// Write with send from the first buffer or with sendv from all of them
+static void pni_raw_do_write(pn_raw_connection_t *conn, int sock,
+                             long (*send)(int, const void*, size_t), long (*sendv)(int, const pn_bytes_t*, size_t, bool*),
+                             void(*set_error)(pn_raw_connection_t *, const char *, int)) {
   assert(conn);
 
   if (pni_raw_wdrained(conn)) return;
@@ -559,11 +661,19 @@ void pni_raw_write(pn_raw_connection_t *conn, int sock, long (*send)(int, const
   bool closed = false;
   bool drained = false;
   for(;conn->wbuffer_first_towrite;) {
-    buff_ptr p = conn->wbuffer_first_towrite;
-    assert(conn->wbuffers[p-1].type == buff_unwritten);
-    char *bytes = conn->wbuffers[p-1].bytes+conn->wbuffers[p-1].offset+conn->unwritten_offset;
-    size_t s = conn->wbuffers[p-1].size-conn->unwritten_offset;
-    int r = send(sock,  bytes, s);
+    pn_bytes_t iov[raw_iov_count];
+    size_t n = 0;
+    size_t total = 0;
+    for (buff_ptr p = conn->wbuffer_first_towrite; p && n < raw_iov_count && (sendv || n == 0); p = conn->wbuffers[p-1].next) {
+      assert(conn->wbuffers[p-1].type == buff_unwritten);
+      size_t skip = n == 0 ? conn->unwritten_offset : 0;
+      iov[n].start = conn->wbuffers[p-1].bytes+conn->wbuffers[p-1].offset+skip;
+      iov[n].size = conn->wbuffers[p-1].size-skip;
+      total += iov[n++].size;
+    }
+    bool zerocopy = sendv && conn->zerocopy_threshold && total >= conn->zerocopy_threshold &&
+      conn->zerocopy_sent - conn->zerocopy_done < PNI_RAW_ZEROCOPY_MAX;
+    long r = sendv ? sendv(sock, iov, n, &zerocopy) : send(sock, iov[0].start, iov[0].size);
     if (r < 0) {
       // Interrupted system call try again
       switch (errno) {
@@ -583,30 +693,46 @@ void pni_raw_write(pn_raw_connection_t *conn, int sock, long (*send)(int, const
     // return of 0 was never observed in testing and the documentation
     // implies that 0 could only be returned if 0 bytes were sent; however
     // leaving this case here seems safe.
-    if (r == 0 && s > 0) {
+    if (r == 0 && total > 0) {
       closed = true;
       break;
     }
 
-    // Only wrote a partial buffer  - adjust buffer
-    if (r != (int)s) {
-      conn->unwritten_offset += r;
-      break;
-    }
+    // The kernel numbers zero copy sends that succeed
+    uint32_t zerocopy_id = (zerocopy && r > 0) ? ++conn->zerocopy_sent : 0;
 
-    conn->unwritten_offset = 0;
+    // Move each buffer written completely to the written list
+    size_t left = r;
+    for (;conn->wbuffer_first_towrite;) {
+      buff_ptr p = conn->wbuffer_first_towrite;
+      size_t s = conn->wbuffers[p-1].size-conn->unwritten_offset;
+      if (left == 0 && s > 0) break;
+      if (zerocopy_id) conn->wbuffers[p-1].zerocopy_id = zerocopy_id;
 
-    if (!conn->wbuffer_first_written) {
-      conn->wbuffer_first_written = p;
-    }
-    if (conn->wbuffer_last_written) {
-      conn->wbuffers[conn->wbuffer_last_written-1].next = p;
+      // Only wrote a partial buffer  - adjust buffer
+      if (left < s) {
+        conn->unwritten_offset += left;
+        break;
+      }
+      left -= s;
+
+      conn->unwritten_offset = 0;
+
+      if (!conn->wbuffer_first_written) {
+        conn->wbuffer_first_written = p;
+      }
+      if (conn->wbuffer_last_written) {
+        conn->wbuffers[conn->wbuffer_last_written-1].next = p;
+      }
+      conn->wbuffer_last_written = p;
+      conn->wbuffer_first_towrite = conn->wbuffers[p-1].next;
+
+      conn->wbuffers[p-1].next = 0;
+      conn->wbuffers[p-1].type = buff_written;
     }
-    conn->wbuffer_last_written = p;
-    conn->wbuffer_first_towrite = conn->wbuffers[p-1].next;
 
-    conn->wbuffers[p-1].next = 0;
-    conn->wbuffers[p-1].type = buff_written;
+    // Partial write - the socket is full
+    if ((size_t)r < total) break;
   }
 finished_writing:
   if (!conn->wbuffer_first_towrite) {
@@ -614,7 +740,7 @@ finished_writing:
     drained = true;
   }
   // Wrote something; end of stream; out of buffers; or blocked for write
-  if (conn->wbuffer_first_written && !conn->wpending) {
+  if (pni_raw_written_ready(conn) && !conn->wpending) {
     conn->wpending = true;
   }
 
@@ -639,6 +765,102 @@ finished_writing:
   return;
 }
 
+void pni_raw_write(pn_raw_connection_t *conn, int sock, long (*send)(int, const void*, size_t), void(*set_error)(pn_raw_connection_t *, const char *, int)) {
+  pni_raw_do_write(conn, sock, send, NULL, set_error);
+}
+
+void pni_raw_writev(pn_raw_connection_t *conn, int sock, long (*sendv)(int, const pn_bytes_t*, size_t, bool*), void(*set_error)(pn_raw_connection_t *, const char *, int)) {
+  pni_raw_do_write(conn, sock, NULL, sendv, set_error);
+}
+
+void pni_raw_zerocopy_done(pn_raw_connection_t *conn, uint32_t first, uint32_t last) {
+  // Our numbering starts from 1
+  for (uint32_t id = first + 1; id != last + 2; id++) {
+    uint32_t bit = id - conn->zerocopy_done - 1;
+    if (bit < PNI_RAW_ZEROCOPY_MAX) conn->zerocopy_completed |= (uint64_t)1 << bit;
+  }
+  while (conn->zerocopy_completed & 1) {
+    conn->zerocopy_completed >>= 1;
+    conn->zerocopy_done++;
+  }
+  if (pni_raw_written_ready(conn) && !conn->wpending) {
+    conn->wpending = true;
+  }
+}
+
+bool pni_raw_zerocopy_pending(pn_raw_connection_t *conn) {
+  return conn->zerocopy_sent != conn->zerocopy_done;
+}
+
+void pni_raw_relay_start(pn_raw_connection_t *conn) {
+  conn->relayed = true;
+  // Read buffers can't be filled any more, write buffers are still written before any relayed bytes
+  pni_raw_release_rbuffers(conn);
+  if (conn->rbuffer_first_read) {
+    conn->rpending = true;
+  }
+}
+
+// Move bytes from sock into the relay until it would block or the stream ends
+void pni_raw_relay_read(pn_raw_connection_t *conn, int sock, long (*relay)(pn_raw_connection_t *, int), void(*set_error)(pn_raw_connection_t *, const char *, int)) {
+  assert(conn);
+
+  if (!pni_raw_ropen(conn)) return;
+
+  bool closed = false;
+  for(;;) {
+    long r = relay(conn, sock);
+    if (r < 0) {
+      switch (errno) {
+        case EINTR: continue;
+        case EWOULDBLOCK: goto finished_relaying;
+        default:
+          set_error(conn, "splice error", errno);
+          pni_raw_close(conn);
+          return;
+      }
+    }
+    if (r == 0) {
+      closed = true;
+      break;
+    }
+    // There are no buffers to return, the read event just reports progress
+    conn->rpending = true;
+  }
+finished_relaying:
+  if (closed) {
+    conn->state = pni_raw_new_state(conn, conn_read_closed);
+    conn->rclosedpending = true;
+    if (pni_raw_rwclosed(conn)) {
+      pni_raw_disconnect(conn);
+    }
+  }
+}
+
+// Move bytes waiting in the relay to sock until it would block or the relay is empty
+void pni_raw_relay_write(pn_raw_connection_t *conn, int sock, long (*relay)(pn_raw_connection_t *, int), void(*set_error)(pn_raw_connection_t *, const char *, int)) {
+  assert(conn);
+
+  if (pni_raw_wdrained(conn) || conn->wbuffer_first_towrite) return;
+
+  for(;;) {
+    long r = relay(conn, sock);
+    if (r < 0) {
+      switch (errno) {
+        case EINTR: continue;
+        case EWOULDBLOCK: return;
+        default:
+          set_error(conn, "splice error", errno);
+          pni_raw_close(conn);
+          return;
+      }
+    }
+    if (r == 0) return;
+    // There are no buffers to return, the written event just reports progress
+    conn->wpending = true;
+  }
+}
+
 void pni_raw_process_shutdown(pn_raw_connection_t *conn, int sock, int (*shutdown_rd)(int), int (*shutdown_wr)(int)) {
   assert(conn);
   if (pni_raw_rclosing(conn)) {
@@ -652,13 +874,23 @@ void pni_raw_process_shutdown(pn_raw_connection_t *conn, int sock, int (*shutdow
 }
 
 bool pni_raw_can_read(pn_raw_connection_t *conn) {
-  return pni_raw_ropen(conn) && conn->rbuffer_first_unused;
+  // A pooled connection takes buffers once there is something to read
+  return pni_raw_ropen(conn) &&
+    (conn->rbuffer_first_unused || (conn->rpooled && conn->rbuffer_count < conn->rbuffer_slots));
 }
 
 bool pni_raw_can_write(pn_raw_connection_t *conn) {
   return !pni_raw_wdrained(conn) && conn->wbuffer_first_towrite;
 }
 
+bool pni_raw_can_relay_read(pn_raw_connection_t *conn) {
+  return conn->relayed && pni_raw_ropen(conn);
+}
+
+bool pni_raw_can_relay_write(pn_raw_connection_t *conn) {
+  return conn->relayed && !pni_raw_wdrained(conn) && !conn->wbuffer_first_towrite;
+}
+
 pn_event_t *pni_raw_event_next(pn_raw_connection_t *conn) {
   assert(conn);
   do {
@@ -708,11 +940,11 @@ pn_event_t *pni_raw_event_next(pn_raw_connection_t *conn) {
         conn->disconnect_state = disc_fini;
         break;
       }
-    } else if (!pni_raw_wdrained(conn) && !conn->wbuffer_first_towrite && !conn->wrequestedbuffers) {
+    } else if (!pni_raw_wdrained(conn) && !conn->wbuffer_first_towrite && !conn->wrequestedbuffers && !conn->relayed) {
       // Ran out of write buffers
       pni_raw_put_event(conn, PN_RAW_CONNECTION_NEED_WRITE_BUFFERS);
       conn->wrequestedbuffers = true;
-    } else if (!pni_raw_rclosed(conn) && !conn->rbuffer_first_unused && !conn->rrequestedbuffers) {
+    } else if (!pni_raw_rclosed(conn) && !conn->rbuffer_first_unused && !conn->rrequestedbuffers && !conn->relayed && !conn->rpooled) {
       // Ran out of read buffers
       pni_raw_put_event(conn, PN_RAW_CONNECTION_NEED_READ_BUFFERS);
       conn->rrequestedbuffers = true;
@@ -0,0 +1,354 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+
+/*
+ * io_uring poller for the epoll proactor.
+ *
+ * The scheduler in epoll.c is unchanged: every fd is still armed one shot
+ * and reported as a struct epoll_event.  Arming is an IORING_OP_POLL_ADD
+ * request placed on the submission queue, which costs no system call.  The
+ * poller thread submits everything queued so far in the same io_uring_enter()
+ * that waits for completions, and reads the completions straight from the
+ * shared completion queue.  Only a thread that arms an fd while the poller is
+ * blocked has to make the system call itself so that the poller sees it.
+ *
+ * A completion identifies the polled fd by its registration slot and a
+ * generation number. The generation changes whenever a poll request is
+ * abandoned, so late completions of removed or replaced requests, possibly
+ * for an epoll_extended_t that no longer exists, are recognised and dropped.
+ */
+
+/* For syscall() */
+#define _DEFAULT_SOURCE
+
+#include "epoll-internal.h"
+
+#include <errno.h>
+#include <endian.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <linux/io_uring.h>
+
+#define URING_SQ_ENTRIES 1024
+#define URING_CQ_ENTRIES 8192
+
+typedef struct uring_slot_t {
+  epoll_extended_t *ee;   /* NULL if free */
+  uint32_t generation;
+  uint32_t next_free;     /* free list, by index + 1 */
+  bool armed;             /* a poll request is outstanding */
+} uring_slot_t;
+
+struct pni_uring_t {
+  pmutex mutex;           /* Submission queue and slots */
+  int fd;
+  bool waiting;           /* poller is blocked in the kernel */
+  uint8_t remove_flags;   /* for poll removals, no completion unless they fail */
+  // Submission queue, shared with the kernel
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_flags;
+  unsigned sq_entries;
+  struct io_uring_sqe *sqes;
+  // Completion queue, shared with the kernel
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+  void *sq_ring;
+  size_t sq_ring_size;
+  void *cq_ring;
+  size_t cq_ring_size;
+  size_t sqes_size;
+  uring_slot_t *slots;
+  uint32_t slots_capacity;
+  uint32_t free_slot;
+};
+
+static inline int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static inline unsigned uring_sq_pending(pni_uring_t *u) {
+  return *u->sq_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+}
+
+static inline uint64_t uring_user_data(pni_uring_t *u, uint32_t slot) {
+  return ((uint64_t) u->slots[slot-1].generation << 32) | slot;
+}
+
+static void uring_unmap(pni_uring_t *u) {
+  if (u->sqes && u->sqes != MAP_FAILED) munmap(u->sqes, u->sqes_size);
+  if (u->cq_ring && u->cq_ring != MAP_FAILED && u->cq_ring != u->sq_ring) munmap(u->cq_ring, u->cq_ring_size);
+  if (u->sq_ring && u->sq_ring != MAP_FAILED) munmap(u->sq_ring, u->sq_ring_size);
+}
+
+bool pni_poller_init(pn_proactor_t *p) {
+  p->epollfd = -1;
+  pni_uring_t *u = (pni_uring_t *) calloc(1, sizeof(*u));
+  if (!u) return false;
+
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = URING_CQ_ENTRIES;
+  u->fd = (int) syscall(__NR_io_uring_setup, URING_SQ_ENTRIES, &params);
+  // Completions must never be dropped when the completion queue is full
+  if (u->fd < 0 || !(params.features & IORING_FEAT_NODROP)) goto error;
+
+  u->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  u->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (u->cq_ring_size > u->sq_ring_size) u->sq_ring_size = u->cq_ring_size;
+  }
+  u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+  if (u->sq_ring == MAP_FAILED) goto error;
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    u->cq_ring = u->sq_ring;
+  } else {
+    u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+    if (u->cq_ring == MAP_FAILED) goto error;
+  }
+  u->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  u->sqes = (struct io_uring_sqe *) mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+  if (u->sqes == MAP_FAILED) goto error;
+
+#ifdef IORING_FEAT_CQE_SKIP
+  if (params.features & IORING_FEAT_CQE_SKIP) u->remove_flags = IOSQE_CQE_SKIP_SUCCESS;
+#endif
+
+  char *sq = (char *) u->sq_ring;
+  u->sq_head = (unsigned *) (sq + params.sq_off.head);
+  u->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+  u->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+  u->sq_flags = (unsigned *) (sq + params.sq_off.flags);
+  u->sq_entries = params.sq_entries;
+  // Submission queue entries are always used in order
+  unsigned *array = (unsigned *) (sq + params.sq_off.array);
+  for (unsigned i = 0; i < params.sq_entries; i++) array[i] = i;
+
+  char *cq = (char *) u->cq_ring;
+  u->cq_head = (unsigned *) (cq + params.cq_off.head);
+  u->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+  u->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+
+  pmutex_init(&u->mutex);
+  p->uring = u;
+  p->epollfd = u->fd;
+  return true;
+
+ error:
+  uring_unmap(u);
+  if (u->fd >= 0) close(u->fd);
+  free(u);
+  return false;
+}
+
+void pni_poller_finalize(pn_proactor_t *p) {
+  pni_uring_t *u = p->uring;
+  if (!u) return;
+  // Closing the ring cancels all outstanding polls
+  uring_unmap(u);
+  close(u->fd);
+  pmutex_finalize(&u->mutex);
+  free(u->slots);
+  free(u);
+  p->uring = NULL;
+  p->epollfd = -1;
+}
+
+/* Push queued requests into the kernel.  Call with the uring lock held. */
+static void uring_submit_lh(pni_uring_t *u) {
+  while (uring_sq_pending(u)) {
+    if (uring_enter(u->fd, uring_sq_pending(u), 0, 0) >= 0) continue;
+    if (errno == EINTR) continue;
+    // The completion queue is overflowing, the poller is not blocked and will submit later.
+    if (errno == EAGAIN || errno == EBUSY) return;
+    EPOLL_FATAL("io_uring submit", errno);
+  }
+}
+
+/* Call with the uring lock held. */
+static struct io_uring_sqe *uring_get_sqe_lh(pni_uring_t *u) {
+  while (uring_sq_pending(u) >= u->sq_entries) {
+    uring_submit_lh(u);
+    if (uring_sq_pending(u) >= u->sq_entries) sched_yield();
+  }
+  struct io_uring_sqe *sqe = &u->sqes[*u->sq_tail & *u->sq_mask];
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+static inline void uring_queue_lh(pni_uring_t *u) {
+  __atomic_store_n(u->sq_tail, *u->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+/* Abandon the outstanding poll request of a slot, if any. */
+static void uring_remove_lh(pni_uring_t *u, uint32_t slot) {
+  uring_slot_t *s = &u->slots[slot-1];
+  if (!s->armed) return;
+  struct io_uring_sqe *sqe = uring_get_sqe_lh(u);
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->flags = u->remove_flags;
+  sqe->fd = -1;
+  sqe->addr = uring_user_data(u, slot);
+  sqe->user_data = 0;
+  uring_queue_lh(u);
+  s->generation++;
+  s->armed = false;
+}
+
+static void uring_arm_lh(pni_uring_t *u, epoll_extended_t *ee) {
+  uring_remove_lh(u, ee->slot);
+  uint32_t events = ee->wanted;
+#if __BYTE_ORDER == __BIG_ENDIAN
+  events = (events << 16) | (events >> 16);
+#endif
+  struct io_uring_sqe *sqe = uring_get_sqe_lh(u);
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = ee->fd;
+  sqe->poll32_events = events;
+  sqe->user_data = uring_user_data(u, ee->slot);
+  uring_queue_lh(u);
+  u->slots[ee->slot-1].armed = true;
+  if (u->waiting) uring_submit_lh(u);
+}
+
+bool start_polling(epoll_extended_t *ee, pn_proactor_t *p) {
+  if (ee->polling)
+    return false;
+  pni_uring_t *u = p->uring;
+  lock(&u->mutex);
+  if (!u->free_slot) {
+    uint32_t capacity = u->slots_capacity ? 2 * u->slots_capacity : 64;
+    uring_slot_t *slots = (uring_slot_t *) realloc(u->slots, capacity * sizeof(uring_slot_t));
+    if (!slots) {
+      unlock(&u->mutex);
+      return false;
+    }
+    memset(slots + u->slots_capacity, 0, (capacity - u->slots_capacity) * sizeof(uring_slot_t));
+    for (uint32_t i = u->slots_capacity; i < capacity; i++) slots[i].next_free = (i + 1 < capacity) ? i + 2 : 0;
+    u->free_slot = u->slots_capacity + 1;
+    u->slots = slots;
+    u->slots_capacity = capacity;
+  }
+  ee->slot = u->free_slot;
+  u->free_slot = u->slots[ee->slot-1].next_free;
+  u->slots[ee->slot-1].ee = ee;
+  ee->polling = true;
+  memory_barrier(ee);
+  uring_arm_lh(u, ee);
+  unlock(&u->mutex);
+  return true;
+}
+
+void stop_polling(epoll_extended_t *ee, pn_proactor_t *p) {
+  if (ee->fd == -1 || !ee->polling || p->epollfd == -1)
+    return;
+  pni_uring_t *u = p->uring;
+  memory_barrier(ee);
+  lock(&u->mutex);
+  uring_remove_lh(u, ee->slot);
+  uring_slot_t *s = &u->slots[ee->slot-1];
+  s->ee = NULL;
+  s->generation++;
+  s->next_free = u->free_slot;
+  u->free_slot = ee->slot;
+  // The kernel holds a reference to the file until the poll is removed, do it before the fd is closed
+  uring_submit_lh(u);
+  unlock(&u->mutex);
+  ee->slot = 0;
+  ee->fd = -1;
+  ee->polling = false;
+}
+
+void rearm_polling(epoll_extended_t *ee, pn_proactor_t *p) {
+  pni_uring_t *u = p->uring;
+  memory_barrier(ee);
+  lock(&u->mutex);
+  uring_arm_lh(u, ee);
+  unlock(&u->mutex);
+}
+
+/* Copy completions to p->kevents */
+static int uring_reap(pn_proactor_t *p) {
+  pni_uring_t *u = p->uring;
+  unsigned head = *u->cq_head;
+  unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+  int n = 0;
+  if (head == tail) return 0;
+  lock(&u->mutex);
+  for (; head != tail && n < p->kevents_capacity; head++) {
+    struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+    uint32_t slot = (uint32_t) cqe->user_data;
+    if (!slot || slot > u->slots_capacity) continue;
+    uring_slot_t *s = &u->slots[slot-1];
+    if (!s->ee || cqe->user_data != uring_user_data(u, slot)) continue;
+    s->armed = false;
+    p->kevents[n].data.ptr = s->ee;
+    p->kevents[n].events = (cqe->res < 0) ? EPOLLERR : (uint32_t) cqe->res;
+    n++;
+  }
+  unlock(&u->mutex);
+  __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+  return n;
+}
+
+int pni_poller_wait(pn_proactor_t *p, int timeout) {
+  pni_uring_t *u = p->uring;
+  while (true) {
+    lock(&u->mutex);
+    unsigned to_submit = uring_sq_pending(u);
+    bool ready = *u->cq_head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    bool overflow = __atomic_load_n(u->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW;
+    bool block = timeout != 0 && !ready;
+    // From here on anything newly armed is submitted by the arming thread
+    u->waiting = block;
+    unlock(&u->mutex);
+
+    int err = 0;
+    if (to_submit || block || overflow) {
+      unsigned flags = (block || overflow) ? IORING_ENTER_GETEVENTS : 0;
+      if (uring_enter(u->fd, to_submit, block ? 1 : 0, flags) < 0) err = errno;
+    }
+    if (block) {
+      lock(&u->mutex);
+      u->waiting = false;
+      unlock(&u->mutex);
+    }
+
+    int n = uring_reap(p);
+    if (n == 0 && err == EINTR) {
+      errno = EINTR;
+      return -1;
+    }
+    // Only completions of abandoned polls, keep waiting
+    if (n > 0 || timeout == 0) return n;
+  }
+}
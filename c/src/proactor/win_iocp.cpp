@@ -2124,7 +2124,8 @@ VOID CALLBACK tick_timer_cb(PVOID arg, BOOLEAN /* ignored*/ ) {
 // Call with no lock held or stop_timer and callback may deadlock
 static void pconnection_tick(pconnection_t *pc) {
   pn_transport_t *t = pc->driver.transport;
-  if (pn_transport_get_idle_timeout(t) || pn_transport_get_remote_idle_timeout(t)) {
+  if (pn_transport_get_idle_timeout(t) || pn_transport_get_remote_idle_timeout(t) ||
+      pn_transport_get_disposition_delay(t)) {
     if(!stop_timer(pc->context.proactor->timer_queue, &pc->tick_timer)) {
       // TODO: handle error
     }
@@ -3429,5 +3430,10 @@ void pn_raw_connection_wake(pn_raw_connection_t *conn) {}
 void pn_raw_connection_close(pn_raw_connection_t *conn) {}
 void pn_raw_connection_read_close(pn_raw_connection_t *conn) {}
 void pn_raw_connection_write_close(pn_raw_connection_t *conn) {}
+void pn_raw_connection_set_zerocopy(pn_raw_connection_t *conn, size_t threshold) {}
+int pn_raw_connection_relay(pn_raw_connection_t *conn, pn_raw_connection_t *peer) { return PN_ERR; }
+int pn_proactor_add_raw_buffers(pn_proactor_t *p, size_t size, size_t count) { return PN_ERR; }
+size_t pn_proactor_release_raw_buffers(pn_proactor_t *p, const pn_raw_buffer_t *buffers, size_t num) { return 0; }
+void pn_raw_connection_use_buffer_pool(pn_raw_connection_t *conn, size_t size) {}
 const struct pn_netaddr_t *pn_raw_connection_local_addr(pn_raw_connection_t *connection) { return NULL; }
 const struct pn_netaddr_t *pn_raw_connection_remote_addr(pn_raw_connection_t *connection) { return NULL; }
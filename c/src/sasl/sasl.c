@@ -692,7 +692,7 @@ static ssize_t pn_output_write_sasl(pn_transport_t* transport, unsigned int laye
 
   pni_post_sasl_frame(transport);
 
-  if (pn_buffer_size(transport->output_buffer) != 0 || !pni_sasl_is_final_output_state(sasl)) {
+  if (pni_output_queue_size(&transport->output_queue) != 0 || !pni_sasl_is_final_output_state(sasl)) {
     return pn_dispatcher_output(transport, bytes, available);
   }
 
@@ -932,7 +932,7 @@ int pn_do_mechanisms(pn_transport_t *transport, uint8_t frame_type, uint16_t cha
     while(pn_data_next(args)) {
       pn_bytes_t s = pn_data_get_symbol(args);
       if (pni_sasl_client_included_mech(sasl->included_mechanisms, s)) {
-        pn_string_addf(mechs, "%*s ", (int)s.size, s.start);
+        pn_string_addf(mechs, "%.*s ", (int)s.size, s.start);
       }
     }
 
@@ -24,6 +24,7 @@
 #include "core/engine-internal.h"
 #include "core/logger_private.h"
 #include "core/util.h"
+#include "ssl/ssl-internal.h"
 
 #include <proton/ssl.h>
 #include <proton/engine.h>
@@ -52,7 +53,40 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <linux/version.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,13,0)
+#include <linux/tls.h>
+#endif
+#endif
+
+// Kernel TLS takes the keys from a BIO ctrl that OpenSSL keeps internal,
+// so it is only built for the OpenSSL 3 series, whose public header
+// reserves the ctrl's number next to BIO_CTRL_GET_KTLS_SEND.
+#if defined(TLS_TX) && !defined(OPENSSL_NO_KTLS) && \
+    OPENSSL_VERSION_NUMBER >= 0x30000000L && OPENSSL_VERSION_NUMBER < 0x40000000L && \
+    defined(BIO_CTRL_GET_KTLS_SEND) && BIO_CTRL_GET_KTLS_SEND == 73
+#define PNI_KTLS 1
+#endif
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION pni_mutex_t;
+static inline void pni_mutex_init(pni_mutex_t *m) { InitializeCriticalSection(m); }
+static inline void pni_mutex_finalize(pni_mutex_t *m) { DeleteCriticalSection(m); }
+static inline void pni_mutex_lock(pni_mutex_t *m) { EnterCriticalSection(m); }
+static inline void pni_mutex_unlock(pni_mutex_t *m) { LeaveCriticalSection(m); }
+#else
+#include <pthread.h>
+typedef pthread_mutex_t pni_mutex_t;
+static inline int pni_mutex_init(pni_mutex_t *m) { return pthread_mutex_init(m, NULL); }
+static inline void pni_mutex_finalize(pni_mutex_t *m) { pthread_mutex_destroy(m); }
+static inline int pni_mutex_lock(pni_mutex_t *m) { return pthread_mutex_lock(m); }
+static inline int pni_mutex_unlock(pni_mutex_t *m) { return pthread_mutex_unlock(m); }
+#endif
 
 /** @file
  * SSL/TLS support API.
@@ -63,6 +97,7 @@
 typedef struct pn_ssl_session_t pn_ssl_session_t;
 
 static int ssl_ex_data_index;
+static int ssl_ctx_ex_data_index;
 
 struct pn_ssl_domain_t {
 
@@ -84,8 +119,11 @@ struct pn_ssl_domain_t {
 
   bool has_certificate; // true when certificate configured
   bool allow_unsecured;
+  bool ktls;            // offer output encryption to the kernel
 };
 
+typedef struct pni_ktls_t pni_ktls_t;
+
 
 struct pni_ssl_t {
   pn_ssl_mode_t mode;
@@ -95,13 +133,25 @@ struct pni_ssl_t {
   SSL *ssl;
 
   BIO *bio_ssl;         // i/o from/to SSL socket layer
-  BIO *bio_ssl_io;      // SSL "half" of network-facing BIO
-  BIO *bio_net_io;      // socket-side "half" of network-facing BIO
+  BIO *bio_net;         // network-facing BIO under the SSL socket, see net_bio_method
   // buffers for holding I/O from "applications" above SSL
 #define APP_BUF_SIZE    (4*1024)
   char *outbuf;
   char *inbuf;
 
+  // Network data for bio_net: the input being processed, the output buffer
+  // being filled and the output written when there was no room left in it
+  const char *net_in;
+  size_t net_in_size;
+  bool net_in_closed;
+  char *net_out;
+  size_t net_out_size;
+  size_t net_out_count;
+  char *spill;
+  size_t spill_size;
+  size_t spill_start;
+  size_t spill_count;
+
   ssize_t app_input_closed;   // error code returned by upper layer process input
   ssize_t app_output_closed;  // error code returned by upper layer process output
 
@@ -117,6 +167,9 @@ struct pni_ssl_t {
 
   char *subject;
   X509 *peer_certificate;
+
+  pni_ktls_t *ktls;     // kernel TLS state if the domain asked for it
+  bool ktls_offered;    // the I/O layer can install kernel TLS, see pni_ssl_ktls_offer()
 };
 
 static inline pn_transport_t *get_transport_internal(pn_ssl_t *ssl)
@@ -199,6 +252,8 @@ static int ssl_failed(pn_transport_t *transport)
   SSL_set_shutdown(ssl->ssl, SSL_SENT_SHUTDOWN|SSL_RECEIVED_SHUTDOWN);
   ssl->ssl_closed = true;
   ssl->app_input_closed = ssl->app_output_closed = PN_EOS;
+  ssl->net_in = NULL;     // nothing more will be read
+  ssl->net_in_size = 0;
   // fake a shutdown so the i/o processing code will close properly
   SSL_set_shutdown(ssl->ssl, SSL_SENT_SHUTDOWN|SSL_RECEIVED_SHUTDOWN);
   // try to grab the first SSL error to add to the failure log
@@ -412,56 +467,583 @@ static DH *get_dh2048(void)
   return dh;
 }
 
-typedef struct {
+/*
+ * Client session cache
+ *
+ * Sessions of client connections initialized with a session id are kept by
+ * id so that a later connection with the same id can resume them. The cache
+ * hangs off the SSL_CTX rather than the pn_ssl_domain_t as connections can
+ * outlive the domain they were made with; it is freed with the SSL_CTX.
+ * Sessions are stored as soon as OpenSSL has them, so a connection that is
+ * dropped rather than shut down cleanly can still be resumed.
+ *
+ * Entries are found through a hash of the id and evicted least recently used
+ * first. Proactor threads share the cache so it has a lock.
+ */
+#define SSN_CACHE_DEFAULT_CAPACITY 64
+
+typedef struct pni_ssn_entry_t {
   char *id;
   SSL_SESSION *session;
-} ssl_cache_data;
+  struct pni_ssn_entry_t *hash_next;
+  struct pni_ssn_entry_t *lru_next;   // from least to most recently used
+  struct pni_ssn_entry_t *lru_prev;
+} pni_ssn_entry_t;
+
+typedef struct pni_ssn_cache_t {
+  pni_mutex_t lock;
+  pni_ssn_entry_t **buckets;
+  size_t bucket_count;   // a power of 2
+  size_t count;
+  size_t capacity;
+  pn_millis_t ttl;
+  pni_ssn_entry_t *lru_head;
+  pni_ssn_entry_t *lru_tail;
+} pni_ssn_cache_t;
+
+static size_t ssn_hash(const char *id)
+{
+  // FNV-1a
+  size_t h = 2166136261u;
+  for (; *id; id++) h = (h ^ (unsigned char) *id) * 16777619u;
+  return h;
+}
+
+static pni_ssn_entry_t **ssn_cache_slot(pni_ssn_cache_t *cache, const char *id)
+{
+  pni_ssn_entry_t **slot = &cache->buckets[ssn_hash(id) & (cache->bucket_count - 1)];
+  while (*slot && strcmp((*slot)->id, id) != 0) slot = &(*slot)->hash_next;
+  return slot;
+}
+
+// Call with the lock held
+static void ssn_cache_remove(pni_ssn_cache_t *cache, pni_ssn_entry_t **slot)
+{
+  pni_ssn_entry_t *e = *slot;
+  *slot = e->hash_next;
+  LL_REMOVE(cache, lru, e);
+  cache->count--;
+  SSL_SESSION_free(e->session);
+  free(e->id);
+  free(e);
+}
+
+// Call with the lock held
+static void ssn_cache_trim(pni_ssn_cache_t *cache, size_t capacity)
+{
+  while (cache->count > capacity) {
+    ssn_cache_remove(cache, ssn_cache_slot(cache, cache->lru_head->id));
+  }
+}
+
+static pni_ssn_cache_t *ssn_cache(void)
+{
+  pni_ssn_cache_t *cache = (pni_ssn_cache_t *) calloc(1, sizeof(pni_ssn_cache_t));
+  if (!cache) return NULL;
+  cache->bucket_count = 16;
+  cache->buckets = (pni_ssn_entry_t **) calloc(cache->bucket_count, sizeof(pni_ssn_entry_t *));
+  if (!cache->buckets) {
+    free(cache);
+    return NULL;
+  }
+  cache->capacity = SSN_CACHE_DEFAULT_CAPACITY;
+  pni_mutex_init(&cache->lock);
+  return cache;
+}
+
+// Called by OpenSSL when the SSL_CTX holding the cache is freed
+static void ssn_cache_free(void *parent, void *ptr, CRYPTO_EX_DATA *ad, int idx, long argl, void *argp)
+{
+  pni_ssn_cache_t *cache = (pni_ssn_cache_t *) ptr;
+  if (!cache) return;
+  ssn_cache_trim(cache, 0);
+  pni_mutex_finalize(&cache->lock);
+  free(cache->buckets);
+  free(cache);
+}
+
+static inline pni_ssn_cache_t *ssn_cache_get(SSL_CTX *ctx)
+{
+  return (pni_ssn_cache_t *) SSL_CTX_get_ex_data(ctx, ssl_ctx_ex_data_index);
+}
 
-#define SSL_CACHE_SIZE 4
-static int ssl_cache_ptr = 0;
-static ssl_cache_data ssl_cache[SSL_CACHE_SIZE];
+// Call with the lock held
+static void ssn_cache_grow(pni_ssn_cache_t *cache)
+{
+  size_t count = cache->bucket_count * 2;
+  pni_ssn_entry_t **buckets = (pni_ssn_entry_t **) calloc(count, sizeof(pni_ssn_entry_t *));
+  if (!buckets) return;         // Carry on with longer chains
+  for (size_t i = 0; i < cache->bucket_count; i++) {
+    pni_ssn_entry_t *e = cache->buckets[i];
+    while (e) {
+      pni_ssn_entry_t *next = e->hash_next;
+      pni_ssn_entry_t **slot = &buckets[ssn_hash(e->id) & (count - 1)];
+      e->hash_next = *slot;
+      *slot = e;
+      e = next;
+    }
+  }
+  free(cache->buckets);
+  cache->buckets = buckets;
+  cache->bucket_count = count;
+}
 
-static void ssn_init(void) {
-  ssl_cache_data s = {NULL, NULL};
-  for (int i=0; i<SSL_CACHE_SIZE; i++) {
-    ssl_cache[i] = s;
+// Takes over the reference to session if it returns true
+static bool ssn_cache_put(pni_ssn_cache_t *cache, const char *id, SSL_SESSION *session)
+{
+  bool stored = false;
+  pni_mutex_lock(&cache->lock);
+  if (cache->capacity) {
+    pni_ssn_entry_t **slot = ssn_cache_slot(cache, id);
+    if (*slot) {
+      ssn_cache_remove(cache, slot);
+    } else if (cache->count >= cache->bucket_count) {
+      ssn_cache_grow(cache);
+    }
+    pni_ssn_entry_t *e = (pni_ssn_entry_t *) malloc(sizeof(pni_ssn_entry_t));
+    char *e_id = pn_strdup(id);
+    if (e && e_id) {
+      e->id = e_id;
+      e->session = session;
+      slot = &cache->buckets[ssn_hash(id) & (cache->bucket_count - 1)];
+      e->hash_next = *slot;
+      *slot = e;
+      LL_ADD(cache, lru, e);
+      cache->count++;
+      ssn_cache_trim(cache, cache->capacity);
+      stored = true;
+    } else {
+      free(e);
+      free(e_id);
+    }
   }
+  pni_mutex_unlock(&cache->lock);
+  return stored;
+}
+
+// OpenSSL callback for each new client session
+static int ssn_new_cb(SSL *s, SSL_SESSION *session)
+{
+  pn_transport_t *transport = (pn_transport_t *) SSL_get_ex_data(s, ssl_ex_data_index);
+  pni_ssl_t *ssl = transport ? transport->ssl : NULL;
+  pni_ssn_cache_t *cache = ssn_cache_get(SSL_get_SSL_CTX(s));
+  if (!ssl || !ssl->session_id || !cache) return 0;
+  ssl_log(transport, PN_LEVEL_TRACE, "Saving SSL session as %s", ssl->session_id);
+#if OPENSSL_VERSION_NUMBER < 0x10101000
+  // Only resumable if the connection is shut down cleanly
+  return ssn_cache_put(cache, ssl->session_id, session) ? 1 : 0;
+#else
+  // OpenSSL marks the session of a connection that is freed without an SSL
+  // shutdown as not resumable, keep a copy that the connection does not share.
+  SSL_SESSION *copy = SSL_SESSION_dup(session);
+  if (copy && !ssn_cache_put(cache, ssl->session_id, copy)) SSL_SESSION_free(copy);
+  return 0;
+#endif
 }
 
 static void ssn_restore(pn_transport_t *transport, pni_ssl_t *ssl) {
   if (!ssl->session_id) return;
-  for (int i = ssl_cache_ptr;;) {
-    i = (i==0) ? SSL_CACHE_SIZE-1 : i-1;
-    if (ssl_cache[i].id == NULL) return;
-    if (strcmp(ssl_cache[i].id, ssl->session_id) == 0) {
-      ssl_log( transport, PN_LEVEL_TRACE, "Restoring previous session id=%s", ssl->session_id );
-      int rc = SSL_set_session( ssl->ssl, ssl_cache[i].session );
-      if (rc != 1) {
-        ssl_log( transport, PN_LEVEL_WARNING, "Session restore failed, id=%s", ssl->session_id );
-      }
-      return;
+  pni_ssn_cache_t *cache = ssn_cache_get(SSL_get_SSL_CTX(ssl->ssl));
+  if (!cache) return;
+  pni_mutex_lock(&cache->lock);
+  pni_ssn_entry_t **slot = ssn_cache_slot(cache, ssl->session_id);
+  pni_ssn_entry_t *e = *slot;
+  if (e && cache->ttl && (time(NULL) - SSL_SESSION_get_time(e->session)) * 1000 > (long) cache->ttl) {
+    ssl_log(transport, PN_LEVEL_TRACE, "Discarding expired session id=%s", ssl->session_id);
+    ssn_cache_remove(cache, slot);
+    e = NULL;
+  }
+  if (e) {
+    ssl_log(transport, PN_LEVEL_TRACE, "Restoring previous session id=%s", ssl->session_id);
+    LL_REMOVE(cache, lru, e);
+    LL_ADD(cache, lru, e);
+    if (SSL_set_session(ssl->ssl, e->session) != 1) {
+      ssl_log(transport, PN_LEVEL_WARNING, "Session restore failed, id=%s", ssl->session_id);
     }
-    if (i == ssl_cache_ptr) return;
   }
+  pni_mutex_unlock(&cache->lock);
+}
+
+/*
+ * Network BIO
+ *
+ * The SSL socket reads records straight from the input the transport passes
+ * to process_input_ssl() and writes them straight into the buffer passed to
+ * process_output_ssl(), rather than through a BIO pair that would copy every
+ * byte once more on the way in and on the way out. OpenSSL keeps a partly
+ * read record itself, so input is only consumed as OpenSSL reads it.
+ *
+ * Output written while there is no output buffer, such as a handshake flight
+ * written while processing input, or that does not fit in what is left of it
+ * is kept in a spill buffer that is passed down first next time.
+ */
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000
+// BIO_METHOD and BIO were public structures before v1.1
+static BIO_METHOD *BIO_meth_new(int type, const char *name)
+{
+  BIO_METHOD *method = (BIO_METHOD *) calloc(1, sizeof(BIO_METHOD));
+  if (method) {
+    method->type = type;
+    method->name = name;
+  }
+  return method;
 }
+#define BIO_meth_set_create(m, f) ((m)->create = (f), 1)
+#define BIO_meth_set_write(m, f) ((m)->bwrite = (f), 1)
+#define BIO_meth_set_read(m, f) ((m)->bread = (f), 1)
+#define BIO_meth_set_ctrl(m, f) ((m)->ctrl = (f), 1)
+#define BIO_set_data(b, p) ((b)->ptr = (p))
+#define BIO_get_data(b) ((b)->ptr)
+#define BIO_set_init(b, i) ((b)->init = (i))
+#define BIO_get_new_index() (100)
+#endif
 
-static void ssn_save(pn_transport_t *transport, pni_ssl_t *ssl) {
-  if (ssl->session_id) {
-    // Attach the session id to the session before we close the connection
-    // So that if we find it in the cache later we can figure out the session id
-    SSL_SESSION *session = SSL_get1_session( ssl->ssl );
-    if (session) {
-      ssl_log(transport, PN_LEVEL_TRACE, "Saving SSL session as %s", ssl->session_id );
-      // If we're overwriting a value, need to free it
-      free(ssl_cache[ssl_cache_ptr].id);
-      if (ssl_cache[ssl_cache_ptr].session) SSL_SESSION_free(ssl_cache[ssl_cache_ptr].session);
+static BIO_METHOD *net_bio_method;
 
-      char *id = pn_strdup( ssl->session_id );
-      ssl_cache_data s = {id, session};
-      ssl_cache[ssl_cache_ptr++] = s;
-      if (ssl_cache_ptr==SSL_CACHE_SIZE) ssl_cache_ptr = 0;
+static bool spill_output(pni_ssl_t *ssl, const char *data, size_t len)
+{
+  if (ssl->spill_start + ssl->spill_count + len > ssl->spill_size) {
+    if (ssl->spill_start) {
+      memmove(ssl->spill, ssl->spill + ssl->spill_start, ssl->spill_count);
+      ssl->spill_start = 0;
     }
+    size_t size = ssl->spill_size ? ssl->spill_size : APP_BUF_SIZE;
+    while (ssl->spill_count + len > size) size *= 2;
+    if (size > ssl->spill_size) {
+      char *spill = (char *) realloc(ssl->spill, size);
+      if (!spill) return false;
+      ssl->spill = spill;
+      ssl->spill_size = size;
+    }
+  }
+  memcpy(ssl->spill + ssl->spill_start + ssl->spill_count, data, len);
+  ssl->spill_count += len;
+  return true;
+}
+
+// Move spilled output into the output buffer, true if it is all gone
+static bool unspill_output(pni_ssl_t *ssl)
+{
+  size_t n = pn_min(ssl->spill_count, ssl->net_out_size - ssl->net_out_count);
+  if (n) {
+    memcpy(ssl->net_out + ssl->net_out_count, ssl->spill + ssl->spill_start, n);
+    ssl->net_out_count += n;
+    ssl->spill_count -= n;
+    ssl->spill_start = ssl->spill_count ? ssl->spill_start + n : 0;
+  }
+  return ssl->spill_count == 0;
+}
+
+static int net_bio_create(BIO *b)
+{
+  BIO_set_init(b, 1);
+  return 1;
+}
+
+static int net_bio_write(BIO *b, const char *data, int len)
+{
+  pni_ssl_t *ssl = (pni_ssl_t *) BIO_get_data(b);
+  BIO_clear_retry_flags(b);
+  size_t n = 0;
+  if (ssl->spill_count == 0 && ssl->net_out) {
+    n = pn_min((size_t) len, ssl->net_out_size - ssl->net_out_count);
+    memcpy(ssl->net_out + ssl->net_out_count, data, n);
+    ssl->net_out_count += n;
+  }
+  if (n < (size_t) len && !spill_output(ssl, data + n, len - n)) {
+    if (n) return n;
+    BIO_set_retry_write(b);
+    return -1;
+  }
+  return len;
+}
+
+static int net_bio_read(BIO *b, char *data, int len)
+{
+  pni_ssl_t *ssl = (pni_ssl_t *) BIO_get_data(b);
+  BIO_clear_retry_flags(b);
+  if (ssl->net_in_size) {
+    size_t n = pn_min((size_t) len, ssl->net_in_size);
+    memcpy(data, ssl->net_in, n);
+    ssl->net_in += n;
+    ssl->net_in_size -= n;
+    return n;
+  }
+  if (ssl->net_in_closed) return 0;
+  BIO_set_retry_read(b);
+  return -1;
+}
+
+static long net_bio_ctrl(BIO *b, int cmd, long num, void *ptr)
+{
+  pni_ssl_t *ssl = (pni_ssl_t *) BIO_get_data(b);
+  switch (cmd) {
+   case BIO_CTRL_FLUSH:
+    return 1;
+   case BIO_CTRL_PENDING:
+    return ssl->net_in_size;
+   case BIO_CTRL_WPENDING:
+    return ssl->spill_count;
+   case BIO_CTRL_EOF:
+    return ssl->net_in_closed && !ssl->net_in_size;
+   default:
+    return 0;
+  }
+}
+
+static BIO_METHOD *net_bio_method_new(void)
+{
+  BIO_METHOD *method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "proton network");
+  if (!method) return NULL;
+  BIO_meth_set_create(method, net_bio_create);
+  BIO_meth_set_write(method, net_bio_write);
+  BIO_meth_set_read(method, net_bio_read);
+  BIO_meth_set_ctrl(method, net_bio_ctrl);
+  return method;
+}
+
+#ifdef PNI_KTLS
+/*
+ * Kernel TLS
+ *
+ * OpenSSL only hands encryption to the kernel itself when it writes to a
+ * socket BIO, the SSL layer writes to its network BIO. A filter BIO under
+ * the SSL object catches the kernel crypto_info that OpenSSL offers when it
+ * installs the application write keys and declines it, so OpenSSL goes on
+ * encrypting in user space for now. The filter counts the records written
+ * after that to keep the record sequence number up to date.
+ *
+ * Once the handshake is over and every record OpenSSL has written has been
+ * passed down, the SSL layer holds back output until the I/O layer has tried
+ * to install the keys on the socket, see pni_ssl_ktls_tx(). If it did, output
+ * from the layer above is passed straight down for the kernel to encrypt,
+ * otherwise OpenSSL carries on as before.
+ *
+ * Input is still decrypted by OpenSSL. A record that OpenSSL wants to write
+ * after the switch, such as a key update, cannot be sent any more and fails
+ * the connection.
+ */
+
+// Internal to OpenSSL, see BIO_set_ktls(). It is only used when the
+// OpenSSL library at run time is the release series proton was built
+// with, see ktls_bio_method_new().
+#define PNI_BIO_CTRL_SET_KTLS 72
+
+typedef enum {
+  KTLS_WAITING,         // for the application write keys
+  KTLS_CAPTURED,
+  KTLS_ACTIVE,          // the kernel encrypts output
+  KTLS_OFF
+} pni_ktls_state_t;
+
+struct pni_ktls_t {
+  pni_ktls_state_t state;
+  bool lost;            // OpenSSL wrote a record after the switch
+  size_t info_size;
+  union {
+    struct tls_crypto_info base;
+    struct tls12_crypto_info_aes_gcm_128 gcm128;
+    struct tls12_crypto_info_aes_gcm_256 gcm256;
+#ifdef TLS_CIPHER_AES_CCM_128
+    struct tls12_crypto_info_aes_ccm_128 ccm128;
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    struct tls12_crypto_info_chacha20_poly1305 chacha20;
+#endif
+  } info;
+  uint64_t seq;         // record sequence number when the keys were captured
+  uint64_t records;     // records written since
+  unsigned char header[5];
+  size_t header_count;  // of the record header being written
+  size_t body_left;     // of the record being written
+};
+
+static BIO_METHOD *ktls_bio_method;
+
+static unsigned char *ktls_rec_seq(pni_ktls_t *ktls)
+{
+  switch (ktls->info.base.cipher_type) {
+   case TLS_CIPHER_AES_GCM_128: return ktls->info.gcm128.rec_seq;
+   case TLS_CIPHER_AES_GCM_256: return ktls->info.gcm256.rec_seq;
+#ifdef TLS_CIPHER_AES_CCM_128
+   case TLS_CIPHER_AES_CCM_128: return ktls->info.ccm128.rec_seq;
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+   case TLS_CIPHER_CHACHA20_POLY1305: return ktls->info.chacha20.rec_seq;
+#endif
+   default: return NULL;
+  }
+}
+
+static void ktls_capture(pni_ktls_t *ktls, const void *info)
+{
+  size_t size = 0;
+  switch (((const struct tls_crypto_info *) info)->cipher_type) {
+   case TLS_CIPHER_AES_GCM_128: size = sizeof(ktls->info.gcm128); break;
+   case TLS_CIPHER_AES_GCM_256: size = sizeof(ktls->info.gcm256); break;
+#ifdef TLS_CIPHER_AES_CCM_128
+   case TLS_CIPHER_AES_CCM_128: size = sizeof(ktls->info.ccm128); break;
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+   case TLS_CIPHER_CHACHA20_POLY1305: size = sizeof(ktls->info.chacha20); break;
+#endif
+   default: break;
   }
+  // Keys changing again, e.g. on renegotiation, is more than we follow
+  if (!size || ktls->state != KTLS_WAITING) {
+    ktls->state = KTLS_OFF;
+    return;
+  }
+  memcpy(&ktls->info, info, size);
+  ktls->info_size = size;
+  const unsigned char *rec_seq = ktls_rec_seq(ktls);
+  ktls->seq = 0;
+  for (int i = 0; i < 8; i++) ktls->seq = (ktls->seq << 8) | rec_seq[i];
+  ktls->records = 0;
+  ktls->state = KTLS_CAPTURED;
+}
+
+static void ktls_count_records(pni_ktls_t *ktls, const unsigned char *data, size_t len)
+{
+  while (len) {
+    if (ktls->body_left) {
+      size_t n = pn_min(len, ktls->body_left);
+      ktls->body_left -= n;
+      data += n;
+      len -= n;
+    } else {
+      ktls->header[ktls->header_count++] = *data++;
+      len--;
+      if (ktls->header_count == sizeof(ktls->header)) {
+        ktls->body_left = (ktls->header[3] << 8) | ktls->header[4];
+        ktls->header_count = 0;
+        ktls->records++;
+      }
+    }
+  }
+}
+
+static int ktls_bio_create(BIO *b)
+{
+  BIO_set_init(b, 1);
+  return 1;
+}
+
+static int ktls_bio_write(BIO *b, const char *data, int len)
+{
+  pni_ktls_t *ktls = (pni_ktls_t *) BIO_get_data(b);
+  BIO_clear_retry_flags(b);
+  if (ktls->state == KTLS_ACTIVE) {
+    // Encrypted by OpenSSL with keys the kernel now owns
+    ktls->lost = true;
+    return len;
+  }
+  int n = BIO_write(BIO_next(b), data, len);
+  BIO_copy_next_retry(b);
+  if (n > 0 && ktls->state == KTLS_CAPTURED) {
+    ktls_count_records(ktls, (const unsigned char *) data, n);
+  }
+  return n;
+}
+
+static int ktls_bio_read(BIO *b, char *data, int len)
+{
+  BIO_clear_retry_flags(b);
+  int n = BIO_read(BIO_next(b), data, len);
+  BIO_copy_next_retry(b);
+  return n;
+}
+
+static long ktls_bio_ctrl(BIO *b, int cmd, long num, void *ptr)
+{
+  if (cmd == PNI_BIO_CTRL_SET_KTLS) {
+    // num is non-zero for the write keys, input stays with OpenSSL
+    if (num) ktls_capture((pni_ktls_t *) BIO_get_data(b), ptr);
+    return 0;
+  }
+  return BIO_ctrl(BIO_next(b), cmd, num, ptr);
+}
+
+static BIO_METHOD *ktls_bio_method_new(void)
+{
+  // Same major and minor version as the headers
+  if ((OpenSSL_version_num() >> 20) != (OPENSSL_VERSION_NUMBER >> 20)) return NULL;
+  BIO_METHOD *method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_FILTER, "proton kernel TLS");
+  if (!method) return NULL;
+  BIO_meth_set_create(method, ktls_bio_create);
+  BIO_meth_set_write(method, ktls_bio_write);
+  BIO_meth_set_read(method, ktls_bio_read);
+  BIO_meth_set_ctrl(method, ktls_bio_ctrl);
+  return method;
+}
+
+// Ready for pni_ssl_ktls_tx(): handshake done and no records part written
+static bool ktls_ready(pni_ssl_t *ssl)
+{
+  pni_ktls_t *ktls = ssl->ktls;
+  return ktls && ssl->ktls_offered && ktls->state == KTLS_CAPTURED &&
+    SSL_is_init_finished(ssl->ssl) && !ssl->ssl_shutdown && !ssl->ssl_closed &&
+    ssl->out_count == 0 && ktls->header_count == 0 && ktls->body_left == 0 &&
+    ssl->spill_count == 0;
+}
+
+static inline bool ktls_active(pni_ssl_t *ssl)
+{
+  return ssl->ktls && ssl->ktls->state == KTLS_ACTIVE;
+}
+
+static int ktls_failed(pn_transport_t *transport)
+{
+  pni_ssl_t *ssl = transport->ssl;
+  ssl->ssl_closed = true;
+  ssl->app_input_closed = ssl->app_output_closed = PN_EOS;
+  // fake a shutdown so the i/o processing code will close properly
+  SSL_set_shutdown(ssl->ssl, SSL_SENT_SHUTDOWN|SSL_RECEIVED_SHUTDOWN);
+  pn_do_error(transport, "amqp:connection:framing-error", "SSL Failure: %s",
+              "cannot send a TLS record after handing output to kernel TLS");
+  return PN_EOS;
+}
+
+#else
+
+static inline bool ktls_active(pni_ssl_t *ssl)
+{
+  return false;
+}
+
+#endif
+
+void pni_ssl_ktls_offer(pn_transport_t *transport)
+{
+  if (transport->ssl) transport->ssl->ktls_offered = true;
+}
+
+const void *pni_ssl_ktls_tx(pn_transport_t *transport, size_t *size)
+{
+#ifdef PNI_KTLS
+  pni_ssl_t *ssl = transport->ssl;
+  if (!ssl || !ktls_ready(ssl)) return NULL;
+  pni_ktls_t *ktls = ssl->ktls;
+  unsigned char *rec_seq = ktls_rec_seq(ktls);
+  uint64_t seq = ktls->seq + ktls->records;
+  for (int i = 7; i >= 0; i--, seq >>= 8) rec_seq[i] = (unsigned char) seq;
+  *size = ktls->info_size;
+  return &ktls->info;
+#else
+  return NULL;
+#endif
+}
+
+void pni_ssl_ktls_tx_done(pn_transport_t *transport, bool installed)
+{
+#ifdef PNI_KTLS
+  pni_ssl_t *ssl = transport->ssl;
+  if (!ssl || !ssl->ktls || ssl->ktls->state != KTLS_CAPTURED) return;
+  ssl->ktls->state = installed ? KTLS_ACTIVE : KTLS_OFF;
+  ssl_log(transport, PN_LEVEL_TRACE, installed ? "Kernel TLS encrypts output" :
+          "Kernel TLS not available, output stays with OpenSSL");
+#endif
 }
 
 /** Public API - visible to application code */
@@ -494,6 +1076,7 @@ static bool pni_init_ssl_domain( pn_ssl_domain_t * domain, pn_ssl_mode_t mode )
       return false;
     }
     SSL_CTX_set_session_cache_mode(domain->ctx, SSL_SESS_CACHE_CLIENT);
+    SSL_CTX_sess_set_new_cb(domain->ctx, ssn_new_cb);
 
     // By default, require peer name verification - this is a safe default
     if (pn_ssl_domain_set_peer_authentication( domain, PN_SSL_VERIFY_PEER_NAME, NULL )) {
@@ -508,6 +1091,10 @@ static bool pni_init_ssl_domain( pn_ssl_domain_t * domain, pn_ssl_mode_t mode )
       ssl_log_error("Unable to initialize OpenSSL context.");
       return false;
     }
+    // Sessions can only be resumed with a session id context once clients are verified.
+    // Each domain has its own SSL_CTX and so its own sessions.
+    SSL_CTX_set_session_id_context(domain->ctx, (const unsigned char *) "qpid-proton", 11);
+
     // By default, allow anonymous ciphers and do no authentication so certificates are
     // not required 'out of the box'; authenticating the client can be done by SASL.
     if (pn_ssl_domain_set_peer_authentication( domain, PN_SSL_ANONYMOUS_PEER, NULL )) {
@@ -521,6 +1108,16 @@ static bool pni_init_ssl_domain( pn_ssl_domain_t * domain, pn_ssl_mode_t mode )
     return false;
   }
 
+  if (mode == PN_SSL_MODE_CLIENT) {
+    pni_ssn_cache_t *cache = ssn_cache();
+    if (!cache || !SSL_CTX_set_ex_data(domain->ctx, ssl_ctx_ex_data_index, cache)) {
+      ssl_log_error("Unable to allocate SSL session cache");
+      if (cache) ssn_cache_free(NULL, cache, NULL, 0, 0, NULL);
+      SSL_CTX_free(domain->ctx);
+      return false;
+    }
+  }
+
   // By default set up system default certificates
   if (!SSL_CTX_set_default_verify_paths(domain->ctx)){
     ssl_log_error("Failed to set default certificate paths");
@@ -637,6 +1234,52 @@ int pn_ssl_domain_set_ciphers(pn_ssl_domain_t *domain, const char *ciphers)
   return 0;
 }
 
+int pn_ssl_domain_set_session_cache(pn_ssl_domain_t *domain, size_t capacity, pn_millis_t ttl)
+{
+  if (!domain || !domain->ctx) return -1;
+  if (domain->mode == PN_SSL_MODE_SERVER) {
+    // OpenSSL keeps the server's sessions itself, a cache size of 0 means unlimited to it.
+    if (capacity) {
+      SSL_CTX_set_session_cache_mode(domain->ctx, SSL_SESS_CACHE_SERVER);
+      SSL_CTX_sess_set_cache_size(domain->ctx, (long) pn_min(capacity, (size_t) LONG_MAX));
+    } else {
+      SSL_CTX_set_session_cache_mode(domain->ctx, SSL_SESS_CACHE_OFF);
+    }
+    if (ttl) SSL_CTX_set_timeout(domain->ctx, (long) pn_max(ttl / 1000, (pn_millis_t) 1));
+    return 0;
+  }
+  pni_ssn_cache_t *cache = ssn_cache_get(domain->ctx);
+  if (!cache) return -1;
+  pni_mutex_lock(&cache->lock);
+  cache->capacity = capacity;
+  cache->ttl = ttl;
+  ssn_cache_trim(cache, capacity);
+  pni_mutex_unlock(&cache->lock);
+  return 0;
+}
+
+int pn_ssl_domain_set_session_tickets(pn_ssl_domain_t *domain, bool enabled)
+{
+  if (!domain || !domain->ctx) return -1;
+  if (enabled)
+    SSL_CTX_clear_options(domain->ctx, SSL_OP_NO_TICKET);
+  else
+    SSL_CTX_set_options(domain->ctx, SSL_OP_NO_TICKET);
+  return 0;
+}
+
+int pn_ssl_domain_set_kernel_tls(pn_ssl_domain_t *domain, bool enabled)
+{
+  if (!domain) return -1;
+#ifdef PNI_KTLS
+  if (enabled && !ktls_bio_method) return -1;
+  domain->ktls = enabled;
+  return 0;
+#else
+  return enabled ? -1 : 0;
+#endif
+}
+
 int pn_ssl_domain_set_protocols(pn_ssl_domain_t *domain, const char *protocols)
 {
   static const struct {
@@ -938,8 +1581,10 @@ void pn_ssl_free(pn_transport_t *transport)
   if (ssl->peer_hostname) free((void *)ssl->peer_hostname);
   if (ssl->inbuf) free((void *)ssl->inbuf);
   if (ssl->outbuf) free((void *)ssl->outbuf);
+  if (ssl->spill) free(ssl->spill);
   if (ssl->subject) free(ssl->subject);
   if (ssl->peer_certificate) X509_free(ssl->peer_certificate);
+  free(ssl->ktls);
   free(ssl);
 }
 
@@ -950,7 +1595,7 @@ pn_ssl_t *pn_ssl(pn_transport_t *transport)
 
   pni_ssl_t *ssl = (pni_ssl_t *) calloc(1, sizeof(pni_ssl_t));
   if (!ssl) return NULL;
-  ssl->out_size = APP_BUF_SIZE;
+  ssl->out_size = SSL3_RT_MAX_PLAIN_LENGTH;   // a full record per write
   uint32_t max_frame = pn_transport_get_max_frame(transport);
   ssl->in_size =  max_frame ? max_frame : APP_BUF_SIZE;
   ssl->outbuf = (char *)malloc(ssl->out_size);
@@ -993,9 +1638,13 @@ static int start_ssl_shutdown(pn_transport_t *transport)
   pni_ssl_t *ssl = transport->ssl;
   if (!ssl->ssl_shutdown) {
     ssl_log(transport, PN_LEVEL_TRACE, "Shutting down SSL connection...");
-    ssn_save(transport, ssl);
     ssl->ssl_shutdown = true;
-    BIO_ssl_shutdown( ssl->bio_ssl );
+    if (ktls_active(ssl)) {
+      // The I/O layer sends close_notify through the kernel as it closes the socket
+      SSL_set_shutdown(ssl->ssl, SSL_get_shutdown(ssl->ssl) | SSL_SENT_SHUTDOWN);
+    } else {
+      BIO_ssl_shutdown( ssl->bio_ssl );
+    }
   }
   return 0;
 }
@@ -1018,32 +1667,23 @@ static ssize_t process_input_ssl( pn_transport_t *transport, unsigned int layer,
 
   ssize_t consumed = 0;
   bool work_pending;
-  bool shutdown_input = (available == 0);  // caller is closed
+
+  // The SSL socket reads the input straight from input_data, see net_bio_read()
+  ssl->net_in = input_data;
+  ssl->net_in_size = available;
+  if (available > 0) {
+    ssl->read_blocked = false;
+  } else if (!ssl->net_in_closed) {
+    // lower layer (caller) has closed.  This will cause an EOF to be passed to SSL
+    // once all pending inbound data has been consumed.
+    ssl_log( transport, PN_LEVEL_TRACE, "Lower layer closed - closing BIO input");
+    ssl->net_in_closed = true;
+  }
 
   do {
     work_pending = false;
     ERR_clear_error();
 
-    // Write to network bio as much as possible, consuming bytes/available
-
-    if (available > 0) {
-      int written = BIO_write( ssl->bio_net_io, input_data, available );
-      if (written > 0) {
-        input_data += written;
-        available -= written;
-        consumed += written;
-        ssl->read_blocked = false;
-        work_pending = (available > 0);
-        ssl_log( transport, PN_LEVEL_TRACE, "Wrote %d bytes to BIO Layer, %" PN_ZU " left over", written, available );
-      }
-    } else if (shutdown_input) {
-      // lower layer (caller) has closed.  Close the WRITE side of the BIO.  This will cause
-      // an EOF to be passed to SSL once all pending inbound data has been consumed.
-      ssl_log( transport, PN_LEVEL_TRACE, "Lower layer closed - shutting down BIO write side");
-      (void)BIO_shutdown_wr( ssl->bio_net_io );
-      shutdown_input = false;
-    }
-
     // Read all available data from the SSL socket
 
     if (!ssl->ssl_closed && ssl->in_count < ssl->in_size) {
@@ -1131,6 +1771,16 @@ static ssize_t process_input_ssl( pn_transport_t *transport, unsigned int layer,
 
   } while (work_pending);
 
+  // Input after the SSL socket has closed is dropped
+  consumed = ssl->ssl_closed ? available : available - ssl->net_in_size;
+  ssl->net_in = NULL;
+  ssl->net_in_size = 0;
+  ssl_log( transport, PN_LEVEL_TRACE, "SSL socket read %" PN_ZI " bytes, %" PN_ZU " left over", consumed, available - consumed );
+
+#ifdef PNI_KTLS
+  if (ssl->ktls && ssl->ktls->lost && !ssl->ssl_closed) return ktls_failed(transport);
+#endif
+
   //_log(ssl, "ssl_closed=%d in_count=%d app_input_closed=%d app_output_closed=%d",
   //     ssl->ssl_closed, ssl->in_count, ssl->app_input_closed, ssl->app_output_closed );
 
@@ -1161,16 +1811,58 @@ static void handle_error_ssl(pn_transport_t *transport, unsigned int layer)
   transport->io_layers[layer] = &ssl_closed_layer;
 }
 
+#ifdef PNI_KTLS
+// Output once the kernel encrypts it: straight from the layer above
+static ssize_t process_output_ktls(pn_transport_t *transport, unsigned int layer, char *buffer, size_t max_len)
+{
+  pni_ssl_t *ssl = transport->ssl;
+  if (ssl->ktls->lost && !ssl->ssl_closed) return ktls_failed(transport);
+  if (!ssl->app_output_closed) {
+    ssize_t app_bytes = transport->io_layers[layer+1]->process_output(transport, layer+1, buffer, max_len);
+    if (app_bytes >= 0) return app_bytes;
+    ssl_log(transport, PN_LEVEL_TRACE, "Application layer closed its output, error=%d", (int) app_bytes);
+    ssl->app_output_closed = app_bytes;
+  }
+  if (ssl->app_input_closed) start_ssl_shutdown(transport);
+  if (!(SSL_get_shutdown(ssl->ssl) & SSL_SENT_SHUTDOWN)) return 0;
+  if (transport->io_layers[layer]==&ssl_input_closed_layer) {
+    transport->io_layers[layer] = &ssl_closed_layer;
+  } else {
+    transport->io_layers[layer] = &ssl_output_closed_layer;
+  }
+  return ssl->app_output_closed ? ssl->app_output_closed : PN_EOS;
+}
+#endif
+
 static ssize_t process_output_ssl( pn_transport_t *transport, unsigned int layer, char *buffer, size_t max_len)
 {
   pni_ssl_t *ssl = transport->ssl;
   if (!ssl) return PN_EOS;
   if (ssl->ssl == NULL && init_ssl_socket(transport, ssl, NULL)) return PN_EOS;
 
+#ifdef PNI_KTLS
+  if (ssl->ktls) {
+    if (ssl->ktls->state == KTLS_ACTIVE) return process_output_ktls(transport, layer, buffer, max_len);
+    if (ktls_ready(ssl)) return 0;      // until the I/O layer has tried pni_ssl_ktls_tx()
+    if (ssl->ktls->state == KTLS_WAITING && SSL_is_init_finished(ssl->ssl)) {
+      // OpenSSL never offered the keys, e.g. for a cipher the kernel lacks
+      ssl->ktls->state = KTLS_OFF;
+      if (ssl->ktls_offered)
+        ssl_log(transport, PN_LEVEL_INFO, "Kernel TLS keys not offered by OpenSSL, output stays with OpenSSL");
+    }
+  }
+#endif
+
   ssize_t written = 0;
-  bool work_pending;
 
-  do {
+  // The SSL socket writes records straight into buffer, see net_bio_write().
+  // Spilled output goes first, and may leave no room for more.
+  ssl->net_out = buffer;
+  ssl->net_out_size = max_len;
+  ssl->net_out_count = 0;
+  bool work_pending = unspill_output(ssl);
+
+  while (work_pending) {
     work_pending = false;
     ERR_clear_error();
 
@@ -1195,7 +1887,7 @@ static ssize_t process_output_ssl( pn_transport_t *transport, unsigned int layer
 
     if (!ssl->ssl_closed) {
       char *data = ssl->outbuf;
-      if (ssl->out_count > 0) {
+      if (ssl->out_count > 0 && ssl->net_out_count < ssl->net_out_size) {
         int wrote = BIO_write( ssl->bio_ssl, data, ssl->out_count );
         if (wrote > 0) {
           data += wrote;
@@ -1241,33 +1933,29 @@ static ssize_t process_output_ssl( pn_transport_t *transport, unsigned int layer
       }
     }
 
-    // read from the network bio as much as possible, filling the buffer
-    if (max_len) {
-      int available = BIO_read( ssl->bio_net_io, buffer, max_len );
-      if (available > 0) {
-        max_len -= available;
-        buffer += available;
-        written += available;
-        ssl->write_blocked = false;
-        work_pending = work_pending || max_len > 0;
-        ssl_log(transport, PN_LEVEL_TRACE, "Read %d bytes from BIO Layer", available );
-      }
-    }
+    work_pending = work_pending && ssl->net_out_count < ssl->net_out_size;
+  }
 
-  } while (work_pending);
+  written = ssl->net_out_count;
+  ssl->net_out = NULL;
+  ssl->net_out_size = ssl->net_out_count = 0;
+  if (written > 0) {
+    ssl->write_blocked = false;
+    ssl_log(transport, PN_LEVEL_TRACE, "SSL socket wrote %" PN_ZI " bytes, %" PN_ZU " spilled", written, ssl->spill_count);
+  }
 
-  //_log(ssl, "written=%d ssl_closed=%d in_count=%d app_input_closed=%d app_output_closed=%d bio_pend=%d",
-  //     written, ssl->ssl_closed, ssl->in_count, ssl->app_input_closed, ssl->app_output_closed, BIO_pending(ssl->bio_net_io) );
+  //_log(ssl, "written=%d ssl_closed=%d in_count=%d app_input_closed=%d app_output_closed=%d spilled=%d",
+  //     written, ssl->ssl_closed, ssl->in_count, ssl->app_input_closed, ssl->app_output_closed, ssl->spill_count );
 
   // PROTON-82: close the output side as soon as we've sent the SSL close_notify.
   // We're not requiring the response, as some implementations never reply.
   // ----
   // Once no more data is available "below" the SSL socket, tell the transport we are
   // done.
-  //if (written == 0 && ssl->ssl_closed && BIO_pending(ssl->bio_net_io) == 0) {
+  //if (written == 0 && ssl->ssl_closed && ssl->spill_count == 0) {
   //  written = ssl->app_output_closed ? ssl->app_output_closed : PN_EOS;
   //}
-  if (written == 0 && (SSL_get_shutdown(ssl->ssl) & SSL_SENT_SHUTDOWN) && BIO_pending(ssl->bio_net_io) == 0) {
+  if (written == 0 && (SSL_get_shutdown(ssl->ssl) & SSL_SENT_SHUTDOWN) && ssl->spill_count == 0) {
     written = ssl->app_output_closed ? ssl->app_output_closed : PN_EOS;
     if (transport->io_layers[layer]==&ssl_input_closed_layer) {
       transport->io_layers[layer] = &ssl_closed_layer;
@@ -1311,12 +1999,27 @@ static int init_ssl_socket(pn_transport_t* transport, pni_ssl_t *ssl, pn_ssl_dom
   }
   (void)BIO_set_ssl(ssl->bio_ssl, ssl->ssl, BIO_NOCLOSE);
 
-  // create the "lower" BIO "pipe", and attach it below the SSL layer
-  if (!BIO_new_bio_pair(&ssl->bio_ssl_io, 0, &ssl->bio_net_io, 0)) {
+  // create the network BIO, and attach it below the SSL layer
+  ssl->bio_net = net_bio_method ? BIO_new(net_bio_method) : NULL;
+  if (!ssl->bio_net) {
     ssl_log(transport, PN_LEVEL_ERROR, "BIO setup failure." );
     return -1;
   }
-  SSL_set_bio(ssl->ssl, ssl->bio_ssl_io, ssl->bio_ssl_io);
+  BIO_set_data(ssl->bio_net, ssl);
+  BIO *bio = ssl->bio_net;
+#ifdef PNI_KTLS
+  // Without the filter the connection simply stays with OpenSSL
+  BIO *filter = domain->ktls && ktls_bio_method ? BIO_new(ktls_bio_method) : NULL;
+  ssl->ktls = filter ? (pni_ktls_t *) calloc(1, sizeof(pni_ktls_t)) : NULL;
+  if (ssl->ktls) {
+    BIO_set_data(filter, ssl->ktls);
+    bio = BIO_push(filter, bio);
+    SSL_set_options(ssl->ssl, SSL_OP_ENABLE_KTLS);
+  } else if (filter) {
+    BIO_free(filter);
+  }
+#endif
+  SSL_set_bio(ssl->ssl, bio, bio);
 
   if (ssl->mode == PN_SSL_MODE_SERVER) {
     SSL_set_accept_state(ssl->ssl);
@@ -1336,14 +2039,12 @@ static void release_ssl_socket(pni_ssl_t *ssl)
 {
   if (ssl->bio_ssl) BIO_free(ssl->bio_ssl);
   if (ssl->ssl) {
-    SSL_free(ssl->ssl);       // will free bio_ssl_io
+    SSL_free(ssl->ssl);       // will free bio_net
   } else {
-    if (ssl->bio_ssl_io) BIO_free(ssl->bio_ssl_io);
+    if (ssl->bio_net) BIO_free(ssl->bio_net);
   }
-  if (ssl->bio_net_io) BIO_free(ssl->bio_net_io);
   ssl->bio_ssl = NULL;
-  ssl->bio_ssl_io = NULL;
-  ssl->bio_net_io = NULL;
+  ssl->bio_net = NULL;
   ssl->ssl = NULL;
 }
 
@@ -1568,9 +2269,7 @@ static size_t buffered_output(pn_transport_t *transport)
   pni_ssl_t *ssl = transport->ssl;
   if (ssl) {
     count += ssl->out_count;
-    if (ssl->bio_net_io) { // pick up any bytes waiting for network io
-      count += BIO_ctrl_pending(ssl->bio_net_io);
-    }
+    count += ssl->spill_count;  // bytes waiting for network io
   }
   return count;
 }
@@ -1582,10 +2281,6 @@ static bool init_ok = false;
 
 #ifdef _WIN32
 
-typedef CRITICAL_SECTION pni_mutex_t;
-static inline void pni_mutex_init(pni_mutex_t *m) { InitializeCriticalSection(m); }
-static inline void pni_mutex_lock(pni_mutex_t *m) { EnterCriticalSection(m); }
-static inline void pni_mutex_unlock(pni_mutex_t *m) { LeaveCriticalSection(m); }
 static inline unsigned long id_callback(void) { return (unsigned long)GetCurrentThreadId(); }
 INIT_ONCE initialize_once = INIT_ONCE_STATIC_INIT;
 static inline bool ensure_initialized(void) {
@@ -1596,14 +2291,8 @@ static inline bool ensure_initialized(void) {
 
 #else  /* POSIX */
 
-#include <pthread.h>
-
 static void initialize(void);
 
-typedef pthread_mutex_t pni_mutex_t;
-static inline int pni_mutex_init(pni_mutex_t *m) { return pthread_mutex_init(m, NULL); }
-static inline int pni_mutex_lock(pni_mutex_t *m) { return pthread_mutex_lock(m); }
-static inline int pni_mutex_unlock(pni_mutex_t *m) { return pthread_mutex_unlock(m); }
 static inline unsigned long id_callback(void) { return (unsigned long)pthread_self(); }
 static pthread_once_t initialize_once = PTHREAD_ONCE_INIT;
 static inline bool ensure_initialized(void) {
@@ -1630,7 +2319,12 @@ static void initialize(void) {
   OpenSSL_add_all_algorithms();
   ssl_ex_data_index = SSL_get_ex_new_index( 0, (void *) "org.apache.qpid.proton.ssl",
                                             NULL, NULL, NULL);
-  ssn_init();
+  ssl_ctx_ex_data_index = SSL_CTX_get_ex_new_index( 0, (void *) "org.apache.qpid.proton.ssl_ctx",
+                                                    NULL, NULL, ssn_cache_free);
+  net_bio_method = net_bio_method_new();
+#ifdef PNI_KTLS
+  ktls_bio_method = ktls_bio_method_new();
+#endif
   locks = (pni_mutex_t*)malloc(CRYPTO_num_locks() * sizeof(pni_mutex_t));
   if (!locks) return;
   for(i = 0;  i < CRYPTO_num_locks();  i++)
@@ -639,6 +639,21 @@ int pn_ssl_domain_set_protocols(pn_ssl_domain_t *domain, const char *protocols)
   return PN_ERR;
 }
 
+int pn_ssl_domain_set_session_cache(pn_ssl_domain_t *domain, size_t capacity, pn_millis_t ttl)
+{
+  return PN_ERR;
+}
+
+int pn_ssl_domain_set_session_tickets(pn_ssl_domain_t *domain, bool enabled)
+{
+  return PN_ERR;
+}
+
+int pn_ssl_domain_set_kernel_tls(pn_ssl_domain_t *domain, bool enabled)
+{
+  return enabled ? PN_ERR : 0;
+}
+
 const pn_io_layer_t ssl_layer = {
     process_input_ssl,
     process_output_ssl,
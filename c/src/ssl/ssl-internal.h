@@ -37,6 +37,21 @@ extern "C" {
 // release the SSL context
 void pn_ssl_free(pn_transport_t *transport);
 
+/*
+ * Kernel TLS offload of output, for I/O layers that own the socket.
+ *
+ * pni_ssl_ktls_offer() says the caller can install kernel TLS, call it before
+ * any I/O. Once the handshake is over pni_ssl_ktls_tx() returns the crypto_info
+ * for setsockopt(SOL_TLS, TLS_TX) and the SSL layer holds back output until
+ * pni_ssl_ktls_tx_done() says whether it was installed. Only call
+ * pni_ssl_ktls_tx() when all output so far has been written to the socket.
+ * If installed, later output is plain text for the kernel to encrypt and the
+ * caller sends close_notify itself before shutting down the socket.
+ */
+PN_EXTERN void pni_ssl_ktls_offer(pn_transport_t *transport);
+PN_EXTERN const void *pni_ssl_ktls_tx(pn_transport_t *transport, size_t *size);
+PN_EXTERN void pni_ssl_ktls_tx_done(pn_transport_t *transport, bool installed);
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,6 +23,7 @@
 #include <proton/error.h>
 #include <proton/transport.h>
 #include "core/engine-internal.h"
+#include "ssl/ssl-internal.h"
 
 
 /** @file
@@ -52,6 +53,19 @@ void pn_ssl_free(pn_transport_t *transport)
 {
 }
 
+void pni_ssl_ktls_offer(pn_transport_t *transport)
+{
+}
+
+const void *pni_ssl_ktls_tx(pn_transport_t *transport, size_t *size)
+{
+  return NULL;
+}
+
+void pni_ssl_ktls_tx_done(pn_transport_t *transport, bool installed)
+{
+}
+
 void pn_ssl_trace(pn_ssl_t *ssl, pn_trace_t trace)
 {
 }
@@ -130,6 +144,21 @@ int pn_ssl_domain_set_protocols(pn_ssl_domain_t* domain, const char* protocols)
   return -1;
 }
 
+int pn_ssl_domain_set_session_cache(pn_ssl_domain_t *domain, size_t capacity, pn_millis_t ttl)
+{
+  return -1;
+}
+
+int pn_ssl_domain_set_session_tickets(pn_ssl_domain_t *domain, bool enabled)
+{
+  return -1;
+}
+
+int pn_ssl_domain_set_kernel_tls(pn_ssl_domain_t *domain, bool enabled)
+{
+  return -1;
+}
+
 bool pn_ssl_allow_unsecured(pn_ssl_t *ssl)
 {
   return true;
@@ -30,6 +30,10 @@
 
 #include <string.h>
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 using Catch::Matchers::EndsWith;
 using Catch::Matchers::Equals;
 using namespace pn_test;
@@ -182,6 +186,142 @@ struct send_client_handler : public pn_test::handler {
 };
 } // namespace
 
+/* View a received message in place and forward the original bytes */
+TEST_CASE("driver_message_view") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  pn_link_flow(rcv, 1);
+  d.run();
+
+  auto_free<pn_message_t, pn_message_free> m(pn_message());
+  pn_message_set_address(m, "queue");
+  pn_data_put_string(pn_message_body(m), pn_bytes("abc"));
+  pn_delivery(snd, pn_bytes("x"));
+  REQUIRE(pn_message_send(m, snd, NULL) >= 0);
+  d.run();
+
+  pn_delivery_t *dlv = server.delivery;
+  REQUIRE(dlv);
+  auto_free<pn_message_view_t, pn_message_view_free> view(pn_message_view());
+  REQUIRE(0 == pn_message_view_recv(view, dlv));
+  pn_bytes_t address = pn_message_view_get_address(view);
+  CHECK("queue" == std::string(address.start, address.size));
+  pn_bytes_t bytes = pn_message_view_bytes(view);
+  CHECK(pn_delivery_pending(dlv) == bytes.size);
+
+  /* Forward the message unchanged on a link of another session */
+  pn_session_t *ssn = pn_session(d.server.connection);
+  pn_link_t *fwd = pn_sender(ssn, "fwd");
+  pn_delivery_t *out = pn_delivery(fwd, pn_bytes("y"));
+  CHECK(ssize_t(bytes.size) == pn_message_view_send(view, fwd));
+  CHECK(pn_delivery_pending(out) == bytes.size);
+  CHECK(out != pn_link_current(fwd));
+
+  /* The viewed delivery can still be received as usual */
+  auto_free<pn_message_t, pn_message_free> m2(pn_message());
+  pn_rwbytes_t buf2 = {0};
+  message_decode(m2, dlv, &buf2);
+  CHECK_THAT("queue", Equals(pn_message_get_address(m2)));
+  free(buf2.start);
+}
+
+/* A view of a delivery stays valid after the link has moved on from it */
+TEST_CASE("driver_message_view_advance") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  pn_link_flow(rcv, 2);
+  d.run();
+
+  auto_free<pn_message_t, pn_message_free> m(pn_message());
+  pn_message_set_address(m, "queue");
+  pn_delivery(snd, pn_bytes("x"));
+  REQUIRE(pn_message_send(m, snd, NULL) >= 0);
+  pn_delivery(snd, pn_bytes("y"));
+  REQUIRE(pn_message_send(m, snd, NULL) >= 0);
+  d.run();
+
+  pn_delivery_t *dlv = pn_link_current(rcv);
+  REQUIRE(dlv);
+  pn_session_t *ssn = pn_link_session(rcv);
+  size_t size = pn_delivery_pending(dlv);
+  CHECK(pn_session_incoming_bytes(ssn) == 2 * size);
+  auto_free<pn_message_view_t, pn_message_view_free> view(pn_message_view());
+  REQUIRE(0 == pn_message_view_recv(view, dlv));
+  REQUIRE(pn_link_advance(rcv));
+  CHECK(pn_link_credit(rcv) == 1);
+  CHECK(pn_delivery_pending(dlv) == 0);
+  /* The viewed bytes are kept but no longer count against the session */
+  CHECK(pn_session_incoming_bytes(ssn) == size);
+  CHECK(pn_message_view_bytes(view).size == size);
+  pn_bytes_t address = pn_message_view_get_address(view);
+  CHECK("queue" == std::string(address.start, address.size));
+  REQUIRE(0 == pn_message_view_recv(view, dlv));
+
+  /* Until the link moves on again */
+  pn_delivery_t *next = pn_link_current(rcv);
+  REQUIRE(next);
+  CHECK(pn_delivery_pending(next) == size);
+  pn_link_advance(rcv);
+  CHECK(PN_ARG_ERR == pn_message_view_recv(view, dlv));
+  CHECK(pn_session_incoming_bytes(ssn) == 0);
+  /* A delivery that was not viewed keeps nothing */
+  CHECK(PN_ARG_ERR == pn_message_view_recv(view, next));
+  pn_delivery_settle(dlv);
+  pn_delivery_settle(next);
+  CHECK(pn_session_incoming_bytes(ssn) == 0);
+}
+
+/* Advancing past deliveries without reading them reopens the session window */
+TEST_CASE("driver_message_advance_unread") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+  pn_transport_set_max_frame(d.server.transport, 512);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  pn_session_set_incoming_capacity(server.session, 1024);
+  pn_link_flow(rcv, 10);
+  d.run();
+
+  std::string body(600, 'x');
+  for (int i = 0; i < 10; ++i) {
+    pn_delivery(snd, pn_bytes(std::to_string(i)));
+    CHECK((ssize_t)body.size() == pn_link_send(snd, body.data(), body.size()));
+    CHECK(pn_link_advance(snd));
+  }
+
+  std::vector<pn_delivery_t *> received;
+  bool progress = true;
+  while (received.size() < 10 && progress) {
+    progress = d.run() != PN_EVENT_NONE;
+    pn_delivery_t *dlv = pn_link_current(rcv);
+    if (dlv && !pn_delivery_partial(dlv)) {
+      CHECK(body.size() == pn_delivery_pending(dlv));
+      received.push_back(dlv);
+      CHECK(pn_link_advance(rcv));
+      progress = true;
+    }
+  }
+  CHECK(received.size() == 10);
+  CHECK(pn_session_incoming_bytes(server.session) == 0);
+  for (pn_delivery_t *dlv : received) pn_delivery_settle(dlv);
+  while (d.run())
+    ;
+  CHECK(pn_session_incoming_bytes(server.session) == 0);
+}
+
 /* Send a message in pieces, ensure each can be received before the next is sent
  */
 TEST_CASE("driver_message_stream") {
@@ -231,6 +371,222 @@ TEST_CASE("driver_message_stream") {
   free(buf2.start);
 }
 
+namespace {
+/* Like driver::read() but gathers the source output with pn_connection_driver_write_buffers() */
+size_t read_buffers(pn_connection_driver_t &dst, pn_connection_driver_t &src) {
+  pn_bytes_t wbs[4];
+  size_t n = pn_connection_driver_write_buffers(&src, wbs, 4);
+  size_t size = 0;
+  for (size_t i = 0; i < n; ++i) {
+    pn_rwbytes_t rb = pn_connection_driver_read_buffer(&dst);
+    size_t c = rb.size < wbs[i].size ? rb.size : wbs[i].size;
+    std::copy(wbs[i].start, wbs[i].start + c, rb.start);
+    pn_connection_driver_read_done(&dst, c);
+    size += c;
+    if (c < wbs[i].size) break;
+  }
+  if (size) pn_connection_driver_write_done(&src, size);
+  return size;
+}
+} // namespace
+
+/* Send large messages split over several frames using scatter/gather output */
+TEST_CASE("driver_message_write_buffers") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+  pn_transport_set_max_frame(d.server.transport, 4096);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  pn_link_flow(rcv, 2);
+  d.run();
+
+  std::vector<char> body(10000);
+  for (size_t i = 0; i < body.size(); ++i) body[i] = (char)i;
+  for (int m = 0; m < 2; ++m) {
+    pn_delivery(snd, pn_bytes(1, m ? "y" : "x"));
+    CHECK((ssize_t)body.size() == pn_link_send(snd, &body[0], body.size()));
+    CHECK(pn_link_advance(snd));
+  }
+  while (read_buffers(d.server, d.client) || d.server.run() || d.client.run())
+    ;
+
+  pn_delivery_t *dlv = pn_link_current(rcv);
+  for (int m = 0; m < 2; ++m) {
+    REQUIRE(dlv);
+    CHECK(!pn_delivery_partial(dlv));
+    std::vector<char> received(body.size());
+    CHECK((ssize_t)body.size() == pn_link_recv(rcv, &received[0], received.size()));
+    CHECK(body == received);
+    CHECK(pn_link_advance(rcv));
+    dlv = pn_link_current(rcv);
+  }
+  CHECK(pn_transport_get_frames_output(d.client.transport) > 6);
+}
+
+/* Receive a delivery of many frames in pieces, then one in a single view */
+TEST_CASE("driver_message_large") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+  pn_transport_set_max_frame(d.server.transport, 4096);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  /* Let the whole delivery be buffered before it is received */
+  pn_session_set_incoming_capacity(server.session, 1024 * 1024);
+  pn_link_flow(rcv, 2);
+  d.run();
+
+  std::vector<char> body(300000);
+  for (size_t i = 0; i < body.size(); ++i) body[i] = (char)(i % 251);
+  pn_delivery(snd, pn_bytes("x"));
+  CHECK((ssize_t)body.size() == pn_link_send(snd, &body[0], body.size()));
+  CHECK(pn_link_advance(snd));
+  while (d.run())
+    ;
+
+  pn_delivery_t *dlv = pn_link_current(rcv);
+  REQUIRE(dlv);
+  CHECK(!pn_delivery_partial(dlv));
+  CHECK(body.size() == pn_delivery_pending(dlv));
+  std::vector<char> received;
+  char piece[7001];
+  ssize_t n;
+  while ((n = pn_link_recv(rcv, piece, sizeof(piece))) > 0) {
+    received.insert(received.end(), piece, piece + n);
+  }
+  CHECK(PN_EOS == n);
+  CHECK(body == received);
+  CHECK(pn_link_advance(rcv));
+
+  auto_free<pn_message_t, pn_message_free> m(pn_message());
+  pn_data_put_binary(pn_message_body(m), pn_bytes(body.size(), &body[0]));
+  pn_delivery(snd, pn_bytes("y"));
+  REQUIRE(pn_message_send(m, snd, NULL) >= 0);
+  while (d.run())
+    ;
+
+  dlv = pn_link_current(rcv);
+  REQUIRE(dlv);
+  CHECK(!pn_delivery_partial(dlv));
+  auto_free<pn_message_view_t, pn_message_view_free> view(pn_message_view());
+  REQUIRE(0 == pn_message_view_recv(view, dlv));
+  auto_free<pn_message_t, pn_message_free> m2(pn_message());
+  pn_bytes_t bytes = pn_message_view_bytes(view);
+  REQUIRE(0 == pn_message_decode(m2, bytes.start, bytes.size));
+  pn_data_t *data = pn_message_body(m2);
+  REQUIRE(pn_data_next(data));
+  pn_bytes_t received2 = pn_data_get_binary(data);
+  CHECK(body == std::vector<char>(received2.start, received2.start + received2.size));
+}
+
+/* Send a message written in many pieces and decode it from the chunks it is received in */
+TEST_CASE("driver_message_chunked") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+  pn_transport_set_max_frame(d.server.transport, 4096);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  pn_session_set_incoming_capacity(server.session, 1024 * 1024);
+  pn_link_flow(rcv, 1);
+  d.run();
+
+  std::vector<char> body(300000);
+  for (size_t i = 0; i < body.size(); ++i) body[i] = (char)(i % 251);
+  auto_free<pn_message_t, pn_message_free> m(pn_message());
+  pn_message_set_address(m, "queue");
+  pn_data_put_binary(pn_message_body(m), pn_bytes(body.size(), &body[0]));
+  std::vector<char> encoded(pn_message_encoded_size(m));
+  size_t size = encoded.size();
+  REQUIRE(0 == pn_message_encode(m, &encoded[0], &size));
+
+  pn_delivery(snd, pn_bytes("x"));
+  const size_t piece = 5000;
+  CHECK((ssize_t)piece == pn_link_send(snd, &encoded[0], piece));
+  while (d.run())
+    ;
+  pn_delivery_t *dlv = pn_link_current(rcv);
+  REQUIRE(dlv);
+  auto_free<pn_message_t, pn_message_free> m2(pn_message());
+  CHECK(PN_STATE_ERR == pn_message_recv(m2, dlv));
+
+  for (size_t i = piece; i < size; i += piece) {
+    size_t n = std::min(piece, size - i);
+    CHECK((ssize_t)n == pn_link_send(snd, &encoded[i], n));
+  }
+  CHECK(pn_link_advance(snd));
+  while (d.run())
+    ;
+
+  CHECK(!pn_delivery_partial(dlv));
+  REQUIRE(0 == pn_message_recv(m2, dlv));
+  CHECK(std::string("queue") == pn_message_get_address(m2));
+  pn_data_t *data = pn_message_body(m2);
+  REQUIRE(pn_data_next(data));
+  pn_bytes_t received = pn_data_get_binary(data);
+  CHECK(body == std::vector<char>(received.start, received.start + received.size));
+  /* The bytes are left to be read */
+  CHECK(size == pn_delivery_pending(dlv));
+}
+
+/* Send a burst of small deliveries, some settled and one too big for a single frame */
+TEST_CASE("driver_message_batch") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+  pn_transport_set_max_frame(d.server.transport, 512);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  pn_session_set_incoming_capacity(server.session, 1024 * 1024);
+  pn_link_flow(rcv, 60);
+  d.run();
+
+  const int count = 100;
+  std::vector<std::string> sent;
+  for (int i = 0; i < count; ++i) {
+    std::string tag = "tag" + std::to_string(i);
+    std::string body = (i == 42) ? std::string(600, 'x') : "body" + std::to_string(i);
+    pn_delivery_t *dlv = pn_delivery(snd, pn_bytes(tag.size(), tag.data()));
+    CHECK((ssize_t)body.size() == pn_link_send(snd, body.data(), body.size()));
+    CHECK(pn_link_advance(snd));
+    if (i % 3 == 0) pn_delivery_settle(dlv);
+    sent.push_back(body);
+  }
+  while (d.run())
+    ;
+  CHECK(60 == pn_link_queued(rcv));
+  CHECK(count - 60 == pn_link_queued(snd));
+  pn_link_flow(rcv, count - 60);
+  while (d.run())
+    ;
+  CHECK(count == pn_link_queued(rcv));
+  CHECK(0 == pn_link_queued(snd));
+
+  for (int i = 0; i < count; ++i) {
+    pn_delivery_t *dlv = pn_link_current(rcv);
+    REQUIRE(dlv);
+    pn_delivery_tag_t tag = pn_delivery_tag(dlv);
+    CHECK("tag" + std::to_string(i) == std::string(tag.start, tag.size));
+    CHECK(!pn_delivery_partial(dlv));
+    CHECK((i % 3 == 0) == pn_delivery_settled(dlv));
+    std::vector<char> body(pn_delivery_pending(dlv));
+    CHECK((ssize_t)body.size() == pn_link_recv(rcv, body.data(), body.size()));
+    CHECK(sent[i] == std::string(body.begin(), body.end()));
+    CHECK(pn_link_advance(rcv));
+    pn_delivery_settle(dlv);
+  }
+  CHECK(0 == pn_link_unsettled(rcv));
+}
+
 // Test aborting a delivery
 TEST_CASE("driver_message_abort") {
   send_client_handler client;
@@ -617,3 +973,295 @@ TEST_CASE("driver_empty_last_frame") {
              cond_empty());
   CHECK_THAT(*pn_connection_condition(d.server.connection), cond_empty());
 }
+
+/* Delivery outcomes with fields survive the trip from receiver to sender */
+TEST_CASE("driver_disposition_outcomes") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  pn_link_flow(rcv, 3);
+  d.run();
+
+  pn_delivery_t *sd[3];
+  pn_delivery_t *rd[3];
+  for (int i = 0; i < 3; ++i) {
+    char tag[] = {char('a' + i), 0};
+    sd[i] = pn_delivery(snd, pn_bytes(tag));
+    CHECK(3 == pn_link_send(snd, "xyz", 3));
+    CHECK(pn_link_advance(snd));
+    d.run();
+    rd[i] = pn_link_current(rcv);
+    REQUIRE(rd[i]);
+    CHECK(pn_link_advance(rcv));
+  }
+
+  pn_disposition_t *rejected = pn_delivery_local(rd[0]);
+  pn_condition_set_name(pn_disposition_condition(rejected), "x:y");
+  pn_condition_set_description(pn_disposition_condition(rejected), "bad");
+  pn_delivery_update(rd[0], PN_REJECTED);
+
+  pn_disposition_t *modified = pn_delivery_local(rd[1]);
+  pn_disposition_set_failed(modified, true);
+  pn_disposition_set_undeliverable(modified, true);
+  pn_data_t *annotations = pn_disposition_annotations(modified);
+  pn_data_put_map(annotations);
+  pn_data_enter(annotations);
+  pn_data_put_symbol(annotations, pn_bytes("k"));
+  pn_data_put_int(annotations, 42);
+  pn_data_exit(annotations);
+  pn_delivery_update(rd[1], PN_MODIFIED);
+
+  pn_disposition_t *received = pn_delivery_local(rd[2]);
+  pn_disposition_set_section_number(received, 7);
+  pn_disposition_set_section_offset(received, 11);
+  pn_delivery_update(rd[2], PN_RECEIVED);
+  d.run();
+
+  CHECK(PN_REJECTED == pn_delivery_remote_state(sd[0]));
+  pn_condition_t *cond = pn_disposition_condition(pn_delivery_remote(sd[0]));
+  CHECK_THAT("x:y", Equals(pn_condition_get_name(cond)));
+  CHECK_THAT("bad", Equals(pn_condition_get_description(cond)));
+
+  CHECK(PN_MODIFIED == pn_delivery_remote_state(sd[1]));
+  pn_disposition_t *rmod = pn_delivery_remote(sd[1]);
+  CHECK(pn_disposition_is_failed(rmod));
+  CHECK(pn_disposition_is_undeliverable(rmod));
+  CHECK("{:k=42}" == inspect(pn_disposition_annotations(rmod)));
+
+  CHECK(PN_RECEIVED == pn_delivery_remote_state(sd[2]));
+  CHECK(7 == pn_disposition_get_section_number(pn_delivery_remote(sd[2])));
+  CHECK(11 == pn_disposition_get_section_offset(pn_delivery_remote(sd[2])));
+
+  /* Outcomes without fields, settled as a range */
+  for (int i = 0; i < 3; ++i) {
+    pn_delivery_update(rd[i], PN_ACCEPTED);
+    pn_delivery_settle(rd[i]);
+  }
+  d.run();
+  for (int i = 0; i < 3; ++i) {
+    CHECK(PN_ACCEPTED == pn_delivery_remote_state(sd[i]));
+    CHECK(pn_delivery_settled(sd[i]));
+  }
+  CHECK_THAT(*pn_connection_condition(d.client.connection), cond_empty());
+  CHECK_THAT(*pn_connection_condition(d.server.connection), cond_empty());
+}
+
+/* Many unsettled deliveries settled out of order, singly and in ranges */
+TEST_CASE("driver_disposition_unsettled_many") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  const int count = 1000;
+  pn_link_flow(rcv, count);
+  d.run();
+
+  std::vector<pn_delivery_t *> sd, rd;
+  for (int i = 0; i < count; ++i) {
+    std::string tag = std::to_string(i);
+    sd.push_back(pn_delivery(snd, pn_bytes(tag.size(), tag.data())));
+    CHECK(1 == pn_link_send(snd, "x", 1));
+    CHECK(pn_link_advance(snd));
+  }
+  while (d.run())
+    ;
+  for (int i = 0; i < count; ++i) {
+    rd.push_back(pn_link_current(rcv));
+    REQUIRE(rd.back());
+    CHECK(pn_link_advance(rcv));
+  }
+  CHECK(count == pn_link_unsettled(snd));
+
+  /* Every other delivery from the end, leaving the oldest unsettled */
+  for (int i = count - 1; i > 0; i -= 2) {
+    pn_delivery_update(rd[i], PN_ACCEPTED);
+    pn_delivery_settle(rd[i]);
+  }
+  d.run();
+  for (int i = 0; i < count; ++i) {
+    CHECK((i % 2 == 1) == pn_delivery_settled(sd[i]));
+  }
+
+  /* The rest, which the receiver can send as a few ranges */
+  for (int i = 0; i < count; i += 2) {
+    pn_delivery_update(rd[i], PN_RELEASED);
+    pn_delivery_settle(rd[i]);
+  }
+  d.run();
+  for (int i = 0; i < count; ++i) {
+    CHECK(pn_delivery_settled(sd[i]));
+    CHECK((i % 2 ? PN_ACCEPTED : PN_RELEASED) == pn_delivery_remote_state(sd[i]));
+    pn_delivery_settle(sd[i]);
+  }
+  d.run();
+  CHECK(0 == pn_link_unsettled(snd));
+  CHECK(0 == pn_link_unsettled(rcv));
+  CHECK_THAT(*pn_connection_condition(d.client.connection), cond_empty());
+  CHECK_THAT(*pn_connection_condition(d.server.connection), cond_empty());
+}
+
+/* One delivery left unsettled while many more pass, more than the ring
+   holding the deliveries in flight can span */
+TEST_CASE("driver_disposition_old_unsettled") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  const int batch = 1000;
+  const int batches = 20;
+  pn_link_flow(rcv, 1 + batch * batches);
+  d.run();
+
+  pn_delivery_t *first = pn_delivery(snd, pn_dtag("first", 5));
+  pn_link_send(snd, "x", 1);
+  pn_link_advance(snd);
+  d.run();
+  pn_delivery_t *rfirst = pn_link_current(rcv);
+  REQUIRE(rfirst);
+  pn_link_advance(rcv);
+
+  for (int b = 0; b < batches; ++b) {
+    std::vector<pn_delivery_t *> sd;
+    for (int i = 0; i < batch; ++i) {
+      std::string tag = std::to_string(b * batch + i);
+      sd.push_back(pn_delivery(snd, pn_bytes(tag.size(), tag.data())));
+      pn_link_send(snd, "x", 1);
+      pn_link_advance(snd);
+    }
+    while (d.run())
+      ;
+    pn_delivery_t *dlv;
+    while ((dlv = pn_link_current(rcv))) {
+      pn_delivery_update(dlv, PN_ACCEPTED);
+      pn_delivery_settle(dlv);
+    }
+    while (d.run())
+      ;
+    for (pn_delivery_t *s : sd) {
+      CHECK(pn_delivery_settled(s));
+      pn_delivery_settle(s);
+    }
+    d.run();
+  }
+  CHECK(1 == pn_link_unsettled(snd));
+  CHECK(1 == pn_link_unsettled(rcv));
+
+  /* The oldest delivery is still found by its id */
+  pn_delivery_update(rfirst, PN_REJECTED);
+  pn_delivery_settle(rfirst);
+  d.run();
+  CHECK(pn_delivery_settled(first));
+  CHECK(PN_REJECTED == pn_delivery_remote_state(first));
+  pn_delivery_settle(first);
+  d.run();
+  CHECK(0 == pn_link_unsettled(snd));
+  CHECK(0 == pn_link_unsettled(rcv));
+  CHECK_THAT(*pn_connection_condition(d.client.connection), cond_empty());
+  CHECK_THAT(*pn_connection_condition(d.server.connection), cond_empty());
+}
+
+/* Open a link and transfer count unsettled deliveries to the server */
+static void transfer_unsettled(pn_test::driver_pair &d, pn_link_t *snd, pn_link_t *rcv, int count,
+                               std::vector<pn_delivery_t *> &sd, std::vector<pn_delivery_t *> &rd) {
+  pn_link_flow(rcv, count);
+  d.run();
+  for (int i = 0; i < count; ++i) {
+    std::string tag = std::to_string(i);
+    sd.push_back(pn_delivery(snd, pn_bytes(tag.size(), tag.data())));
+    CHECK(1 == pn_link_send(snd, "x", 1));
+    CHECK(pn_link_advance(snd));
+  }
+  while (d.run())
+    ;
+  for (int i = 0; i < count; ++i) {
+    rd.push_back(pn_link_current(rcv));
+    REQUIRE(rd.back());
+    CHECK(pn_link_advance(rcv));
+  }
+}
+
+/* Out of order settlement goes out as ranges */
+TEST_CASE("driver_disposition_coalesce") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+  pn_transport_t *t = d.server.transport;
+  d.run();
+  std::vector<pn_delivery_t *> sd, rd;
+  transfer_unsettled(d, client.link, server.link, 10, sd, rd);
+
+  SECTION("in one pass") {
+    uint64_t frames = pn_transport_get_frames_output(t);
+    for (int i = 0; i < 10; i += 2) pn_delivery_update(rd[i], PN_ACCEPTED);
+    for (int i = 9; i > 0; i -= 2) pn_delivery_update(rd[i], PN_ACCEPTED);
+    pn_delivery_update(rd[5], PN_RELEASED);  // splits the accepted range
+    d.run();
+    CHECK(frames + 3 == pn_transport_get_frames_output(t));
+    CHECK(7 == pn_transport_get_disposition_frames_saved(t));
+    for (int i = 0; i < 10; ++i) {
+      CHECK((i == 5 ? PN_RELEASED : PN_ACCEPTED) == pn_delivery_remote_state(sd[i]));
+    }
+  }
+
+  SECTION("with delay") {
+    pn_transport_set_disposition_delay(t, 100);
+    CHECK(100 == pn_transport_get_disposition_delay(t));
+    for (int i = 1; i < 10; i += 2) pn_delivery_settle(rd[i]);
+    d.run();
+    CHECK(1000 + 100 == pn_transport_tick(t, 1000));
+    for (int i = 0; i < 10; i += 2) pn_delivery_settle(rd[i]);
+    d.run();
+    for (int i = 0; i < 10; ++i) CHECK(!pn_delivery_settled(sd[i]));
+    CHECK(1000 + 100 == pn_transport_tick(t, 1050));
+    CHECK(0 == pn_transport_tick(t, 1100));
+    d.run();
+    for (int i = 0; i < 10; ++i) CHECK(pn_delivery_settled(sd[i]));
+    CHECK(9 == pn_transport_get_disposition_frames_saved(t));
+  }
+
+  SECTION("updated while held") {
+    pn_transport_set_disposition_delay(t, 100);
+    pn_delivery_update(rd[3], PN_ACCEPTED);
+    d.run();
+    pn_delivery_settle(rd[3]);
+    d.run();
+    CHECK(PN_ACCEPTED == pn_delivery_remote_state(sd[3]));
+    CHECK(!pn_delivery_settled(sd[3]));
+    pn_transport_tick(t, 1000);
+    pn_transport_tick(t, 1100);
+    d.run();
+    CHECK(pn_delivery_settled(sd[3]));
+  }
+
+  SECTION("held until close") {
+    pn_transport_set_disposition_delay(t, 100);
+    for (int i = 0; i < 10; ++i) pn_delivery_settle(rd[i]);
+    d.run();
+    CHECK(!pn_delivery_settled(sd[0]));
+    pn_connection_close(d.server.connection);
+    d.run();
+    for (int i = 0; i < 10; ++i) CHECK(pn_delivery_settled(sd[i]));
+  }
+
+  SECTION("batch limit") {
+    pn_transport_set_disposition_delay(t, 100);
+    pn_transport_set_disposition_batch(t, 4);
+    CHECK(4 == pn_transport_get_disposition_batch(t));
+    for (int i = 0; i < 10; ++i) pn_delivery_settle(rd[i]);
+    d.run();
+    for (int i = 0; i < 10; ++i) CHECK((i < 8) == pn_delivery_settled(sd[i]));
+    CHECK(6 == pn_transport_get_disposition_frames_saved(t));
+  }
+  CHECK_THAT(*pn_connection_condition(d.client.connection), cond_empty());
+  CHECK_THAT(*pn_connection_condition(d.server.connection), cond_empty());
+}
@@ -22,28 +22,113 @@
 #include "./pn_test.hpp"
 
 #include "core/data.h"
+#include "performatives.h"
+#include "protocol.h"
 
 #include <proton/codec.h>
 #include <proton/error.h>
 
 #include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <string>
 
 using namespace pn_test;
 
-// Make sure we can grow the capacity of a pn_data_t all the way to the max and
-// we stop there.
+// Node ids are 32 bits, so a pn_data_t grows well past the 65535 nodes that
+// 16 bit ids allowed, and its strings stay put as the buffer holding them grows.
 TEST_CASE("data_grow") {
+  const int entries = 100000;
   auto_free<pn_data_t, pn_data_free> data(pn_data(0));
-  int code = 0;
-  while (pn_data_size(data) < PNI_NID_MAX && !code) {
-    code = pn_data_put_int(data, 1);
+  REQUIRE(pn_data_put_map(data) == 0);
+  pn_data_enter(data);
+  char key[16];
+  for (int i = 0; i < entries; ++i) {
+    snprintf(key, sizeof(key), "key%d", i);
+    REQUIRE(pn_data_put_string(data, pn_bytes(strlen(key), key)) == 0);
+    REQUIRE(pn_data_put_long(data, i) == 0);
   }
-  CHECK_THAT(*pn_data_error(data), error_empty());
-  CHECK(pn_data_size(data) == PNI_NID_MAX);
-  code = pn_data_put_int(data, 1);
-  INFO(pn_code(code));
-  CHECK(code == PN_OUT_OF_MEMORY);
-  CHECK(pn_data_size(data) == PNI_NID_MAX);
+  pn_data_exit(data);
+  CHECK(pn_data_size(data) == 2 * entries + 1);
+  CHECK(sizeof(pni_node_t) <= 32);
+
+  pn_data_rewind(data);
+  REQUIRE(pn_data_next(data));
+  CHECK(pn_data_get_map(data) == 2 * entries);
+  ssize_t size = pn_data_encoded_size(data);
+  REQUIRE(size > 0);
+  std::string buf(size, '\0');
+  REQUIRE(pn_data_encode(data, &buf[0], buf.size()) == size);
+
+  auto_free<pn_data_t, pn_data_free> decoded(pn_data(0));
+  REQUIRE(pn_data_decode(decoded, buf.data(), buf.size()) == size);
+  pn_data_rewind(decoded);
+  REQUIRE(pn_data_next(decoded));
+  CHECK(pn_data_get_map(decoded) == 2 * entries);
+  pn_data_enter(decoded);
+  for (int i = 0; i < entries; ++i) {
+    snprintf(key, sizeof(key), "key%d", i);
+    REQUIRE(pn_data_next(decoded));
+    REQUIRE(pn_data_type(decoded) == PN_STRING);
+    pn_bytes_t got = pn_data_get_string(decoded);
+    CHECK(std::string(got.start, got.size) == key);
+    REQUIRE(pn_data_next(decoded));
+    CHECK(pn_data_get_long(decoded) == i);
+  }
+}
+
+// Values kept out of line survive being copied from the same data
+TEST_CASE("data_put_own_bytes") {
+  auto_free<pn_data_t, pn_data_free> data(pn_data(0));
+  std::string value(40, 'x');
+  pn_uuid_t uuid = {{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16}};
+  REQUIRE(pn_data_put_uuid(data, uuid) == 0);
+  REQUIRE(pn_data_put_binary(data, pn_bytes(value.size(), value.data())) == 0);
+  // The buffer has to grow, moving the bytes being copied
+  REQUIRE(pn_data_put_binary(data, pn_data_get_binary(data)) == 0);
+  pn_bytes_t got = pn_data_get_binary(data);
+  CHECK(std::string(got.start, got.size) == value);
+  pn_data_rewind(data);
+  REQUIRE(pn_data_next(data));
+  CHECK(memcmp(pn_data_get_uuid(data).bytes, uuid.bytes, 16) == 0);
+  pn_atom_t atom = pn_data_get_atom(data);
+  CHECK(atom.type == PN_UUID);
+  CHECK(memcmp(atom.u.as_uuid.bytes, uuid.bytes, 16) == 0);
+}
+
+TEST_CASE("data_decode_borrowed") {
+  auto_free<pn_data_t, pn_data_free> data(pn_data(0));
+  pn_data_fill(data, "DL[SzI]", (uint64_t) 0x12, "address", (size_t) 4, "body", 7);
+  char encoded[64];
+  ssize_t size = pn_data_encode(data, encoded, sizeof(encoded));
+  REQUIRE(size > 0);
+
+  auto_free<pn_data_t, pn_data_free> decoded(pn_data(0));
+  std::string input(encoded, size);
+  REQUIRE(pn_data_decode_borrowed(decoded, input.data(), input.size()) == size);
+  pn_bytes_t address, body;
+  REQUIRE(pn_data_scan(decoded, "D.[Sz]", &address, &body) == 0);
+  CHECK(std::string(address.start, address.size) == "address");
+  // Points into the input rather than a copy
+  CHECK(address.start >= input.data());
+  CHECK(address.start < input.data() + input.size());
+
+  // Decoding from other bytes interns what was borrowed before
+  std::string second(encoded, size);
+  REQUIRE(pn_data_decode_borrowed(decoded, second.data(), second.size()) == size);
+  input.assign(input.size(), '\0');
+  pn_data_rewind(decoded);
+  REQUIRE(pn_data_scan(decoded, "D.[Sz]", &address, &body) == 0);
+  CHECK(std::string(address.start, address.size) == "address");
+  CHECK(std::string(body.start, body.size) == "body");
+
+  REQUIRE(pn_data_intern(decoded) == 0);
+  second.assign(second.size(), '\0');
+  char reencoded[128];
+  ssize_t resize = pn_data_encode(decoded, reencoded, sizeof(reencoded));
+  REQUIRE(resize == 2 * size);
+  CHECK(std::string(reencoded, size) == std::string(encoded, size));
+  CHECK(std::string(reencoded + size, size) == std::string(encoded, size));
 }
 
 TEST_CASE("data_multiple") {
@@ -156,3 +241,127 @@ TEST_CASE("array_list") {
 	// only empty lists
 	check_array("@T[[][][][][]]", PN_LIST);
 }
+
+// The direct performative decoders must agree with pn_data_t on the encoding
+// pn_data_encode produces.
+TEST_CASE("data_decode_performative") {
+  auto_free<pn_data_t, pn_data_free> data(pn_data(0));
+  pn_data_fill(data, "DL[IIzInoBDL[I]o]", TRANSFER, 1, 300, (size_t)3, "tag", 0,
+               true, 1, RECEIVED, 5, false);
+  char buf[256];
+  ssize_t size = pn_data_encode(data, buf, sizeof(buf));
+  REQUIRE(size > 0);
+  memcpy(buf + size, "payload", 7);
+
+  pni_consumer_t consumer = make_consumer_from_bytes(pn_bytes(size + 7, buf));
+  uint64_t code;
+  REQUIRE(pni_consumer_read_descriptor(&consumer, &code));
+  CHECK(TRANSFER == code);
+  pni_amqp_transfer_t transfer;
+  REQUIRE(pni_amqp_decode_transfer(&consumer, &transfer));
+  CHECK(size == (ssize_t)consumer.position);
+  CHECK(transfer.handle_present);
+  CHECK(1 == transfer.handle);
+  CHECK(transfer.delivery_id_present);
+  CHECK(300 == transfer.delivery_id);
+  CHECK("tag" == std::string(transfer.delivery_tag.start, transfer.delivery_tag.size));
+  CHECK(transfer.message_format_present);
+  CHECK(0 == transfer.message_format);
+  CHECK(!transfer.settled_present);
+  CHECK(transfer.more);
+  CHECK(1 == transfer.rcv_settle_mode);
+  CHECK(transfer.state_present);
+  CHECK(!transfer.resume);
+  CHECK(transfer.resume_present);
+  CHECK(!transfer.aborted_present);
+
+  /* The state is left encoded */
+  auto_free<pn_data_t, pn_data_free> state(pn_data(0));
+  CHECK((ssize_t)transfer.state.size ==
+        pn_data_decode(state, transfer.state.start, transfer.state.size));
+  CHECK("@received(35) [section-number=5]" == inspect(state));
+
+  /* Mistyped fields are absent, as with pn_data_scan */
+  pn_data_clear(data);
+  pn_data_fill(data, "DL[SIo]", FLOW, "x", 10, true);
+  size = pn_data_encode(data, buf, sizeof(buf));
+  REQUIRE(size > 0);
+  consumer = make_consumer_from_bytes(pn_bytes(size, buf));
+  REQUIRE(pni_consumer_read_descriptor(&consumer, &code));
+  CHECK(FLOW == code);
+  pni_amqp_flow_t flow;
+  REQUIRE(pni_amqp_decode_flow(&consumer, &flow));
+  CHECK(!flow.next_incoming_id_present);
+  CHECK(10 == flow.incoming_window);
+  CHECK(!flow.next_outgoing_id_present);
+
+  /* Truncated input is an error */
+  consumer = make_consumer_from_bytes(pn_bytes(size - 1, buf));
+  REQUIRE(pni_consumer_read_descriptor(&consumer, &code));
+  CHECK(!pni_amqp_decode_flow(&consumer, &flow));
+}
+
+// The direct performative encoders must produce exactly what pn_data_encode
+// does for the same performative.
+TEST_CASE("data_encode_performative") {
+  auto_free<pn_data_t, pn_data_free> data(pn_data(0));
+  char expect[256];
+  char buf[256];
+
+  pn_data_fill(data, "DL[IIzI?o?on?DL[]?o?o?o]", TRANSFER, 1, 300, (size_t)3, "tag",
+               0, true, true, false, false, true, ACCEPTED, false, false, true,
+               true, false, false);
+  ssize_t size = pn_data_encode(data, expect, sizeof(expect));
+  REQUIRE(size > 0);
+  const char state[] = {0x00, 0x53, 0x24, 0x45};
+  pni_amqp_transfer_t transfer;
+  memset(&transfer, 0, sizeof(transfer));
+  transfer.handle = 1;
+  transfer.handle_present = true;
+  transfer.delivery_id = 300;
+  transfer.delivery_id_present = true;
+  transfer.delivery_tag = pn_bytes(3, "tag");
+  transfer.delivery_tag_present = true;
+  transfer.message_format_present = true;
+  transfer.settled = transfer.settled_present = true;
+  transfer.state = pn_bytes(sizeof(state), state);
+  transfer.state_present = true;
+  transfer.aborted = transfer.aborted_present = true;
+  /* Too small: nothing written, size still returned */
+  CHECK((size_t)size == pni_amqp_encode_transfer(pn_rwbytes(size - 1, buf), &transfer));
+  CHECK((size_t)size == pni_amqp_encode_transfer(pn_rwbytes(sizeof(buf), buf), &transfer));
+  CHECK(std::string(expect, size) == std::string(buf, size));
+
+  /* Trailing absent fields are dropped */
+  pn_data_clear(data);
+  pn_data_fill(data, "DL[?IIII?I?I?In?o]", FLOW, false, 0, 2048, 70000, 2048,
+               true, 0, true, 5, true, 100, true, false);
+  size = pn_data_encode(data, expect, sizeof(expect));
+  REQUIRE(size > 0);
+  pni_amqp_flow_t flow;
+  memset(&flow, 0, sizeof(flow));
+  flow.incoming_window = 2048;
+  flow.next_outgoing_id = 70000;
+  flow.outgoing_window = 2048;
+  flow.handle = 0;
+  flow.delivery_count = 5;
+  flow.link_credit = 100;
+  flow.incoming_window_present = flow.next_outgoing_id_present = true;
+  flow.outgoing_window_present = flow.handle_present = true;
+  flow.delivery_count_present = flow.link_credit_present = flow.drain_present = true;
+  CHECK((size_t)size == pni_amqp_encode_flow(pn_rwbytes(sizeof(buf), buf), &flow));
+  CHECK(std::string(expect, size) == std::string(buf, size));
+
+  pn_data_clear(data);
+  pn_data_fill(data, "DL[oI?I?o?DL[]]", DISPOSITION, true, 7, false, 0, false,
+               false, false, 0);
+  size = pn_data_encode(data, expect, sizeof(expect));
+  REQUIRE(size > 0);
+  pni_amqp_disposition_t disposition;
+  memset(&disposition, 0, sizeof(disposition));
+  disposition.role = disposition.role_present = true;
+  disposition.first = 7;
+  disposition.first_present = true;
+  CHECK((size_t)size == pni_amqp_encode_disposition(pn_rwbytes(sizeof(buf), buf), &disposition));
+  CHECK(std::string(expect, size) == std::string(buf, size));
+}
@@ -21,6 +21,7 @@
 
 #include "./pn_test.hpp"
 
+#include <proton/error.h>
 #include <proton/event.h>
 #include <proton/object.h>
 
@@ -103,3 +104,37 @@ TEST_CASE("event_incref") {
   test_event_incref(true);
   test_event_incref(false);
 }
+
+TEST_CASE("event_collector_ring") {
+  pn_collector_t *collector = pn_collector();
+  REQUIRE(pn_collector_ring(collector, 2) == 0);
+  REQUIRE(pn_collector_ring(collector, 2) == PN_STATE_ERR);
+  void *obj = pn_class_new(PN_OBJECT, 0);
+  void *obj2 = pn_class_new(PN_OBJECT, 0);
+  // Contexts are pinned once for the batch, however many events they have
+  pn_event_t *e1 = pn_collector_put(collector, PN_OBJECT, obj, PN_LINK_FLOW);
+  pn_event_t *e2 = pn_collector_put(collector, PN_OBJECT, obj, PN_DELIVERY);
+  pn_event_t *e3 = pn_collector_put(collector, PN_OBJECT, obj2, PN_DELIVERY);
+  CHECK(pn_refcount(obj) == 2);
+  CHECK(pn_refcount(obj2) == 2);
+  // The ring grew past its capacity without disturbing queued events
+  CHECK(pn_collector_next(collector) == e1);
+  CHECK(pn_event_context(e1) == obj);
+  CHECK(pn_collector_next(collector) == e2);
+  CHECK(pn_event_type(e2) == PN_DELIVERY);
+  CHECK(pn_collector_next(collector) == e3);
+  CHECK(pn_event_context(e3) == obj2);
+  CHECK(pn_refcount(obj) == 2);
+  CHECK(!pn_collector_next(collector));
+  CHECK(pn_refcount(obj) == 1);
+  CHECK(pn_refcount(obj2) == 1);
+  // Attachments are only allocated when asked for
+  CHECK(pn_collector_put(collector, PN_OBJECT, obj, PN_LINK_FLOW));
+  pn_record_t *r = pn_event_attachments(pn_collector_peek(collector));
+  REQUIRE(r);
+  CHECK(pn_collector_pop(collector));
+  CHECK(pn_refcount(obj) == 1);
+  pn_decref(obj);
+  pn_decref(obj2);
+  pn_free(collector);
+}
@@ -24,6 +24,11 @@
 #include <proton/error.h>
 #include <proton/message.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
 
 using namespace pn_test;
 
@@ -82,3 +87,131 @@ TEST_CASE("message_inferred") {
   pn_message_free(src);
   pn_message_free(dst);
 }
+
+TEST_CASE("message_encoded_size") {
+  pn_message_t *m = pn_message();
+  pn_message_set_address(m, "queue");
+  pn_message_set_subject(m, "subject");
+  std::string body(1000, 'x');
+  pn_data_put_binary(pn_message_body(m), pn_bytes(body.size(), body.data()));
+
+  ssize_t size = pn_message_encoded_size(m);
+  REQUIRE(size > 1000);
+
+  /* An exactly sized buffer is enough, one byte less overflows */
+  std::vector<char> buf(size);
+  size_t len = size - 1;
+  CHECK(PN_OVERFLOW == pn_message_encode(m, &buf[0], &len));
+  len = size;
+  CHECK(0 == pn_message_encode(m, &buf[0], &len));
+  CHECK(size_t(size) == len);
+
+  /* encode2 grows a short buffer straight to the needed size */
+  pn_rwbytes_t rw = {0};
+  rw.start = (char*)malloc(16);
+  rw.size = 16;
+  CHECK(size == pn_message_encode2(m, &rw));
+  CHECK(rw.size == size_t(size));
+  CHECK(0 == memcmp(rw.start, &buf[0], size));
+
+  /* An adequate buffer is reused as is */
+  char *start = rw.start;
+  CHECK(size == pn_message_encode2(m, &rw));
+  CHECK(start == rw.start);
+  free(rw.start);
+
+  pn_message_free(m);
+}
+
+static std::string str(pn_bytes_t b) { return std::string(b.start, b.size); }
+
+TEST_CASE("message_view") {
+  pn_message_t *m = pn_message();
+  pn_message_set_durable(m, true);
+  pn_message_set_priority(m, 7);
+  pn_message_set_ttl(m, 1000);
+  pn_message_set_delivery_count(m, 3);
+  pn_atom_t id;
+  id.type = PN_ULONG;
+  id.u.as_ulong = 42;
+  pn_message_set_id(m, id);
+  pn_message_set_address(m, "queue");
+  pn_message_set_reply_to(m, "reply");
+  pn_message_set_content_type(m, "text/plain");
+  pn_message_set_creation_time(m, 12345);
+  pn_message_set_group_sequence(m, 9);
+  pn_data_t *props = pn_message_properties(m);
+  pn_data_put_map(props);
+  pn_data_enter(props);
+  pn_data_put_string(props, pn_bytes("colour"));
+  pn_data_put_string(props, pn_bytes("red"));
+  pn_data_put_string(props, pn_bytes("size"));
+  pn_data_put_int(props, 10);
+  pn_data_exit(props);
+  pn_data_put_string(pn_message_body(m), pn_bytes("hello"));
+
+  pn_rwbytes_t buf = {0};
+  ssize_t size = pn_message_encode2(m, &buf);
+  REQUIRE(size > 0);
+
+  pn_message_view_t *view = pn_message_view();
+  REQUIRE(0 == pn_message_view_decode(view, buf.start, size));
+  CHECK(pn_message_view_bytes(view).start == buf.start);
+  CHECK(size_t(size) == pn_message_view_bytes(view).size);
+
+  CHECK(pn_message_view_is_durable(view));
+  CHECK(7 == pn_message_view_get_priority(view));
+  CHECK(1000 == pn_message_view_get_ttl(view));
+  CHECK(!pn_message_view_is_first_acquirer(view));
+  CHECK(3 == pn_message_view_get_delivery_count(view));
+  CHECK(PN_ULONG == pn_message_view_get_id(view).type);
+  CHECK(42 == pn_message_view_get_id(view).u.as_ulong);
+  CHECK(PN_NULL == pn_message_view_get_correlation_id(view).type);
+  CHECK("queue" == str(pn_message_view_get_address(view)));
+  CHECK("reply" == str(pn_message_view_get_reply_to(view)));
+  CHECK("text/plain" == str(pn_message_view_get_content_type(view)));
+  CHECK(0 == pn_message_view_get_subject(view).size);
+  CHECK(12345 == pn_message_view_get_creation_time(view));
+  CHECK(0 == pn_message_view_get_expiry_time(view));
+  CHECK(9 == pn_message_view_get_group_sequence(view));
+
+  /* Property values are returned encoded */
+  pn_bytes_t colour = pn_message_view_property(view, pn_bytes("colour"));
+  REQUIRE(colour.size);
+  pn_data_t *value = pn_data(0);
+  REQUIRE(ssize_t(colour.size) == pn_data_decode(value, colour.start, colour.size));
+  pn_data_next(value);
+  CHECK("red" == str(pn_data_get_string(value)));
+  pn_data_free(value);
+  CHECK(pn_message_view_property(view, pn_bytes("size")).size);
+  CHECK(!pn_message_view_property(view, pn_bytes("weight")).size);
+  CHECK(!pn_message_view_annotations(view).size);
+
+  /* Body sections decode the same as the full message */
+  pn_bytes_t body = pn_message_view_body(view);
+  REQUIRE(body.size);
+  pn_message_t *m2 = pn_message();
+  REQUIRE(0 == pn_message_decode(m2, body.start, body.size));
+  pn_data_t *body2 = pn_message_body(m2);
+  pn_data_rewind(body2);
+  pn_data_next(body2);
+  CHECK("hello" == str(pn_data_get_string(body2)));
+  pn_message_free(m2);
+
+  /* Defaults when sections are absent */
+  pn_message_clear(m);
+  size = pn_message_encode2(m, &buf);
+  REQUIRE(size > 0);
+  REQUIRE(0 == pn_message_view_decode(view, buf.start, size));
+  CHECK(!pn_message_view_is_durable(view));
+  CHECK(4 == pn_message_view_get_priority(view));
+  CHECK(0 == pn_message_view_get_address(view).size);
+
+  /* Truncated sections are rejected */
+  CHECK(PN_ARG_ERR == pn_message_view_decode(view, buf.start, size - 1));
+  CHECK(0 == pn_message_view_bytes(view).size);
+
+  pn_message_view_free(view);
+  free(buf.start);
+  pn_message_free(m);
+}
@@ -21,12 +21,16 @@
 
 #include "./pn_test.hpp"
 
+#include <proton/allocator.h>
 #include <proton/object.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <vector>
+
 using Catch::Matchers::Equals;
 
 static char mem;
@@ -967,3 +971,55 @@ TEST_CASE("list_heap") {
 
   pn_free(list);
 }
+
+TEST_CASE("slab_allocator") {
+  const pn_allocator_t *a = pn_slab_allocator();
+  static const size_t sizes[] = {0, 1, 16, 100, 1000, 4000, 5000, 100000};
+  const size_t n = sizeof(sizes) / sizeof(sizes[0]);
+
+  /* Blocks of every size are usable and distinct */
+  char *blocks[n];
+  for (size_t i = 0; i < n; ++i) {
+    blocks[i] = (char *)a->allocate(a->context, sizes[i]);
+    REQUIRE(blocks[i]);
+    CHECK(0 == (uintptr_t)blocks[i] % sizeof(void *));
+    memset(blocks[i], (int)i, sizes[i]);
+  }
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < sizes[i]; ++j) {
+      if (blocks[i][j] != (char)i) FAIL("block " << i << " overwritten");
+    }
+  }
+
+  /* Reallocating keeps the content across classes and into large blocks */
+  char *b = (char *)a->reallocate(a->context, NULL, 10);
+  REQUIRE(b);
+  memcpy(b, "0123456789", 10);
+  size_t size = 10;
+  while (size < 200000) {
+    size *= 3;
+    b = (char *)a->reallocate(a->context, b, size);
+    REQUIRE(b);
+    CHECK(0 == memcmp(b, "0123456789", 10));
+  }
+  b = (char *)a->reallocate(a->context, b, 20);
+  REQUIRE(b);
+  CHECK(0 == memcmp(b, "0123456789", 10));
+  a->deallocate(a->context, b);
+
+  for (size_t i = 0; i < n; ++i) a->deallocate(a->context, blocks[i]);
+  a->deallocate(a->context, NULL);
+
+  /* Freed blocks are reused, including past the per-thread cache limit */
+  std::vector<void *> many(20000);
+  for (int round = 0; round < 2; ++round) {
+    for (size_t i = 0; i < many.size(); ++i) {
+      many[i] = a->allocate(a->context, 40);
+      if (!many[i]) FAIL("allocation " << i << " failed");
+    }
+    for (size_t i = 0; i < many.size(); ++i) a->deallocate(a->context, many[i]);
+  }
+  void *p = a->allocate(a->context, 40);
+  CHECK(p == many.back());
+  a->deallocate(a->context, p);
+}
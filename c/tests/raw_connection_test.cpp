@@ -220,6 +220,46 @@ namespace {
   }
 #endif
 
+  // Vectored transfers built on the single buffer ones, stopping at the first short transfer
+  long rcvv(int fd, const pn_rwbytes_t* b, size_t n) {
+    long total = 0;
+    for (size_t i = 0; i < n; ++i) {
+      long r = rcv(fd, b[i].start, b[i].size);
+      if (r < 0) return total ? total : r;
+      total += r;
+      if (r < (long) b[i].size) break;
+    }
+    return total;
+  }
+
+  long sndv(int fd, const pn_bytes_t* b, size_t n, bool* zerocopy) {
+    *zerocopy = false;
+    long total = 0;
+    for (size_t i = 0; i < n; ++i) {
+      long r = snd(fd, b[i].start, b[i].size);
+      if (r < 0) return total ? total : r;
+      total += r;
+      if (r < (long) b[i].size) break;
+    }
+    return total;
+  }
+
+  // Pretends the kernel accepted a zero copy send
+  long sndv_zerocopy(int fd, const pn_bytes_t* b, size_t n, bool* zerocopy) {
+    bool requested = *zerocopy;
+    long r = sndv(fd, b, n, zerocopy);
+    *zerocopy = requested;
+    return r;
+  }
+
+  bool has_event(pn_raw_connection_t* p, pn_event_type_t type) {
+    bool found = false;
+    for (pn_event_t* e = pni_raw_event_next(p); e; e = pni_raw_event_next(p)) {
+      if (pn_event_type(e) == type) found = true;
+    }
+    return found;
+  }
+
   // Block of memory for buffers
   const size_t BUFFMEMSIZE = 8*1024;
   const size_t RBUFFCOUNT = 32;
@@ -833,3 +873,601 @@ TEST_CASE("raw connection") {
     }
   }
 }
+
+TEST_CASE("raw connection vectored") {
+  auto_free<pn_raw_connection_t, free_raw_connection> p(mk_raw_connection());
+  max_send_size = 0;
+  max_recv_size = 0;
+
+  BufferAllocator rb(rbuffer_memory, sizeof(rbuffer_memory));
+  BufferAllocator wb(message, sizeof(message));
+  rb.split_buffers(rbuffs);
+  wb.split_buffers(wbuffs);
+
+  size_t rtaken = pn_raw_connection_give_read_buffers(p, rbuffs, RBUFFCOUNT);
+  size_t wtaken = pn_raw_connection_write_buffers(p, wbuffs, WBUFFCOUNT);
+  REQUIRE(pni_raw_validate(p));
+  REQUIRE(rtaken > 1);
+  REQUIRE(wtaken > 1);
+
+  int fds[2];
+  REQUIRE(makepair(fds) == 0);
+  pni_raw_connected(p);
+  REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_CONNECTED);
+  REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_EVENT_NONE);
+
+  std::vector<pn_raw_buffer_t> read(rtaken);
+  std::vector<pn_raw_buffer_t> written(wtaken);
+  size_t wbytes = 0;
+  for (size_t i = 0; i < wtaken; ++i) wbytes += wbuffs[i].size;
+
+  SECTION("Write then read every buffer") {
+    pni_raw_writev(p, fds[0], sndv, set_write_error);
+    CHECK(write_err == 0);
+    REQUIRE(pni_raw_validate(p));
+    REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_WRITTEN);
+    CHECK(pn_raw_connection_take_written_buffers(p, &written[0], written.size()) == wtaken);
+
+    pni_raw_readv(p, fds[1], rcvv, set_read_error);
+    CHECK(read_err == 0);
+    REQUIRE(pni_raw_validate(p));
+    REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_READ);
+    size_t rgiven = pn_raw_connection_take_read_buffers(p, &read[0], read.size());
+    REQUIRE(pni_raw_validate(p));
+    CHECK(rgiven > 1);
+
+    std::string received;
+    for (size_t i = 0; i < rgiven; ++i) received.append(read[i].bytes, read[i].size);
+    CHECK(received == std::string(message, wbytes));
+  }
+
+  SECTION("Zero copy writes are held until complete") {
+    static_cast<pn_raw_connection_t*>(p)->zerocopy_threshold = 1;
+
+    pni_raw_writev(p, fds[0], sndv_zerocopy, set_write_error);
+    CHECK(write_err == 0);
+    REQUIRE(pni_raw_validate(p));
+    CHECK(pni_raw_zerocopy_pending(p));
+    CHECK_FALSE(has_event(p, PN_RAW_CONNECTION_WRITTEN));
+    CHECK(pn_raw_connection_take_written_buffers(p, &written[0], written.size()) == 0);
+
+    pni_raw_zerocopy_done(p, 0, 0);
+    REQUIRE(pni_raw_validate(p));
+    CHECK_FALSE(pni_raw_zerocopy_pending(p));
+    CHECK(has_event(p, PN_RAW_CONNECTION_WRITTEN));
+    CHECK(pn_raw_connection_take_written_buffers(p, &written[0], written.size()) == wtaken);
+  }
+
+  freepair(fds);
+}
+
+namespace {
+  // Stands in for the pipe between two relayed connections
+  std::string relayed;
+  int relay_errno = 0;
+
+  long relay_from(pn_raw_connection_t*, int fd) {
+    if (relay_errno) {errno = relay_errno; return -1;}
+    char b[256];
+    long r = rcv(fd, b, sizeof(b));
+    if (r > 0) relayed.append(b, r);
+    return r;
+  }
+
+  long relay_to(pn_raw_connection_t*, int fd) {
+    if (relayed.empty()) return 0;
+    long r = snd(fd, relayed.data(), relayed.size());
+    if (r > 0) relayed.erase(0, r);
+    return r;
+  }
+}
+
+TEST_CASE("raw connection relayed") {
+  auto_free<pn_raw_connection_t, free_raw_connection> p(mk_raw_connection());
+  max_send_size = 0;
+  max_recv_size = 0;
+  relayed.clear();
+  relay_errno = 0;
+
+  BufferAllocator rb(rbuffer_memory, sizeof(rbuffer_memory));
+  rb.split_buffers(rbuffs);
+  size_t rtaken = pn_raw_connection_give_read_buffers(p, rbuffs, RBUFFCOUNT);
+  REQUIRE(rtaken > 0);
+
+  int fds[2];
+  REQUIRE(makepair(fds) == 0);
+  pni_raw_connected(p);
+  REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_CONNECTED);
+  REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_NEED_WRITE_BUFFERS);
+  REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_EVENT_NONE);
+
+  // Unfilled read buffers come back empty and no more buffers are taken
+  pni_raw_relay_start(p);
+  REQUIRE(pni_raw_validate(p));
+  REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_READ);
+  std::vector<pn_raw_buffer_t> read(rtaken);
+  CHECK(pn_raw_connection_take_read_buffers(p, &read[0], read.size()) == rtaken);
+  CHECK(read[0].size == 0);
+  CHECK(pn_raw_connection_give_read_buffers(p, rbuffs, RBUFFCOUNT) == 0);
+  CHECK(pn_raw_connection_write_buffers(p, wbuffs, WBUFFCOUNT) == 0);
+  CHECK(pni_raw_can_relay_read(p));
+  CHECK(pni_raw_can_relay_write(p));
+  REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_EVENT_NONE);
+
+  SECTION("Relay both ways") {
+    std::string in(message, 100);
+    REQUIRE(snd(fds[1], in.data(), in.size()) == (long) in.size());
+    pni_raw_relay_read(p, fds[0], relay_from, set_read_error);
+    REQUIRE(pni_raw_validate(p));
+    CHECK(relayed == in);
+    REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_READ);
+    REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_EVENT_NONE);
+
+    pni_raw_relay_write(p, fds[0], relay_to, set_write_error);
+    REQUIRE(pni_raw_validate(p));
+    CHECK(relayed.empty());
+    REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_WRITTEN);
+    REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_EVENT_NONE);
+    char b[256];
+    CHECK(rcv(fds[1], b, sizeof(b)) == (long) in.size());
+    CHECK(std::string(b, in.size()) == in);
+
+    // Nothing to relay
+    pni_raw_relay_write(p, fds[0], relay_to, set_write_error);
+    REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_EVENT_NONE);
+  }
+
+  SECTION("End of stream closes for read") {
+    snd_stop(fds[1]);
+    pni_raw_relay_read(p, fds[0], relay_from, set_read_error);
+    REQUIRE(pni_raw_validate(p));
+    CHECK(pn_raw_connection_is_read_closed(p));
+    CHECK_FALSE(pni_raw_can_relay_read(p));
+    REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_CLOSED_READ);
+    REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_EVENT_NONE);
+
+    pni_raw_write_close(p);
+    REQUIRE(pni_raw_validate(p));
+    CHECK_FALSE(pni_raw_can_relay_write(p));
+    REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_CLOSED_WRITE);
+    REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_DISCONNECTED);
+  }
+
+  SECTION("Errors close the connection") {
+    relay_errno = EPIPE;
+    read_err = 0;
+    pni_raw_relay_read(p, fds[0], relay_from, set_read_error);
+    REQUIRE(pni_raw_validate(p));
+    CHECK(read_err == EPIPE);
+    CHECK(pn_raw_connection_is_read_closed(p));
+    CHECK(pn_raw_connection_is_write_closed(p));
+    REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_CLOSED_READ);
+    REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_CLOSED_WRITE);
+    REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_DISCONNECTED);
+  }
+
+  freepair(fds);
+}
+
+TEST_CASE("raw connection buffer slots") {
+  auto_free<pn_raw_connection_t, free_raw_connection> p(mk_raw_connection());
+  max_send_size = 0;
+  max_recv_size = 0;
+
+  CHECK(pn_raw_connection_read_buffers_capacity(p) == read_buffer_count);
+  CHECK(pn_raw_connection_write_buffers_capacity(p) == write_buffer_count);
+  CHECK(pn_raw_connection_set_buffer_slots(p, 0, 1) == PN_ARG_ERR);
+  CHECK(pn_raw_connection_set_buffer_slots(p, 1, raw_buffer_slots_max+1) == PN_ARG_ERR);
+
+  // More buffers than one vectored read takes
+  const size_t slots = raw_iov_count*2 + 3;
+  REQUIRE(pn_raw_connection_set_buffer_slots(p, slots, 2) == 0);
+  REQUIRE(pni_raw_validate(p));
+  CHECK(pn_raw_connection_read_buffers_capacity(p) == slots);
+  CHECK(pn_raw_connection_write_buffers_capacity(p) == 2);
+
+  std::vector<pn_raw_buffer_t> rbs(slots);
+  const size_t rbsize = 4;
+  for (size_t i = 0; i < slots; ++i) {
+    rbs[i] = pn_raw_buffer_t();
+    rbs[i].bytes = rbuffer_memory + i*rbsize;
+    rbs[i].capacity = rbsize;
+  }
+  CHECK(pn_raw_connection_give_read_buffers(p, &rbs[0], slots) == slots);
+  CHECK(pn_raw_connection_set_buffer_slots(p, 4, 4) == PN_STATE_ERR);
+
+  int fds[2];
+  REQUIRE(makepair(fds) == 0);
+  pni_raw_connected(p);
+  CHECK(pn_raw_connection_set_buffer_slots(p, 4, 4) == PN_STATE_ERR);
+
+  size_t wsize = slots*rbsize - 2;
+  REQUIRE(snd(fds[1], message, wsize) == (long) wsize);
+  pni_raw_readv(p, fds[0], rcvv, set_read_error);
+  CHECK(read_err == 0);
+  REQUIRE(pni_raw_validate(p));
+  std::vector<pn_raw_buffer_t> read(slots);
+  size_t rgiven = pn_raw_connection_take_read_buffers(p, &read[0], read.size());
+  REQUIRE(rgiven == slots);
+  std::string received;
+  for (size_t i = 0; i < rgiven; ++i) received.append(read[i].bytes+read[i].offset, read[i].size);
+  CHECK(received == std::string(message, wsize));
+
+  freepair(fds);
+}
+
+TEST_CASE("raw connection pooled reads") {
+  auto_free<pn_raw_connection_t, free_raw_connection> p(mk_raw_connection());
+  max_send_size = 0;
+  max_recv_size = 0;
+  static_cast<pn_raw_connection_t*>(p)->rpooled = true;
+
+  BufferAllocator rb(rbuffer_memory, sizeof(rbuffer_memory));
+  rb.split_buffers(rbuffs);
+  for (size_t i = 0; i < RBUFFCOUNT; ++i) rbuffs[i].size = 0;
+
+  int fds[2];
+  REQUIRE(makepair(fds) == 0);
+  pni_raw_connected(p);
+  // Ready to read without being given buffers and never asks for them
+  CHECK(pni_raw_can_read(p));
+  CHECK(pn_raw_connection_give_read_buffers(p, rbuffs, RBUFFCOUNT) == 0);
+  REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_CONNECTED);
+  REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_NEED_WRITE_BUFFERS);
+  REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_EVENT_NONE);
+
+  // The proactor gives buffers for one read and takes back the ones left unused
+  REQUIRE(snd(fds[1], message, 100) == 100);
+  size_t given = pni_raw_give_read_buffers(p, rbuffs, 4);
+  REQUIRE(given == 4);
+  pni_raw_readv(p, fds[0], rcvv, set_read_error);
+  REQUIRE(pni_raw_validate(p));
+  pn_raw_buffer_t unused[4];
+  CHECK(pni_raw_take_unused_read_buffers(p, unused, 4) == 3);
+  REQUIRE(pni_raw_validate(p));
+  CHECK(unused[0].bytes == rbuffs[1].bytes);
+  CHECK(unused[0].size == 0);
+  CHECK(pn_raw_connection_read_buffers_capacity(p) == read_buffer_count-1);
+
+  REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_RAW_CONNECTION_READ);
+  REQUIRE(pn_event_type(pni_raw_event_next(p)) == PN_EVENT_NONE);
+  pn_raw_buffer_t read[4];
+  REQUIRE(pn_raw_connection_take_read_buffers(p, read, 4) == 1);
+  CHECK(std::string(read[0].bytes, read[0].size) == std::string(message, 100));
+  CHECK(pn_raw_connection_read_buffers_capacity(p) == read_buffer_count);
+
+  freepair(fds);
+}
+
+#ifdef __linux__
+#include <proton/listener.h>
+#include <proton/netaddr.h>
+#include <proton/proactor.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Raw connections run by a proactor, with the test at the far end of loopback sockets
+
+namespace {
+  // A proactor run by its own thread that accepts every connection to its
+  // listener as a raw connection. on_event is called for each event with lock held.
+  struct raw_proactor {
+    pn_proactor_t *proactor;
+    pn_listener_t *listener;
+    std::function<void(pn_raw_connection_t*)> on_accept;
+    std::function<void(pn_event_t*)> on_event;
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<pn_raw_connection_t*> accepted;
+    int port = 0;
+    int connected = 0;
+    int disconnected = 0;
+    std::thread thread;
+
+    raw_proactor() : proactor(pn_proactor()), listener(pn_listener()) {}
+
+    ~raw_proactor() {
+      if (thread.joinable()) {
+        pn_proactor_interrupt(proactor);
+        thread.join();
+      }
+      pn_proactor_free(proactor);
+    }
+
+    void start() {
+      pn_proactor_listen(proactor, listener, "127.0.0.1:0", 16);
+      thread = std::thread([this]() { run(); });
+    }
+
+    void run() {
+      bool interrupted = false;
+      while (!interrupted) {
+        pn_event_batch_t *batch = pn_proactor_wait(proactor);
+        pn_event_t *e;
+        while ((e = pn_event_batch_next(batch))) {
+          std::lock_guard<std::mutex> g(lock);
+          switch (pn_event_type(e)) {
+           case PN_PROACTOR_INTERRUPT:
+            interrupted = true;
+            break;
+           case PN_LISTENER_OPEN: {
+            char p[PN_MAX_ADDR];
+            pn_netaddr_host_port(pn_listener_addr(listener), NULL, 0, p, sizeof(p));
+            port = atoi(p);
+            break;
+           }
+           case PN_LISTENER_ACCEPT: {
+            pn_raw_connection_t *rc = pn_raw_connection();
+            if (on_accept) on_accept(rc);
+            pn_listener_raw_accept(listener, rc);
+            accepted.push_back(rc);
+            break;
+           }
+           case PN_RAW_CONNECTION_CONNECTED:
+            ++connected;
+            break;
+           case PN_RAW_CONNECTION_DISCONNECTED:
+            ++disconnected;
+            break;
+           default:
+            break;
+          }
+          if (on_event) on_event(e);
+          changed.notify_all();
+        }
+        pn_proactor_done(proactor, batch);
+      }
+    }
+
+    template <class P> bool wait_for_ms(int ms, P predicate) {
+      std::unique_lock<std::mutex> l(lock);
+      return changed.wait_for(l, std::chrono::milliseconds(ms), predicate);
+    }
+
+    template <class P> bool wait_for(P predicate) { return wait_for_ms(10000, predicate); }
+
+    // Connect a non-blocking socket and wait for its raw connection
+    int connect() {
+      if (!wait_for([this]() { return port != 0; })) return -1;
+      size_t n = accepted.size() + 1;
+      int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+      struct sockaddr_in addr = {};
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      addr.sin_port = htons(port);
+      if (fd < 0 || ::connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) return -1;
+      ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+      if (!wait_for([this, n]() { return accepted.size() == n && connected == (int) n; })) return -1;
+      return fd;
+    }
+  };
+
+  std::string pattern(size_t size, int seed) {
+    std::string s(size, '\0');
+    for (size_t i = 0; i < size; ++i) s[i] = (char) (i * 7 + i / 251 + seed);
+    return s;
+  }
+
+  // Send out on from and receive on to till in has as many bytes, in both
+  // directions at once. False if neither side makes progress for a while.
+  bool exchange(int fds[2], const std::string out[2], std::string in[2]) {
+    size_t sent[2] = {0, 0};
+    while (in[0].size() < out[1].size() || in[1].size() < out[0].size()) {
+      struct pollfd pfds[2];
+      for (int i = 0; i < 2; ++i) {
+        pfds[i].fd = fds[i];
+        pfds[i].events = POLLIN | (sent[i] < out[i].size() ? POLLOUT : 0);
+        pfds[i].revents = 0;
+      }
+      if (::poll(pfds, 2, 10000) <= 0) return false;
+      for (int i = 0; i < 2; ++i) {
+        if (pfds[i].revents & POLLOUT) {
+          ssize_t n = ::send(fds[i], out[i].data() + sent[i], std::min<size_t>(out[i].size() - sent[i], 65536), MSG_NOSIGNAL);
+          if (n > 0) sent[i] += n;
+        }
+        if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+          char b[65536];
+          ssize_t n = ::recv(fds[i], b, sizeof(b), 0);
+          if (n <= 0) return false;
+          in[i].append(b, n);
+        }
+      }
+    }
+    return true;
+  }
+
+  // Wait for end of stream, or a reset if reset is set
+  bool closed_by_peer(int fd, bool reset = false) {
+    struct pollfd pfd = {fd, POLLIN, 0};
+    if (::poll(&pfd, 1, 10000) != 1) return false;
+    char b[16];
+    ssize_t n = ::recv(fd, b, sizeof(b), 0);
+    return reset ? (n == 0 || (n < 0 && errno == ECONNRESET)) : n == 0;
+  }
+}
+
+TEST_CASE("raw connection relayed by the proactor") {
+  raw_proactor p;
+  p.start();
+  int fds[2];
+  fds[0] = p.connect();
+  fds[1] = p.connect();
+  REQUIRE(fds[0] >= 0);
+  REQUIRE(fds[1] >= 0);
+  int err = pn_raw_connection_relay(p.accepted[0], p.accepted[1]);
+  if (err == PN_ERR) {
+    WARN("Relay not supported by this proactor, skipping");
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return;
+  }
+  REQUIRE(err == 0);
+  CHECK(pn_raw_connection_relay(p.accepted[1], p.accepted[0]) == PN_STATE_ERR);
+
+  // Much more than a pipe and the socket buffers hold, both ways at once
+  const std::string out[2] = {pattern(8 << 20, 0), pattern(8 << 20, 1)};
+  std::string in[2];
+  REQUIRE(exchange(fds, out, in));
+  CHECK(in[1] == out[0]);
+  CHECK(in[0] == out[1]);
+
+  SECTION("A reader that stops holds back the writer") {
+    // Send till nothing more is taken: the far socket, the relay's pipe and
+    // the near socket are full
+    std::string sent;
+    const std::string chunk = pattern(65536, 2);
+    struct pollfd pfd = {fds[0], POLLOUT, 0};
+    while (::poll(&pfd, 1, 500) == 1) {
+      ssize_t n = ::send(fds[0], chunk.data(), chunk.size(), MSG_NOSIGNAL);
+      REQUIRE(n > 0);
+      sent.append(chunk.data(), n);
+      REQUIRE(sent.size() < (size_t) 256 << 20);
+    }
+    CHECK(sent.size() > 65536);
+
+    // Reading again lets everything through
+    std::string back;
+    while (back.size() < sent.size()) {
+      struct pollfd rp = {fds[1], POLLIN, 0};
+      REQUIRE(::poll(&rp, 1, 10000) == 1);
+      char b[65536];
+      ssize_t n = ::recv(fds[1], b, sizeof(b), 0);
+      REQUIRE(n > 0);
+      back.append(b, n);
+    }
+    CHECK(back == sent);
+  }
+
+  SECTION("Half close is passed on") {
+    ::shutdown(fds[0], SHUT_WR);
+    CHECK(closed_by_peer(fds[1]));
+
+    // The other direction still relays
+    REQUIRE(::send(fds[1], "after", 5, MSG_NOSIGNAL) == 5);
+    struct pollfd pfd = {fds[0], POLLIN, 0};
+    REQUIRE(::poll(&pfd, 1, 10000) == 1);
+    char b[16];
+    CHECK(::recv(fds[0], b, sizeof(b), 0) == 5);
+    CHECK(std::string(b, 5) == "after");
+
+    ::shutdown(fds[1], SHUT_WR);
+    CHECK(closed_by_peer(fds[0]));
+    CHECK(p.wait_for([&p]() { return p.disconnected == 2; }));
+  }
+
+  SECTION("Reset is passed on") {
+    struct linger l = {1, 0};
+    ::setsockopt(fds[0], SOL_SOCKET, SO_LINGER, &l, sizeof(l));
+    ::close(fds[0]);
+    fds[0] = -1;
+    CHECK(closed_by_peer(fds[1], true));
+    CHECK(p.wait_for([&p]() { return p.disconnected == 2; }));
+  }
+
+  if (fds[0] >= 0) ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+TEST_CASE("raw connection buffer pool in the proactor") {
+  raw_proactor p;
+  int err = pn_proactor_add_raw_buffers(p.proactor, 1024, 2);
+  if (err == PN_ERR) {
+    WARN("Raw buffer pool not supported by this proactor, skipping");
+    return;
+  }
+  REQUIRE(err == 0);
+
+  std::vector<std::string> in(3);
+  std::vector<pn_raw_buffer_t> held;
+  int need_read_buffers = 0;
+  size_t received = 0;
+  p.on_accept = [](pn_raw_connection_t *rc) {
+    pn_raw_connection_set_buffer_slots(rc, 4, 1);
+    pn_raw_connection_use_buffer_pool(rc, 0);
+  };
+  // Keep every filled buffer till the test releases it
+  p.on_event = [&](pn_event_t *e) {
+    pn_raw_connection_t *rc = pn_event_raw_connection(e);
+    switch (pn_event_type(e)) {
+     case PN_RAW_CONNECTION_NEED_READ_BUFFERS:
+      ++need_read_buffers;
+      break;
+     case PN_RAW_CONNECTION_READ:
+     case PN_RAW_CONNECTION_DISCONNECTED: {
+      size_t i = std::find(p.accepted.begin(), p.accepted.end(), rc) - p.accepted.begin();
+      pn_raw_buffer_t b[4];
+      size_t n;
+      while ((n = pn_raw_connection_take_read_buffers(rc, b, 4))) {
+        for (size_t j = 0; j < n; ++j) {
+          if (!b[j].size) {
+            // Empty buffers still belong to the pool
+            pn_proactor_release_raw_buffers(p.proactor, &b[j], 1);
+            continue;
+          }
+          in[i].append(b[j].bytes + b[j].offset, b[j].size);
+          received += b[j].size;
+          held.push_back(b[j]);
+        }
+      }
+      break;
+     }
+     case PN_RAW_CONNECTION_CLOSED_READ:
+      pn_raw_connection_close(rc);
+      break;
+     default:
+      break;
+    }
+  };
+  p.start();
+
+  int fds[3];
+  const std::string out[3] = {pattern(4096, 0), pattern(4096, 1), pattern(4096, 2)};
+  for (int i = 0; i < 3; ++i) {
+    fds[i] = p.connect();
+    REQUIRE(fds[i] >= 0);
+  }
+  for (int i = 0; i < 3; ++i) {
+    REQUIRE(::send(fds[i], out[i].data(), out[i].size(), MSG_NOSIGNAL) == (ssize_t) out[i].size());
+  }
+
+  // The pool runs dry and reading stops with all 3 connections still wanting buffers
+  REQUIRE(p.wait_for([&]() { return held.size() == 2; }));
+  CHECK_FALSE(p.wait_for_ms(200, [&]() { return held.size() > 2; }));
+  CHECK(received == 2*1024);
+
+  // Each release wakes the waiting connections until everything has been read
+  while (received < 3*4096) {
+    std::vector<pn_raw_buffer_t> done;
+    {
+      std::lock_guard<std::mutex> g(p.lock);
+      done.swap(held);
+    }
+    CHECK(pn_proactor_release_raw_buffers(p.proactor, done.data(), done.size()) == done.size());
+    REQUIRE(p.wait_for([&]() { return !held.empty() || received == 3*4096; }));
+  }
+  for (int i = 0; i < 3; ++i) CHECK(in[i] == out[i]);
+  CHECK(need_read_buffers == 0);
+
+  // A pooled connection needs a buffer to read end of stream into
+  std::vector<pn_raw_buffer_t> done;
+  {
+    std::lock_guard<std::mutex> g(p.lock);
+    done.swap(held);
+  }
+  CHECK(pn_proactor_release_raw_buffers(p.proactor, done.data(), done.size()) == done.size());
+  for (int i = 0; i < 3; ++i) ::close(fds[i]);
+  REQUIRE(p.wait_for([&p]() { return p.disconnected == 3; }));
+  CHECK(held.empty());
+}
+#endif
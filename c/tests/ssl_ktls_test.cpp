@@ -0,0 +1,262 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "./pn_test.hpp"
+
+#include "ssl/ssl-internal.h"
+
+#include <proton/condition.h>
+#include <proton/connection.h>
+#include <proton/connection_driver.h>
+#include <proton/ssl.h>
+#include <proton/transport.h>
+
+#include <linux/tls.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+#include <string.h>
+
+#include <string>
+
+// Does what the kernel does with the output of a socket with TLS_TX set:
+// TLS 1.3 AES-GCM records from the crypto_info the SSL layer hands over.
+struct kernel_tls {
+  bool on;
+  int key_size;
+  unsigned char key[32];
+  unsigned char nonce[12];  // salt followed by iv
+  uint64_t seq;
+
+  kernel_tls() : on(false), key_size(0), seq(0) {}
+
+  bool install(const void *info, size_t size) {
+    const tls_crypto_info *base = (const tls_crypto_info *) info;
+    if (base->version != TLS_1_3_VERSION) return false;
+    const unsigned char *salt, *iv, *rec_seq;
+    if (base->cipher_type == TLS_CIPHER_AES_GCM_128 && size == sizeof(tls12_crypto_info_aes_gcm_128)) {
+      const tls12_crypto_info_aes_gcm_128 *ci = (const tls12_crypto_info_aes_gcm_128 *) info;
+      key_size = sizeof(ci->key);
+      memcpy(key, ci->key, key_size);
+      salt = ci->salt;
+      iv = ci->iv;
+      rec_seq = ci->rec_seq;
+    } else if (base->cipher_type == TLS_CIPHER_AES_GCM_256 && size == sizeof(tls12_crypto_info_aes_gcm_256)) {
+      const tls12_crypto_info_aes_gcm_256 *ci = (const tls12_crypto_info_aes_gcm_256 *) info;
+      key_size = sizeof(ci->key);
+      memcpy(key, ci->key, key_size);
+      salt = ci->salt;
+      iv = ci->iv;
+      rec_seq = ci->rec_seq;
+    } else {
+      return false;
+    }
+    memcpy(nonce, salt, 4);
+    memcpy(nonce + 4, iv, 8);
+    seq = 0;
+    for (int i = 0; i < 8; ++i) seq = (seq << 8) | rec_seq[i];
+    on = true;
+    return true;
+  }
+
+  std::string record(const char *data, size_t size, unsigned char type) {
+    std::string inner(data, size);
+    inner += (char) type;
+    size_t len = inner.size() + 16;
+    unsigned char header[5] = {23, 3, 3, (unsigned char) (len >> 8), (unsigned char) len};
+    unsigned char n[12];
+    memcpy(n, nonce, 12);
+    for (int i = 0; i < 8; ++i) n[11 - i] ^= (unsigned char) (seq >> (8 * i));
+    ++seq;
+
+    std::string out((const char *) header, 5);
+    out.resize(5 + len);
+    unsigned char *p = (unsigned char *) &out[5];
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    int outl = 0;
+    EVP_EncryptInit_ex(ctx, key_size == 16 ? EVP_aes_128_gcm() : EVP_aes_256_gcm(), NULL, key, n);
+    EVP_EncryptUpdate(ctx, NULL, &outl, header, 5);
+    EVP_EncryptUpdate(ctx, p, &outl, (const unsigned char *) inner.data(), (int) inner.size());
+    EVP_EncryptFinal_ex(ctx, p + outl, &outl);
+    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16, p + inner.size());
+    EVP_CIPHER_CTX_free(ctx);
+    return out;
+  }
+
+  std::string encrypt(const char *data, size_t size) {
+    std::string out;
+    while (size) {
+      size_t n = size < 16384 ? size : 16384;
+      out += record(data, n, 23);
+      data += n;
+      size -= n;
+    }
+    return out;
+  }
+};
+
+// Client whose output may be handed to the emulated kernel, as by the proactor
+struct ktls_pair {
+  pn_connection_driver_t client, server;
+  kernel_tls ktls;
+  bool install;   // whether the "kernel" accepts the keys
+  bool offered;   // pni_ssl_ktls_tx() returned keys
+  std::string wire;   // client output not yet read by the server
+
+  ktls_pair(pn_ssl_domain_t *cd, pn_ssl_domain_t *sd, bool install_) : install(install_), offered(false) {
+    pn_transport_t *ct = pn_transport();
+    pn_transport_t *st = pn_transport();
+    pn_transport_set_server(st);
+    pn_ssl_init(pn_ssl(ct), cd, NULL);
+    pn_ssl_init(pn_ssl(st), sd, NULL);
+    pn_connection_driver_init(&client, NULL, ct);
+    pn_connection_driver_init(&server, NULL, st);
+    pni_ssl_ktls_offer(ct);
+  }
+
+  ~ktls_pair() {
+    pn_connection_driver_destroy(&client);
+    pn_connection_driver_destroy(&server);
+  }
+
+  size_t client_output() {
+    size_t moved = 0;
+    pn_bytes_t out = pn_connection_driver_write_buffer(&client);
+    if (out.size == 0) {
+      size_t size;
+      const void *info = pni_ssl_ktls_tx(client.transport, &size);
+      if (info) {
+        offered = true;
+        bool installed = install && ktls.install(info, size);
+        pni_ssl_ktls_tx_done(client.transport, installed);
+        out = pn_connection_driver_write_buffer(&client);
+      } else if (pn_connection_driver_write_closed(&client) && ktls.on) {
+        static const char alert[2] = {1, 0};
+        wire += ktls.record(alert, sizeof(alert), 21);
+        ktls.on = false;    // once only
+      }
+    }
+    if (out.size) {
+      wire += ktls.on ? ktls.encrypt(out.start, out.size) : std::string(out.start, out.size);
+      pn_connection_driver_write_done(&client, out.size);
+      moved += out.size;
+    }
+    pn_rwbytes_t in = pn_connection_driver_read_buffer(&server);
+    size_t n = in.size < wire.size() ? in.size : wire.size();
+    if (n) {
+      memcpy(in.start, wire.data(), n);
+      wire.erase(0, n);
+      pn_connection_driver_read_done(&server, n);
+      moved += n;
+    }
+    return moved;
+  }
+
+  size_t server_output() {
+    pn_bytes_t out = pn_connection_driver_write_buffer(&server);
+    pn_rwbytes_t in = pn_connection_driver_read_buffer(&client);
+    size_t n = in.size < out.size ? in.size : out.size;
+    if (n) {
+      memcpy(in.start, out.start, n);
+      pn_connection_driver_read_done(&client, n);
+      pn_connection_driver_write_done(&server, n);
+    }
+    return n;
+  }
+
+  void run() {
+    size_t moved;
+    do {
+      while (pn_connection_driver_next_event(&client))
+        ;
+      while (pn_connection_driver_next_event(&server))
+        ;
+      moved = client_output() + server_output();
+    } while (moved);
+  }
+};
+
+TEST_CASE("ssl_kernel_tls") {
+  pn_test::auto_free<pn_ssl_domain_t, pn_ssl_domain_free> sd(
+      pn_ssl_domain(PN_SSL_MODE_SERVER));
+  pn_test::auto_free<pn_ssl_domain_t, pn_ssl_domain_free> cd(
+      pn_ssl_domain(PN_SSL_MODE_CLIENT));
+  if (pn_ssl_domain_set_kernel_tls(cd, true) != 0) {
+    WARN("Kernel TLS not supported by this build, skipping");
+    return;
+  }
+  REQUIRE(pn_ssl_domain_set_credentials(sd, "ssl-certs/tserver-certificate.pem",
+                                        "ssl-certs/tserver-private-key.pem", "tserverpw") == 0);
+  REQUIRE(pn_ssl_domain_set_peer_authentication(cd, PN_SSL_ANONYMOUS_PEER, NULL) == 0);
+  if (pn_ssl_domain_set_protocols(cd, "TLSv1.3") != 0) {
+    WARN("TLS 1.3 not available, skipping");
+    return;
+  }
+
+  SECTION("output encrypted by the kernel") {
+    ktls_pair p(cd, sd, true);
+    pn_connection_open(p.client.connection);
+    pn_connection_open(p.server.connection);
+    p.run();
+    // The keys come from a BIO ctrl internal to OpenSSL, if it is never
+    // seen OpenSSL has changed how it installs kernel TLS keys
+    INFO("kernel TLS keys never offered by " << OpenSSL_version(OPENSSL_VERSION));
+    REQUIRE(p.offered);
+    REQUIRE(p.ktls.on);
+    CHECK((pn_connection_state(p.server.connection) & PN_REMOTE_ACTIVE));
+    CHECK((pn_connection_state(p.client.connection) & PN_REMOTE_ACTIVE));
+
+    // Frames after the switch are encrypted by the "kernel" only
+    pn_connection_close(p.client.connection);
+    p.run();
+    CHECK((pn_connection_state(p.server.connection) & PN_REMOTE_CLOSED));
+    pn_connection_close(p.server.connection);
+    p.run();
+    CHECK(pn_connection_driver_finished(&p.client));
+    CHECK(pn_connection_driver_finished(&p.server));
+    CHECK(!pn_condition_is_set(pn_transport_condition(p.client.transport)));
+    CHECK(!pn_condition_is_set(pn_transport_condition(p.server.transport)));
+  }
+
+  SECTION("output stays with OpenSSL if the kernel declines") {
+    ktls_pair p(cd, sd, false);
+    pn_connection_open(p.client.connection);
+    pn_connection_open(p.server.connection);
+    p.run();
+    REQUIRE(p.offered);
+    CHECK(!p.ktls.on);
+    pn_connection_close(p.client.connection);
+    pn_connection_close(p.server.connection);
+    p.run();
+    CHECK(pn_connection_driver_finished(&p.client));
+    CHECK(pn_connection_driver_finished(&p.server));
+    CHECK(!pn_condition_is_set(pn_transport_condition(p.client.transport)));
+    CHECK(!pn_condition_is_set(pn_transport_condition(p.server.transport)));
+  }
+
+  SECTION("not offered without the domain option") {
+    REQUIRE(pn_ssl_domain_set_kernel_tls(cd, false) == 0);
+    ktls_pair p(cd, sd, true);
+    pn_connection_open(p.client.connection);
+    pn_connection_open(p.server.connection);
+    p.run();
+    CHECK(!p.offered);
+    CHECK((pn_connection_state(p.server.connection) & PN_REMOTE_ACTIVE));
+  }
+}
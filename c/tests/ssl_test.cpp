@@ -17,10 +17,21 @@
  * under the License.
  */
 
+#include <proton/condition.h>
+#include <proton/connection.h>
+#include <proton/connection_driver.h>
 #include <proton/ssl.h>
+#include <proton/transport.h>
 
 #include "./pn_test.hpp"
 
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+
+#define SSL_FILE(NAME) "ssl-certs/" NAME
+
 TEST_CASE("ssl_protocols") {
   if (!pn_ssl_present()) {
     WARN("SSL not available, skipping");
@@ -70,3 +81,152 @@ TEST_CASE("ssl_protocols") {
   // Known followed by unknown protocols
   CHECK(pn_ssl_domain_set_protocols(sd, "TLSv1 TLSv1.x;TLSv1_2") == PN_ARG_ERR);
 }
+
+// Copy pending output of one driver to the input of the other, at most limit bytes
+static size_t shovel(pn_connection_driver_t &from, pn_connection_driver_t &to, size_t limit) {
+  pn_bytes_t wbuf = pn_connection_driver_write_buffer(&from);
+  pn_rwbytes_t rbuf = pn_connection_driver_read_buffer(&to);
+  size_t n = rbuf.size < wbuf.size ? rbuf.size : wbuf.size;
+  if (n > limit) n = limit;
+  if (n) {
+    memcpy(rbuf.start, wbuf.start, n);
+    pn_connection_driver_read_done(&to, n);
+    pn_connection_driver_write_done(&from, n);
+  }
+  return n;
+}
+
+static void run(pn_connection_driver_t &client, pn_connection_driver_t &server,
+                size_t limit = SIZE_MAX) {
+  size_t moved;
+  do {
+    while (pn_connection_driver_next_event(&client))
+      ;
+    while (pn_connection_driver_next_event(&server))
+      ;
+    moved = shovel(client, server, limit) + shovel(server, client, limit);
+  } while (moved);
+}
+
+// Open a connection over SSL in memory, return the client's resume status.
+// Unless clean the connection is dropped without an orderly SSL shutdown.
+static pn_ssl_resume_status_t ssl_connect(pn_ssl_domain_t *cd, pn_ssl_domain_t *sd, const char *session_id,
+                                          bool clean = false) {
+  pn_connection_driver_t client, server;
+  pn_transport_t *ct = pn_transport();
+  pn_transport_t *st = pn_transport();
+  pn_transport_set_server(st);
+  REQUIRE(pn_ssl_init(pn_ssl(ct), cd, session_id) == 0);
+  REQUIRE(pn_ssl_init(pn_ssl(st), sd, NULL) == 0);
+  REQUIRE(pn_connection_driver_init(&client, NULL, ct) == 0);
+  REQUIRE(pn_connection_driver_init(&server, NULL, st) == 0);
+  pn_connection_open(client.connection);
+  pn_connection_open(server.connection);
+  // Run until the client has read any session ticket sent after the handshake
+  run(client, server);
+  CHECK((pn_connection_state(client.connection) & PN_REMOTE_ACTIVE));
+  pn_ssl_resume_status_t status = pn_ssl_resume_status(pn_ssl(ct));
+  if (clean) {
+    pn_connection_close(client.connection);
+    pn_connection_close(server.connection);
+    run(client, server);
+  }
+  pn_connection_driver_destroy(&client);
+  pn_connection_driver_destroy(&server);
+  return status;
+}
+
+TEST_CASE("ssl_session_resume") {
+  if (!pn_ssl_present()) {
+    WARN("SSL not available, skipping");
+    return;
+  }
+  pn_test::auto_free<pn_ssl_domain_t, pn_ssl_domain_free> sd(
+      pn_ssl_domain(PN_SSL_MODE_SERVER));
+  REQUIRE(pn_ssl_domain_set_credentials(sd, SSL_FILE("tserver-certificate.pem"),
+                                        SSL_FILE("tserver-private-key.pem"), "tserverpw") == 0);
+  pn_test::auto_free<pn_ssl_domain_t, pn_ssl_domain_free> cd(
+      pn_ssl_domain(PN_SSL_MODE_CLIENT));
+  REQUIRE(pn_ssl_domain_set_peer_authentication(cd, PN_SSL_ANONYMOUS_PEER, NULL) == 0);
+
+  SECTION("same session id resumes") {
+    CHECK(ssl_connect(cd, sd, "a") == PN_SSL_RESUME_NEW);
+    CHECK(ssl_connect(cd, sd, "a") == PN_SSL_RESUME_REUSED);
+    CHECK(ssl_connect(cd, sd, "b") == PN_SSL_RESUME_NEW);
+    CHECK(ssl_connect(cd, sd, NULL) == PN_SSL_RESUME_NEW);
+  }
+
+  SECTION("least recently used is evicted") {
+    REQUIRE(pn_ssl_domain_set_session_cache(cd, 2, 0) == 0);
+    CHECK(ssl_connect(cd, sd, "a") == PN_SSL_RESUME_NEW);
+    CHECK(ssl_connect(cd, sd, "b") == PN_SSL_RESUME_NEW);
+    CHECK(ssl_connect(cd, sd, "a") == PN_SSL_RESUME_REUSED);
+    CHECK(ssl_connect(cd, sd, "c") == PN_SSL_RESUME_NEW);
+    CHECK(ssl_connect(cd, sd, "b") == PN_SSL_RESUME_NEW);
+    CHECK(ssl_connect(cd, sd, "c") == PN_SSL_RESUME_REUSED);
+  }
+
+  SECTION("disabled client cache") {
+    REQUIRE(pn_ssl_domain_set_session_cache(cd, 0, 0) == 0);
+    CHECK(ssl_connect(cd, sd, "a") == PN_SSL_RESUME_NEW);
+    CHECK(ssl_connect(cd, sd, "a") == PN_SSL_RESUME_NEW);
+  }
+
+  SECTION("server cache without tickets") {
+    REQUIRE(pn_ssl_domain_set_session_tickets(sd, false) == 0);
+    REQUIRE(pn_ssl_domain_set_session_cache(sd, 16, 60000) == 0);
+    // The server forgets sessions of connections that are not shut down cleanly
+    CHECK(ssl_connect(cd, sd, "a", true) == PN_SSL_RESUME_NEW);
+    CHECK(ssl_connect(cd, sd, "a", true) == PN_SSL_RESUME_REUSED);
+  }
+
+  SECTION("disabled server cache without tickets") {
+    REQUIRE(pn_ssl_domain_set_session_tickets(sd, false) == 0);
+    REQUIRE(pn_ssl_domain_set_session_cache(sd, 0, 0) == 0);
+    CHECK(ssl_connect(cd, sd, "a", true) == PN_SSL_RESUME_NEW);
+    CHECK(ssl_connect(cd, sd, "a", true) == PN_SSL_RESUME_NEW);
+  }
+}
+
+TEST_CASE("ssl_small_reads") {
+  if (!pn_ssl_present()) {
+    WARN("SSL not available, skipping");
+    return;
+  }
+  pn_test::auto_free<pn_ssl_domain_t, pn_ssl_domain_free> sd(
+      pn_ssl_domain(PN_SSL_MODE_SERVER));
+  REQUIRE(pn_ssl_domain_set_credentials(sd, SSL_FILE("tserver-certificate.pem"),
+                                        SSL_FILE("tserver-private-key.pem"), "tserverpw") == 0);
+  pn_test::auto_free<pn_ssl_domain_t, pn_ssl_domain_free> cd(
+      pn_ssl_domain(PN_SSL_MODE_CLIENT));
+  REQUIRE(pn_ssl_domain_set_peer_authentication(cd, PN_SSL_ANONYMOUS_PEER, NULL) == 0);
+
+  // Records split across many reads, and output held back between writes
+  pn_connection_driver_t client, server;
+  pn_transport_t *ct = pn_transport();
+  pn_transport_t *st = pn_transport();
+  pn_transport_set_server(st);
+  REQUIRE(pn_ssl_init(pn_ssl(ct), cd, NULL) == 0);
+  REQUIRE(pn_ssl_init(pn_ssl(st), sd, NULL) == 0);
+  REQUIRE(pn_connection_driver_init(&client, NULL, ct) == 0);
+  REQUIRE(pn_connection_driver_init(&server, NULL, st) == 0);
+  std::string id(40000, 'x');   // an open frame of several records
+  pn_connection_set_container(client.connection, id.c_str());
+  pn_connection_open(client.connection);
+  pn_connection_open(server.connection);
+  run(client, server, 7);
+  CHECK((pn_connection_state(client.connection) & PN_REMOTE_ACTIVE));
+  CHECK(id == pn_connection_remote_container(server.connection));
+
+  pn_connection_close(client.connection);
+  pn_connection_close(server.connection);
+  // Each side closes its input once it has sent close_notify, so the
+  // last few bytes of the other's may never be read here.
+  run(client, server, 7);
+  CHECK((pn_connection_state(client.connection) & PN_REMOTE_CLOSED));
+  CHECK((pn_connection_state(server.connection) & PN_REMOTE_CLOSED));
+  CHECK(!pn_condition_is_set(pn_transport_condition(ct)));
+  CHECK(!pn_condition_is_set(pn_transport_condition(st)));
+  pn_connection_driver_destroy(&client);
+  pn_connection_driver_destroy(&server);
+}
@@ -0,0 +1,152 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "./pn_test.hpp"
+
+#include "core/timer_wheel.h"
+
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Everything that pops from the wheel, in order
+std::vector<pni_timer_entry_t *> pop_all(pni_timer_wheel_t &w) {
+  std::vector<pni_timer_entry_t *> popped;
+  while (pni_timer_entry_t *e = pni_timer_wheel_pop(&w)) popped.push_back(e);
+  return popped;
+}
+
+} // namespace
+
+TEST_CASE("timer_wheel_basic") {
+  pni_timer_wheel_t w;
+  pni_timer_wheel_init(&w, 1000);
+  CHECK(pni_timer_wheel_next(&w) == 0);
+  CHECK(pni_timer_wheel_empty(&w));
+
+  pni_timer_entry_t a, b, c;
+  pni_timer_entry_init(&a);
+  pni_timer_entry_init(&b);
+  pni_timer_entry_init(&c);
+  pni_timer_wheel_add(&w, &a, 1010);
+  pni_timer_wheel_add(&w, &b, 1000 + 5000);
+  pni_timer_wheel_add(&w, &c, 900);    // Already due
+  CHECK(pni_timer_entry_scheduled(&a));
+  CHECK(pni_timer_wheel_next(&w) == 1000);
+  CHECK(pop_all(w) == std::vector<pni_timer_entry_t *>{&c});
+  CHECK(!pni_timer_entry_scheduled(&c));
+
+  CHECK(pni_timer_wheel_next(&w) == 1010);
+  pni_timer_wheel_advance(&w, 1009);
+  CHECK(pop_all(w).empty());
+  pni_timer_wheel_advance(&w, 1010);
+  CHECK(pop_all(w) == std::vector<pni_timer_entry_t *>{&a});
+
+  // b is on a higher level, next is the start of its slot
+  uint64_t next = pni_timer_wheel_next(&w);
+  CHECK(next > 1010);
+  CHECK(next <= 6000);
+  pni_timer_wheel_remove(&w, &b);
+  CHECK(!pni_timer_entry_scheduled(&b));
+  CHECK(pni_timer_wheel_next(&w) == 0);
+  pni_timer_wheel_advance(&w, 100000);
+  CHECK(pop_all(w).empty());
+  CHECK(pni_timer_wheel_empty(&w));
+}
+
+TEST_CASE("timer_wheel_far_future") {
+  pni_timer_wheel_t w;
+  pni_timer_wheel_init(&w, 1);
+  pni_timer_entry_t a, b;
+  pni_timer_entry_init(&a);
+  pni_timer_entry_init(&b);
+  pni_timer_wheel_add(&w, &a, UINT64_MAX);
+  pni_timer_wheel_add(&w, &b, (uint64_t) 1 << 40);
+  pni_timer_wheel_advance(&w, ((uint64_t) 1 << 40) - 1);
+  CHECK(pop_all(w).empty());
+  pni_timer_wheel_advance(&w, (uint64_t) 1 << 40);
+  CHECK(pop_all(w) == std::vector<pni_timer_entry_t *>{&b});
+  pni_timer_wheel_advance(&w, UINT64_MAX);
+  CHECK(pop_all(w) == std::vector<pni_timer_entry_t *>{&a});
+}
+
+TEST_CASE("timer_wheel_random") {
+  // Compare against a multimap with a mix of adds, removes and advances
+  std::mt19937_64 rng(42);
+  const int n = 2000;
+  std::vector<pni_timer_entry_t> entries(n);
+  std::multimap<uint64_t, pni_timer_entry_t *> expect;
+  pni_timer_wheel_t w;
+  uint64_t now = 123456;
+  pni_timer_wheel_init(&w, now);
+  for (auto &e : entries) pni_timer_entry_init(&e);
+
+  for (int round = 0; round < 20000; ++round) {
+    pni_timer_entry_t *e = &entries[rng() % n];
+    switch (rng() % 4) {
+    case 0:
+    case 1:
+      if (!pni_timer_entry_scheduled(e)) {
+        // Mostly short delays with some spread across the levels
+        uint64_t delay = rng() % (rng() % 8 ? 200 : 1000000);
+        pni_timer_wheel_add(&w, e, now + delay);
+        expect.insert(std::make_pair(now + delay, e));
+      }
+      break;
+    case 2:
+      if (pni_timer_entry_scheduled(e)) {
+        for (auto i = expect.begin(); i != expect.end(); ++i) {
+          if (i->second == e) {
+            expect.erase(i);
+            break;
+          }
+        }
+        pni_timer_wheel_remove(&w, e);
+      }
+      break;
+    case 3: {
+      uint64_t next = pni_timer_wheel_next(&w);
+      if (!expect.empty()) {
+        REQUIRE(next != 0);
+        REQUIRE(next <= expect.begin()->first);
+      }
+      now += rng() % 100;
+      pni_timer_wheel_advance(&w, now);
+      std::vector<pni_timer_entry_t *> popped = pop_all(w);
+      uint64_t last = 0;
+      for (pni_timer_entry_t *p : popped) {
+        REQUIRE(p->deadline <= now);
+        REQUIRE(p->deadline >= last);
+        last = p->deadline;
+        auto i = expect.find(p->deadline);
+        while (i != expect.end() && i->second != p) ++i;
+        REQUIRE(i != expect.end());
+        expect.erase(i);
+      }
+      REQUIRE((expect.empty() || expect.begin()->first > now));
+      break;
+    }
+    }
+    REQUIRE(w.count == expect.size());
+  }
+}
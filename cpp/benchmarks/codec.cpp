@@ -0,0 +1,105 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <map>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include <proton/codec/encoder.hpp>
+#include <proton/codec/decoder.hpp>
+#include <proton/codec/map.hpp>
+#include <proton/codec/typed.hpp>
+#include <proton/value.hpp>
+
+// A map-heavy message body encoded and decoded through proton::value, which
+// builds a pn_data_t, and through the typed codec, which does not.
+
+namespace {
+
+typedef std::map<std::string, int64_t> body_map;
+
+body_map make_body(int64_t entries) {
+    body_map m;
+    for (int64_t i = 0; i < entries; ++i)
+        m["key-" + std::to_string(i)] = i * 1000;
+    return m;
+}
+
+} // namespace
+
+static void BM_ValueEncodeMap(benchmark::State &state) {
+    body_map m = make_body(state.range(0));
+    std::string bytes;
+    for (auto _ : state) {
+        proton::value v;
+        proton::codec::encoder e(v);
+        e << m;
+        e.encode(bytes);
+        benchmark::DoNotOptimize(bytes.data());
+    }
+    state.SetItemsProcessed(state.iterations() * m.size());
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+
+static void BM_TypedEncodeMap(benchmark::State &state) {
+    body_map m = make_body(state.range(0));
+    std::string bytes;
+    for (auto _ : state) {
+        proton::codec::typed::encode(m, bytes);
+        benchmark::DoNotOptimize(bytes.data());
+    }
+    state.SetItemsProcessed(state.iterations() * m.size());
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+
+static void BM_ValueDecodeMap(benchmark::State &state) {
+    body_map m = make_body(state.range(0));
+    std::string bytes = proton::codec::typed::encode(m);
+    for (auto _ : state) {
+        proton::value v;
+        proton::codec::decoder d(v);
+        d.decode(bytes);
+        d.rewind();
+        body_map out;
+        d >> out;
+        benchmark::DoNotOptimize(out.size());
+    }
+    state.SetItemsProcessed(state.iterations() * m.size());
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+
+static void BM_TypedDecodeMap(benchmark::State &state) {
+    body_map m = make_body(state.range(0));
+    std::string bytes = proton::codec::typed::encode(m);
+    for (auto _ : state) {
+        body_map out;
+        proton::codec::typed::decode(bytes, out);
+        benchmark::DoNotOptimize(out.size());
+    }
+    state.SetItemsProcessed(state.iterations() * m.size());
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+
+BENCHMARK(BM_ValueEncodeMap)->Arg(16)->Arg(1024);
+BENCHMARK(BM_TypedEncodeMap)->Arg(16)->Arg(1024);
+BENCHMARK(BM_ValueDecodeMap)->Arg(16)->Arg(1024);
+BENCHMARK(BM_TypedDecodeMap)->Arg(16)->Arg(1024);
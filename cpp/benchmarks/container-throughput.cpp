@@ -0,0 +1,240 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <proton/binary.hpp>
+#include <proton/connection.hpp>
+#include <proton/connection_options.hpp>
+#include <proton/container.hpp>
+#include <proton/delivery.hpp>
+#include <proton/error_condition.hpp>
+#include <proton/listen_handler.hpp>
+#include <proton/listener.hpp>
+#include <proton/message.hpp>
+#include <proton/messaging_handler.hpp>
+#include <proton/receiver.hpp>
+#include <proton/receiver_options.hpp>
+#include <proton/sender.hpp>
+#include <proton/ssl.hpp>
+#include <proton/transport.hpp>
+#include <proton/value.hpp>
+
+#include "latency_histogram.hpp"
+
+// The C++ counterpart of c/benchmarks/proactor-throughput.cpp: N connections
+// each with M senders, run by a container on T threads that also accepts the
+// connections and receives the messages. Messages are complete
+// proton::message objects with a binary body, so this includes the cost of
+// encoding and decoding them. Run from c/tests so the test certificates are
+// found.
+
+namespace {
+
+const int CREDIT = 500;
+const uint64_t MAX_MESSAGES = 50000;
+const uint64_t MAX_BYTES = 128 * 1024 * 1024;
+
+struct bench;
+
+// Receives on all the links of one accepted connection
+class receive_handler : public proton::messaging_handler {
+  public:
+    explicit receive_handler(bench &b) : bench_(b) {}
+    latency_histogram latency;
+
+  private:
+    void on_receiver_open(proton::receiver &r) override {
+        r.open(proton::receiver_options().credit_window(CREDIT));
+    }
+    void on_message(proton::delivery &, proton::message &m) override;
+    void on_transport_error(proton::transport &t) override;
+
+    bench &bench_;
+};
+
+// Sends on all the links of one outgoing connection
+class send_handler : public proton::messaging_handler {
+  public:
+    explicit send_handler(bench &b) : bench_(b), sent_(0) {}
+
+  private:
+    void on_connection_open(proton::connection &c) override;
+    void on_sendable(proton::sender &s) override;
+    void on_transport_error(proton::transport &t) override;
+
+    bench &bench_;
+    uint64_t sent_;
+};
+
+struct bench : public proton::listen_handler {
+    size_t connections;
+    size_t links;
+    size_t size;
+    bool tls;
+    uint64_t per_connection;
+    uint64_t total;
+    std::vector<std::unique_ptr<send_handler> > senders;
+    std::vector<std::unique_ptr<receive_handler> > receivers;
+    std::atomic<uint64_t> received;
+    std::atomic<uint64_t> start;
+    std::atomic<uint64_t> end;
+    std::mutex lock;
+    std::string error;
+
+    bench() : received(0), start(0), end(0) {}
+
+    void fail(proton::container &c, const std::string &what) {
+        {
+            std::lock_guard<std::mutex> g(lock);
+            if (!error.empty() || received == total) return;
+            error = what;
+        }
+        c.stop();
+    }
+
+    void on_open(proton::listener &l) override {
+        std::string url = "127.0.0.1:" + std::to_string(l.port());
+        for (std::unique_ptr<send_handler> &h : senders) {
+            proton::connection_options opts;
+            opts.handler(*h);
+            if (tls)
+                opts.ssl_client_options(proton::ssl_client_options(proton::ssl::ANONYMOUS_PEER));
+            l.container().connect(url, opts);
+        }
+    }
+
+    // Accepted in turn so each receive handler is used by one connection
+    proton::connection_options on_accept(proton::listener &) override {
+        std::lock_guard<std::mutex> g(lock);
+        receivers.emplace_back(new receive_handler(*this));
+        proton::connection_options opts;
+        opts.handler(*receivers.back());
+        if (tls)
+            opts.ssl_server_options(proton::ssl_server_options(proton::ssl_certificate(
+                "ssl-certs/tserver-certificate.pem", "ssl-certs/tserver-private-key.pem", "tserverpw")));
+        return opts;
+    }
+
+    void on_error(proton::listener &l, const std::string &what) override {
+        fail(l.container(), what);
+    }
+};
+
+void receive_handler::on_message(proton::delivery &d, proton::message &m) {
+    uint64_t now = latency_histogram::now();
+    proton::binary body = proton::get<proton::binary>(m.body());
+    uint64_t sent;
+    memcpy(&sent, &body[0], sizeof(sent));
+    latency.record(now - sent);
+    if (++bench_.received == bench_.total) {
+        bench_.end = now;
+        d.container().stop();
+    }
+}
+
+void receive_handler::on_transport_error(proton::transport &t) {
+    bench_.fail(t.connection().container(), t.error().what());
+}
+
+void send_handler::on_connection_open(proton::connection &c) {
+    for (size_t i = 0; i < bench_.links; ++i)
+        c.open_sender(std::to_string(i));
+}
+
+void send_handler::on_sendable(proton::sender &s) {
+    proton::binary body(bench_.size, 'x');
+    while (s.credit() > 0 && sent_ < bench_.per_connection) {
+        uint64_t now = latency_histogram::now();
+        uint64_t zero = 0;
+        bench_.start.compare_exchange_strong(zero, now);
+        memcpy(&body[0], &now, sizeof(now));
+        s.send(proton::message(body));
+        ++sent_;
+    }
+}
+
+void send_handler::on_transport_error(proton::transport &t) {
+    bench_.fail(t.connection().container(), t.error().what());
+}
+
+} // namespace
+
+static void BM_ContainerThroughput(benchmark::State &state) {
+    size_t threads = state.range(2);
+    latency_histogram latency;
+    uint64_t size = 0;
+
+    for (auto _ : state) {
+        bench b;
+        b.connections = state.range(0);
+        b.links = state.range(1);
+        b.size = size = state.range(3);
+        b.tls = state.range(4);
+        uint64_t messages = std::min(MAX_BYTES / b.size, MAX_MESSAGES);
+        b.per_connection = messages / b.connections + 1;
+        b.total = b.per_connection * b.connections;
+        for (size_t i = 0; i < b.connections; ++i)
+            b.senders.emplace_back(new send_handler(b));
+
+        proton::container c;
+        c.listen("127.0.0.1:0", b);
+        c.run(threads);
+
+        if (!b.error.empty()) {
+            state.SkipWithError(b.error.c_str());
+            break;
+        }
+        state.SetIterationTime((b.end - b.start) / 1e9);
+        for (std::unique_ptr<receive_handler> &h : b.receivers) latency.merge(h->latency);
+    }
+
+    latency.report(state);
+    state.SetItemsProcessed(latency.count());
+    state.SetBytesProcessed(latency.count() * size);
+    state.SetLabel(state.range(4) ? "tls" : "plain");
+}
+
+static void container_args(benchmark::internal::Benchmark *bm) {
+    bm->ArgNames({"conns", "links", "threads", "size", "tls"});
+    for (int64_t size : {64, 1024, 16 * 1024}) {
+        bm->Args({1, 1, 1, size, 0});
+        bm->Args({4, 4, 4, size, 0});
+    }
+    bm->Args({16, 1, 4, 1024, 0});
+    bm->Args({1, 1, 1, 16 * 1024, 1});
+    bm->Args({4, 4, 4, 1024, 1});
+}
+
+BENCHMARK(BM_ContainerThroughput)
+    ->Apply(container_args)
+    ->Iterations(1)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,857 @@
+#ifndef PROTON_CODEC_TYPED_HPP
+#define PROTON_CODEC_TYPED_HPP
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "../binary.hpp"
+#include "../decimal.hpp"
+#include "../error.hpp"
+#include "../internal/config.hpp"
+#include "../internal/type_traits.hpp"
+#include "../null.hpp"
+#include "../symbol.hpp"
+#include "../timestamp.hpp"
+#include "../type_id.hpp"
+#include "../uuid.hpp"
+#include "../value.hpp"
+#include "./decoder.hpp"
+#include "./encoder.hpp"
+
+#include <proton/type_compat.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#if PN_CPP_HAS_CPP11
+#include <unordered_map>
+#endif
+
+/// @file
+/// **Unsettled API** - Encode and decode C++ types directly to and from AMQP bytes.
+
+namespace proton {
+namespace codec {
+
+/// **Unsettled API** - Encode C++ values straight to AMQP bytes and
+/// decode them straight back, without going through a proton::value.
+///
+/// The AMQP type of each C++ type is fixed at compile time by a
+/// specialization of typed::traits, so all that is left to do at run
+/// time is write or read the bytes. The C++ scalar types, std::string,
+/// proton::symbol, proton::binary, std::vector, std::map and
+/// std::unordered_map are supported, as are user structs with a traits
+/// specialization derived from typed::list_traits. A proton::value can
+/// be used for a part whose type is only known at run time.
+///
+/// The bytes are the same as those encoded from a proton::value holding
+/// the same C++ value, so either side can use either codec.
+///
+///     std::map<std::string, int64_t> m = ...;
+///     std::string bytes = proton::codec::typed::encode(m);
+///     proton::codec::typed::decode(bytes, m);
+namespace typed {
+
+/// @cond INTERNAL
+
+// AMQP encoding codes
+enum {
+    CODE_DESCRIPTOR = 0x00,
+    CODE_NULL = 0x40,
+    CODE_TRUE = 0x41,
+    CODE_FALSE = 0x42,
+    CODE_UINT0 = 0x43,
+    CODE_ULONG0 = 0x44,
+    CODE_LIST0 = 0x45,
+    CODE_UBYTE = 0x50,
+    CODE_BYTE = 0x51,
+    CODE_SMALLUINT = 0x52,
+    CODE_SMALLULONG = 0x53,
+    CODE_SMALLINT = 0x54,
+    CODE_SMALLLONG = 0x55,
+    CODE_BOOLEAN = 0x56,
+    CODE_USHORT = 0x60,
+    CODE_SHORT = 0x61,
+    CODE_UINT = 0x70,
+    CODE_INT = 0x71,
+    CODE_FLOAT = 0x72,
+    CODE_CHAR = 0x73,
+    CODE_DECIMAL32 = 0x74,
+    CODE_ULONG = 0x80,
+    CODE_LONG = 0x81,
+    CODE_DOUBLE = 0x82,
+    CODE_TIMESTAMP = 0x83,
+    CODE_DECIMAL64 = 0x84,
+    CODE_DECIMAL128 = 0x94,
+    CODE_UUID = 0x98,
+    CODE_VBIN8 = 0xa0,
+    CODE_STR8 = 0xa1,
+    CODE_SYM8 = 0xa3,
+    CODE_VBIN32 = 0xb0,
+    CODE_STR32 = 0xb1,
+    CODE_SYM32 = 0xb3,
+    CODE_LIST8 = 0xc0,
+    CODE_MAP8 = 0xc1,
+    CODE_LIST32 = 0xd0,
+    CODE_MAP32 = 0xd1,
+    CODE_ARRAY8 = 0xe0,
+    CODE_ARRAY32 = 0xf0
+};
+
+/// @endcond
+
+/// Appends AMQP bytes to a std::string.
+class writer {
+  public:
+    explicit writer(std::string& out) : out_(out) {}
+
+    /// Make room for n more bytes.
+    void reserve(size_t n) { out_.reserve(out_.size() + n); }
+
+    /// The number of bytes written.
+    size_t position() const { return out_.size(); }
+
+    void put8(uint8_t x) { out_.push_back(char(x)); }
+
+    void put16(uint16_t x) {
+        char b[2] = { char(x >> 8), char(x) };
+        out_.append(b, 2);
+    }
+
+    void put32(uint32_t x) {
+        char b[4] = { char(x >> 24), char(x >> 16), char(x >> 8), char(x) };
+        out_.append(b, 4);
+    }
+
+    void put64(uint64_t x) {
+        put32(uint32_t(x >> 32));
+        put32(uint32_t(x));
+    }
+
+    void put_bytes(const void* p, size_t n) { out_.append(static_cast<const char*>(p), n); }
+
+    /// Overwrite the 32 bit value written at position.
+    void put32_at(size_t position, uint32_t x) {
+        char* p = &out_[position];
+        p[0] = char(x >> 24); p[1] = char(x >> 16); p[2] = char(x >> 8); p[3] = char(x);
+    }
+
+  private:
+    std::string& out_;
+};
+
+/// Reads AMQP bytes.
+///
+/// @throw conversion_error if there are not enough bytes.
+class reader {
+  public:
+    reader(const char* begin, const char* end) : p_(begin), end_(end) {}
+
+    const char* position() const { return p_; }
+    size_t remaining() const { return size_t(end_ - p_); }
+
+    uint8_t get8() { need(1); return uint8_t(*p_++); }
+
+    uint16_t get16() {
+        const uint8_t* b = get(2);
+        return uint16_t((b[0] << 8) | b[1]);
+    }
+
+    uint32_t get32() {
+        const uint8_t* b = get(4);
+        return (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) | (uint32_t(b[2]) << 8) | uint32_t(b[3]);
+    }
+
+    uint64_t get64() {
+        uint64_t hi = get32();
+        return (hi << 32) | get32();
+    }
+
+    const char* get_bytes(size_t n) {
+        need(n);
+        const char* p = p_;
+        p_ += n;
+        return p;
+    }
+
+    /// Skip the rest of a value whose constructor code has been read.
+    void skip(uint8_t code) {
+        if (code == CODE_DESCRIPTOR) {
+            skip(get8());       // The descriptor
+            skip(get8());       // The described value
+            return;
+        }
+        switch (code >> 4) {
+          case 0x4: return;
+          case 0x5: get_bytes(1); return;
+          case 0x6: get_bytes(2); return;
+          case 0x7: get_bytes(4); return;
+          case 0x8: get_bytes(8); return;
+          case 0x9: get_bytes(16); return;
+          case 0xa: case 0xc: case 0xe: get_bytes(get8()); return;
+          case 0xb: case 0xd: case 0xf: get_bytes(get32()); return;
+          default: throw conversion_error("invalid AMQP encoding");
+        }
+    }
+
+  private:
+    void need(size_t n) {
+        if (remaining() < n) throw conversion_error("not enough data to decode");
+    }
+
+    const uint8_t* get(size_t n) { return reinterpret_cast<const uint8_t*>(get_bytes(n)); }
+
+    const char* p_;
+    const char* end_;
+};
+
+/// @cond INTERNAL
+
+inline void mismatch(type_id want) {
+    throw conversion_error("unexpected AMQP encoding, want: " + type_name(want));
+}
+
+// Read the header of a list, map or array, return the number of elements
+inline uint32_t read_count(reader& r, uint8_t code, type_id want) {
+    switch (code) {
+      case CODE_LIST0:
+        if (want != LIST) break;
+        return 0;
+      case CODE_LIST8:
+      case CODE_MAP8:
+      case CODE_ARRAY8:
+        if (want != (code == CODE_LIST8 ? LIST : code == CODE_MAP8 ? MAP : ARRAY)) break;
+        r.get8();
+        return r.get8();
+      case CODE_LIST32:
+      case CODE_MAP32:
+      case CODE_ARRAY32:
+        if (want != (code == CODE_LIST32 ? LIST : code == CODE_MAP32 ? MAP : ARRAY)) break;
+        r.get32();
+        return r.get32();
+    }
+    mismatch(want);
+    return 0;
+}
+
+// Write the header of a list, map or array after its constructor, the size
+// is filled in by end_compound()
+inline size_t begin_compound(writer& w, uint32_t count) {
+    size_t at = w.position();
+    w.put32(0);
+    w.put32(count);
+    return at;
+}
+
+inline void end_compound(writer& w, size_t at) {
+    w.put32_at(at, uint32_t(w.position() - at - 4));
+}
+
+/// @endcond
+
+/// **Unsettled API** - The AMQP encoding of T, chosen at compile time.
+///
+/// A specialization provides:
+///
+/// - `static const type_id type`: the AMQP type.
+/// - `static const uint8_t array_code`: the constructor of T as an array element.
+/// - `static const size_t element_size`: the size of T as an array element, or 0 if it varies.
+/// - `static void encode(writer&, const T&)`: write the constructor and the value.
+/// - `static void encode_element(writer&, const T&)`: write the value as an array element.
+/// - `static void decode(reader&, uint8_t code, T&)`: read a value given its constructor.
+///   Any encoding of the AMQP type is accepted.
+template <class T, class Enable=void> struct traits;
+
+/// @cond INTERNAL
+
+// Values encoded as their bits in network order
+template <size_t N> struct bits;
+template <> struct bits<1> {
+    typedef uint8_t type;
+    static void put(writer& w, type x) { w.put8(x); }
+    static type get(reader& r) { return r.get8(); }
+};
+template <> struct bits<2> {
+    typedef uint16_t type;
+    static void put(writer& w, type x) { w.put16(x); }
+    static type get(reader& r) { return r.get16(); }
+};
+template <> struct bits<4> {
+    typedef uint32_t type;
+    static void put(writer& w, type x) { w.put32(x); }
+    static type get(reader& r) { return r.get32(); }
+};
+template <> struct bits<8> {
+    typedef uint64_t type;
+    static void put(writer& w, type x) { w.put64(x); }
+    static type get(reader& r) { return r.get64(); }
+};
+
+template <class T, type_id ID, uint8_t CODE> struct fixed_traits {
+    typedef bits<sizeof(T)> bits_type;
+    static const type_id type = ID;
+    static const uint8_t array_code = CODE;
+    static const size_t element_size = sizeof(T);
+
+    static void encode(writer& w, const T& x) {
+        w.put8(CODE);
+        encode_element(w, x);
+    }
+
+    static void encode_element(writer& w, const T& x) {
+        typename bits_type::type b;
+        std::memcpy(&b, &x, sizeof(T));
+        bits_type::put(w, b);
+    }
+
+    static void decode(reader& r, uint8_t code, T& x) {
+        if (code != CODE) mismatch(ID);
+        typename bits_type::type b = bits_type::get(r);
+        std::memcpy(&x, &b, sizeof(T));
+    }
+};
+
+// Decimals are kept in their byte arrays the way pn_decimal32_t and
+// pn_decimal64_t hold them, as proton::value does
+template <class T, size_t N, type_id ID, uint8_t CODE> struct decimal_traits {
+    typedef bits<N> bits_type;
+    static const type_id type = ID;
+    static const uint8_t array_code = CODE;
+    static const size_t element_size = N;
+
+    static void encode(writer& w, const T& x) {
+        w.put8(CODE);
+        encode_element(w, x);
+    }
+
+    static void encode_element(writer& w, const T& x) {
+        typename bits_type::type b;
+        std::memcpy(&b, x.begin(), N);
+        bits_type::put(w, b);
+    }
+
+    static void decode(reader& r, uint8_t code, T& x) {
+        if (code != CODE) mismatch(ID);
+        typename bits_type::type b = bits_type::get(r);
+        std::memcpy(x.begin(), &b, N);
+    }
+};
+
+template <class T, type_id ID, uint8_t CODE> struct bytes16_traits {
+    static const type_id type = ID;
+    static const uint8_t array_code = CODE;
+    static const size_t element_size = 16;
+
+    static void encode(writer& w, const T& x) {
+        w.put8(CODE);
+        encode_element(w, x);
+    }
+
+    static void encode_element(writer& w, const T& x) { w.put_bytes(x.begin(), 16); }
+
+    static void decode(reader& r, uint8_t code, T& x) {
+        if (code != CODE) mismatch(ID);
+        std::memcpy(x.begin(), r.get_bytes(16), 16);
+    }
+};
+
+template <class T, type_id ID, uint8_t CODE8, uint8_t CODE32> struct variable_traits {
+    static const type_id type = ID;
+    static const uint8_t array_code = CODE32;
+    static const size_t element_size = 0;
+
+    static void encode(writer& w, const T& x) {
+        if (x.size() < 256) {
+            w.put8(CODE8);
+            w.put8(uint8_t(x.size()));
+            put(w, x);
+        } else {
+            w.put8(CODE32);
+            encode_element(w, x);
+        }
+    }
+
+    static void encode_element(writer& w, const T& x) {
+        w.put32(uint32_t(x.size()));
+        put(w, x);
+    }
+
+    static void decode(reader& r, uint8_t code, T& x) {
+        size_t size;
+        if (code == CODE8) size = r.get8();
+        else if (code == CODE32) size = r.get32();
+        else { mismatch(ID); return; }
+        const char* p = r.get_bytes(size);
+        x.assign(p, p + size);
+    }
+
+  private:
+    static void put(writer& w, const T& x) { if (!x.empty()) w.put_bytes(&x[0], x.size()); }
+};
+
+/// @endcond
+
+template <> struct traits<null> {
+    static const type_id type = NULL_TYPE;
+    static const uint8_t array_code = CODE_NULL;
+    static const size_t element_size = 0;
+    static void encode(writer& w, const null&) { w.put8(CODE_NULL); }
+    static void encode_element(writer&, const null&) {}
+    static void decode(reader&, uint8_t code, null&) { if (code != CODE_NULL) mismatch(NULL_TYPE); }
+};
+
+template <> struct traits<bool> {
+    static const type_id type = BOOLEAN;
+    static const uint8_t array_code = CODE_BOOLEAN;
+    static const size_t element_size = 1;
+    static void encode(writer& w, bool x) { w.put8(x ? CODE_TRUE : CODE_FALSE); }
+    static void encode_element(writer& w, bool x) { w.put8(x); }
+    static void decode(reader& r, uint8_t code, bool& x) {
+        switch (code) {
+          case CODE_TRUE: x = true; return;
+          case CODE_FALSE: x = false; return;
+          case CODE_BOOLEAN: x = r.get8() != 0; return;
+          default: mismatch(BOOLEAN);
+        }
+    }
+};
+
+template <> struct traits<uint8_t> : public fixed_traits<uint8_t, UBYTE, CODE_UBYTE> {};
+template <> struct traits<int8_t> : public fixed_traits<int8_t, BYTE, CODE_BYTE> {};
+template <> struct traits<uint16_t> : public fixed_traits<uint16_t, USHORT, CODE_USHORT> {};
+template <> struct traits<int16_t> : public fixed_traits<int16_t, SHORT, CODE_SHORT> {};
+template <> struct traits<float> : public fixed_traits<float, FLOAT, CODE_FLOAT> {};
+template <> struct traits<double> : public fixed_traits<double, DOUBLE, CODE_DOUBLE> {};
+
+template <> struct traits<uint32_t> {
+    static const type_id type = UINT;
+    static const uint8_t array_code = CODE_UINT;
+    static const size_t element_size = 4;
+    static void encode(writer& w, uint32_t x) {
+        if (x < 256) { w.put8(CODE_SMALLUINT); w.put8(uint8_t(x)); }
+        else { w.put8(CODE_UINT); w.put32(x); }
+    }
+    static void encode_element(writer& w, uint32_t x) { w.put32(x); }
+    static void decode(reader& r, uint8_t code, uint32_t& x) {
+        switch (code) {
+          case CODE_UINT0: x = 0; return;
+          case CODE_SMALLUINT: x = r.get8(); return;
+          case CODE_UINT: x = r.get32(); return;
+          default: mismatch(UINT);
+        }
+    }
+};
+
+template <> struct traits<int32_t> {
+    static const type_id type = INT;
+    static const uint8_t array_code = CODE_INT;
+    static const size_t element_size = 4;
+    static void encode(writer& w, int32_t x) {
+        if (-128 <= x && x <= 127) { w.put8(CODE_SMALLINT); w.put8(uint8_t(x)); }
+        else { w.put8(CODE_INT); w.put32(uint32_t(x)); }
+    }
+    static void encode_element(writer& w, int32_t x) { w.put32(uint32_t(x)); }
+    static void decode(reader& r, uint8_t code, int32_t& x) {
+        switch (code) {
+          case CODE_SMALLINT: x = int8_t(r.get8()); return;
+          case CODE_INT: x = int32_t(r.get32()); return;
+          default: mismatch(INT);
+        }
+    }
+};
+
+template <> struct traits<uint64_t> {
+    static const type_id type = ULONG;
+    static const uint8_t array_code = CODE_ULONG;
+    static const size_t element_size = 8;
+    static void encode(writer& w, uint64_t x) {
+        if (x < 256) { w.put8(CODE_SMALLULONG); w.put8(uint8_t(x)); }
+        else { w.put8(CODE_ULONG); w.put64(x); }
+    }
+    static void encode_element(writer& w, uint64_t x) { w.put64(x); }
+    static void decode(reader& r, uint8_t code, uint64_t& x) {
+        switch (code) {
+          case CODE_ULONG0: x = 0; return;
+          case CODE_SMALLULONG: x = r.get8(); return;
+          case CODE_ULONG: x = r.get64(); return;
+          default: mismatch(ULONG);
+        }
+    }
+};
+
+template <> struct traits<int64_t> {
+    static const type_id type = LONG;
+    static const uint8_t array_code = CODE_LONG;
+    static const size_t element_size = 8;
+    static void encode(writer& w, int64_t x) {
+        if (-128 <= x && x <= 127) { w.put8(CODE_SMALLLONG); w.put8(uint8_t(x)); }
+        else { w.put8(CODE_LONG); w.put64(uint64_t(x)); }
+    }
+    static void encode_element(writer& w, int64_t x) { w.put64(uint64_t(x)); }
+    static void decode(reader& r, uint8_t code, int64_t& x) {
+        switch (code) {
+          case CODE_SMALLLONG: x = int8_t(r.get8()); return;
+          case CODE_LONG: x = int64_t(r.get64()); return;
+          default: mismatch(LONG);
+        }
+    }
+};
+
+// wchar_t is not 32 bits everywhere
+template <> struct traits<wchar_t> {
+    static const type_id type = CHAR;
+    static const uint8_t array_code = CODE_CHAR;
+    static const size_t element_size = 4;
+    static void encode(writer& w, wchar_t x) { w.put8(CODE_CHAR); w.put32(uint32_t(x)); }
+    static void encode_element(writer& w, wchar_t x) { w.put32(uint32_t(x)); }
+    static void decode(reader& r, uint8_t code, wchar_t& x) {
+        if (code != CODE_CHAR) mismatch(CHAR);
+        x = wchar_t(r.get32());
+    }
+};
+
+template <> struct traits<timestamp> {
+    static const type_id type = TIMESTAMP;
+    static const uint8_t array_code = CODE_TIMESTAMP;
+    static const size_t element_size = 8;
+    static void encode(writer& w, timestamp x) { w.put8(CODE_TIMESTAMP); encode_element(w, x); }
+    static void encode_element(writer& w, timestamp x) { w.put64(uint64_t(x.milliseconds())); }
+    static void decode(reader& r, uint8_t code, timestamp& x) {
+        if (code != CODE_TIMESTAMP) mismatch(TIMESTAMP);
+        x = timestamp(timestamp::numeric_type(r.get64()));
+    }
+};
+
+template <> struct traits<decimal32> : public decimal_traits<decimal32, 4, DECIMAL32, CODE_DECIMAL32> {};
+template <> struct traits<decimal64> : public decimal_traits<decimal64, 8, DECIMAL64, CODE_DECIMAL64> {};
+template <> struct traits<decimal128> : public bytes16_traits<decimal128, DECIMAL128, CODE_DECIMAL128> {};
+template <> struct traits<uuid> : public bytes16_traits<uuid, UUID, CODE_UUID> {};
+
+template <> struct traits<std::string> : public variable_traits<std::string, STRING, CODE_STR8, CODE_STR32> {};
+template <> struct traits<symbol> : public variable_traits<symbol, SYMBOL, CODE_SYM8, CODE_SYM32> {};
+template <> struct traits<binary> : public variable_traits<binary, BINARY, CODE_VBIN8, CODE_VBIN32> {};
+
+/// Integer types without a type_id of their own are encoded as the
+/// known integer type of the same size and signedness.
+template <class T> struct traits<T, typename internal::enable_if<internal::is_unknown_integer<T>::value>::type> {
+    typedef typename internal::integer_type<sizeof(T), internal::is_signed<T>::value>::type known_type;
+    typedef traits<known_type> known;
+    static const type_id type = known::type;
+    static const uint8_t array_code = known::array_code;
+    static const size_t element_size = known::element_size;
+    static void encode(writer& w, T x) { known::encode(w, known_type(x)); }
+    static void encode_element(writer& w, T x) { known::encode_element(w, known_type(x)); }
+    static void decode(reader& r, uint8_t code, T& x) {
+        known_type k;
+        known::decode(r, code, k);
+        x = T(k);
+    }
+};
+
+/// A proton::value is encoded through its pn_data_t, for parts of a
+/// message whose type is only known at run time. It cannot be an array
+/// element.
+template <> struct traits<value> {
+    static void encode(writer& w, const value& x) {
+        value v;
+        encoder e(v);
+        e << x;
+        std::string bytes = e.encode();
+        w.put_bytes(bytes.data(), bytes.size());
+    }
+
+    static void decode(reader& r, uint8_t code, value& x) {
+        const char* start = r.position() - 1;
+        r.skip(code);
+        x.clear();
+        decoder d(x);
+        d.decode(start, size_t(r.position() - start));
+    }
+};
+
+/// @cond INTERNAL
+
+// AMQP array of T, or list of T when decoding
+template <class S> struct array_traits {
+    typedef typename S::value_type element;
+    static const type_id type = ARRAY;
+    static const uint8_t array_code = CODE_ARRAY32;
+    static const size_t element_size = 0;
+
+    static void encode(writer& w, const S& x) {
+        w.put8(CODE_ARRAY32);
+        encode_element(w, x);
+    }
+
+    static void encode_element(writer& w, const S& x) {
+        // Known exactly at compile time for fixed size elements
+        w.reserve(9 + x.size() * traits<element>::element_size);
+        size_t at = begin_compound(w, uint32_t(x.size()));
+        w.put8(traits<element>::array_code);
+        for (typename S::const_iterator i = x.begin(); i != x.end(); ++i)
+            traits<element>::encode_element(w, *i);
+        end_compound(w, at);
+    }
+
+    static void decode(reader& r, uint8_t code, S& x) {
+        x.clear();
+        if (code == CODE_LIST0 || code == CODE_LIST8 || code == CODE_LIST32) {
+            uint32_t count = read_count(r, code, LIST);
+            x.reserve(std::min(size_t(count), r.remaining()));
+            for (uint32_t i = 0; i < count; ++i)
+                append(r, r.get8(), x);
+        } else {
+            uint32_t count = read_count(r, code, ARRAY);
+            uint8_t element_code = r.get8();
+            x.reserve(std::min(size_t(count), r.remaining()));
+            for (uint32_t i = 0; i < count; ++i)
+                append(r, element_code, x);
+        }
+    }
+
+  private:
+    template <class C> static void append(reader& r, uint8_t code, C& x) {
+        x.push_back(element());
+        traits<element>::decode(r, code, x.back());
+    }
+
+    // No references to the elements of a std::vector<bool>
+    template <class A> static void append(reader& r, uint8_t code, std::vector<bool, A>& x) {
+        bool b;
+        traits<bool>::decode(r, code, b);
+        x.push_back(b);
+    }
+};
+
+// AMQP list of mixed types
+template <class S> struct list_sequence_traits {
+    typedef typename S::value_type element;
+    static const type_id type = LIST;
+    static const uint8_t array_code = CODE_LIST32;
+    static const size_t element_size = 0;
+
+    static void encode(writer& w, const S& x) {
+        if (x.empty()) {
+            w.put8(CODE_LIST0);
+        } else {
+            w.put8(CODE_LIST32);
+            encode_element(w, x);
+        }
+    }
+
+    static void encode_element(writer& w, const S& x) {
+        size_t at = begin_compound(w, uint32_t(x.size()));
+        for (typename S::const_iterator i = x.begin(); i != x.end(); ++i)
+            traits<element>::encode(w, *i);
+        end_compound(w, at);
+    }
+
+    static void decode(reader& r, uint8_t code, S& x) {
+        uint32_t count = read_count(r, code, LIST);
+        x.clear();
+        x.reserve(std::min(size_t(count), r.remaining()));
+        for (uint32_t i = 0; i < count; ++i) {
+            x.push_back(element());
+            traits<element>::decode(r, r.get8(), x.back());
+        }
+    }
+};
+
+// AMQP map from a C++ map or a sequence of pairs
+template <class M, class K, class T> struct map_traits {
+    static const type_id type = MAP;
+    static const uint8_t array_code = CODE_MAP32;
+    static const size_t element_size = 0;
+
+    static void encode(writer& w, const M& x) {
+        w.put8(CODE_MAP32);
+        encode_element(w, x);
+    }
+
+    static void encode_element(writer& w, const M& x) {
+        size_t at = begin_compound(w, uint32_t(2 * x.size()));
+        for (typename M::const_iterator i = x.begin(); i != x.end(); ++i) {
+            traits<K>::encode(w, i->first);
+            traits<T>::encode(w, i->second);
+        }
+        end_compound(w, at);
+    }
+
+    static void decode(reader& r, uint8_t code, M& x) {
+        uint32_t count = read_count(r, code, MAP);
+        x.clear();
+        for (uint32_t i = 0; i < count / 2; ++i) {
+            K k;
+            T v;
+            traits<K>::decode(r, r.get8(), k);
+            traits<T>::decode(r, r.get8(), v);
+            insert(x, k, v);
+        }
+    }
+
+  private:
+    template <class C> static void insert(C& x, const K& k, const T& v) { x[k] = v; }
+    template <class A> static void insert(std::vector<std::pair<K, T>, A>& x, const K& k, const T& v) {
+        x.push_back(std::make_pair(k, v));
+    }
+};
+
+/// @endcond
+
+/// std::vector<T> is an AMQP array, as with proton::value.
+template <class T, class A> struct traits<std::vector<T, A> > : public array_traits<std::vector<T, A> > {};
+
+/// std::vector<value> is an AMQP list.
+template <class A> struct traits<std::vector<value, A> > : public list_sequence_traits<std::vector<value, A> > {};
+
+/// std::vector<std::pair<K, T> > is an AMQP map that keeps the order of its entries.
+template <class K, class T, class A> struct traits<std::vector<std::pair<K, T>, A> >
+    : public map_traits<std::vector<std::pair<K, T>, A>, K, T> {};
+
+template <class K, class T, class C, class A> struct traits<std::map<K, T, C, A> >
+    : public map_traits<std::map<K, T, C, A>, K, T> {};
+
+#if PN_CPP_HAS_CPP11
+template <class K, class T, class H, class E, class A> struct traits<std::unordered_map<K, T, H, E, A> >
+    : public map_traits<std::unordered_map<K, T, H, E, A>, K, T> {};
+#endif
+
+/// @cond INTERNAL
+
+class field_writer {
+  public:
+    explicit field_writer(writer& w) : w_(w), count_(0) {}
+    template <class F> field_writer& operator()(const F& f) {
+        traits<F>::encode(w_, f);
+        ++count_;
+        return *this;
+    }
+    uint32_t count() const { return count_; }
+
+  private:
+    writer& w_;
+    uint32_t count_;
+};
+
+class field_reader {
+  public:
+    field_reader(reader& r, uint32_t count) : r_(r), remaining_(count) {}
+    template <class F> field_reader& operator()(F& f) {
+        if (remaining_) {
+            --remaining_;
+            uint8_t code = r_.get8();
+            if (code != CODE_NULL) traits<F>::decode(r_, code, f);
+        }
+        return *this;
+    }
+    uint32_t remaining() const { return remaining_; }
+
+  private:
+    reader& r_;
+    uint32_t remaining_;
+};
+
+/// @endcond
+
+/// **Unsettled API** - Base for the traits of a user struct encoded
+/// as an AMQP list of its fields.
+///
+/// Derive traits<T> from list_traits<T> and give it a `fields`
+/// template that passes each field to a visitor in order. The
+/// visitor returns itself so calls can be chained:
+///
+///     struct point { int32_t x, y; std::string label; };
+///
+///     namespace proton { namespace codec { namespace typed {
+///     template <> struct traits<point> : public list_traits<point> {
+///         template <class V, class P> static void fields(V& v, P& p) { v(p.x)(p.y)(p.label); }
+///     };
+///     }}}
+///
+/// A decoded field that is null or missing from the end of the list
+/// keeps its value. Extra elements at the end of the list are ignored.
+template <class T> struct list_traits {
+    static const type_id type = LIST;
+    static const uint8_t array_code = CODE_LIST32;
+    static const size_t element_size = 0;
+
+    static void encode(writer& w, const T& x) {
+        w.put8(CODE_LIST32);
+        encode_element(w, x);
+    }
+
+    static void encode_element(writer& w, const T& x) {
+        size_t at = begin_compound(w, 0);
+        field_writer fw(w);
+        traits<T>::fields(fw, x);
+        end_compound(w, at);
+        w.put32_at(at + 4, fw.count());
+    }
+
+    static void decode(reader& r, uint8_t code, T& x) {
+        field_reader fr(r, read_count(r, code, LIST));
+        traits<T>::fields(fr, x);
+        for (uint32_t i = fr.remaining(); i > 0; --i)
+            r.skip(r.get8());
+    }
+};
+
+/// Encode x as AMQP bytes, replacing the contents of out.
+template <class T> void encode(const T& x, std::string& out) {
+    out.clear();
+    writer w(out);
+    traits<T>::encode(w, x);
+}
+
+/// Encode x as AMQP bytes.
+template <class T> std::string encode(const T& x) {
+    std::string s;
+    encode(x, s);
+    return s;
+}
+
+/// Decode one value from the start of bytes into x.
+///
+/// @return the number of bytes decoded.
+/// @throw conversion_error if the bytes do not hold an encoding of the
+/// AMQP type of T.
+template <class T> size_t decode(const char* bytes, size_t size, T& x) {
+    reader r(bytes, bytes + size);
+    traits<T>::decode(r, r.get8(), x);
+    return size_t(r.position() - bytes);
+}
+
+/// Decode one value from the start of s into x.
+template <class T> size_t decode(const std::string& s, T& x) { return decode(s.data(), s.size(), x); }
+
+/// Decode one value from the start of b into x.
+template <class T> size_t decode(const binary& b, T& x) {
+    return decode(b.empty() ? 0 : reinterpret_cast<const char*>(&b[0]), b.size(), x);
+}
+
+} // typed
+} // codec
+} // proton
+
+#endif // PROTON_CODEC_TYPED_HPP
@@ -201,6 +201,14 @@ class connection_options {
     /// If both the failover_urls and reconnect_url options are set then the behavior is not defined.
     PN_CPP_EXTERN connection_options& failover_urls(const std::vector<std::string>&);
 
+    /// **Unsettled API** - Set the maximum number of pending items
+    /// on the connection's work_queue.
+    ///
+    /// When the queue is full work_queue::add() returns false rather
+    /// than queuing more work, leaving the caller to retry or shed
+    /// load.  The default is 0, meaning no limit.
+    PN_CPP_EXTERN connection_options& work_queue_capacity(size_t);
+
     /// Update option values from values set in other.
     PN_CPP_EXTERN connection_options& update(const connection_options& other);
 
@@ -210,6 +218,7 @@ class connection_options {
     void apply_unbound_client(pn_transport_t*) const;
     void apply_unbound_server(pn_transport_t*) const;
     messaging_handler* handler() const;
+    size_t work_queue_capacity() const;
 
     class impl;
     internal::pn_unique_ptr<impl> impl_;
@@ -38,6 +38,7 @@ class duration;
 class error_condition;
 class event;
 class message;
+class message_view;
 class message_id;
 class messaging_handler;
 class listen_handler;
@@ -40,6 +40,8 @@
 /// @copybrief proton::message
 
 struct pn_message_t;
+struct pn_link_t;
+struct pn_delivery_t;
 
 namespace proton {
 
@@ -325,9 +327,16 @@ class message {
     struct impl;
     pn_message_t* pn_msg() const;
     struct impl& impl() const;
+    void send(pn_link_t*) const;
+    void decode(const char*, size_t);
+    void decode(pn_delivery_t*);
 
     mutable pn_message_t* pn_msg_;
 
+  friend class sender;
+  friend class message_view;
+  friend class messaging_adapter;
+
   PN_CPP_EXTERN friend void swap(message&, message&);
     /// @endcond
 };
@@ -68,6 +68,7 @@ class message_id : public scalar_base {
 
     ///@cond INTERNAL
   friend class message;
+  friend class message_view;
   friend class codec::decoder;
     ///@endcond
 };
@@ -0,0 +1,116 @@
+#ifndef PROTON_MESSAGE_VIEW_HPP
+#define PROTON_MESSAGE_VIEW_HPP
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "./fwd.hpp"
+#include "./internal/export.hpp"
+#include "./duration.hpp"
+#include "./message_id.hpp"
+#include "./symbol.hpp"
+#include "./timestamp.hpp"
+#include "./value.hpp"
+
+#include <proton/type_compat.h>
+
+#include <string>
+
+/// @file
+/// @copybrief proton::message_view
+
+struct pn_message_view_t;
+
+namespace proton {
+
+/// **Unsettled API** - A read-only view of a received message.
+///
+/// A message_view refers directly to the bytes of a delivery and only
+/// decodes the fields that are asked for, which is much cheaper than
+/// decoding a complete proton::message when a few fields are enough,
+/// for example to route a message. The original bytes can be sent on
+/// unchanged with sender::send(const message_view&).
+///
+/// A view can be made from the delivery passed to
+/// messaging_handler::on_message() and is only valid until that
+/// delivery is settled or on_message() returns.
+class message_view {
+  public:
+    /// Create an empty view.
+    PN_CPP_EXTERN message_view();
+
+    /// View the message held by a complete delivery.
+    PN_CPP_EXTERN explicit message_view(const delivery&);
+
+    PN_CPP_EXTERN ~message_view();
+
+    /// View the message held by a complete delivery, replacing any
+    /// previous one.
+    PN_CPP_EXTERN void view(const delivery&);
+
+    /// Decode the complete message into m.
+    PN_CPP_EXTERN void decode(message& m) const;
+
+    /// @name Header fields
+    /// @{
+    PN_CPP_EXTERN bool durable() const;
+    PN_CPP_EXTERN uint8_t priority() const;
+    PN_CPP_EXTERN duration ttl() const;
+    PN_CPP_EXTERN bool first_acquirer() const;
+    PN_CPP_EXTERN uint32_t delivery_count() const;
+    /// @}
+
+    /// @name Properties fields
+    /// @{
+    PN_CPP_EXTERN message_id id() const;
+    PN_CPP_EXTERN std::string user() const;
+    PN_CPP_EXTERN std::string to() const;
+    PN_CPP_EXTERN std::string address() const;
+    PN_CPP_EXTERN std::string subject() const;
+    PN_CPP_EXTERN std::string reply_to() const;
+    PN_CPP_EXTERN message_id correlation_id() const;
+    PN_CPP_EXTERN std::string content_type() const;
+    PN_CPP_EXTERN std::string content_encoding() const;
+    PN_CPP_EXTERN timestamp expiry_time() const;
+    PN_CPP_EXTERN timestamp creation_time() const;
+    PN_CPP_EXTERN std::string group_id() const;
+    PN_CPP_EXTERN int32_t group_sequence() const;
+    PN_CPP_EXTERN std::string reply_to_group_id() const;
+    /// @}
+
+    /// Get an application property, or an empty value if there is no
+    /// property with this key.
+    PN_CPP_EXTERN value property(const std::string& key) const;
+
+    /// @cond INTERNAL
+  private:
+    message_view(const message_view&);
+    message_view& operator=(const message_view&);
+
+    pn_message_view_t* view_;
+
+  friend class sender;
+    /// @endcond
+};
+
+} // proton
+
+#endif // PROTON_MESSAGE_VIEW_HPP
@@ -57,6 +57,10 @@ PN_CPP_CLASS_EXTERN sender : public link {
     /// Send a message on the sender.
     PN_CPP_EXTERN tracker send(const message &m);
 
+    /// **Unsettled API** - Send the original bytes of a viewed message
+    /// unchanged, without decoding or re-encoding it.
+    PN_CPP_EXTERN tracker send(const message_view &m);
+
     /// Get the source node.
     PN_CPP_EXTERN class source source() const;
 
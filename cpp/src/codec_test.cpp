@@ -19,10 +19,36 @@
 
 #include "test_bits.hpp"
 
+#include "proton/codec/typed.hpp"
 #include "proton/internal/data.hpp"
 #include "proton/internal/config.hpp"
 #include "proton/types.hpp"
 
+struct point {
+    int32_t x, y;
+    std::string label;
+    point() : x(0), y(0) {}
+    point(int32_t x_, int32_t y_, const std::string& l) : x(x_), y(y_), label(l) {}
+};
+
+inline bool operator==(const point& a, const point& b) {
+    return a.x == b.x && a.y == b.y && a.label == b.label;
+}
+
+inline std::ostream& operator<<(std::ostream& o, const point& p) {
+    return o << "point(" << p.x << ", " << p.y << ", " << p.label << ")";
+}
+
+namespace proton {
+namespace codec {
+namespace typed {
+template <> struct traits<point> : public list_traits<point> {
+    template <class V, class P> static void fields(V& v, P& p) { v(p.x)(p.y)(p.label); }
+};
+}
+}
+}
+
 namespace {
 
 using namespace proton;
@@ -47,6 +73,94 @@ template <class T> void  uncodable_type_test() {
     ASSERT(!codec::is_encodable<T>::value);
 }
 
+// The typed codec encodes the same bytes as proton::value and decodes them
+template <class T> void typed_type_test(const T& x) {
+    value v;
+    codec::encoder e(v);
+    e << x;
+    std::string want = e.encode();
+    std::string got = codec::typed::encode(x);
+    ASSERT_EQUAL(binary(want), binary(got));
+    T y;
+    ASSERT_EQUAL(got.size(), codec::typed::decode(got, y));
+    ASSERT_EQUAL(x, y);
+}
+
+void typed_map_test() {
+    std::map<std::string, int64_t> m;
+    m["a"] = 1;
+    m["b"] = -1000;
+    typed_type_test(m);
+    std::map<symbol, std::vector<uint32_t> > mv;
+    mv[symbol("a")] = std::vector<uint32_t>(2, 1);
+    typed_type_test(mv);
+    std::unordered_map<uint32_t, std::string> um;
+    um[1] = "a";
+    typed_type_test(um);
+}
+
+void typed_struct_test() {
+    std::vector<point> points;
+    points.push_back(point(1, -2, "a"));
+    points.push_back(point(300000, 4, std::string(300, 'b')));
+    std::string bytes = codec::typed::encode(points);
+
+    // A point is a list of its fields
+    std::vector<value> fields;
+    fields.push_back(value(int32_t(300000)));
+    fields.push_back(value(int32_t(4)));
+    fields.push_back(value(std::string(300, 'b')));
+    value v;
+    codec::encoder e(v);
+    e << fields;
+    ASSERT_EQUAL(binary(e.encode()), binary(codec::typed::encode(points[1])));
+
+    std::vector<point> decoded;
+    ASSERT_EQUAL(bytes.size(), codec::typed::decode(bytes, decoded));
+    ASSERT_EQUAL(points, decoded);
+
+    // Missing and null fields keep their value, extra ones are ignored
+    fields.clear();
+    fields.push_back(value(int32_t(5)));
+    fields.push_back(value());
+    point p(0, 7, "c");
+    codec::typed::decode(codec::typed::encode(fields), p);
+    ASSERT_EQUAL(point(5, 7, "c"), p);
+    fields.push_back(value(std::string("d")));
+    fields.push_back(value(symbol("extra")));
+    codec::typed::decode(codec::typed::encode(fields), p);
+    ASSERT_EQUAL(point(5, 7, "d"), p);
+}
+
+void typed_value_test() {
+    std::map<std::string, value> m;
+    m["int"] = int32_t(42);
+    m["list"] = std::vector<value>(2, value(symbol("x")));
+    m["null"] = value();
+    typed_type_test(m);
+}
+
+void typed_decode_test() {
+    // Any encoding of the type is accepted, lists and arrays for vectors
+    std::vector<value> list;
+    list.push_back(value(uint32_t(0)));
+    list.push_back(value(uint32_t(1000)));
+    std::vector<uint32_t> got;
+    codec::typed::decode(codec::typed::encode(list), got);
+    ASSERT_EQUAL(2u, got.size());
+    ASSERT_EQUAL(1000u, got[1]);
+    uint32_t u = 1;
+    codec::typed::decode(std::string("\x43"), u);
+    ASSERT_EQUAL(0u, u);
+
+    std::string bytes = codec::typed::encode(std::string("hello"));
+    std::string s;
+    ASSERT_THROWS(conversion_error, codec::typed::decode(bytes.substr(0, 4), s));
+    symbol sym;
+    ASSERT_THROWS_MSG(conversion_error, "want: symbol", codec::typed::decode(bytes, sym));
+    ASSERT_THROWS(conversion_error, codec::typed::decode(std::string(), s));
+}
+
 }
 
 int main(int, char**) {
@@ -104,6 +218,47 @@ int main(int, char**) {
     RUN_TEST(failed, simple_type_test(annotation_key(42)));
     RUN_TEST(failed, simple_type_test(message_id(42)));
 
+    // Typed codec
+    RUN_TEST(failed, typed_type_test(null()));
+    RUN_TEST(failed, typed_type_test(true));
+    RUN_TEST(failed, typed_type_test(uint8_t(42)));
+    RUN_TEST(failed, typed_type_test(int8_t(-42)));
+    RUN_TEST(failed, typed_type_test(uint16_t(4242)));
+    RUN_TEST(failed, typed_type_test(int16_t(-4242)));
+    RUN_TEST(failed, typed_type_test(uint32_t(42)));
+    RUN_TEST(failed, typed_type_test(uint32_t(424242)));
+    RUN_TEST(failed, typed_type_test(int32_t(-42)));
+    RUN_TEST(failed, typed_type_test(int32_t(-424242)));
+    RUN_TEST(failed, typed_type_test(uint64_t(42)));
+    RUN_TEST(failed, typed_type_test(uint64_t(4242424242424242ULL)));
+    RUN_TEST(failed, typed_type_test(int64_t(-42)));
+    RUN_TEST(failed, typed_type_test(int64_t(-4242424242424242LL)));
+    RUN_TEST(failed, typed_type_test(wchar_t('X')));
+    RUN_TEST(failed, typed_type_test(float(1.234)));
+    RUN_TEST(failed, typed_type_test(double(11.2233)));
+    RUN_TEST(failed, typed_type_test(timestamp(1234)));
+    RUN_TEST(failed, typed_type_test(make_fill<decimal32>(1)));
+    RUN_TEST(failed, typed_type_test(make_fill<decimal64>(2)));
+    RUN_TEST(failed, typed_type_test(make_fill<decimal128>(3)));
+    RUN_TEST(failed, typed_type_test(uuid::copy("\x00\x11\x22\x33\x44\x55\x66\x77\x88\x99\xaa\xbb\xcc\xdd\xee\xff")));
+    RUN_TEST(failed, typed_type_test(std::string("xxx")));
+    RUN_TEST(failed, typed_type_test(std::string(1000, 'x')));
+    RUN_TEST(failed, typed_type_test(symbol("aaa")));
+    RUN_TEST(failed, typed_type_test(binary("aaa")));
+    RUN_TEST(failed, typed_type_test(short(42)));
+    RUN_TEST(failed, typed_type_test(static_cast<unsigned long>(42)));
+    RUN_TEST(failed, typed_type_test(std::vector<int32_t>(3, 42)));
+    RUN_TEST(failed, typed_type_test(std::vector<std::string>(2, "xx")));
+    RUN_TEST(failed, typed_type_test(std::vector<bool>(2, true)));
+    RUN_TEST(failed, typed_type_test(std::vector<uint64_t>()));
+    RUN_TEST(failed, typed_type_test(std::vector<value>()));
+    RUN_TEST(failed, typed_type_test(std::vector<value>(2, value("x"))));
+    RUN_TEST(failed, typed_type_test(std::vector<std::pair<symbol, int64_t> >(2, std::make_pair(symbol("k"), int64_t(1)))));
+    RUN_TEST(failed, typed_map_test());
+    RUN_TEST(failed, typed_struct_test());
+    RUN_TEST(failed, typed_value_test());
+    RUN_TEST(failed, typed_decode_test());
+
     // Make sure we reject uncodable types
     RUN_TEST(failed, (uncodable_type_test<std::pair<int, float> >()));
     RUN_TEST(failed, (uncodable_type_test<std::pair<scalar, value> >()));
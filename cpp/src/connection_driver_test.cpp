@@ -27,6 +27,7 @@
 #include "proton/io/connection_driver.hpp"
 #include "proton/link.hpp"
 #include "proton/message.hpp"
+#include "proton/message_view.hpp"
 #include "proton/messaging_handler.hpp"
 #include "proton/receiver_options.hpp"
 #include "proton/sender.hpp"
@@ -490,6 +491,54 @@ void test_message() {
     ASSERT_EQUAL(value("b"), m2.message_annotations().get("a"));
 }
 
+// Route on a message_view and forward the original bytes
+struct forward_handler : public record_handler {
+    sender forward;
+    std::deque<std::string> addresses;
+
+    void on_message(proton::delivery& d, proton::message& m) PN_CPP_OVERRIDE {
+        message_view v(d);
+        addresses.push_back(v.to());
+        ASSERT_EQUAL(value("y"), v.property("x"));
+        ASSERT(v.property("z").empty());
+        ASSERT(v.durable());
+        forward.send(v);
+        record_handler::on_message(d, m);
+    }
+};
+
+void test_message_view() {
+    record_handler ha;
+    forward_handler hb;
+    driver_pair d(ha, hb);
+
+    proton::sender s = d.a.connection().open_sender("x");
+    while (hb.receivers.empty())
+        d.process();
+    hb.forward = d.b.connection().open_sender("fwd");
+    while (ha.receivers.empty())
+        d.process();
+
+    proton::message m("barefoot");
+    m.to("somewhere");
+    m.durable(true);
+    m.properties().put("x", "y");
+    m.message_annotations().put("a", "b");
+    s.send(m);
+
+    while (ha.messages.size() == 0)
+        d.process();
+
+    ASSERT_EQUAL("somewhere", quick_pop(hb.addresses));
+    proton::message m2 = quick_pop(hb.messages);
+    ASSERT_EQUAL(value("barefoot"), m2.body());
+    proton::message m3 = quick_pop(ha.messages);
+    ASSERT_EQUAL("somewhere", m3.to());
+    ASSERT_EQUAL(value("barefoot"), m3.body());
+    ASSERT_EQUAL(value("y"), m3.properties().get("x"));
+    ASSERT_EQUAL(value("b"), m3.message_annotations().get("a"));
+}
+
 void test_message_timeout_succeed() {
     // Verify a message arrives intact
     record_handler ha, hb;
@@ -549,6 +598,7 @@ int main(int argc, char** argv) {
     RUN_ARGV_TEST(failed, test_link_anonymous_dynamic());
     RUN_ARGV_TEST(failed, test_link_capability_filter());
     RUN_ARGV_TEST(failed, test_message());
+    RUN_ARGV_TEST(failed, test_message_view());
     RUN_ARGV_TEST(failed, test_message_timeout_succeed());
     RUN_ARGV_TEST(failed, test_message_timeout_fail());
     return failed;
@@ -75,6 +75,7 @@ class connection_options::impl {
     option<bool> sasl_allow_insecure_mechs;
     option<std::string> sasl_config_name;
     option<std::string> sasl_config_path;
+    option<size_t> work_queue_capacity;
 
     /*
      * There are three types of connection options: the handler
@@ -209,6 +210,7 @@ class connection_options::impl {
         sasl_allowed_mechs.update(x.sasl_allowed_mechs);
         sasl_config_name.update(x.sasl_config_name);
         sasl_config_path.update(x.sasl_config_path);
+        work_queue_capacity.update(x.work_queue_capacity);
     }
 
 };
@@ -260,6 +262,7 @@ connection_options& connection_options::sasl_allow_insecure_mechs(bool b) { impl
 connection_options& connection_options::sasl_allowed_mechs(const std::string &s) { impl_->sasl_allowed_mechs = s; return *this; }
 connection_options& connection_options::sasl_config_name(const std::string &n) { impl_->sasl_config_name = n; return *this; }
 connection_options& connection_options::sasl_config_path(const std::string &p) { impl_->sasl_config_path = p; return *this; }
+connection_options& connection_options::work_queue_capacity(size_t n) { impl_->work_queue_capacity = n; return *this; }
 
 void connection_options::apply_unbound(connection& c) const { impl_->apply_unbound(c); }
 void connection_options::apply_reconnect_urls(pn_connection_t *c) const { impl_->apply_reconnect_urls(c); }
@@ -267,5 +270,6 @@ void connection_options::apply_unbound_client(pn_transport_t *t) const { impl_->
 void connection_options::apply_unbound_server(pn_transport_t *t) const { impl_->apply_sasl(t); impl_->apply_ssl(t, false); impl_->apply_transport(t); }
 
 messaging_handler* connection_options::handler() const { return impl_->handler.value; }
+size_t connection_options::work_queue_capacity() const { return impl_->work_queue_capacity.value; }
 
 } // namespace proton
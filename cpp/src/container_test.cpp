@@ -37,6 +37,8 @@
 #include <string>
 #include <cstdio>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #if PN_CPP_SUPPORTS_THREADS
 # include <thread>
@@ -340,6 +342,31 @@ int test_container_schedule_stop() {
     return 0;
 }
 
+struct schedule_order_tester : public proton::messaging_handler {
+    std::vector<int> ran;
+
+    void run(int delay) { ran.push_back(delay); }
+    void stop(proton::container* c) { c->stop(); }
+
+    void on_container_start(proton::container& c) PN_CPP_OVERRIDE {
+        // Spread over several levels of the timer wheel, out of order
+        const int delays[] = { 300, 10, 150, 10, 0, 70, 1100 };
+        for (size_t i = 0; i < sizeof(delays)/sizeof(delays[0]); ++i)
+            c.schedule(proton::duration(delays[i]), proton::make_work(&schedule_order_tester::run, this, delays[i]));
+        c.schedule(proton::duration(1200), proton::make_work(&schedule_order_tester::stop, this, &c));
+    }
+};
+
+int test_container_schedule_order() {
+    schedule_order_tester tester;
+    proton::container c(tester);
+    c.auto_stop(false);
+    c.run();
+    const int expect[] = { 0, 10, 10, 70, 150, 300, 1100 };
+    ASSERT_EQUAL(std::vector<int>(expect, expect + sizeof(expect)/sizeof(expect[0])), tester.ran);
+    return 0;
+}
+
 class link_test_handler : public proton::messaging_handler {//, public proton::listen_handler {
   public:
     bool had_receiver;
@@ -578,6 +605,105 @@ void test_container_mt_close_race() {
     }
 }
 
+class work_recorder {
+  public:
+    std::vector<std::pair<int, int> > done_;
+
+    void record(int producer, int n) { done_.push_back(std::make_pair(producer, n)); }
+};
+
+void test_container_mt_work_queue() {
+    test_mt_handler_wq th;
+    proton::container c(th);
+    c.auto_stop(false);
+    container_runner runner(c);
+    auto t = std::thread(runner);
+    // Must ensure that thread is joined
+    try {
+        test_listen_handler lh;
+        ASSERT_EQUAL("start", th.wait());
+        c.listen("//:0", lh);       //  Also opens a connection
+        ASSERT_EQUAL("open", th.wait());
+
+        // Several threads adding at once, the work runs serially on the
+        // connection thread so the recorder needs no lock.
+        const int producers = 4, count = 2000;
+        work_recorder r;
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p) {
+            threads.push_back(std::thread([&th, &r, p, count]() {
+                for (int n = 0; n < count; ++n)
+                    ASSERT(th.wq_->add(proton::make_work(&work_recorder::record, &r, p, n)));
+            }));
+        }
+        for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+        th.wq_->add([&th]() { th.set("ran"); });
+        ASSERT_EQUAL("ran", th.wait());
+
+        ASSERT_EQUAL(size_t(producers * count), r.done_.size());
+        std::vector<int> next(producers, 0);
+        for (size_t i = 0; i < r.done_.size(); ++i) {
+            ASSERT_EQUAL(next[r.done_[i].first], r.done_[i].second);
+            ++next[r.done_[i].first];
+        }
+        c.stop();
+        t.join();
+    } catch (const std::exception& e) {
+        std::cerr << FAIL_MSG(e.what()) << std::endl;
+        t.join();
+        throw;
+    }
+}
+
+void test_container_mt_work_queue_capacity() {
+    test_mt_handler_wq th;
+    proton::container c(th);
+    c.auto_stop(false);
+    const size_t capacity = 8;
+    c.client_connection_options(proton::connection_options().work_queue_capacity(capacity));
+    c.server_connection_options(proton::connection_options().work_queue_capacity(capacity));
+    container_runner runner(c);
+    auto t = std::thread(runner);
+    // Must ensure that thread is joined
+    try {
+        test_listen_handler lh;
+        ASSERT_EQUAL("start", th.wait());
+        c.listen("//:0", lh);       //  Also opens a connection
+        ASSERT_EQUAL("open", th.wait());
+
+        // Hold the connection thread in a job while the queue fills up
+        std::mutex m;
+        std::condition_variable cv;
+        bool release = false;
+        ASSERT(th.wq_->add([&]() {
+            th.set("blocked");
+            std::unique_lock<std::mutex> l(m);
+            while (!release) cv.wait(l);
+        }));
+        ASSERT_EQUAL("blocked", th.wait());
+        work_recorder r;
+        for (size_t n = 0; n < capacity; ++n)
+            ASSERT(th.wq_->add(proton::make_work(&work_recorder::record, &r, 0, int(n))));
+        ASSERT(!th.wq_->add(proton::make_work(&work_recorder::record, &r, 0, -1)));
+        {
+            std::lock_guard<std::mutex> l(m);
+            release = true;
+            cv.notify_one();
+        }
+        // Space again once the queue has run
+        while (!th.wq_->add([&th]() { th.set("ran"); }))
+            std::this_thread::yield();
+        ASSERT_EQUAL("ran", th.wait());
+        ASSERT_EQUAL(capacity, r.done_.size());
+        c.stop();
+        t.join();
+    } catch (const std::exception& e) {
+        std::cerr << FAIL_MSG(e.what()) << std::endl;
+        t.join();
+        throw;
+    }
+}
+
 #endif
 
 } // namespace
@@ -596,12 +722,15 @@ int main(int argc, char** argv) {
     RUN_ARGV_TEST(failed, test_container_immediate_stop());
     RUN_ARGV_TEST(failed, test_container_pre_stop());
     RUN_ARGV_TEST(failed, test_container_schedule_stop());
+    RUN_ARGV_TEST(failed, test_container_schedule_order());
     RUN_ARGV_TEST(failed, test_container_links_no_properties());
     RUN_ARGV_TEST(failed, test_container_links_properties());
 #if PN_CPP_SUPPORTS_THREADS
     RUN_ARGV_TEST(failed, test_container_mt_stop_empty());
     RUN_ARGV_TEST(failed, test_container_mt_stop());
     RUN_ARGV_TEST(failed, test_container_mt_close_race());
+    RUN_ARGV_TEST(failed, test_container_mt_work_queue());
+    RUN_ARGV_TEST(failed, test_container_mt_work_queue_capacity());
 #endif
     return failed;
 }
@@ -77,6 +77,7 @@ void encoder::encode(std::string& s) {
         assert(!s.empty());
         encode(&s[0], size);
     }
+    s.resize(size);
 }
 
 std::string encoder::encode() {
@@ -269,22 +269,22 @@ const message::annotation_map& message::delivery_annotations() const {
     return impl().instructions;
 }
 
+// Build the data tree once, size the vector from it and encode into it
 void message::encode(std::vector<char> &s) const {
     impl().flush();
-    size_t sz = std::max(s.capacity(), size_t(512));
-    while (true) {
-        s.resize(sz);
-        assert(!s.empty());
-        int err = pn_message_encode(pn_msg(), const_cast<char*>(&s[0]), &sz);
-        if (err) {
-            if (err != PN_OVERFLOW)
-                check(err);
-        } else {
-            s.resize(sz);
-            return;
-        }
-        sz *= 2;
-    }
+    ssize_t sz = pni_message_prepare(pn_msg());
+    if (sz < 0) check(int(sz));
+    s.resize(sz);
+    ssize_t len = pni_message_encode_prepared(pn_msg(), s.empty() ? 0 : &s[0], s.size());
+    if (len < 0) check(int(len));
+    s.resize(len);
+}
+
+// Encode straight into the current delivery on l and advance it
+void message::send(pn_link_t *l) const {
+    impl().flush();
+    ssize_t err = pn_message_send(pn_msg(), l, 0);
+    if (err < 0) check(int(err));
 }
 
 std::vector<char> message::encode() const {
@@ -296,8 +296,17 @@ std::vector<char> message::encode() const {
 void message::decode(const std::vector<char> &s) {
     if (s.empty())
         throw error("message decode: no data");
+    decode(&s[0], s.size());
+}
+
+void message::decode(const char* bytes, size_t size) {
+    impl().clear();
+    check(pn_message_decode(pn_msg(), bytes, size));
+}
+
+void message::decode(pn_delivery_t* d) {
     impl().clear();
-    check(pn_message_decode(pn_msg(), &s[0], s.size()));
+    check(pn_message_recv(pn_msg(), d));
 }
 
 bool message::durable() const { return pn_message_is_durable(pn_msg()); }
@@ -0,0 +1,88 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "proton/message_view.hpp"
+
+#include "proton/codec/decoder.hpp"
+#include "proton/delivery.hpp"
+#include "proton/error.hpp"
+#include "proton/message.hpp"
+
+#include <proton/message.h>
+
+#include "proton_bits.hpp"
+#include "types_internal.hpp"
+
+namespace proton {
+
+message_view::message_view() : view_(pn_message_view()) {}
+
+message_view::message_view(const delivery& d) : view_(pn_message_view()) {
+    try {
+        view(d);
+    } catch (...) {
+        pn_message_view_free(view_);
+        throw;
+    }
+}
+
+message_view::~message_view() { pn_message_view_free(view_); }
+
+void message_view::view(const delivery& d) {
+    int err = pn_message_view_recv(view_, unwrap(d));
+    if (err) throw error("message view: " + error_str(err));
+}
+
+void message_view::decode(message& m) const {
+    pn_bytes_t b = pn_message_view_bytes(view_);
+    if (!b.size) throw error("message decode: no data");
+    m.decode(b.start, b.size);
+}
+
+bool message_view::durable() const { return pn_message_view_is_durable(view_); }
+uint8_t message_view::priority() const { return pn_message_view_get_priority(view_); }
+duration message_view::ttl() const { return duration(pn_message_view_get_ttl(view_)); }
+bool message_view::first_acquirer() const { return pn_message_view_is_first_acquirer(view_); }
+uint32_t message_view::delivery_count() const { return pn_message_view_get_delivery_count(view_); }
+
+message_id message_view::id() const { return pn_message_view_get_id(view_); }
+std::string message_view::user() const { return str(pn_message_view_get_user_id(view_)); }
+std::string message_view::to() const { return str(pn_message_view_get_address(view_)); }
+std::string message_view::address() const { return str(pn_message_view_get_address(view_)); }
+std::string message_view::subject() const { return str(pn_message_view_get_subject(view_)); }
+std::string message_view::reply_to() const { return str(pn_message_view_get_reply_to(view_)); }
+message_id message_view::correlation_id() const { return pn_message_view_get_correlation_id(view_); }
+std::string message_view::content_type() const { return str(pn_message_view_get_content_type(view_)); }
+std::string message_view::content_encoding() const { return str(pn_message_view_get_content_encoding(view_)); }
+timestamp message_view::expiry_time() const { return timestamp(pn_message_view_get_expiry_time(view_)); }
+timestamp message_view::creation_time() const { return timestamp(pn_message_view_get_creation_time(view_)); }
+std::string message_view::group_id() const { return str(pn_message_view_get_group_id(view_)); }
+int32_t message_view::group_sequence() const { return pn_message_view_get_group_sequence(view_); }
+std::string message_view::reply_to_group_id() const { return str(pn_message_view_get_reply_to_group_id(view_)); }
+
+value message_view::property(const std::string& key) const {
+    value v;
+    pn_bytes_t b = pn_message_view_property(view_, pn_bytes(key));
+    if (b.size) codec::decoder(v).decode(b.start, b.size);
+    return v;
+}
+
+}
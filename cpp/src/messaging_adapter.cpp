@@ -38,6 +38,8 @@
 #include "msg.hpp"
 #include "proton_bits.hpp"
 
+#include "core/message-internal.h"
+
 #include <proton/connection.h>
 #include <proton/delivery.h>
 #include <proton/handlers.h>
@@ -94,18 +96,15 @@ void on_link_flow(messaging_handler& handler, pn_event_t* event) {
 }
 
 // Decode the message corresponding to a delivery from a link.
+// The delivery's bytes are kept after the link is advanced so that it
+// can still be viewed in on_message(), see pni_delivery_drop_bytes().
 void message_decode(message& msg, proton::delivery delivery) {
-    std::vector<char> buf;
-    buf.resize(pn_delivery_pending(unwrap(delivery)));
-    if (buf.empty())
+    if (!pn_delivery_pending(unwrap(delivery)))
         throw error("message decode: no delivery pending on link");
-    proton::receiver link = delivery.receiver();
-    assert(!buf.empty());
-    ssize_t n = pn_link_recv(unwrap(link), const_cast<char *>(&buf[0]), buf.size());
-    if (n != ssize_t(buf.size())) throw error(MSG("receiver read failure"));
-    msg.clear();
-    msg.decode(buf);
-    pn_link_advance(unwrap(link));
+    // Decode in place from the delivery's buffer without copying it out
+    messaging_adapter::decode(msg, unwrap(delivery));
+    pni_delivery_keep_bytes(unwrap(delivery));
+    pn_link_advance(unwrap(delivery.receiver()));
 }
 
 void on_delivery(messaging_handler& handler, pn_event_t* event) {
@@ -138,6 +137,7 @@ void on_delivery(messaging_handler& handler, pn_event_t* event) {
                     handler.on_receiver_drain_finish(r);
                 }
             }
+            pni_delivery_drop_bytes(dlv);
         }
         else if (pn_delivery_updated(dlv) && d.settled()) {
             handler.on_delivery_settle(d);
@@ -304,6 +304,10 @@ void on_connection_wake(messaging_handler& handler, pn_event_t* event) {
 
 }
 
+void messaging_adapter::decode(message& msg, pn_delivery_t* d) {
+    msg.decode(d);
+}
+
 void messaging_adapter::dispatch(messaging_handler& handler, pn_event_t* event)
 {
     pn_event_type_t type = pn_event_type(event);
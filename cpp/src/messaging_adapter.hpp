@@ -25,9 +25,11 @@
 ///@cond INTERNAL
 
 struct pn_event_t;
+struct pn_delivery_t;
 
 namespace proton {
 
+class message;
 class messaging_handler;
 
 /// Convert the low level proton-c events to the higher level proton::messaging_handler calls
@@ -35,6 +37,8 @@ class messaging_adapter
 {
   public:
     static void dispatch(messaging_handler& delegate, pn_event_t* e);
+    /// Decode a message straight from the bytes of a received delivery
+    static void decode(message& msg, pn_delivery_t* d);
 };
 
 }
@@ -0,0 +1,99 @@
+#ifndef PROTON_CPP_MPSC_QUEUE_HPP
+#define PROTON_CPP_MPSC_QUEUE_HPP
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace proton {
+
+// Bounded lock-free queue for any number of producers and a single consumer.
+//
+// Each slot carries a sequence number telling whose turn it is: a producer
+// may fill slot i of lap n when its sequence is the position itself, the
+// consumer may empty it when the sequence is one past the position. Values
+// live in the slots for the life of the queue so pushing copies into
+// existing storage rather than allocating.
+template <class T> class mpsc_queue {
+  public:
+    explicit mpsc_queue(size_t capacity) :
+        slots_(capacity ? capacity : 1), tail_(0), head_(0)
+    {
+        for (size_t i = 0; i < slots_.size(); ++i)
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return slots_.size(); }
+
+    // Any thread. False if the queue is full.
+    bool push(const T& x) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            slot& s = slots_[pos % slots_.size()];
+            size_t seq = s.seq.load(std::memory_order_acquire);
+            if (seq == pos) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    s.value = x;
+                    s.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (seq < pos) {
+                return false;   // Consumer has not emptied the slot of the previous lap
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer only. False if the queue is empty.
+    bool pop(T& x) {
+        slot& s = slots_[head_ % slots_.size()];
+        if (s.seq.load(std::memory_order_acquire) != head_ + 1) return false;
+        x = s.value;
+        s.value = T();
+        s.seq.store(head_ + slots_.size(), std::memory_order_release);
+        ++head_;
+        return true;
+    }
+
+    // Consumer only.
+    bool empty() const {
+        return slots_[head_ % slots_.size()].seq.load(std::memory_order_acquire) != head_ + 1;
+    }
+
+  private:
+    struct slot {
+        slot() : seq(0), value() {}
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::vector<slot> slots_;
+    std::atomic<size_t> tail_;
+    size_t head_;
+};
+
+}
+
+#endif // PROTON_CPP_MPSC_QUEUE_HPP
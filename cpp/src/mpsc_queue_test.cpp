@@ -0,0 +1,79 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "mpsc_queue.hpp"
+
+#include <catch.hpp>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+using proton::mpsc_queue;
+
+TEST_CASE("mpsc_queue bound", "[mpsc_queue]") {
+    mpsc_queue<std::string> q(3);
+    std::string s;
+    CHECK(q.empty());
+    CHECK(!q.pop(s));
+    CHECK(q.push("a"));
+    CHECK(q.push("b"));
+    CHECK(q.push("c"));
+    CHECK(!q.push("d"));
+    CHECK(q.pop(s));
+    CHECK("a" == s);
+    // Wraps around into the freed slot
+    CHECK(q.push("d"));
+    CHECK(!q.push("e"));
+    for (const char* x : {"b", "c", "d"}) {
+        CHECK(q.pop(s));
+        CHECK(x == s);
+    }
+    CHECK(q.empty());
+}
+
+TEST_CASE("mpsc_queue producers", "[mpsc_queue]") {
+    const int producers = 4, count = 20000;
+    mpsc_queue<std::pair<int, int> > q(16);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.push_back(std::thread([&q, p, count]() {
+            for (int n = 0; n < count; ++n)
+                while (!q.push(std::make_pair(p, n))) std::this_thread::yield();
+        }));
+    }
+    // Each producer's items arrive in order
+    std::vector<int> next(producers, 0);
+    int received = 0;
+    std::pair<int, int> x;
+    while (received < producers * count) {
+        if (q.pop(x)) {
+            REQUIRE(next[x.first] == x.second);
+            ++next[x.first];
+            ++received;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+    CHECK(q.empty());
+}
+
+}
@@ -46,6 +46,8 @@
 #include <vector>
 
 #if PN_CPP_SUPPORTS_THREADS
+# include "mpsc_queue.hpp"
+# include <atomic>
 # include <thread>
 #endif
 
@@ -60,19 +62,42 @@ namespace proton {
 
 class container::impl::common_work_queue : public work_queue::impl {
   public:
-    common_work_queue(container::impl& c): container_(c), finished_(false), running_(false) {}
+    // A capacity of 0 means no limit
+    common_work_queue(container::impl& c, size_t capacity);
 
     typedef std::vector<work> jobs;
 
+    bool add(work f);
     void run_all_jobs();
-    void finished() { GUARD(lock_); finished_ = true; }
+    void finished();
     void schedule(duration, work);
 
-    MUTEX(lock_)
+  protected:
+    // Arrange for run_all_jobs() to be called, on whatever thread serves the queue
+    virtual void notify() = 0;
+
     container::impl& container_;
+#if PN_CPP_SUPPORTS_THREADS
+    // Size of the ring when the queue is unbounded, overflow goes to a locked vector
+    static const size_t unbounded_ring_size = 32;
+
+    void collect(jobs&);
+
+    mpsc_queue<work> ring_;
+    const bool bounded_;
+    MUTEX(lock_)
+    jobs overflow_;             // Guarded by lock_
+    std::atomic<bool> overflowing_;
+    std::atomic<bool> notified_;
+    std::atomic<bool> finished_;
+    std::atomic<int> adding_;
+    std::atomic<bool> running_;
+    jobs batch_;
+#else
     jobs jobs_;
     bool finished_;
     bool running_;
+#endif
 };
 
 void container::impl::common_work_queue::schedule(duration d, work f) {
@@ -82,65 +107,121 @@ void container::impl::common_work_queue::schedule(duration d, work f) {
     container_.schedule(d, make_work(&work_queue::impl::add_void, (work_queue::impl*)this, f));
 }
 
-void container::impl::common_work_queue::run_all_jobs() {
-    jobs j;
-    // Lock this operation for mt
+#if PN_CPP_SUPPORTS_THREADS
+container::impl::common_work_queue::common_work_queue(container::impl& c, size_t capacity) :
+    container_(c), ring_(capacity ? capacity : unbounded_ring_size), bounded_(capacity != 0),
+    overflowing_(false), notified_(false), finished_(false), adding_(0), running_(false)
+{}
+
+// Adding takes no lock unless an unbounded queue has filled its ring. Only
+// the add that finds the queue un-notified calls notify(), so a burst of work
+// costs a single wake.
+bool container::impl::common_work_queue::add(work f) {
+    // finished() waits for adds in progress, after it the connection may be gone
+    ++adding_;
+    bool added = false;
+    if (!finished_) {
+        if (!overflowing_.load(std::memory_order_acquire) && ring_.push(f)) {
+            added = true;
+        } else if (!bounded_) {
+            // Once work overflows, keep adding there until the overflow is
+            // drained so each producer's work stays in order.
+            GUARD(lock_);
+            overflow_.push_back(f);
+            overflowing_.store(true, std::memory_order_relaxed);
+            added = true;
+        }
+        if (added && !notified_.exchange(true)) notify();
+    }
+    --adding_;
+    return added;
+}
+
+void container::impl::common_work_queue::finished() {
+    finished_ = true;
+    while (adding_) std::this_thread::yield();
+}
+
+// Move the queued work to j in the order it was added
+void container::impl::common_work_queue::collect(jobs& j) {
+    work f;
+    while (ring_.pop(f)) j.push_back(f);
+    jobs o;
     {
         GUARD(lock_);
-        // Ensure that we never run work from this queue concurrently
-        if (running_) return;
-        running_ = true;
-        // But allow adding to the queue concurrently to running
-        std::swap(j, jobs_);
+        std::swap(o, overflow_);
+        if (o.empty()) overflowing_.store(false, std::memory_order_relaxed);
+    }
+    if (!o.empty()) {
+        // Work that made it into the ring before the overflow began
+        while (ring_.pop(f)) j.push_back(f);
+        j.insert(j.end(), o.begin(), o.end());
+    }
+}
+
+void container::impl::common_work_queue::run_all_jobs() {
+    // Ensure that we never run work from this queue concurrently
+    if (running_.exchange(true)) return;
+    // Work added from here on needs a new notification. This is called for
+    // every connection event so look before writing.
+    if (notified_.load(std::memory_order_relaxed) && notified_.exchange(false)) {
+        collect(batch_);
+        // Run queued work, but ignore any exceptions
+        for (jobs::iterator f = batch_.begin(); f != batch_.end(); ++f) try {
+            (*f)();
+        } catch (...) {};
+        batch_.clear();
     }
+    running_ = false;
+}
+
+#else
+container::impl::common_work_queue::common_work_queue(container::impl& c, size_t) :
+    container_(c), finished_(false), running_(false)
+{}
+
+bool container::impl::common_work_queue::add(work f) {
+    // Note this is an unbounded work queue.
+    // A resource-safe implementation should be bounded.
+    if (finished_) return false;
+    jobs_.push_back(f);
+    notify();
+    return true;
+}
+
+void container::impl::common_work_queue::finished() { finished_ = true; }
+
+void container::impl::common_work_queue::run_all_jobs() {
+    if (running_) return;
+    running_ = true;
+    jobs j;
+    std::swap(j, jobs_);
     // Run queued work, but ignore any exceptions
     for (jobs::iterator f = j.begin(); f != j.end(); ++f) try {
         (*f)();
     } catch (...) {};
-    {
-        GUARD(lock_);
-        running_ = false;
-    }
-    return;
+    running_ = false;
 }
+#endif
 
 class container::impl::connection_work_queue : public common_work_queue {
   public:
-    connection_work_queue(container::impl& ct, pn_connection_t* c): common_work_queue(ct), connection_(c) {}
+    connection_work_queue(container::impl& ct, pn_connection_t* c, size_t capacity) :
+        common_work_queue(ct, capacity), connection_(c) {}
 
-    bool add(work f);
+    void notify() { pn_connection_wake(connection_); }
 
     pn_connection_t* connection_;
 };
 
-bool container::impl::connection_work_queue::add(work f) {
-    // Note this is an unbounded work queue.
-    // A resource-safe implementation should be bounded.
-    GUARD(lock_);
-    if (finished_) return false;
-    jobs_.push_back(f);
-    pn_connection_wake(connection_);
-    return true;
-}
-
 class container::impl::container_work_queue : public common_work_queue {
   public:
-    container_work_queue(container::impl& c): common_work_queue(c) {}
+    container_work_queue(container::impl& c): common_work_queue(c, 0) {}
     ~container_work_queue() { container_.remove_work_queue(this); }
 
-    bool add(work f);
+    void notify() { pn_proactor_set_timeout(container_.proactor_, 0); }
 };
 
-bool container::impl::container_work_queue::add(work f) {
-    // Note this is an unbounded work queue.
-    // A resource-safe implementation should be bounded.
-    GUARD(lock_);
-    if (finished_) return false;
-    jobs_.push_back(f);
-    pn_proactor_set_timeout(container_.proactor_, 0);
-    return true;
-}
-
 class work_queue::impl* container::impl::make_work_queue(container& c) {
     return c.impl_->add_work_queue();
 }
@@ -148,10 +229,17 @@ class work_queue::impl* container::impl::make_work_queue(container& c) {
 container::impl::impl(container& c, const std::string& id, messaging_handler* mh)
     : threads_(0), container_(c), proactor_(pn_proactor()), handler_(mh), id_(id),
       reconnecting_(0), auto_stop_(true), stopping_(false)
-{}
+{
+    pni_timer_wheel_init(&deferred_, timestamp::now().milliseconds());
+    deferred_timeout_ = 0;
+}
 
 container::impl::~impl() {
     pn_proactor_free(proactor_);
+    // Discard work that never came due
+    pni_timer_wheel_advance(&deferred_, ~uint64_t(0));
+    while (pni_timer_entry_t* e = pni_timer_wheel_pop(&deferred_))
+        delete static_cast<scheduled*>(e);
 }
 
 container::impl::container_work_queue* container::impl::add_work_queue() {
@@ -198,7 +286,7 @@ pn_connection_t* container::impl::make_connection_lh(
     connection_context& cc(connection_context::get(pnc));
     cc.container = &container_;
     cc.handler = mh;
-    cc.work_queue_ = new container::impl::connection_work_queue(*container_.impl_, pnc);
+    cc.work_queue_ = new container::impl::connection_work_queue(*container_.impl_, pnc, opts.work_queue_capacity());
     cc.reconnect_url_ = url;
     cc.connection_options_.reset(new connection_options(opts));
 
@@ -464,18 +552,21 @@ proton::listener container::impl::listen(const std::string& addr, proton::listen
 }
 
 void container::impl::schedule(duration delay, work f) {
+    scheduled* s = new scheduled;
+    pni_timer_entry_init(s);
+    s->task = f;
+
     GUARD(deferred_lock_);
     timestamp now = timestamp::now();
-
-    // Record timeout; Add callback to timeout sorted list
-    scheduled s = {now+delay, f};
-    deferred_.push_back(s);
-    std::push_heap(deferred_.begin(), deferred_.end());
-
-    // Set timeout for current head of timeout queue
-    scheduled* next = &deferred_.front();
-    pn_millis_t timeout_ms = (now < next->time) ? (next->time-now).milliseconds() : 0;
-    pn_proactor_set_timeout(proactor_, timeout_ms);
+    uint64_t deadline = (now+delay).milliseconds();
+    pni_timer_wheel_add(&deferred_, s, deadline);
+
+    // Only move the timeout if this is now the first work due
+    if (!deferred_timeout_ || deadline < deferred_timeout_) {
+        deferred_timeout_ = deadline;
+        uint64_t timeout_ms = (now.milliseconds() < int64_t(deadline)) ? deadline-now.milliseconds() : 0;
+        pn_proactor_set_timeout(proactor_, pn_millis_t(std::min<uint64_t>(timeout_ms, 0xFFFFFFFF)));
+    }
 }
 
 void container::impl::client_connection_options(const connection_options &opts) {
@@ -499,51 +590,29 @@ void container::impl::receiver_options(const proton::receiver_options &opts) {
 }
 
 void container::impl::run_timer_jobs() {
-    timestamp now = timestamp::now();
-    std::vector<scheduled> tasks;
+    std::vector<work> tasks;
 
     // We first extract all the runnable tasks and then run them -  this is to avoid having tasks
     // injected as we are running them (which could potentially never end)
     {
         GUARD(deferred_lock_);
-
-        // Figure out how many tasks we need to execute and pop them to the back of the
-        // queue (in reverse order)
-        unsigned i = 0;
-        for (;;) {
-            // Have we seen all the queued tasks?
-            if  ( deferred_.size()-i==0 ) break;
-
-            // Is the next task in the future?
-            timestamp next_time = deferred_.front().time;
-            if ( next_time>now ) {
-                pn_proactor_set_timeout(proactor_, (next_time-now).milliseconds());
-                break;
-            }
-
-            std::pop_heap(deferred_.begin(), deferred_.end()-i);
-            ++i;
-        }
-        // Nothing to do
-        if ( i==0 ) return;
-
-        // Now we know how many tasks to run
-        if ( deferred_.size()==i ) {
-            // If we sorted the entire heap, then we're executing every task
-            // so don't need to copy and can just swap
-            tasks.swap(deferred_);
-        } else {
-            // Otherwise just copy the ones we sorted
-            tasks = std::vector<scheduled>(deferred_.end()-i, deferred_.end());
-
-            // Remove tasks to be executed
-            deferred_.resize(deferred_.size()-i);
+        timestamp::numeric_type now = timestamp::now().milliseconds();
+        pni_timer_wheel_advance(&deferred_, now);
+        while (pni_timer_entry_t* e = pni_timer_wheel_pop(&deferred_)) {
+            scheduled* s = static_cast<scheduled*>(e);
+            tasks.push_back(s->task);
+            delete s;
         }
+
+        // Set the timeout for whatever comes next, this may be early for
+        // work that is far off but the wheel catches up then.
+        deferred_timeout_ = pni_timer_wheel_next(&deferred_);
+        if (deferred_timeout_)
+            pn_proactor_set_timeout(proactor_, pn_millis_t(std::min<uint64_t>(deferred_timeout_-now, 0xFFFFFFFF)));
     }
     // We've now taken the tasks to run from the deferred tasks
-    // so we can run them unlocked
-    // NB. We copied the due tasks in reverse order so execute from end
-    for (int i = tasks.size()-1; i>=0; --i) tasks[i].task();
+    // so we can run them unlocked, in the order they came due
+    for (std::vector<work>::iterator i = tasks.begin(); i != tasks.end(); ++i) (*i)();
 }
 
 // Return true if this thread is finished
@@ -627,7 +696,7 @@ container::impl::dispatch_result container::impl::dispatch(pn_event_t* event) {
         cc.container = &container_;
         cc.listener_context_ = lc;
         cc.handler = opts.handler();
-        cc.work_queue_ = new container::impl::connection_work_queue(*container_.impl_, c);
+        cc.work_queue_ = new container::impl::connection_work_queue(*container_.impl_, c, opts.work_queue_capacity());
         pn_transport_t* pnt = pn_transport();
         pn_transport_set_server(pnt);
         opts.apply_unbound_server(pnt);
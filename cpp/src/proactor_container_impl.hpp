@@ -37,6 +37,8 @@
 
 #include "proton_bits.hpp"
 
+#include "core/timer_wheel.h"
+
 #include <list>
 #include <map>
 #include <set>
@@ -129,14 +131,12 @@ class container::impl {
     container_work_queue* add_work_queue();
     void remove_work_queue(container_work_queue*);
 
-    struct scheduled {
-        timestamp time; // duration from epoch for task
+    // Work for schedule() on the deferred_ wheel, timed in milliseconds from the epoch
+    struct scheduled : pni_timer_entry_t {
         work task;
-
-        // We want to get to get the *earliest* first so test is "reversed"
-        bool operator < (const scheduled& r) const { return  r.time < time; }
     };
-    std::vector<scheduled> deferred_; // This vector is kept as a heap
+    pni_timer_wheel_t deferred_;
+    uint64_t deferred_timeout_; // When the proactor timeout is set to go off for deferred_, 0 if not set
     MUTEX(deferred_lock_)
 
     pn_proactor_t* proactor_;
@@ -21,7 +21,9 @@
 
 #include "proton/sender.hpp"
 
+#include "proton/error.hpp"
 #include "proton/link.hpp"
+#include "proton/message_view.hpp"
 #include "proton/sender_options.hpp"
 #include "proton/source.hpp"
 #include "proton/target.hpp"
@@ -29,6 +31,7 @@
 
 #include <proton/delivery.h>
 #include <proton/link.h>
+#include <proton/message.h>
 #include <proton/types.h>
 
 #include "proton_bits.hpp"
@@ -62,23 +65,33 @@ class target sender::target() const {
 namespace {
 // TODO: revisit if thread safety required
 uint64_t tag_counter = 0;
-}
 
-tracker sender::send(const message &message) {
+pn_delivery_t* next_delivery(pn_link_t* l) {
     uint64_t id = ++tag_counter;
-    pn_delivery_t *dlv =
-        pn_delivery(pn_object(), pn_dtag(reinterpret_cast<const char*>(&id), sizeof(id)));
-    std::vector<char> buf;
-    message.encode(buf);
-    assert(!buf.empty());
-    pn_link_send(pn_object(), &buf[0], buf.size());
-    pn_link_advance(pn_object());
-    if (pn_link_snd_settle_mode(pn_object()) == PN_SND_SETTLED)
+    return pn_delivery(l, pn_dtag(reinterpret_cast<const char*>(&id), sizeof(id)));
+}
+
+tracker sent(pn_link_t* l, pn_delivery_t* dlv) {
+    if (pn_link_snd_settle_mode(l) == PN_SND_SETTLED)
         pn_delivery_settle(dlv);
-    if (!pn_link_credit(pn_object()))
-        link_context::get(pn_object()).draining = false;
+    if (!pn_link_credit(l))
+        link_context::get(l).draining = false;
     return make_wrapper<tracker>(dlv);
 }
+}
+
+tracker sender::send(const message &message) {
+    pn_delivery_t *dlv = next_delivery(pn_object());
+    message.send(pn_object());
+    return sent(pn_object(), dlv);
+}
+
+tracker sender::send(const message_view &message) {
+    pn_delivery_t *dlv = next_delivery(pn_object());
+    ssize_t err = pn_message_view_send(message.view_, pn_object());
+    if (err < 0) throw proton::error(error_str(err));
+    return sent(pn_object(), dlv);
+}
 
 void sender::return_credit() {
     link_context &lctx = link_context::get(pn_object());
@@ -75,7 +75,7 @@ endif()
 # Eventually all the C++ tests will migrate to Catch2.
 
 include_directories(${CMAKE_SOURCE_DIR}/tests/include)
-add_executable(cpp-test src/cpp-test.cpp src/url_test.cpp)
+add_executable(cpp-test src/cpp-test.cpp src/url_test.cpp src/mpsc_queue_test.cpp)
 target_link_libraries(cpp-test qpid-proton-cpp ${PLATFORM_LIBS})
 # tests that require access to pn_ functions in qpid-proton-core
 add_executable(cpp-core-test src/cpp-test.cpp src/object_test.cpp)
@@ -100,4 +100,5 @@ macro(add_core_catch_test tag)
 endmacro(add_core_catch_test)
 
 add_catch_test(url)
+add_catch_test(mpsc_queue)
 add_core_catch_test(object)